@@ -9,6 +9,7 @@
  */
 
 #include <cstdlib>
+#include <algorithm>
 #include "Buffer.h"
 #include "Util/onceToken.h"
 
@@ -17,6 +18,7 @@ namespace toolkit {
 StatisticImp(Buffer)
 StatisticImp(BufferRaw)
 StatisticImp(BufferLikeString)
+StatisticImp(BufferRope)
 
 BufferRaw::Ptr BufferRaw::create(size_t size) {
 #if 0
@@ -32,4 +34,244 @@ BufferRaw::Ptr BufferRaw::create(size_t size) {
 #endif
 }
 
+/////////////////////////////////////// BufferRope ///////////////////////////////////////
+
+// 拷贝式追加使用的块大小
+// Chunk size used by copying appends
+static constexpr size_t kRopeChunkSize = 16 * 1024;
+
+char *BufferRope::data() const {
+    if (_slices.empty()) {
+        return nullptr;
+    }
+    if (_slices.size() == 1) {
+        return _slices.front().data();
+    }
+    auto flat = std::atomic_load(&_flat);
+    if (!flat) {
+        // 合并为连续拷贝，并发调用时只保留最先完成的一份
+        // Merge into a contiguous copy, only the first one finished is kept when called concurrently
+        auto merged = BufferRaw::create(_size + 1);
+        copyTo(merged->data(), 0, _size);
+        merged->data()[_size] = '\0';
+        merged->setSize(_size);
+        if (std::atomic_compare_exchange_strong(&_flat, &flat, merged)) {
+            flat = std::move(merged);
+        }
+    }
+    return flat->data();
+}
+
+std::string BufferRope::toString() const {
+    std::string ret;
+    ret.resize(_size);
+    copyTo(&ret[0], 0, _size);
+    return ret;
+}
+
+void BufferRope::append(Buffer::Ptr buffer, size_t offset, size_t len) {
+    if (!buffer || offset >= buffer->size() || !len) {
+        return;
+    }
+    len = std::min(len, buffer->size() - offset);
+    _flat = nullptr;
+    _size += len;
+    _slices.push_back(Slice { std::move(buffer), offset, len });
+}
+
+void BufferRope::prepend(Buffer::Ptr buffer, size_t offset, size_t len) {
+    if (!buffer || offset >= buffer->size() || !len) {
+        return;
+    }
+    len = std::min(len, buffer->size() - offset);
+    _flat = nullptr;
+    _size += len;
+    _slices.push_front(Slice { std::move(buffer), offset, len });
+}
+
+void BufferRope::append(const BufferRope &that) {
+    if (that.empty()) {
+        return;
+    }
+    _flat = nullptr;
+    if (&that == this) {
+        auto slices = _slices;
+        _slices.insert(_slices.end(), slices.begin(), slices.end());
+        _size *= 2;
+        return;
+    }
+    _slices.insert(_slices.end(), that._slices.begin(), that._slices.end());
+    _size += that._size;
+}
+
+void BufferRope::append(const char *data, size_t len) {
+    if (len) {
+        _flat = nullptr;
+    }
+    while (len) {
+        // 最后一个片段正好结束于块的末尾时，直接在块中续写
+        // Write into the chunk directly if the last slice ends exactly at the end of the chunk
+        if (_chunk && _chunk->getCapacity() > _chunk->size() && !_slices.empty()) {
+            auto &back = _slices.back();
+            if (back.buffer == _chunk && back.offset + back.size == _chunk->size()) {
+                auto count = std::min(len, _chunk->getCapacity() - _chunk->size());
+                memcpy(_chunk->data() + _chunk->size(), data, count);
+                _chunk->setSize(_chunk->size() + count);
+                back.size += count;
+                _size += count;
+                data += count;
+                len -= count;
+                continue;
+            }
+        }
+        _chunk = BufferRaw::create(std::max(len, kRopeChunkSize));
+        _chunk->setSize(0);
+        _slices.push_back(Slice { _chunk, 0, 0 });
+    }
+}
+
+std::deque<BufferRope::Slice>::const_iterator BufferRope::locate(size_t &pos) const {
+    auto it = _slices.begin();
+    while (it != _slices.end() && pos >= it->size) {
+        pos -= it->size;
+        ++it;
+    }
+    return it;
+}
+
+BufferRope::Ptr BufferRope::slice(size_t pos, size_t len) const {
+    auto ret = create();
+    if (pos >= _size) {
+        return ret;
+    }
+    len = std::min(len, _size - pos);
+    for (auto it = locate(pos); len && it != _slices.end(); ++it, pos = 0) {
+        auto count = std::min(len, it->size - pos);
+        ret->_slices.push_back(Slice { it->buffer, it->offset + pos, count });
+        ret->_size += count;
+        len -= count;
+    }
+    return ret;
+}
+
+BufferRope::Ptr BufferRope::split(size_t len) {
+    auto ret = create();
+    len = std::min(len, _size);
+    if (len) {
+        _flat = nullptr;
+    }
+    while (len) {
+        auto &front = _slices.front();
+        if (front.size <= len) {
+            len -= front.size;
+            _size -= front.size;
+            ret->_size += front.size;
+            ret->_slices.push_back(std::move(front));
+            _slices.pop_front();
+            continue;
+        }
+        ret->_slices.push_back(Slice { front.buffer, front.offset, len });
+        ret->_size += len;
+        front.offset += len;
+        front.size -= len;
+        _size -= len;
+        break;
+    }
+    return ret;
+}
+
+void BufferRope::erase(size_t n) {
+    n = std::min(n, _size);
+    if (n) {
+        _flat = nullptr;
+    }
+    while (n) {
+        auto &front = _slices.front();
+        if (front.size <= n) {
+            n -= front.size;
+            _size -= front.size;
+            _slices.pop_front();
+            continue;
+        }
+        front.offset += n;
+        front.size -= n;
+        _size -= n;
+        break;
+    }
+}
+
+void BufferRope::clear() {
+    _flat = nullptr;
+    _slices.clear();
+    _size = 0;
+}
+
+char BufferRope::operator[](size_t pos) const {
+    if (pos >= _size) {
+        throw std::out_of_range("BufferRope::operator[] out_of_range");
+    }
+    auto it = locate(pos);
+    return it->data()[pos];
+}
+
+size_t BufferRope::copyTo(char *dst, size_t pos, size_t len) const {
+    if (pos >= _size) {
+        return 0;
+    }
+    len = std::min(len, _size - pos);
+    auto ret = len;
+    for (auto it = locate(pos); len && it != _slices.end(); ++it, pos = 0) {
+        auto count = std::min(len, it->size - pos);
+        memcpy(dst, it->data() + pos, count);
+        dst += count;
+        len -= count;
+    }
+    return ret;
+}
+
+static const char *searchInSlice(const char *begin, const char *end, const char *pattern, size_t len) {
+    while (end - begin >= (std::ptrdiff_t)len) {
+        begin = (const char *)memchr(begin, pattern[0], end - begin - len + 1);
+        if (!begin) {
+            return nullptr;
+        }
+        if (memcmp(begin, pattern, len) == 0) {
+            return begin;
+        }
+        ++begin;
+    }
+    return nullptr;
+}
+
+size_t BufferRope::find(const char *pattern, size_t len, size_t pos) const {
+    if (!len || pos >= _size || len > _size - pos) {
+        return std::string::npos;
+    }
+    auto base = pos;
+    auto it = locate(pos);
+    base -= pos;
+    std::string tail;
+    for (; it != _slices.end(); base += it->size, ++it, pos = 0) {
+        auto begin = it->data();
+        auto end = begin + it->size;
+        if (auto hit = searchInSlice(begin + pos, end, pattern, len)) {
+            return base + (hit - begin);
+        }
+        // 检查跨越本片段末尾的位置
+        // Check the positions spanning the end of this slice
+        auto cross_begin = std::max(pos, it->size >= len ? it->size - len + 1 : 0);
+        for (auto i = cross_begin; i < it->size; ++i) {
+            if (base + i + len > _size) {
+                return std::string::npos;
+            }
+            tail.resize(len);
+            copyTo(&tail[0], base + i, len);
+            if (memcmp(tail.data(), pattern, len) == 0) {
+                return base + i;
+            }
+        }
+    }
+    return std::string::npos;
+}
+
 }//namespace toolkit
@@ -12,6 +12,7 @@
 #define ZLTOOLKIT_BUFFER_H
 
 #include <cassert>
+#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
@@ -50,7 +51,28 @@ public:
         return size();
     }
 
+    /**
+     * 设置发送优先级与是否可丢弃，socket设置了丢弃策略且发送拥塞时，可丢弃的数据(例如非关键帧)按优先级从低到高被丢弃
+     * 同一Buffer发送给多个socket时标记共享
+     * @param priority 优先级，越大越重要，默认0
+     * @param droppable 是否可丢弃，默认不可丢弃
+     * Set the send priority and whether it is droppable, when the socket has a drop policy and sending is congested,
+     * droppable data (such as non-key frames) is dropped from the lowest priority up
+     * The tags are shared when the same Buffer is sent to multiple sockets
+     * @param priority Priority, larger is more important, 0 by default
+     * @param droppable Whether it is droppable, not droppable by default
+     */
+    void setSendPriority(int8_t priority, bool droppable = true) {
+        _send_priority = priority;
+        _droppable = droppable;
+    }
+
+    int8_t getSendPriority() const { return _send_priority; }
+    bool isDroppable() const { return _droppable; }
+
 private:
+    int8_t _send_priority = 0;
+    bool _droppable = false;
     //对象个数统计  [AUTO-TRANSLATED:3b43e8c2]
     //Object count statistics
     ObjectStatistic<Buffer> _statistic;
@@ -487,5 +509,112 @@ private:
     ObjectStatistic<BufferLikeString> _statistic;
 };
 
+/**
+ * 引用计数的链式缓存(rope)
+ * 由若干指向其他Buffer的片段组成，追加、前插、切分、截取只增减片段引用，不拷贝数据；
+ * 发送时BufferSendMsg直接把各片段作为iovec交给sendmsg；
+ * 调用data()时若有多个片段，会合并为一个连续片段(仅此一次拷贝)以兼容只接受连续内存的接口；
+ * 注意：socket的接收缓存会被复用，引用前需转移其所有权，或者使用拷贝式的append(data, len)
+ * Reference counted chained buffer (rope)
+ * Consists of slices referencing other Buffers, appending, prepending, splitting and slicing only add or drop slice references without copying data;
+ * when sending, BufferSendMsg passes each slice to sendmsg as an iovec directly;
+ * if there are multiple slices when data() is called, they are merged into a single contiguous slice (copied only this once)
+ * for compatibility with interfaces accepting contiguous memory only;
+ * Note: the receive buffer of a socket is reused, take its ownership before referencing it, or use the copying append(data, len)
+ */
+class BufferRope final : public Buffer {
+public:
+    using Ptr = std::shared_ptr<BufferRope>;
+
+    struct Slice {
+        Buffer::Ptr buffer;
+        size_t offset;
+        size_t size;
+
+        char *data() const { return buffer->data() + offset; }
+    };
+
+    static Ptr create() { return std::make_shared<BufferRope>(); }
+
+    char *data() const override;
+    size_t size() const override { return _size; }
+    std::string toString() const override;
+
+    /**
+     * 在末尾或开头引用buffer的[offset, offset + len)部分，O(1)
+     * Reference the [offset, offset + len) part of the buffer at the end or the beginning, O(1)
+     */
+    void append(Buffer::Ptr buffer, size_t offset = 0, size_t len = std::string::npos);
+    void prepend(Buffer::Ptr buffer, size_t offset = 0, size_t len = std::string::npos);
+
+    /**
+     * 引用另一个rope的所有片段
+     * Reference all slices of another rope
+     */
+    void append(const BufferRope &that);
+
+    /**
+     * 拷贝数据到末尾，数据写入rope自有的定长块中，连续的小块追加不会产生大量片段
+     * Copy data to the end, the data is written into fixed-size chunks owned by the rope, consecutive small appends do not produce lots of slices
+     */
+    void append(const char *data, size_t len);
+
+    /**
+     * 截取[pos, pos + len)部分作为新的rope，共享底层数据
+     * Take the [pos, pos + len) part as a new rope, sharing the underlying data
+     */
+    Ptr slice(size_t pos, size_t len = std::string::npos) const;
+
+    /**
+     * 从本rope中切下前len个字节并返回，共享底层数据
+     * Cut the first len bytes off this rope and return them, sharing the underlying data
+     */
+    Ptr split(size_t len);
+
+    /**
+     * 移除前n个字节
+     * Remove the first n bytes
+     */
+    void erase(size_t n);
+    void clear();
+    bool empty() const { return _size == 0; }
+
+    /**
+     * 查找字符串，可跨越片段边界，未找到返回std::string::npos
+     * Find a string, which may span slice boundaries, std::string::npos is returned if not found
+     */
+    size_t find(const char *pattern, size_t len, size_t pos) const;
+    size_t find(const std::string &pattern, size_t pos = 0) const { return find(pattern.data(), pattern.size(), pos); }
+
+    char operator[](size_t pos) const;
+
+    /**
+     * 拷贝[pos, pos + len)部分到dst，返回实际拷贝的字节数
+     * Copy the [pos, pos + len) part to dst, return the bytes actually copied
+     */
+    size_t copyTo(char *dst, size_t pos, size_t len) const;
+
+    const std::deque<Slice> &slices() const { return _slices; }
+
+private:
+    // 定位pos所在的片段及其在片段中的偏移
+    // Locate the slice containing pos and the offset in it
+    std::deque<Slice>::const_iterator locate(size_t &pos) const;
+
+private:
+    size_t _size = 0;
+    std::deque<Slice> _slices;
+    // data()合并出的连续拷贝，只设置一次，片段本身保持不变，因此已发布给多个线程的rope可安全并发读取；修改rope时清空
+    // Contiguous copy merged by data(), set only once while the slices stay untouched, so a rope published to several
+    // threads can be read concurrently; cleared when the rope is modified
+    mutable std::shared_ptr<BufferRaw> _flat;
+    // 拷贝式追加时写入的块
+    // Chunk written by copying appends
+    std::shared_ptr<BufferRaw> _chunk;
+    //对象个数统计
+    //Object count statistics
+    ObjectStatistic<BufferRope> _statistic;
+};
+
 }//namespace toolkit
 #endif //ZLTOOLKIT_BUFFER_H
@@ -9,9 +9,11 @@
  */
 
 #include <assert.h>
+#include <typeinfo>
 #include "BufferSock.h"
 #include "Util/logger.h"
 #include "Util/uv_errno.h"
+#include "Poller/PollerMetrics.h"
 
 #if defined(__linux__) || defined(__linux)
 
@@ -64,6 +66,9 @@ BufferSock::BufferSock(Buffer::Ptr buffer, struct sockaddr *addr, int addr_len)
         memcpy(&_addr, addr, _addr_len);
     }
     assert(buffer);
+    // 继承发送优先级标记
+    // Inherit the send priority tags
+    setSendPriority(buffer->getSendPriority(), buffer->isDroppable());
     _buffer = std::move(buffer);
 }
 
@@ -85,6 +90,18 @@ socklen_t BufferSock::socklen() const {
 
 /////////////////////////////////////// BufferCallBack ///////////////////////////////////////
 
+static inline void onSendSyscall(ssize_t bytes) {
+    if (MetricsRegistry::enabled()) {
+        PollerMetrics::current().onSendSyscall(bytes);
+    }
+}
+
+static inline void onSendPackets(size_t packets) {
+    if (packets && MetricsRegistry::enabled()) {
+        PollerMetrics::current().send_packets->add(packets);
+    }
+}
+
 class BufferCallBack {
 public:
     BufferCallBack(List<std::pair<Buffer::Ptr, bool> > list, BufferList::SendResult cb)
@@ -96,6 +113,9 @@ public:
     }
 
     void sendCompleted(bool flag) {
+        if (flag) {
+            onSendPackets(_pkt_list.size());
+        }
         if (_cb) {
             //全部发送成功或失败回调  [AUTO-TRANSLATED:6b9a9abf]
             //All send success or failure callback
@@ -109,6 +129,7 @@ public:
     }
 
     void sendFrontSuccess() {
+        onSendPackets(1);
         if (_cb) {
             //发送成功回调  [AUTO-TRANSLATED:52759efc]
             //Send success callback
@@ -144,10 +165,16 @@ private:
     void reOffset(size_t n);
     ssize_t send_l(int fd, int flags);
 
+private:
+    void addIovec(char *data, size_t size, bool pkt_end);
+
 private:
     size_t _iovec_off = 0;
     size_t _remain_size = 0;
     SocketBufVec _iovec;
+    // 该iovec是否为一个包的最后一段，BufferRope会展开为多个iovec
+    // Whether the iovec is the last segment of a packet, a BufferRope is expanded into multiple iovecs
+    std::vector<bool> _pkt_end;
 };
 
 bool BufferSendMsg::empty() {
@@ -155,7 +182,7 @@ bool BufferSendMsg::empty() {
 }
 
 size_t BufferSendMsg::count() {
-    return _iovec.size() - _iovec_off;
+    return _pkt_list.size();
 }
 
 ssize_t BufferSendMsg::send_l(int fd, int flags) {
@@ -174,6 +201,7 @@ ssize_t BufferSendMsg::send_l(int fd, int flags) {
         msg.msg_controllen = 0;
         msg.msg_flags = flags;
         n = sendmsg(fd, &msg, flags);
+        onSendSyscall(n);
     } while (-1 == n && UV_EINTR == get_uv_error(true));
 #else
     do {
@@ -232,7 +260,9 @@ void BufferSendMsg::reOffset(size_t n) {
         if (offset < n) {
             //此包发送完毕  [AUTO-TRANSLATED:759b9f0e]
             //This package is sent
-            sendFrontSuccess();
+            if (_pkt_end[i]) {
+                sendFrontSuccess();
+            }
             continue;
         }
         _iovec_off = i;
@@ -240,7 +270,9 @@ void BufferSendMsg::reOffset(size_t n) {
             //这是末尾发送完毕的一个包  [AUTO-TRANSLATED:6a3b77e4]
             //This is the last package sent
             ++_iovec_off;
-            sendFrontSuccess();
+            if (_pkt_end[i]) {
+                sendFrontSuccess();
+            }
             break;
         }
         //这是末尾发送部分成功的一个包  [AUTO-TRANSLATED:64645cef]
@@ -257,21 +289,37 @@ void BufferSendMsg::reOffset(size_t n) {
     }
 }
 
-BufferSendMsg::BufferSendMsg(List<std::pair<Buffer::Ptr, bool>> list, SendResult cb)
-    : BufferCallBack(std::move(list), std::move(cb))
-    , _iovec(_pkt_list.size()) {
-    auto it = _iovec.begin();
-    _pkt_list.for_each([&](std::pair<Buffer::Ptr, bool> &pr) {
+void BufferSendMsg::addIovec(char *data, size_t size, bool pkt_end) {
+    SocketBuf buf;
 #if !defined(_WIN32)
-        it->iov_base = pr.first->data();
-        it->iov_len = pr.first->size();
-        _remain_size += it->iov_len;
+    buf.iov_base = data;
+    buf.iov_len = size;
 #else
-        it->buf = pr.first->data();
-        it->len = pr.first->size();
-        _remain_size += it->len;
+    buf.buf = data;
+    buf.len = static_cast<ULONG>(size);
 #endif
-        ++it;
+    _iovec.emplace_back(buf);
+    _pkt_end.emplace_back(pkt_end);
+    _remain_size += size;
+}
+
+BufferSendMsg::BufferSendMsg(List<std::pair<Buffer::Ptr, bool>> list, SendResult cb)
+    : BufferCallBack(std::move(list), std::move(cb)) {
+    _iovec.reserve(_pkt_list.size());
+    _pkt_end.reserve(_pkt_list.size());
+    _pkt_list.for_each([&](std::pair<Buffer::Ptr, bool> &pr) {
+        auto &buf = *pr.first;
+        if (typeid(buf) == typeid(BufferRope) && !static_cast<BufferRope &>(buf).empty()) {
+            // 链式缓存各片段直接作为iovec发送，不合并
+            // Each slice of the chained buffer is sent as an iovec directly without merging
+            auto &slices = static_cast<BufferRope &>(buf).slices();
+            auto last = slices.size() - 1;
+            for (size_t i = 0; i <= last; ++i) {
+                addIovec(slices[i].data(), slices[i].size, i == last);
+            }
+            return;
+        }
+        addIovec(buf.data(), buf.size(), true);
     });
 }
 
@@ -321,6 +369,7 @@ ssize_t BufferSendTo::send(int fd, int flags) {
         } else {
             n = ::send(fd, buffer->data() + _offset, buffer->size() - _offset, flags);
         }
+        onSendSyscall(n);
 
         if (n >= 0) {
             assert(n);
@@ -366,10 +415,22 @@ private:
 
 private:
     size_t _remain_size = 0;
+    // 每个udp包占用一个或多个iovec，BufferRope按片段展开
+    // Each udp packet occupies one or more iovecs, a BufferRope is expanded by slices
     std::vector<struct iovec> _iovec;
     std::vector<struct mmsghdr> _hdrvec;
 };
 
+// 获取待发送的链式缓存，可能被BufferSock包裹
+// Get the chained buffer to send, which may be wrapped by BufferSock
+static inline BufferRope *getBufferRope(std::pair<Buffer::Ptr, bool> &pr) {
+    auto buf = pr.second ? static_cast<BufferSock *>(pr.first.get())->buffer().get() : pr.first.get();
+    if (typeid(*buf) != typeid(BufferRope) || static_cast<BufferRope *>(buf)->empty()) {
+        return nullptr;
+    }
+    return static_cast<BufferRope *>(buf);
+}
+
 bool BufferSendMMsg::empty() {
     return _remain_size == 0;
 }
@@ -382,6 +443,17 @@ ssize_t BufferSendMMsg::send_l(int fd, int flags) {
     ssize_t n;
     do {
         n = sendmmsg(fd, &_hdrvec[0], _hdrvec.size(), flags);
+        if (n > 0 && MetricsRegistry::enabled()) {
+            // sendmmsg返回的是包数，统计字节数需累加每个包实际发送的长度
+            // sendmmsg returns the number of packets, the bytes are the sum of the length actually sent of each packet
+            ssize_t bytes = 0;
+            for (ssize_t i = 0; i < n; ++i) {
+                bytes += _hdrvec[i].msg_len;
+            }
+            onSendSyscall(bytes);
+        } else {
+            onSendSyscall(n);
+        }
     } while (-1 == n && UV_EINTR == get_uv_error(true));
 
     if (n > 0) {
@@ -413,10 +485,14 @@ ssize_t BufferSendMMsg::send(int fd, int flags) {
 void BufferSendMMsg::reOffset(size_t n) {
     for (auto it = _hdrvec.begin(); it != _hdrvec.end();) {
         auto &hdr = *it;
-        auto &io = *(hdr.msg_hdr.msg_iov);
-        assert(hdr.msg_len <= io.iov_len);
+        auto &msg = hdr.msg_hdr;
+        size_t pkt_size = 0;
+        for (size_t i = 0; i < msg.msg_iovlen; ++i) {
+            pkt_size += msg.msg_iov[i].iov_len;
+        }
+        assert(hdr.msg_len <= pkt_size);
         _remain_size -= hdr.msg_len;
-        if (hdr.msg_len == io.iov_len) {
+        if (hdr.msg_len == pkt_size) {
             //这个udp包全部发送成功  [AUTO-TRANSLATED:fce1cc86]
             //this UDP packet sent successfully
             it = _hdrvec.erase(it);
@@ -425,22 +501,49 @@ void BufferSendMMsg::reOffset(size_t n) {
         }
         //部分发送成功  [AUTO-TRANSLATED:4c240905]
         //partially sent successfully
-        io.iov_base = (char *)io.iov_base + hdr.msg_len;
-        io.iov_len -= hdr.msg_len;
+        size_t sent = hdr.msg_len;
+        while (sent && sent >= msg.msg_iov->iov_len) {
+            sent -= msg.msg_iov->iov_len;
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+        msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + sent;
+        msg.msg_iov->iov_len -= sent;
         break;
     }
 }
 
 BufferSendMMsg::BufferSendMMsg(List<std::pair<Buffer::Ptr, bool>> list, SendResult cb)
     : BufferCallBack(std::move(list), std::move(cb))
-    , _iovec(_pkt_list.size())
     , _hdrvec(_pkt_list.size()) {
+    // 先统计iovec个数，保证填充时iovec的地址不变
+    // Count the iovecs first, so that their addresses do not change while filling
+    size_t iovec_count = 0;
+    _pkt_list.for_each([&](std::pair<Buffer::Ptr, bool> &pr) {
+        auto rope = getBufferRope(pr);
+        iovec_count += rope ? rope->slices().size() : 1;
+    });
+    _iovec.reserve(iovec_count);
+
     auto i = 0U;
     _pkt_list.for_each([&](std::pair<Buffer::Ptr, bool> &pr) {
-        auto &io = _iovec[i];
-        io.iov_base = pr.first->data();
-        io.iov_len = pr.first->size();
-        _remain_size += io.iov_len;
+        auto first = _iovec.size();
+        if (auto rope = getBufferRope(pr)) {
+            // 链式缓存各片段聚集为一个udp包，不合并
+            // Slices of the chained buffer are gathered into one udp packet without merging
+            for (auto &slice : rope->slices()) {
+                struct iovec io;
+                io.iov_base = slice.data();
+                io.iov_len = slice.size;
+                _iovec.emplace_back(io);
+            }
+        } else {
+            struct iovec io;
+            io.iov_base = pr.first->data();
+            io.iov_len = pr.first->size();
+            _iovec.emplace_back(io);
+        }
+        _remain_size += pr.first->size();
 
         auto ptr = getBufferSockPtr(pr);
         auto &mmsg = _hdrvec[i];
@@ -448,8 +551,8 @@ BufferSendMMsg::BufferSendMMsg(List<std::pair<Buffer::Ptr, bool>> list, SendResu
         mmsg.msg_len = 0;
         msg.msg_name = ptr ? (void *)ptr->sockaddr() : nullptr;
         msg.msg_namelen = ptr ? ptr->socklen() : 0;
-        msg.msg_iov = &io;
-        msg.msg_iovlen = 1;
+        msg.msg_iov = &_iovec[first];
+        msg.msg_iovlen = _iovec.size() - first;
         msg.msg_control = nullptr;
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
@@ -43,6 +43,7 @@ public:
     size_t size() const override;
     const struct sockaddr *sockaddr() const;
     socklen_t  socklen() const;
+    const Buffer::Ptr &buffer() const { return _buffer; }
 
 private:
     int _addr_len = 0;
@@ -0,0 +1,609 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TOOLKIT_NETWORK_COROUTINE_H
+#define TOOLKIT_NETWORK_COROUTINE_H
+
+// 可选的c++20协程层，只有包含者以c++20编译时才可用，库本身仍以c++11编译，本头文件不参与库的编译
+// Optional c++20 coroutine layer, only available when the includer is compiled with c++20,
+// the library itself is still compiled with c++11 and this header is not part of the library build
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#define ENABLE_COROUTINE 1
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "Socket.h"
+#include "TcpClient.h"
+#include "Util/List.h"
+
+namespace toolkit {
+
+/**
+ * 协程帧缓存：按64字节分级缓存释放的协程帧，每个线程独立，无锁
+ * poller线程独占一份，即协程帧从所在poller的缓存中分配；在其他线程释放的帧进入该线程的缓存
+ * Coroutine frame cache: released coroutine frames are cached in 64-byte size classes, one per thread, lock free
+ * Each poller thread owns one, that is, coroutine frames are allocated from the cache of the poller they run on;
+ * frames released in another thread go into the cache of that thread
+ */
+class CoFrameCache {
+public:
+    static constexpr size_t kGranularity = 64;
+    static constexpr size_t kClasses = 64;
+    static constexpr size_t kMaxCached = 256;
+
+    static void *allocate(size_t size) {
+        auto index = classOf(size);
+        auto cache = current();
+        if (index < kClasses && cache) {
+            auto &list = cache->_free[index];
+            if (list.head) {
+                auto node = list.head;
+                list.head = node->next;
+                --list.count;
+                return node;
+            }
+        }
+        return ::operator new(index < kClasses ? (index + 1) * kGranularity : size);
+    }
+
+    static void deallocate(void *ptr, size_t size) {
+        auto index = classOf(size);
+        auto cache = current();
+        if (index < kClasses && cache) {
+            auto &list = cache->_free[index];
+            if (list.count < kMaxCached) {
+                auto node = static_cast<Node *>(ptr);
+                node->next = list.head;
+                list.head = node;
+                ++list.count;
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+private:
+    struct Node {
+        Node *next;
+    };
+    struct FreeList {
+        Node *head = nullptr;
+        size_t count = 0;
+    };
+
+    ~CoFrameCache() {
+        for (auto &list : _free) {
+            while (list.head) {
+                auto node = list.head;
+                list.head = node->next;
+                ::operator delete(node);
+            }
+        }
+        destroyed() = true;
+    }
+
+    static size_t classOf(size_t size) { return (size + kGranularity - 1) / kGranularity - 1; }
+
+    static bool &destroyed() {
+        static thread_local bool s_destroyed = false;
+        return s_destroyed;
+    }
+
+    // 线程退出后不再缓存
+    // No caching after the thread exits
+    static CoFrameCache *current() {
+        if (destroyed()) {
+            return nullptr;
+        }
+        static thread_local CoFrameCache s_cache;
+        return &s_cache;
+    }
+
+private:
+    FreeList _free[kClasses];
+};
+
+template <typename T>
+class CoTask;
+
+class CoPromiseBase {
+public:
+    static void *operator new(size_t size) { return CoFrameCache::allocate(size); }
+    static void operator delete(void *ptr, size_t size) { CoFrameCache::deallocate(ptr, size); }
+
+    // 惰性启动，被co_await或coSpawn时才开始执行
+    // Lazily started, runs only when co_awaited or spawned by coSpawn
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // 结束时对称转移到等待者
+    // Symmetrically transfer to the awaiter when finished
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            auto continuation = handle.promise()._continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { _exception = std::current_exception(); }
+
+protected:
+    template <typename T>
+    friend class CoTask;
+
+    std::coroutine_handle<> _continuation;
+    std::exception_ptr _exception;
+};
+
+template <typename T>
+class CoPromise : public CoPromiseBase {
+public:
+    CoTask<T> get_return_object();
+    void return_value(T value) { _value.emplace(std::move(value)); }
+
+private:
+    friend class CoTask<T>;
+    std::optional<T> _value;
+};
+
+template <>
+class CoPromise<void> : public CoPromiseBase {
+public:
+    CoTask<void> get_return_object();
+    void return_void() {}
+};
+
+/**
+ * 协程任务，co_await时启动并在结束后恢复等待者，异常会传递给等待者
+ * Coroutine task, started when co_awaited and resumes the awaiter when finished, exceptions are propagated to the awaiter
+ */
+template <typename T = void>
+class CoTask {
+public:
+    using promise_type = CoPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit CoTask(Handle handle) : _handle(handle) {}
+    CoTask(CoTask &&that) noexcept : _handle(std::exchange(that._handle, {})) {}
+    CoTask &operator=(CoTask &&that) noexcept {
+        if (this != &that) {
+            reset();
+            _handle = std::exchange(that._handle, {});
+        }
+        return *this;
+    }
+    CoTask(const CoTask &) = delete;
+    CoTask &operator=(const CoTask &) = delete;
+    ~CoTask() { reset(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        _handle.promise()._continuation = awaiter;
+        return _handle;
+    }
+    T await_resume() {
+        auto &promise = _handle.promise();
+        if (promise._exception) {
+            std::rethrow_exception(promise._exception);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*promise._value);
+        }
+    }
+
+private:
+    void reset() {
+        if (_handle) {
+            _handle.destroy();
+            _handle = nullptr;
+        }
+    }
+
+private:
+    Handle _handle;
+};
+
+template <typename T>
+inline CoTask<T> CoPromise<T>::get_return_object() {
+    return CoTask<T>(std::coroutine_handle<CoPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoPromise<void>::get_return_object() {
+    return CoTask<void>(std::coroutine_handle<CoPromise<void>>::from_promise(*this));
+}
+
+/**
+ * 后台运行的协程，结束时自行销毁，未捕获的异常只打印日志
+ * Coroutine running in the background, destroyed by itself when finished, uncaught exceptions are only logged
+ */
+class CoDetached {
+public:
+    class promise_type {
+    public:
+        static void *operator new(size_t size) { return CoFrameCache::allocate(size); }
+        static void operator delete(void *ptr, size_t size) { CoFrameCache::deallocate(ptr, size); }
+
+        CoDetached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+            try {
+                std::rethrow_exception(std::current_exception());
+            } catch (std::exception &ex) {
+                ErrorL << "Uncaught exception in coroutine: " << ex.what();
+            } catch (...) {
+                ErrorL << "Uncaught exception in coroutine";
+            }
+        }
+    };
+};
+
+inline CoDetached coRunDetached(CoTask<void> task) {
+    co_await std::move(task);
+}
+
+/**
+ * 在poller线程中启动协程，当前就在该线程时立即执行到第一个挂起点
+ * Start a coroutine in the poller thread, it runs to the first suspension point immediately if already in that thread
+ */
+inline void coSpawn(const EventPoller::Ptr &poller, CoTask<void> task) {
+    if (poller->isCurrentThread()) {
+        coRunDetached(std::move(task));
+        return;
+    }
+    auto holder = std::make_shared<CoTask<void>>(std::move(task));
+    poller->async([holder]() { coRunDetached(std::move(*holder)); }, false);
+}
+
+/**
+ * co_await coSwitchTo(poller): 切换到poller线程继续执行
+ * co_await coSwitchTo(poller): continue in the poller thread
+ */
+class CoSwitchTo {
+public:
+    explicit CoSwitchTo(EventPoller::Ptr poller) : _poller(std::move(poller)) {}
+
+    bool await_ready() const noexcept { return _poller->isCurrentThread(); }
+    void await_suspend(std::coroutine_handle<> handle) {
+        _poller->async([handle]() { handle.resume(); }, false);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    EventPoller::Ptr _poller;
+};
+
+inline CoSwitchTo coSwitchTo(EventPoller::Ptr poller) {
+    return CoSwitchTo(std::move(poller));
+}
+
+/**
+ * co_await coSleep(poller, ms): 休眠ms毫秒后在poller线程继续执行
+ * co_await coSleep(poller, ms): continue in the poller thread after sleeping for ms milliseconds
+ */
+class CoSleep {
+public:
+    CoSleep(EventPoller::Ptr poller, uint64_t ms) : _poller(std::move(poller)), _ms(ms) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        _poller->doDelayTask(_ms, [handle]() {
+            handle.resume();
+            return 0;
+        });
+    }
+    void await_resume() const noexcept {}
+
+private:
+    EventPoller::Ptr _poller;
+    uint64_t _ms;
+};
+
+inline CoSleep coSleep(EventPoller::Ptr poller, uint64_t ms) {
+    return CoSleep(std::move(poller), ms);
+}
+
+/**
+ * 协程化的数据流：把连接、接收、可写、出错事件转换为可等待的操作，事件到达时在poller线程直接恢复协程
+ * 同一时刻每种操作最多一个协程等待，所有操作须在所属poller线程co_await
+ * Coroutine-based stream: turns the connect, receive, writable and error events into awaitable operations,
+ * the coroutine is resumed directly in the poller thread when the event arrives
+ * At most one coroutine waits for each kind of operation at a time, all operations must be co_awaited in the owning poller thread
+ */
+class CoStream {
+public:
+    virtual ~CoStream() = default;
+
+    // 连接、读写失败的原因
+    // The reason why connecting, reading or writing failed
+    const SockException &getError() const { return _error; }
+
+    /**
+     * co_await read(): 返回收到的数据，出错时返回nullptr
+     * 有协程等待时直接交出socket的接收缓存，只在下一次挂起前有效，需要保留时请拷贝
+     * co_await read(): return the received data, nullptr is returned on error
+     * When a coroutine is waiting, the receive buffer of the socket is handed over directly, which is only valid until the next suspension,
+     * copy it if it needs to be kept
+     */
+    auto read() {
+        struct Awaiter {
+            CoStream *stream;
+            bool await_ready() const noexcept { return !stream->_recv_queue.empty() || stream->_error; }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { stream->_read_waiter = handle; }
+            Buffer::Ptr await_resume() {
+                if (stream->_recv_direct) {
+                    return std::exchange(stream->_recv_direct, nullptr);
+                }
+                if (stream->_recv_queue.empty()) {
+                    return nullptr;
+                }
+                auto buf = std::move(stream->_recv_queue.front());
+                stream->_recv_queue.pop_front();
+                return buf;
+            }
+        };
+        return Awaiter { this };
+    }
+
+    /**
+     * co_await write(buf): 发送数据，发送缓存积压时等待其清空；返回send的结果
+     * co_await write(buf): send the data and wait until the send buffer is drained if it is congested; return the result of send
+     */
+    auto write(Buffer::Ptr buf) {
+        struct Awaiter {
+            CoStream *stream;
+            Buffer::Ptr buf;
+            ssize_t ret = 0;
+            bool await_ready() {
+                ret = stream->sendData(std::move(buf));
+                return ret < 0 || stream->_error || !stream->isBusy();
+            }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { stream->_flush_waiter = handle; }
+            ssize_t await_resume() const noexcept { return stream->_error ? -1 : ret; }
+        };
+        return Awaiter { this, std::move(buf) };
+    }
+
+protected:
+    virtual ssize_t sendData(Buffer::Ptr buf) = 0;
+    virtual bool isBusy() const = 0;
+
+    // 收到数据，stealable表示可以接管buf
+    // Data received, stealable means buf can be taken over
+    void emitRecv(Buffer::Ptr &buf, bool stealable) {
+        if (_read_waiter && _recv_queue.empty()) {
+            _recv_direct = buf;
+            std::exchange(_read_waiter, nullptr).resume();
+            return;
+        }
+        if (stealable) {
+            _recv_queue.emplace_back(std::move(buf));
+            return;
+        }
+        auto copy = BufferRaw::create();
+        copy->assign(buf->data(), buf->size());
+        _recv_queue.emplace_back(std::move(copy));
+    }
+
+    void emitFlush() {
+        if (_flush_waiter) {
+            std::exchange(_flush_waiter, nullptr).resume();
+        }
+    }
+
+    void emitConnect(const SockException &ex) {
+        if (ex) {
+            _error = ex;
+        }
+        _connected = true;
+        if (_connect_waiter) {
+            std::exchange(_connect_waiter, nullptr).resume();
+        }
+    }
+
+    void emitError(const SockException &ex) {
+        _error = ex;
+        emitConnect(ex);
+        if (_read_waiter) {
+            std::exchange(_read_waiter, nullptr).resume();
+        }
+        emitFlush();
+    }
+
+    // 等待emitConnect，start中连接可能同步完成
+    // Wait for emitConnect, the connection may complete synchronously in start
+    template <typename Start>
+    auto waitConnect(Start start) {
+        struct Awaiter {
+            CoStream *stream;
+            Start start;
+            bool await_ready() noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                stream->_connected = false;
+                start();
+                if (stream->_connected) {
+                    return false;
+                }
+                stream->_connect_waiter = handle;
+                return true;
+            }
+            SockException await_resume() const { return stream->_error; }
+        };
+        return Awaiter { this, std::move(start) };
+    }
+
+private:
+    bool _connected = false;
+    SockException _error;
+    Buffer::Ptr _recv_direct;
+    List<Buffer::Ptr> _recv_queue;
+    std::coroutine_handle<> _read_waiter;
+    std::coroutine_handle<> _flush_waiter;
+    std::coroutine_handle<> _connect_waiter;
+};
+
+/**
+ * 协程化的Socket，支持connect、listen/accept、read、write
+ * Coroutine-based Socket, supports connect, listen/accept, read and write
+ */
+class CoSocket : public CoStream, public std::enable_shared_from_this<CoSocket> {
+public:
+    using Ptr = std::shared_ptr<CoSocket>;
+
+    static Ptr create(const EventPoller::Ptr &poller) { return attach(Socket::createSocket(poller, false)); }
+
+    // 接管已有的socket，替换其回调
+    // Take over an existing socket and replace its callbacks
+    static Ptr attach(const Socket::Ptr &sock) {
+        auto ret = Ptr(new CoSocket(sock));
+        ret->setupCallbacks();
+        return ret;
+    }
+
+    const Socket::Ptr &getSock() const { return _sock; }
+
+    /**
+     * co_await connect(host, port): 返回连接结果
+     * co_await connect(host, port): return the connection result
+     */
+    auto connect(const std::string &host, uint16_t port, float timeout_sec = 5) {
+        std::weak_ptr<CoSocket> weak_self = shared_from_this();
+        return waitConnect([weak_self, host, port, timeout_sec]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->_sock->connect(host, port, [weak_self](const SockException &ex) {
+                    if (auto strong_self = weak_self.lock()) {
+                        strong_self->emitConnect(ex);
+                    }
+                }, timeout_sec);
+            }
+        });
+    }
+
+    bool listen(uint16_t port, const std::string &host = "::", int backlog = 1024) {
+        std::weak_ptr<CoSocket> weak_self = shared_from_this();
+        _sock->setOnAccept([weak_self](Socket::Ptr &sock, std::shared_ptr<void> &complete) {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->emitAccept(attach(sock));
+            }
+        });
+        return _sock->listen(port, host, backlog);
+    }
+
+    /**
+     * co_await accept(): 返回新连接，出错时返回nullptr
+     * co_await accept(): return the new connection, nullptr is returned on error
+     */
+    auto accept() {
+        struct Awaiter {
+            CoSocket *sock;
+            bool await_ready() const noexcept { return !sock->_accepted.empty() || sock->getError(); }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { sock->_accept_waiter = handle; }
+            Ptr await_resume() {
+                if (sock->_accepted.empty()) {
+                    return nullptr;
+                }
+                auto ret = std::move(sock->_accepted.front());
+                sock->_accepted.pop_front();
+                return ret;
+            }
+        };
+        return Awaiter { this };
+    }
+
+protected:
+    ssize_t sendData(Buffer::Ptr buf) override { return _sock->send(std::move(buf)); }
+    bool isBusy() const override { return _sock->isSocketBusy(); }
+
+private:
+    explicit CoSocket(Socket::Ptr sock) : _sock(std::move(sock)) {}
+
+    void setupCallbacks() {
+        // 协程可能在回调中结束并释放本对象，回调期间持有socket
+        // The coroutine may finish and release this object in the callback, so the socket is held during the callback
+        std::weak_ptr<CoSocket> weak_self = shared_from_this();
+        _sock->setOnRead([weak_self](Buffer::Ptr &buf, struct sockaddr *, int) {
+            if (auto strong_self = weak_self.lock()) {
+                auto sock = strong_self->_sock;
+                strong_self->emitRecv(buf, true);
+            }
+        });
+        _sock->setOnErr([weak_self](const SockException &ex) {
+            if (auto strong_self = weak_self.lock()) {
+                auto sock = strong_self->_sock;
+                strong_self->emitError(ex);
+                if (strong_self->_accept_waiter) {
+                    std::exchange(strong_self->_accept_waiter, nullptr).resume();
+                }
+            }
+        });
+        _sock->setOnFlush([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                auto sock = strong_self->_sock;
+                strong_self->emitFlush();
+                return true;
+            }
+            return false;
+        });
+    }
+
+    void emitAccept(Ptr sock) {
+        _accepted.emplace_back(std::move(sock));
+        if (_accept_waiter) {
+            std::exchange(_accept_waiter, nullptr).resume();
+        }
+    }
+
+private:
+    Socket::Ptr _sock;
+    List<Ptr> _accepted;
+    std::coroutine_handle<> _accept_waiter;
+};
+
+/**
+ * 协程化的TcpClient，支持代理、网卡绑定等TcpClient的全部特性
+ * Coroutine-based TcpClient, supports all the features of TcpClient such as proxy and network adapter binding
+ */
+class CoTcpClient : public TcpClient, public CoStream {
+public:
+    using Ptr = std::shared_ptr<CoTcpClient>;
+
+    explicit CoTcpClient(const EventPoller::Ptr &poller = nullptr) : TcpClient(poller) {}
+
+    /**
+     * co_await connect(url, port): 返回连接结果
+     * co_await connect(url, port): return the connection result
+     */
+    auto connect(const std::string &url, uint16_t port, float timeout_sec = 5, uint16_t local_port = 0) {
+        return waitConnect([this, url, port, timeout_sec, local_port]() { startConnect(url, port, timeout_sec, local_port); });
+    }
+
+protected:
+    void onConnect(const SockException &ex) override { emitConnect(ex); }
+    void onRecv(const Buffer::Ptr &buf) override {
+        auto ref = buf;
+        emitRecv(ref, false);
+    }
+    void onError(const SockException &ex) override { emitError(ex); }
+    void onFlush() override { emitFlush(); }
+
+    ssize_t sendData(Buffer::Ptr buf) override { return TcpClient::send(std::move(buf)); }
+    bool isBusy() const override { return isSocketBusy(); }
+};
+
+} // namespace toolkit
+
+#endif // __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#endif // TOOLKIT_NETWORK_COROUTINE_H
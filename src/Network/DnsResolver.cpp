@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "DnsResolver.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+
+using namespace std;
+
+namespace toolkit {
+
+static constexpr uint16_t kTypeA = 1;
+static constexpr uint16_t kTypeAAAA = 28;
+static constexpr uint16_t kClassIN = 1;
+static constexpr uint8_t kRcodeNameError = 3;
+// ttl上限，防止异常的ttl导致缓存长期不更新
+// Upper limit of ttl, prevent an abnormal ttl from keeping the cache unrefreshed for a long time
+static constexpr uint32_t kMaxTTL = 24 * 3600;
+
+static string makeKey(const string &host, int ai_family) {
+    string ret = ai_family == AF_INET6 ? "6:" : "4:";
+    ret.append(host);
+    if (ret.back() == '.') {
+        ret.pop_back();
+    }
+    return strToLower(std::move(ret));
+}
+
+static uint16_t readUint16(const uint8_t *ptr) {
+    return (uint16_t)((ptr[0] << 8) | ptr[1]);
+}
+
+static uint32_t readUint32(const uint8_t *ptr) {
+    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+}
+
+/**
+ * 编码question段，域名非法时返回空
+ * Encode the question section, return empty if the domain name is invalid
+ */
+static string makeQuestion(const string &host, uint16_t qtype) {
+    string ret;
+    for (auto &label : split(host, ".")) {
+        if (label.empty()) {
+            continue;
+        }
+        if (label.size() > 63) {
+            return "";
+        }
+        ret.push_back((char)label.size());
+        ret.append(label);
+    }
+    if (ret.empty() || ret.size() > 253) {
+        return "";
+    }
+    ret.push_back('\0');
+    ret.push_back((char)(qtype >> 8));
+    ret.push_back((char)(qtype & 0xFF));
+    ret.push_back((char)(kClassIN >> 8));
+    ret.push_back((char)(kClassIN & 0xFF));
+    return ret;
+}
+
+static bool skipName(const uint8_t *data, size_t size, size_t &pos) {
+    while (pos < size) {
+        auto len = data[pos];
+        if ((len & 0xC0) == 0xC0) {
+            // 压缩指针，名称在此结束
+            // Compression pointer, the name ends here
+            pos += 2;
+            return pos <= size;
+        }
+        pos += 1 + len;
+        if (!len) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isSameQuestion(const uint8_t *data, const string &question) {
+    for (size_t i = 0; i < question.size(); ++i) {
+        if (tolower(data[i]) != tolower((uint8_t)question[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isSameAddress(const struct sockaddr *lhs, const struct sockaddr_storage &rhs) {
+    if (lhs->sa_family != rhs.ss_family) {
+        return false;
+    }
+    if (lhs->sa_family == AF_INET) {
+        auto l = (const struct sockaddr_in *)lhs;
+        auto r = (const struct sockaddr_in *)&rhs;
+        return l->sin_port == r->sin_port && l->sin_addr.s_addr == r->sin_addr.s_addr;
+    }
+    auto l = (const struct sockaddr_in6 *)lhs;
+    auto r = (const struct sockaddr_in6 *)&rhs;
+    return l->sin6_port == r->sin6_port && memcmp(&l->sin6_addr, &r->sin6_addr, sizeof(l->sin6_addr)) == 0;
+}
+
+///////////////////DnsResolver::Querier///////////////////
+
+/**
+ * 每个poller一个，负责发送查询、重试以及解析应答，只在poller线程中访问
+ * One per poller, responsible for sending queries, retrying and parsing answers, only accessed in the poller thread
+ */
+class DnsResolver::Querier : public std::enable_shared_from_this<Querier> {
+public:
+    Querier(const DnsResolver::Ptr &resolver, EventPoller::Ptr poller) : _resolver(resolver), _poller(std::move(poller)) {}
+
+    void query(const string &key, const string &host, uint16_t qtype, vector<struct sockaddr_storage> servers, uint32_t timeout_ms, uint32_t retry) {
+        auto question = makeQuestion(host, qtype);
+        if (question.empty()) {
+            finish(key, SockException(Err_dns, "invalid domain name: " + host), {}, 0);
+            return;
+        }
+        uint16_t id;
+        do {
+            id = (uint16_t)_random();
+        } while (_queries.find(id) != _queries.end());
+
+        auto &query = _queries[id];
+        query.key = key;
+        query.qtype = qtype;
+        query.question = std::move(question);
+        query.servers = std::move(servers);
+        query.timeout_ms = timeout_ms;
+        query.retry = retry;
+        send(id, query);
+    }
+
+private:
+    struct Query {
+        uint16_t qtype;
+        uint32_t tries = 0;
+        uint32_t timeout_ms;
+        uint32_t retry;
+        string key;
+        string question;
+        vector<struct sockaddr_storage> servers;
+        EventPoller::DelayTask::Ptr timer;
+    };
+
+    const Socket::Ptr &getSocket(int family) {
+        auto &sock = family == AF_INET6 ? _sock6 : _sock4;
+        if (!sock) {
+            sock = Socket::createSocket(_poller, false);
+            if (!sock->bindUdpSock(0, family == AF_INET6 ? "::" : "0.0.0.0")) {
+                WarnL << "Bind dns query socket failed: " << get_uv_errmsg(true);
+            }
+            weak_ptr<Querier> weak_self = shared_from_this();
+            sock->setOnRead([weak_self](Buffer::Ptr &buf, struct sockaddr *addr, int) {
+                if (auto strong_self = weak_self.lock()) {
+                    strong_self->onRecv(buf, addr);
+                }
+            });
+        }
+        return sock;
+    }
+
+    void send(uint16_t id, Query &query) {
+        auto &server = query.servers[query.tries % query.servers.size()];
+        string packet;
+        packet.reserve(12 + query.question.size());
+        // header: id, flags(RD), qdcount = 1
+        char header[12] = { (char)(id >> 8), (char)(id & 0xFF), 0x01, 0x00, 0x00, 0x01, 0, 0, 0, 0, 0, 0 };
+        packet.append(header, sizeof(header));
+        packet.append(query.question);
+        getSocket(server.ss_family)->send(std::move(packet), (struct sockaddr *)&server, SockUtil::get_sock_len((struct sockaddr *)&server));
+
+        weak_ptr<Querier> weak_self = shared_from_this();
+        query.timer = _poller->doDelayTask(query.timeout_ms, [weak_self, id]() -> uint64_t {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->retry(id, SockException(Err_timeout, "dns query timeout"));
+            }
+            return 0;
+        });
+    }
+
+    void retry(uint16_t id, const SockException &ex) {
+        auto it = _queries.find(id);
+        if (it == _queries.end()) {
+            return;
+        }
+        auto &query = it->second;
+        query.timer->cancel();
+        if (++query.tries > query.retry) {
+            finish(id, ex, {}, 0);
+            return;
+        }
+        // 换下一个nameserver重试
+        // Retry with the next nameserver
+        send(id, query);
+    }
+
+    void onRecv(const Buffer::Ptr &buf, struct sockaddr *addr) {
+        auto data = (const uint8_t *)buf->data();
+        auto size = buf->size();
+        if (size < 12) {
+            return;
+        }
+        auto id = readUint16(data);
+        auto it = _queries.find(id);
+        if (it == _queries.end()) {
+            return;
+        }
+        auto &query = it->second;
+        auto &server = query.servers[query.tries % query.servers.size()];
+        // 校验应答来源与question段，防止伪造应答
+        // Verify the source and the question section of the answer to prevent forged answers
+        if (!isSameAddress(addr, server) || !(data[2] & 0x80) || readUint16(data + 4) != 1 || size < 12 + query.question.size()
+            || !isSameQuestion(data + 12, query.question)) {
+            return;
+        }
+
+        auto rcode = data[3] & 0x0F;
+        if (rcode == kRcodeNameError) {
+            finish(id, SockException(Err_dns, "dns name not exist"), {}, 0);
+            return;
+        }
+        if (rcode) {
+            retry(id, SockException(Err_dns, "dns server failure, rcode: " + to_string(rcode)));
+            return;
+        }
+
+        AddressList addrs;
+        uint32_t ttl = kMaxTTL;
+        auto ancount = readUint16(data + 6);
+        size_t pos = 12 + query.question.size();
+        for (size_t i = 0; i < ancount; ++i) {
+            if (!skipName(data, size, pos) || pos + 10 > size) {
+                break;
+            }
+            auto type = readUint16(data + pos);
+            auto cls = readUint16(data + pos + 2);
+            auto record_ttl = readUint32(data + pos + 4);
+            auto rdlen = readUint16(data + pos + 8);
+            pos += 10;
+            if (pos + rdlen > size) {
+                break;
+            }
+            if (cls == kClassIN && type == query.qtype) {
+                struct sockaddr_storage storage;
+                memset(&storage, 0, sizeof(storage));
+                if (type == kTypeA && rdlen == 4) {
+                    auto addr4 = (struct sockaddr_in *)&storage;
+                    addr4->sin_family = AF_INET;
+                    memcpy(&addr4->sin_addr, data + pos, 4);
+                    addrs.emplace_back(storage);
+                    ttl = std::min(ttl, record_ttl);
+                } else if (type == kTypeAAAA && rdlen == 16) {
+                    auto addr6 = (struct sockaddr_in6 *)&storage;
+                    addr6->sin6_family = AF_INET6;
+                    memcpy(&addr6->sin6_addr, data + pos, 16);
+                    addrs.emplace_back(storage);
+                    ttl = std::min(ttl, record_ttl);
+                }
+            }
+            pos += rdlen;
+        }
+
+        if (addrs.empty()) {
+            finish(id, SockException(Err_dns, "dns answer has no address"), {}, 0);
+            return;
+        }
+        finish(id, SockException(), std::move(addrs), ttl);
+    }
+
+    void finish(uint16_t id, const SockException &ex, AddressList addrs, uint32_t ttl) {
+        auto it = _queries.find(id);
+        if (it == _queries.end()) {
+            return;
+        }
+        it->second.timer->cancel();
+        auto key = std::move(it->second.key);
+        _queries.erase(it);
+        finish(key, ex, std::move(addrs), ttl);
+    }
+
+    void finish(const string &key, const SockException &ex, AddressList addrs, uint32_t ttl) {
+        if (auto resolver = _resolver.lock()) {
+            resolver->onQueryResult(key, ex, std::move(addrs), ttl);
+        }
+    }
+
+private:
+    std::weak_ptr<DnsResolver> _resolver;
+    EventPoller::Ptr _poller;
+    Socket::Ptr _sock4;
+    Socket::Ptr _sock6;
+    std::mt19937 _random { std::random_device {}() };
+    unordered_map<uint16_t, Query> _queries;
+};
+
+///////////////////DnsResolver///////////////////
+
+INSTANCE_IMP(DnsResolver)
+
+DnsResolver::DnsResolver() {
+    loadSystemConfig();
+}
+
+DnsResolver::~DnsResolver() {
+    lock_guard<mutex> lck(_mtx);
+    _queriers.clear();
+}
+
+void DnsResolver::loadSystemConfig() {
+#if !defined(_WIN32)
+    ifstream resolv_conf("/etc/resolv.conf");
+    string line;
+    while (getline(resolv_conf, line)) {
+        istringstream iss(line);
+        string key, value;
+        iss >> key >> value;
+        if (key == "nameserver" && isIP(value.data())) {
+            _name_servers.emplace_back(SockUtil::make_sockaddr(value.data(), 53));
+        }
+    }
+
+    ifstream hosts("/etc/hosts");
+    while (getline(hosts, line)) {
+        auto pos = line.find('#');
+        if (pos != string::npos) {
+            line.resize(pos);
+        }
+        istringstream iss(line);
+        string ip, name;
+        iss >> ip;
+        if (!isIP(ip.data())) {
+            continue;
+        }
+        auto addr = SockUtil::make_sockaddr(ip.data(), 0);
+        while (iss >> name) {
+            _hosts[makeKey(name, addr.ss_family)].emplace_back(addr);
+        }
+    }
+#endif
+}
+
+void DnsResolver::setNameServers(const vector<string> &ips, uint16_t port) {
+    vector<struct sockaddr_storage> servers;
+    for (auto &ip : ips) {
+        servers.emplace_back(SockUtil::make_sockaddr(ip.data(), port));
+    }
+    lock_guard<mutex> lck(_mtx);
+    _name_servers = std::move(servers);
+}
+
+bool DnsResolver::hasNameServer() {
+    lock_guard<mutex> lck(_mtx);
+    return !_name_servers.empty();
+}
+
+void DnsResolver::setStaleSecond(uint32_t second) {
+    _stale_ms = second * 1000;
+}
+
+void DnsResolver::setTimeout(uint32_t timeout_ms, uint32_t retry) {
+    _timeout_ms = timeout_ms ? timeout_ms : 1;
+    _retry = retry;
+}
+
+DnsResolver::CacheShard &DnsResolver::getShard(const string &key) {
+    return _shards[std::hash<string>()(key) % kShardCount];
+}
+
+bool DnsResolver::getCached(const string &host, int ai_family, AddressList &addrs, bool allow_stale) {
+    auto key = makeKey(host, ai_family);
+    auto &shard = getShard(key);
+    lock_guard<mutex> lck(shard.mtx);
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end() || it->second.addrs.empty()) {
+        return false;
+    }
+    auto now = getCurrentMillisecond();
+    if (now >= it->second.expire_ms + (allow_stale ? _stale_ms : 0)) {
+        return false;
+    }
+    addrs = it->second.addrs;
+    return true;
+}
+
+void DnsResolver::resolve(const string &host, int ai_family, onResolved cb, const EventPoller::Ptr &poller) {
+    if (isIP(host.data())) {
+        AddressList addrs { SockUtil::make_sockaddr(host.data(), 0) };
+        cb(SockException(), addrs);
+        return;
+    }
+
+    auto key = makeKey(host, ai_family);
+    // _hosts只在构造时写入，无需加锁
+    // _hosts is only written when constructing, no lock needed
+    auto it = _hosts.find(key);
+    if (it != _hosts.end()) {
+        cb(SockException(), it->second);
+        return;
+    }
+
+    auto executor = poller ? poller : EventPollerPool::Instance().getPoller();
+    AddressList addrs;
+    bool query = false;
+    {
+        auto &shard = getShard(key);
+        lock_guard<mutex> lck(shard.mtx);
+        auto &entry = shard.entries[key];
+        auto now = getCurrentMillisecond();
+        if (!entry.addrs.empty() && now < entry.expire_ms + _stale_ms) {
+            addrs = entry.addrs;
+            if (now >= entry.expire_ms && !entry.pending) {
+                // 已过期但仍在stale时长内，先返回旧结果并在后台刷新
+                // Expired but still within the stale period, return the old result first and refresh in the background
+                entry.pending = query = true;
+            }
+        } else {
+            // 同一域名的并发查询合并为一次
+            // Concurrent lookups of the same name are merged into one query
+            entry.waiters.emplace_back(executor, std::move(cb));
+            if (!entry.pending) {
+                entry.pending = query = true;
+            }
+        }
+    }
+
+    if (query) {
+        startQuery(key, host, ai_family, executor);
+    }
+    if (!addrs.empty()) {
+        cb(SockException(), addrs);
+    }
+}
+
+std::shared_ptr<DnsResolver::Querier> DnsResolver::getQuerier(const EventPoller::Ptr &poller) {
+    lock_guard<mutex> lck(_mtx);
+    auto &querier = _queriers[poller.get()];
+    if (!querier) {
+        querier = std::make_shared<Querier>(shared_from_this(), poller);
+    }
+    return querier;
+}
+
+void DnsResolver::startQuery(const string &key, const string &host, int ai_family, const EventPoller::Ptr &poller) {
+    vector<struct sockaddr_storage> servers;
+    {
+        lock_guard<mutex> lck(_mtx);
+        servers = _name_servers;
+    }
+    if (servers.empty()) {
+        onQueryResult(key, SockException(Err_dns, "no dns nameserver"), {}, 0);
+        return;
+    }
+
+    auto querier = getQuerier(poller);
+    auto qtype = ai_family == AF_INET6 ? kTypeAAAA : kTypeA;
+    auto timeout_ms = _timeout_ms;
+    auto retry = _retry;
+    poller->async([querier, key, host, qtype, servers, timeout_ms, retry]() mutable {
+        querier->query(key, host, qtype, std::move(servers), timeout_ms, retry);
+    });
+}
+
+void DnsResolver::onQueryResult(const string &key, const SockException &ex, AddressList addrs, uint32_t ttl) {
+    decltype(CacheEntry::waiters) waiters;
+    {
+        auto &shard = getShard(key);
+        lock_guard<mutex> lck(shard.mtx);
+        auto it = shard.entries.find(key);
+        if (it == shard.entries.end()) {
+            return;
+        }
+        auto &entry = it->second;
+        entry.pending = false;
+        waiters.swap(entry.waiters);
+        if (!ex) {
+            entry.addrs = addrs;
+            entry.expire_ms = getCurrentMillisecond() + std::max<uint32_t>(std::min(ttl, kMaxTTL), 1) * 1000;
+        } else if (entry.addrs.empty()) {
+            // 失败时如果有旧结果则保留，继续在stale时长内使用
+            // Keep the old result on failure, and continue to use it within the stale period
+            shard.entries.erase(it);
+        }
+    }
+
+    if (ex) {
+        DebugL << "Resolve " << key.substr(2) << " failed: " << ex;
+    }
+    for (auto &pr : waiters) {
+        auto &cb = pr.second;
+        pr.first->async([cb, ex, addrs]() { cb(ex, addrs); });
+    }
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef NETWORK_DNSRESOLVER_H
+#define NETWORK_DNSRESOLVER_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "Socket.h"
+
+namespace toolkit {
+
+/**
+ * 异步dns解析器
+ * 在poller线程中通过udp向nameserver发送查询并解析应答，不占用后台线程；
+ * 解析结果按ttl缓存在分片的哈希表中，同一域名的并发查询只发送一次；
+ * 缓存过期后的一段时间内(stale)先返回旧结果，同时在后台刷新
+ * Asynchronous dns resolver
+ * Queries are sent to the nameservers via udp and answers are parsed in the poller thread, no background thread is occupied;
+ * results are cached by ttl in a sharded hash table, concurrent lookups of the same name only send one query;
+ * within a period after the cache expires (stale), the old result is returned first while it is refreshed in the background
+ */
+class DnsResolver : public std::enable_shared_from_this<DnsResolver> {
+public:
+    using Ptr = std::shared_ptr<DnsResolver>;
+    using AddressList = std::vector<struct sockaddr_storage>;
+    /**
+     * 解析结果回调，成功时addrs不为空，端口为0
+     * Resolve result callback, addrs is not empty when successful, the port is 0
+     */
+    using onResolved = std::function<void(const SockException &ex, const AddressList &addrs)>;
+
+    static DnsResolver &Instance();
+
+    /**
+     * 构造时加载/etc/resolv.conf中的nameserver以及/etc/hosts
+     * Load the nameservers in /etc/resolv.conf and /etc/hosts when constructing
+     */
+    DnsResolver();
+    ~DnsResolver();
+
+    /**
+     * 设置nameserver列表，查询超时后依次重试
+     * @param ips nameserver ip列表
+     * @param port nameserver端口
+     * Set the nameserver list, retry them in turn after a query times out
+     * @param ips Nameserver ip list
+     * @param port Nameserver port
+     */
+    void setNameServers(const std::vector<std::string> &ips, uint16_t port = 53);
+
+    /**
+     * 是否有可用的nameserver
+     * Whether there is an available nameserver
+     */
+    bool hasNameServer();
+
+    /**
+     * 设置缓存过期后仍可使用旧结果的时长，0则禁用
+     * Set how long the old result can still be used after the cache expires, 0 to disable
+     */
+    void setStaleSecond(uint32_t second);
+
+    /**
+     * 设置单次查询超时时间与重试次数
+     * Set the timeout of a single query and the retry count
+     */
+    void setTimeout(uint32_t timeout_ms, uint32_t retry);
+
+    /**
+     * 异步解析域名
+     * 命中缓存时在调用线程同步回调，否则在poller线程回调
+     * @param host 域名或ip
+     * @param ai_family AF_INET查询A记录，AF_INET6查询AAAA记录
+     * @param cb 结果回调
+     * @param poller 执行查询以及回调的poller，为空则自动选择
+     * Resolve a domain name asynchronously
+     * The callback is invoked synchronously in the calling thread on cache hit, otherwise in the poller thread
+     * @param host Domain name or ip
+     * @param ai_family AF_INET queries A records, AF_INET6 queries AAAA records
+     * @param cb Result callback
+     * @param poller The poller which executes the query and the callback, auto selected if null
+     */
+    void resolve(const std::string &host, int ai_family, onResolved cb, const EventPoller::Ptr &poller = nullptr);
+
+    /**
+     * 只查询缓存，不发送请求
+     * @param allow_stale 是否允许返回已过期但在stale时长内的结果
+     * Only query the cache without sending requests
+     * @param allow_stale Whether to allow returning an expired result within the stale period
+     */
+    bool getCached(const std::string &host, int ai_family, AddressList &addrs, bool allow_stale = false);
+
+private:
+    class Querier;
+
+    struct CacheEntry {
+        // 是否有正在进行中的查询
+        // Whether there is a query in progress
+        bool pending = false;
+        uint64_t expire_ms = 0;
+        AddressList addrs;
+        std::vector<std::pair<EventPoller::Ptr, onResolved>> waiters;
+    };
+
+    struct CacheShard {
+        std::mutex mtx;
+        std::unordered_map<std::string, CacheEntry> entries;
+    };
+
+    CacheShard &getShard(const std::string &key);
+    std::shared_ptr<Querier> getQuerier(const EventPoller::Ptr &poller);
+    void startQuery(const std::string &key, const std::string &host, int ai_family, const EventPoller::Ptr &poller);
+    void onQueryResult(const std::string &key, const SockException &ex, AddressList addrs, uint32_t ttl);
+    void loadSystemConfig();
+
+private:
+    static constexpr size_t kShardCount = 16;
+
+    uint32_t _stale_ms = 30 * 1000;
+    uint32_t _timeout_ms = 1500;
+    uint32_t _retry = 2;
+    CacheShard _shards[kShardCount];
+
+    std::mutex _mtx;
+    std::vector<struct sockaddr_storage> _name_servers;
+    // /etc/hosts中的静态记录，key与缓存相同
+    // Static records in /etc/hosts, the key is the same as the cache
+    std::unordered_map<std::string, AddressList> _hosts;
+    std::unordered_map<EventPoller *, std::shared_ptr<Querier>> _queriers;
+};
+
+} /* namespace toolkit */
+#endif /* NETWORK_DNSRESOLVER_H */
@@ -37,6 +37,8 @@ uint32_t getCurrent() {
 
 ////////////  KcpHeader //////////////////////////
 
+const size_t KcpHeader::HEADER_SIZE;
+
 bool KcpHeader::loadHeaderFromData(const char *data, size_t len) {
     if (HEADER_SIZE > len) {
         WarnL << "data len: " << len << " too small";
@@ -102,6 +104,26 @@ KcpPacket::Ptr KcpPacket::parse(const char* data, size_t len) {
     return nullptr;
 }
 
+KcpPacket::Ptr KcpPacket::parse(const Buffer::Ptr &buf, size_t offset) {
+    auto packet = std::make_shared<KcpPacket>();
+    auto data = buf->data() + offset;
+    auto len = buf->size() - offset;
+    if (!packet->loadHeaderFromData(data, len)) {
+        return nullptr;
+    }
+    auto packetSize = packet->getPacketSize();
+    if (len < packetSize) {
+        WarnL << "data len: " << len << " is smaller than packet len: " << packetSize;
+        return nullptr;
+    }
+    if (packet->getLen()) {
+        packet->setPayload(std::make_shared<BufferOffset<Buffer::Ptr>>(buf, offset + HEADER_SIZE, packet->getLen()));
+    } else {
+        packet->setPayLoadSize(0);
+    }
+    return packet;
+}
+
 bool KcpPacket::loadFromData(const char *data, size_t len) {
 
     if (!loadHeaderFromData(data, len)) {
@@ -122,8 +144,47 @@ bool KcpPacket::storeToData() {
     return storeHeaderToData(data(), size());
 }
 
+void KcpPacket::setPayload(Buffer::Ptr payload) {
+    auto len = payload->size();
+    setPayLoadSize(0);
+    setLen(len);
+    _payload = std::move(payload);
+}
+
+size_t KcpPacket::ownPayload() {
+    if (!_payload) {
+        return 0;
+    }
+    auto payload = std::move(_payload);
+    auto len = payload->size();
+    setPayLoadSize(len);
+    memcpy(getPayloadData(), payload->data(), len);
+    return len;
+}
+
+void KcpPacket::resizePayload(size_t len) {
+    assert(!_payload);
+    if (len + HEADER_SIZE + 1 <= getCapacity()) {
+        setSize(len + HEADER_SIZE);
+        setLen(len);
+        return;
+    }
+    std::string old(data(), size());
+    setPayLoadSize(len);
+    memcpy(data(), old.data(), old.size());
+}
+
 ////////////  KcpTransport //////////////////////////
 
+//负载视图,负载在包内时引用包本身
+//The payload view, the packet itself is referenced if the payload is stored in the packet
+static Buffer::Ptr payloadOf(const KcpPacket::Ptr &packet) {
+    if (auto &payload = packet->getPayload()) {
+        return payload;
+    }
+    return std::make_shared<BufferOffset<Buffer::Ptr>>(packet, KcpHeader::HEADER_SIZE, packet->getLen());
+}
+
 KcpTransport::KcpTransport(bool server_mode) {
     _server_mode = server_mode;
     if (!server_mode) {
@@ -164,26 +225,37 @@ ssize_t KcpTransport::send(const Buffer::Ptr& buf, bool flush) {
         return -1;
     }
 
-    auto cache = BufferRaw::create(size);
-    cache->assign(buf->data(), size);
+    Buffer::Ptr cache = buf;
+    if (!_zero_copy) {
+        auto raw = BufferRaw::create(size);
+        raw->assign(buf->data(), size);
+        _copied_bytes += size;
+        cache = std::move(raw);
+    }
 
     _poller->async([=] {
-        auto data = cache->data();
-        auto leftLen = size;
-        auto extendLen = mergeSendQueue(data, leftLen);
-        data += extendLen;
-        leftLen -= extendLen;
+        size_t offset = mergeSendQueue(cache->data(), size);
+        auto leftLen = size - offset;
 
         // fragment
         int count = (leftLen + _mss - 1) / _mss;
         for (int i = 0; i < count; i++) {
             auto len = std::min<size_t>(leftLen, _mss);
-            auto packet = std::make_shared<KcpDataPacket>(_conv, len);
-            memcpy(packet->getPayloadData(), data, len);
+            KcpDataPacket::Ptr packet;
+            if (_zero_copy) {
+                //分片直接引用用户数据
+                //The fragment references the user data directly
+                packet = std::make_shared<KcpDataPacket>(_conv, 0);
+                packet->setPayload(std::make_shared<BufferOffset<Buffer::Ptr>>(cache, offset, len));
+            } else {
+                packet = std::make_shared<KcpDataPacket>(_conv, len);
+                memcpy(packet->getPayloadData(), cache->data() + offset, len);
+                _copied_bytes += len;
+            }
             packet->setFrg(!_stream? (count - i - 1) : 0);
             _snd_queue.push_back(packet);
 
-            data += len;
+            offset += len;
             leftLen -= len;
         }
 
@@ -201,99 +273,127 @@ void KcpTransport::input(const Buffer::Ptr& buf) {
         startTimer();
     }
 
+    if (_zero_copy && _poller->isCurrentThread()) {
+        //直接解析socket的接收缓存,不切换线程也不拷贝
+        //Parse the receive buffer of the socket directly without switching threads or copying
+        inputPackets(buf, true);
+        return;
+    }
+
     auto cache = BufferRaw::create(buf->size());
     cache->assign(buf->data(), buf->size());
+    _copied_bytes += buf->size();
 
     _poller->async([=] {
-        // DebugL << hexdump(cache->data(), cache->size());
-
-        auto data = cache->data();
-        auto size = cache->size();
-        uint32_t current = getCurrent();
-        uint32_t prev_una = _snd_una;
-        uint32_t maxack = 0;
-        uint32_t latest_ts = 0;
-        bool fastAckFlag = false;
-        bool hasData = false;
-
-        while (size) {
-            auto packet = KcpPacket::parse(data, size);
-            if (!packet) {
-                WarnL << "parse kcp packet fail";
-                break;
-            }
-            data += packet->size();
-            size -= packet->size();
-            if (!_conv_init) {
-                _conv = packet->getConv();
-                _conv_init = true;
-            } else {
-                if (_conv != packet->getConv()) {
-                    WarnL << "_conv check fail, skip this packet";
-                    continue;
-                }
-            }
+        inputPackets(cache, false);
+    }, true);
+}
+
+void KcpTransport::inputPackets(const Buffer::Ptr &buf, bool borrowed) {
+    // DebugL << hexdump(buf->data(), buf->size());
 
-            auto cmd = packet->getCmd();
-            if (cmd != KcpHeader::Cmd::CMD_PUSH && cmd != KcpHeader::Cmd::CMD_ACK &&
-                cmd != KcpHeader::Cmd::CMD_WASK && cmd != KcpHeader::Cmd::CMD_WINS) {
-                WarnL << "unknow cmd: " << (uint8_t)cmd;
+    size_t offset = 0;
+    auto size = buf->size();
+    uint32_t current = getCurrent();
+    uint32_t prev_una = _snd_una;
+    uint32_t maxack = 0;
+    uint32_t latest_ts = 0;
+    bool fastAckFlag = false;
+    bool hasData = false;
+
+    while (size) {
+        KcpPacket::Ptr packet;
+        if (_zero_copy) {
+            packet = KcpPacket::parse(buf, offset);
+        } else {
+            packet = KcpPacket::parse(buf->data() + offset, size);
+        }
+        if (!packet) {
+            WarnL << "parse kcp packet fail";
+            break;
+        }
+        if (!_zero_copy) {
+            _copied_bytes += packet->getLen();
+        }
+        offset += packet->getPacketSize();
+        size -= packet->getPacketSize();
+        if (!_conv_init) {
+            _conv = packet->getConv();
+            _conv_init = true;
+        } else {
+            if (_conv != packet->getConv()) {
+                WarnL << "_conv check fail, skip this packet";
                 continue;
             }
+        }
 
-            handleAnyPacket(packet);
-
-            switch (cmd) {
-                case KcpHeader::Cmd::CMD_ACK: {
-                    auto sn = packet->getSn();
-                    auto ts = packet->getTs();
-                    handleCmdAck(packet, current);
-                    if (!fastAckFlag) {
-                        fastAckFlag = true;
-                        maxack = sn;
-                        latest_ts = ts;
-                    } else {
-                        if (sn > maxack) {
-                            if (!_fastack_conserve || ts > latest_ts) {
-                                //激进模式
-                                maxack = sn;
-                                latest_ts = ts;
-                            }
+        auto cmd = packet->getCmd();
+        if (cmd != KcpHeader::Cmd::CMD_PUSH && cmd != KcpHeader::Cmd::CMD_ACK &&
+            cmd != KcpHeader::Cmd::CMD_WASK && cmd != KcpHeader::Cmd::CMD_WINS) {
+            WarnL << "unknow cmd: " << (uint8_t)cmd;
+            continue;
+        }
+
+        handleAnyPacket(packet);
+
+        switch (cmd) {
+            case KcpHeader::Cmd::CMD_ACK: {
+                auto sn = packet->getSn();
+                auto ts = packet->getTs();
+                handleCmdAck(packet, current);
+                if (!fastAckFlag) {
+                    fastAckFlag = true;
+                    maxack = sn;
+                    latest_ts = ts;
+                } else {
+                    if (sn > maxack) {
+                        if (!_fastack_conserve || ts > latest_ts) {
+                            //激进模式
+                            maxack = sn;
+                            latest_ts = ts;
                         }
                     }
                 }
-                    break;
-                case KcpHeader::Cmd::CMD_PUSH:
-                    handleCmdPush(packet);
-                    hasData = true;
-                    break;
-                case KcpHeader::Cmd::CMD_WASK:
-                    _probe |= IKCP_ASK_TELL;
-                    break;
-                case KcpHeader::Cmd::CMD_WINS:
-                    break;
-                default:
-                    WarnL << "unknow cmd: " << (uint32_t)cmd;
-                    break;
             }
+                break;
+            case KcpHeader::Cmd::CMD_PUSH:
+                handleCmdPush(packet);
+                hasData = true;
+                break;
+            case KcpHeader::Cmd::CMD_WASK:
+                _probe |= IKCP_ASK_TELL;
+                break;
+            case KcpHeader::Cmd::CMD_WINS:
+                break;
+            default:
+                WarnL << "unknow cmd: " << (uint32_t)cmd;
+                break;
         }
+    }
 
-        if (fastAckFlag) {
-            updateFastAck(maxack, latest_ts);
-        }
-
-        if (_snd_una > prev_una) {
-            //有新的应答,尝试增大拥塞窗口
-            increaseCwnd();
-        }
+    if (fastAckFlag) {
+        updateFastAck(maxack, latest_ts);
+    }
 
-        if (hasData) {
-            onData();
-        }
+    if (_snd_una > prev_una) {
+        //有新的应答,尝试增大拥塞窗口
+        increaseCwnd();
+    }
 
-    }, true);
+    if (hasData) {
+        onData();
+    }
 
-    return;
+    if (borrowed) {
+        //buf返回后会被socket复用,仍滞留的包需要拷贝负载
+        //buf is reused by the socket after returning, packets still kept need to copy their payload
+        for (auto &packet : _rcv_buf) {
+            _copied_bytes += packet->ownPayload();
+        }
+        for (auto &packet : _rcv_queue) {
+            _copied_bytes += packet->ownPayload();
+        }
+    }
 }
 
 void KcpTransport::startTimer() {
@@ -326,14 +426,38 @@ void KcpTransport::onData() {
 
     // merge fragment
     while (int size = peeksize()) {
+        if (_zero_copy) {
+            //单个分片直接交出负载视图,多个分片以链式缓存串联,均不拷贝
+            //A single fragment hands over its payload view directly, multiple fragments are chained by a rope, neither copies
+            auto packet = _rcv_queue.front();
+            _rcv_queue.pop_front();
+            if (packet->getFrg() == 0) {
+                onRead(payloadOf(packet));
+                continue;
+            }
+            auto rope = BufferRope::create();
+            rope->append(payloadOf(packet));
+            while (true) {
+                packet = _rcv_queue.front();
+                _rcv_queue.pop_front();
+                rope->append(payloadOf(packet));
+                if (packet->getFrg() == 0) {
+                    break;
+                }
+            }
+            onRead(rope);
+            continue;
+        }
+
+        int offset = 0;
+        auto buffer = BufferRaw::create(size);
+        buffer->setSize(size);
         while (1) {
-            int offset = 0;
-            auto buffer = BufferRaw::create(size);
-            buffer->setSize(size);
             auto packet = _rcv_queue.front();
             _rcv_queue.pop_front();
             memcpy(buffer->data() + offset, packet->getPayloadData(), packet->getLen());
             offset += packet->getLen();
+            _copied_bytes += packet->getLen();
 
             if (packet->getFrg() == 0) {
                 onRead(buffer);
@@ -452,17 +576,20 @@ size_t KcpTransport::mergeSendQueue(const char *buffer, size_t len) {
         return 0;
     }
 
-    auto packet = _snd_queue.front();
+    auto packet = _snd_queue.back();
     size_t oldLen = packet->getLen();
     if (oldLen >= _mss) {
         //前一个包已经达到_mss长度,不允许合并
         return 0;
     }
 
+    //合并的数据不超过一个mss,直接拷贝
+    //The merged data does not exceed one mss, copy it directly
+    _copied_bytes += packet->ownPayload();
     size_t extendLen = std::min<size_t>(len, _mss - oldLen);
-    packet->setPayLoadSize(oldLen + extendLen);
+    packet->resizePayload(oldLen + extendLen);
     memcpy(packet->getPayloadData() + oldLen, buffer, extendLen);
-    packet->setLen(oldLen + extendLen);
+    _copied_bytes += extendLen;
     packet->setFrg(0);
     return extendLen;
 }
@@ -873,6 +1000,35 @@ void KcpTransport::setStreamMode(bool flag) {
     return;
 }
 
+bool KcpTransport::verifyMigration(const char *data, size_t len) const {
+    KcpHeader header;
+    if (!_conv_init || len < KcpHeader::HEADER_SIZE || !header.loadHeaderFromData(data, len) || header.getConv() != _conv) {
+        return false;
+    }
+    auto una = header.getUna();
+    if (_itimediff(una, _snd_una) < 0 || _itimediff(una, _snd_nxt) > 0) {
+        return false;
+    }
+    switch (header.getCmd()) {
+        case KcpHeader::Cmd::CMD_PUSH: {
+            auto diff = _itimediff(header.getSn(), _rcv_nxt);
+            return diff >= -(long)_rcv_wnd && diff < (long)_rcv_wnd;
+        }
+        case KcpHeader::Cmd::CMD_ACK:
+            return _itimediff(header.getSn(), _snd_nxt) < 0;
+        case KcpHeader::Cmd::CMD_WASK:
+        case KcpHeader::Cmd::CMD_WINS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void KcpTransport::setZeroCopy(bool flag) {
+    _zero_copy = flag;
+    return;
+}
+
 void KcpTransport::setFastResend(int resend) {
     _fastresend = resend;
     return;
@@ -889,13 +1045,19 @@ void KcpTransport::setWndSize(int sndwnd, int rcvwnd) {
 }
 
 void KcpTransport::sendPacket(KcpPacket::Ptr pkt, bool flush) {
-    pkt->storeToData();
-    if (pkt->size() + _buffer_pool->size() > _mtu) {
-        flushPool();
-    }
+    if (_zero_copy) {
+        sendPacketZeroCopy(pkt);
+    } else {
+        _copied_bytes += pkt->ownPayload();
+        pkt->storeToData();
+        if (pkt->size() + _buffer_pool->size() > _mtu) {
+            flushPool();
+        }
 
-    memcpy(_buffer_pool->data() + _buffer_pool->size(), pkt->data(), pkt->size());
-    _buffer_pool->setSize(_buffer_pool->size() + pkt->size());
+        memcpy(_buffer_pool->data() + _buffer_pool->size(), pkt->data(), pkt->size());
+        _buffer_pool->setSize(_buffer_pool->size() + pkt->size());
+        _copied_bytes += pkt->getLen();
+    }
 
     if (flush) {
         flushPool();
@@ -903,9 +1065,42 @@ void KcpTransport::sendPacket(KcpPacket::Ptr pkt, bool flush) {
     return;
 }
 
+void KcpTransport::sendPacketZeroCopy(const KcpPacket::Ptr &pkt) {
+    if (_send_rope && pkt->getPacketSize() + _send_rope->size() > _mtu) {
+        flushPool();
+    }
+    if (!_send_rope) {
+        _send_rope = BufferRope::create();
+        _header_pool = BufferRaw::create(_mtu);
+    }
+
+    //头部写入本udp包的头部缓存,负载只引用
+    //The header is written into the header cache of this udp packet, the payload is only referenced
+    auto offset = _header_pool->size();
+    pkt->storeHeaderToData(_header_pool->data() + offset, KcpHeader::HEADER_SIZE);
+    _header_pool->setSize(offset + KcpHeader::HEADER_SIZE);
+    _send_rope->append(_header_pool, offset, KcpHeader::HEADER_SIZE);
+    if (pkt->getLen()) {
+        _send_rope->append(payloadOf(pkt));
+    }
+}
+
 void KcpTransport::flushPool() {
+    if (_zero_copy) {
+        if (_send_rope) {
+            onWrite(_send_rope);
+            _send_rope = nullptr;
+            _header_pool = nullptr;
+        }
+        return;
+    }
+    if (!_buffer_pool->size()) {
+        return;
+    }
+    //已交出的udp包可能仍在socket发送队列中,不能复用
+    //The handed over udp packet may still be in the send queue of the socket, so it can not be reused
     onWrite(_buffer_pool);
-    _buffer_pool->setSize(0);
+    _buffer_pool = BufferRaw::create(_mtu);
 }
 
 } // namespace toolkit
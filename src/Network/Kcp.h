@@ -75,6 +75,10 @@ public:
 
     static KcpPacket::Ptr parse(const char* data, size_t len);
 
+    // 零拷贝解析,负载为指向buf的视图,不拷贝数据
+    // Zero-copy parsing, the payload is a view into buf and no data is copied
+    static KcpPacket::Ptr parse(const Buffer::Ptr &buf, size_t offset);
+
     KcpPacket() {};
     KcpPacket(uint32_t conv, Cmd cmd, size_t payloadSize) {
         setConv(conv);
@@ -91,9 +95,25 @@ public:
     bool storeToData();
 
     char *getPayloadData() {
-        return data() + HEADER_SIZE;
+        return _payload ? _payload->data() : data() + HEADER_SIZE;
     };
 
+    // 以视图方式引用外部负载,本包只保存头部
+    // Reference an external payload as a view, this packet only stores the header
+    void setPayload(Buffer::Ptr payload);
+
+    // 外部负载视图,负载在本包内时返回nullptr
+    // The external payload view, nullptr is returned if the payload is stored in this packet
+    const Buffer::Ptr &getPayload() const { return _payload; }
+
+    // 把外部负载拷贝到本包内,返回拷贝的字节数
+    // Copy the external payload into this packet, the number of bytes copied is returned
+    size_t ownPayload();
+
+    // 修改负载长度并保留原有内容
+    // Change the payload length and keep the existing content
+    void resizePayload(size_t len);
+
     uint32_t getResendts() const { return _resendts; }
     uint32_t getRto() const { return _rto; }
     uint32_t getFastack() const { return _fastack; }
@@ -114,6 +134,7 @@ protected:
     bool loadFromData(const char *data, size_t len);
 
 private:
+    Buffer::Ptr _payload; // 零拷贝模式下的负载视图
     uint32_t _resendts; // 重传超时时间戳,表示该数据包下次重传的时间戳
     uint32_t _rto;      // 超时重传时间，表示数据包在多长时间没收到ACK就重传,会基于rtt动态调整
     uint32_t _fastack;  // 快速确认计数器
@@ -238,6 +259,30 @@ public:
     //默认不开启
     void setStreamMode(bool flag);
 
+    //设置零拷贝模式,默认不开启
+    //开启后: 在poller线程中input的数据直接解析为视图,仅在包需滞留到本次input之后时才拷贝;
+    //send不再拷贝用户数据,发送的buf在被对端确认前不可修改;
+    //输出的udp包为BufferRope(头部+负载视图),由sendmmsg/sendmsg直接聚集发送;
+    //onRead回调中的buf仅在回调期间有效,需要保留时请自行拷贝
+    //Set the zero-copy mode, disabled by default
+    //When enabled: data input in the poller thread is parsed into views directly, and is copied only if a packet must be kept after this input;
+    //send no longer copies the user data, the sent buf must not be modified until acknowledged by the peer;
+    //output udp packets are BufferRope (header + payload view) gathered by sendmmsg/sendmsg directly;
+    //the buf of the onRead callback is only valid during the callback, copy it if it needs to be kept
+    void setZeroCopy(bool flag);
+
+    //校验来自新对端地址的数据能否迁移本会话(NAT重绑定),须在poller线程调用
+    //conv须一致,una须落在已发送未确认的区间内,数据包的sn须落在接收窗口内,
+    //即以当前收发序号作为令牌,不知道会话状态的第三方无法伪造
+    //Verify whether data from a new peer address can migrate this session (NAT rebinding), must be called in the poller thread
+    //the conv must match, una must be within the range sent but not acknowledged, and the sn of a data packet must be within the receive window,
+    //that is, the current sequence numbers act as the token, which can not be forged by a third party without the session state
+    bool verifyMigration(const char *data, size_t len) const;
+
+    //KCP层拷贝的数据字节数,用于评估零拷贝效果
+    //Bytes of data copied by the KCP layer, used to evaluate the effect of zero-copy
+    uint64_t getCopiedBytes() const { return _copied_bytes; }
+
 protected:
 
     void onWrite(const Buffer::Ptr &buf) {
@@ -261,6 +306,10 @@ protected:
 
     void startTimer();
 
+    //解析并处理收到的数据,borrowed表示buf在本次调用后会被复用
+    //Parse and handle the received data, borrowed means buf is reused after this call
+    void inputPackets(const Buffer::Ptr &buf, bool borrowed);
+
     //处理收到的数据,rcv_buf中有新数据时调用
     void onData();
 
@@ -283,6 +332,7 @@ protected:
     void sendAckList();
     void sendProbePacket();
     void sendPacket(KcpPacket::Ptr pkt, bool flush = false);
+    void sendPacketZeroCopy(const KcpPacket::Ptr &pkt);
     void flushPool();
 
     //将发送缓存中对端已经确认的数据包丢弃
@@ -379,6 +429,13 @@ private:
     //待发送的ACK列表
     std::deque<std::pair<uint32_t /*sn*/, uint32_t /*ts*/>>_acklist;
     BufferRaw::Ptr _buffer_pool;  //用于合并多个kcp包到一个udp包中
+
+    bool _zero_copy = false;
+    uint64_t _copied_bytes = 0;
+    //零拷贝模式下正在组装的udp包,以及存放其中各kcp包头部的缓存
+    //The udp packet being assembled in zero-copy mode, and the cache of the headers of its kcp packets
+    BufferRope::Ptr _send_rope;
+    BufferRaw::Ptr _header_pool;
 };
 } // namespace toolkit
 
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2021 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "KcpMux.h"
+#include "Util/Byte.hpp"
+
+using namespace std;
+
+namespace toolkit {
+
+static const uint8_t kMagic = 0xA0;
+static const uint8_t kFlagUnreliable = 0x01;
+static const size_t kHeaderPoolSize = 4096;
+
+const size_t KcpMux::HEADER_SIZE;
+const uint8_t KcpMux::PRIORITY_LEVELS;
+
+ssize_t KcpMux::Stream::send(const Buffer::Ptr &buf, bool flush) {
+    if (_kcp) {
+        return _kcp->send(buf, flush);
+    }
+    auto mux = _mux.lock();
+    if (!mux) {
+        return -1;
+    }
+    return mux->sendUnreliable(*this, buf);
+}
+
+KcpMux::KcpMux(bool server_mode, const EventPoller::Ptr &poller) : _server_mode(server_mode) {
+    setPoller(poller);
+}
+
+KcpMux::~KcpMux() {
+    //先销毁流,KcpTransport析构时的输出会被丢弃
+    //Destroy the streams first, the output when KcpTransport destructs is dropped
+    _streams.clear();
+}
+
+void KcpMux::setPoller(const EventPoller::Ptr &poller) {
+    _poller = poller ? poller : EventPollerPool::Instance().getPoller();
+    for (auto &pr : _streams) {
+        if (pr.second->_kcp) {
+            pr.second->_kcp->setPoller(_poller);
+        }
+    }
+}
+
+void KcpMux::setMtu(int mtu) {
+    if (mtu < 50 + (int)HEADER_SIZE) {
+        std::string err = (StrPrinter << "KcpMux setMtu " << mtu << " too small");
+        throw std::runtime_error(err);
+    }
+    _mtu = mtu;
+}
+
+KcpMux::Stream::Ptr KcpMux::openStream(uint16_t id, StreamMode mode, uint8_t priority) {
+    auto it = _streams.find(id);
+    if (it != _streams.end()) {
+        return it->second;
+    }
+    return createStream(id, mode, priority);
+}
+
+KcpMux::Stream::Ptr KcpMux::getStream(uint16_t id) const {
+    auto it = _streams.find(id);
+    return it == _streams.end() ? nullptr : it->second;
+}
+
+void KcpMux::closeStream(uint16_t id) {
+    _streams.erase(id);
+}
+
+KcpMux::Stream::Ptr KcpMux::createStream(uint16_t id, StreamMode mode, uint8_t priority) {
+    auto stream = std::make_shared<Stream>(id, mode, 0);
+    stream->setPriority(priority);
+    stream->_mux = shared_from_this();
+    if (mode == StreamMode::RELIABLE) {
+        std::weak_ptr<KcpMux> weak_self = shared_from_this();
+        std::weak_ptr<Stream> weak_stream = stream;
+        stream->_kcp = std::make_shared<KcpTransport>(_server_mode, _poller);
+        stream->_kcp->setMtu(_mtu - HEADER_SIZE);
+        stream->_kcp->setOnWrite([weak_self, weak_stream](const Buffer::Ptr &buf) {
+            auto strong_self = weak_self.lock();
+            auto strong_stream = weak_stream.lock();
+            if (strong_self && strong_stream) {
+                strong_self->sendFrame(*strong_stream, buf);
+            }
+        });
+        stream->_kcp->setOnRead([weak_stream](const Buffer::Ptr &buf) {
+            auto strong_stream = weak_stream.lock();
+            if (strong_stream && strong_stream->_on_read) {
+                strong_stream->_on_read(buf);
+            }
+        });
+        stream->_kcp->setOnErr([weak_self](const SockException &ex) {
+            auto strong_self = weak_self.lock();
+            if (strong_self && strong_self->_on_err) {
+                strong_self->_on_err(ex);
+            }
+        });
+    }
+    _streams.emplace(id, stream);
+    return stream;
+}
+
+void KcpMux::input(const Buffer::Ptr &buf) {
+    if (buf->size() < HEADER_SIZE || (buf->data()[0] & 0xF0) != kMagic) {
+        WarnL << "invalid kcp mux packet, size: " << buf->size();
+        return;
+    }
+    auto flags = (uint8_t)buf->data()[0] & 0x0F;
+    auto id = Byte::Get2BytesLE((const uint8_t *)buf->data(), 1);
+    auto mode = (flags & kFlagUnreliable) ? StreamMode::UNRELIABLE : StreamMode::RELIABLE;
+
+    auto stream = getStream(id);
+    if (!stream) {
+        if (_max_streams && _streams.size() >= _max_streams) {
+            WarnL << "kcp mux stream count reaches the limit " << _max_streams << ", drop packet of stream " << id;
+            return;
+        }
+        stream = createStream(id, mode, 0);
+        if (_on_stream) {
+            _on_stream(stream);
+        }
+    }
+    if (stream->_mode != mode) {
+        WarnL << "kcp mux stream " << id << " mode mismatch";
+        return;
+    }
+
+    auto payload = std::make_shared<BufferOffset<Buffer::Ptr> >(buf, HEADER_SIZE, buf->size() - HEADER_SIZE);
+    if (stream->_kcp) {
+        stream->_kcp->input(payload);
+    } else if (stream->_on_read) {
+        stream->_on_read(payload);
+    }
+}
+
+ssize_t KcpMux::sendUnreliable(Stream &stream, const Buffer::Ptr &buf) {
+    if (buf->size() + HEADER_SIZE > (size_t)_mtu) {
+        WarnL << "kcp mux unreliable message too large: " << buf->size();
+        return -1;
+    }
+    sendFrame(stream, buf);
+    return buf->size();
+}
+
+void KcpMux::sendFrame(const Stream &stream, const Buffer::Ptr &buf) {
+    //帧头写入共享的头部缓存,负载只引用
+    //The frame header is written into the shared header cache, the payload is only referenced
+    if (!_header_pool || _header_pool->size() + HEADER_SIZE > kHeaderPoolSize) {
+        _header_pool = BufferRaw::create(kHeaderPoolSize);
+    }
+    auto offset = _header_pool->size();
+    auto header = (uint8_t *)_header_pool->data() + offset;
+    Byte::Set1Byte(header, 0, kMagic | (stream._mode == StreamMode::UNRELIABLE ? kFlagUnreliable : 0));
+    Byte::Set2BytesLE(header, 1, stream._id);
+    _header_pool->setSize(offset + HEADER_SIZE);
+
+    auto rope = std::dynamic_pointer_cast<BufferRope>(buf);
+    if (!rope) {
+        rope = BufferRope::create();
+        rope->append(buf);
+    }
+    rope->prepend(_header_pool, offset, HEADER_SIZE);
+    _send_queue[stream._priority].emplace_back(std::move(rope));
+    ++_pending;
+    scheduleFlush();
+}
+
+void KcpMux::scheduleFlush() {
+    if (_flush_scheduled) {
+        return;
+    }
+    //本次事件循环中各流的输出汇总后再按优先级发送
+    //The output of all streams in this event loop iteration is collected and then sent by priority
+    _flush_scheduled = true;
+    std::weak_ptr<KcpMux> weak_self = shared_from_this();
+    _poller->async([weak_self]() {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->flush();
+        }
+    }, false);
+}
+
+void KcpMux::flush() {
+    _flush_scheduled = false;
+    auto budget = _max_burst ? _max_burst : _pending;
+    for (auto &queue : _send_queue) {
+        while (budget && !queue.empty()) {
+            auto buf = std::move(queue.front());
+            queue.pop_front();
+            --_pending;
+            --budget;
+            if (_on_write) {
+                _on_write(buf);
+            }
+        }
+    }
+    if (_pending) {
+        scheduleFlush();
+    }
+}
+
+} // namespace toolkit
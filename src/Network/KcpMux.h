@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2021 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TOOLKIT_NETWORK_KCPMUX_H
+#define TOOLKIT_NETWORK_KCPMUX_H
+
+#include <unordered_map>
+#include "Network/Kcp.h"
+#include "Util/List.h"
+
+namespace toolkit {
+
+//KCP多路复用: 一个udp连接上承载多个流,每个udp包前加3字节帧头:
+//| magic(高4位) + flags(低4位) 1字节 | stream id 2字节(小端) | 负载 |
+//可靠流各自拥有一个KcpTransport,独立排序与重传,一个流丢包不会阻塞其他流(无流间队头阻塞);
+//不可靠流的每条消息即一个udp包,不重传也不排序,消息不能超过mtu;
+//所有流输出的udp包按流的优先级调度发送
+//KCP multiplexing: multiple streams over one udp connection, each udp packet is prefixed with a 3-byte frame header:
+//| magic (high 4 bits) + flags (low 4 bits) 1 byte | stream id 2 bytes (little endian) | payload |
+//each reliable stream owns a KcpTransport, which orders and retransmits independently, so the loss of one stream does not stall
+//the others (no head-of-line blocking across streams);
+//each message of an unreliable stream is one udp packet, which is neither retransmitted nor ordered, and must not exceed the mtu;
+//udp packets output by all streams are scheduled by the priority of the streams
+//所有接口须在poller线程调用,须通过std::make_shared创建
+//All interfaces must be called in the poller thread, must be created with std::make_shared
+class KcpMux : public std::enable_shared_from_this<KcpMux> {
+public:
+    using Ptr = std::shared_ptr<KcpMux>;
+
+    static const size_t HEADER_SIZE = 3;
+    //优先级个数,0最高
+    //Count of priorities, 0 is the highest
+    static const uint8_t PRIORITY_LEVELS = 8;
+
+    enum class StreamMode : uint8_t {
+        RELIABLE = 0,   //可靠有序 reliable and ordered
+        UNRELIABLE = 1, //不可靠无序 unreliable and unordered
+    };
+
+    class Stream {
+    public:
+        using Ptr = std::shared_ptr<Stream>;
+        using onReadCB = std::function<void(const Buffer::Ptr &buf)>;
+
+        Stream(uint16_t id, StreamMode mode, uint8_t priority) : _id(id), _mode(mode), _priority(priority) {}
+
+        uint16_t getId() const { return _id; }
+        StreamMode getMode() const { return _mode; }
+
+        //调整发送优先级,0最高
+        //Adjust the send priority, 0 is the highest
+        void setPriority(uint8_t priority) { _priority = std::min<uint8_t>(priority, PRIORITY_LEVELS - 1); }
+        uint8_t getPriority() const { return _priority; }
+
+        //收到的数据,不可靠流的buf仅在回调期间有效
+        //Received data, the buf of an unreliable stream is only valid during the callback
+        void setOnRead(onReadCB cb) { _on_read = std::move(cb); }
+
+        ssize_t send(const Buffer::Ptr &buf, bool flush = false);
+
+        //可靠流的KcpTransport,可用于调整KCP参数(不要修改mtu与回调),不可靠流为空
+        //The KcpTransport of a reliable stream, which can be used to tune the KCP parameters (do not change the mtu or callbacks),
+        //null for an unreliable stream
+        const KcpTransport::Ptr &getKcpTransport() const { return _kcp; }
+
+    private:
+        friend class KcpMux;
+
+        uint16_t _id;
+        StreamMode _mode;
+        uint8_t _priority;
+        onReadCB _on_read;
+        KcpTransport::Ptr _kcp;
+        std::weak_ptr<KcpMux> _mux;
+    };
+
+    using onWriteCB = std::function<void(const Buffer::Ptr &buf)>;
+    using onStreamCB = std::function<void(const Stream::Ptr &stream)>;
+    using OnErr = std::function<void(const SockException &)>;
+
+    KcpMux(bool server_mode, const EventPoller::Ptr &poller = nullptr);
+    ~KcpMux();
+
+    void setOnWrite(onWriteCB cb) { _on_write = std::move(cb); }
+    void setOnErr(OnErr cb) { _on_err = std::move(cb); }
+
+    //对端新建流时触发,在处理该流的第一个包前回调,可在此设置onRead、优先级与KCP参数
+    //Triggered when the peer creates a new stream, called before handling the first packet of the stream,
+    //where onRead, the priority and KCP parameters can be set
+    void setOnStream(onStreamCB cb) { _on_stream = std::move(cb); }
+
+    void setPoller(const EventPoller::Ptr &poller);
+    const EventPoller::Ptr &getPoller() const { return _poller; }
+
+    //udp包最大长度(含帧头),默认1400,须在打开流之前设置
+    //Max size of udp packets (including the frame header), 1400 by default, must be set before opening streams
+    void setMtu(int mtu);
+
+    //每个事件循环最多发送的udp包个数,超出部分留待下个循环,优先级低的先被推迟;0则不限制
+    //Max udp packets sent per event loop iteration, the rest waits for the next iteration and low priorities are deferred first;
+    //0 for no limit
+    void setMaxBurst(size_t max_burst) { _max_burst = max_burst; }
+
+    //流个数上限,达到上限后丢弃对端新建流的数据,默认1024;0则不限制
+    //Max count of streams, data of streams newly created by the peer is dropped once it is reached, 1024 by default;
+    //0 for no limit
+    void setMaxStreams(size_t max_streams) { _max_streams = max_streams; }
+
+    //打开流,已存在则直接返回
+    //Open a stream, return it directly if it already exists
+    Stream::Ptr openStream(uint16_t id, StreamMode mode = StreamMode::RELIABLE, uint8_t priority = 0);
+    Stream::Ptr getStream(uint16_t id) const;
+    //只在本地关闭,对端再发送数据时会重新打开
+    //Only closed locally, it is reopened when the peer sends data again
+    void closeStream(uint16_t id);
+
+    //输入socket层收到的udp包
+    //Input udp packets received by the socket layer
+    void input(const Buffer::Ptr &buf);
+
+    //待发送的udp包个数
+    //Count of udp packets waiting to be sent
+    size_t getPendingCount() const { return _pending; }
+
+private:
+    Stream::Ptr createStream(uint16_t id, StreamMode mode, uint8_t priority);
+    ssize_t sendUnreliable(Stream &stream, const Buffer::Ptr &buf);
+    void sendFrame(const Stream &stream, const Buffer::Ptr &buf);
+    void scheduleFlush();
+    void flush();
+
+private:
+    bool _server_mode;
+    bool _flush_scheduled = false;
+    int _mtu = KcpTransport::IKCP_MTU_DEF;
+    size_t _max_burst = 0;
+    size_t _pending = 0;
+    size_t _max_streams = 1024;
+    BufferRaw::Ptr _header_pool;
+    EventPoller::Ptr _poller;
+    onWriteCB _on_write;
+    onStreamCB _on_stream;
+    OnErr _on_err;
+    std::unordered_map<uint16_t, Stream::Ptr> _streams;
+    List<Buffer::Ptr> _send_queue[PRIORITY_LEVELS];
+};
+
+} // namespace toolkit
+
+#endif // TOOLKIT_NETWORK_KCPMUX_H
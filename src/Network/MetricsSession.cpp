@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "MetricsSession.h"
+#include "Util/Metrics.h"
+#include "Util/Trace.h"
+#include "Util/util.h"
+
+using namespace std;
+
+namespace toolkit {
+
+// 请求头的最大长度
+// Max length of the request header
+static constexpr size_t kMaxRequestSize = 8 * 1024;
+
+MetricsSession::MetricsSession(const Socket::Ptr &sock) : Session(sock) {
+    setIdleTimeout(15 * 1000);
+}
+
+void MetricsSession::onRecv(const Buffer::Ptr &buf) {
+    if (_responded) {
+        return;
+    }
+    _request.append(buf->data(), buf->size());
+    auto pos = _request.find("\r\n\r\n");
+    if (pos == string::npos) {
+        if (_request.size() > kMaxRequestSize) {
+            sendResponse("431 Request Header Fields Too Large", "text/plain", "");
+        }
+        return;
+    }
+    auto line = _request.substr(0, _request.find("\r\n"));
+    auto parts = split(line, " ");
+    if (parts.size() < 2) {
+        sendResponse("400 Bad Request", "text/plain", "");
+        return;
+    }
+    onRequest(parts[0], parts[1]);
+}
+
+void MetricsSession::onRequest(const string &method, const string &url) {
+    if (method != "GET") {
+        sendResponse("405 Method Not Allowed", "text/plain", "");
+        return;
+    }
+    auto pos = url.find('?');
+    auto path = url.substr(0, pos);
+    auto query = pos == string::npos ? string() : url.substr(pos + 1);
+    bool json = path == "/metrics.json";
+    for (auto &param : split(query, "&")) {
+        if (param == "format=json") {
+            json = true;
+        } else if (path == "/trace" && param == "enable=1") {
+            Tracer::setEnabled(true);
+        } else if (path == "/trace" && param == "enable=0") {
+            Tracer::setEnabled(false);
+        }
+    }
+    if (path == "/trace") {
+        sendResponse("200 OK", "application/json", Tracer::Instance().dumpChromeJson());
+        return;
+    }
+    if (path != "/metrics" && path != "/metrics.json") {
+        sendResponse("404 Not Found", "text/plain", "");
+        return;
+    }
+    if (json) {
+        sendResponse("200 OK", "application/json", MetricsRegistry::Instance().toJson());
+    } else {
+        sendResponse("200 OK", "text/plain; version=0.0.4", MetricsRegistry::Instance().toPrometheus());
+    }
+}
+
+void MetricsSession::sendResponse(const char *status, const char *content_type, const string &body) {
+    _responded = true;
+    _StrPrinter printer;
+    printer << "HTTP/1.1 " << status << "\r\n"
+            << "Content-Type: " << content_type << "\r\n"
+            << "Content-Length: " << body.size() << "\r\n"
+            << "Connection: close\r\n\r\n";
+    // 发送完毕后关闭连接
+    // Close the connection after sending
+    weak_ptr<Session> weak_self = static_pointer_cast<Session>(shared_from_this());
+    getSock()->setOnFlush([weak_self]() {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->shutdown(SockException(Err_shutdown, "metrics response sent"));
+        }
+        return false;
+    });
+    send(printer + body);
+    if (getSock()->getSendBufferCount() == 0 && !isSocketBusy()) {
+        // 已全部写入socket，不会再触发flush回调
+        // All data has been written to the socket, the flush callback will not be triggered
+        shutdown(SockException(Err_shutdown, "metrics response sent"));
+    }
+}
+
+} /* namespace toolkit */
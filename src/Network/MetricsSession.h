@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef NETWORK_METRICSSESSION_H
+#define NETWORK_METRICSSESSION_H
+
+#include <string>
+#include "Session.h"
+
+namespace toolkit {
+
+/**
+ * 导出指标的极简http会话，配合TcpServer使用：
+ * GET /metrics返回Prometheus文本格式，GET /metrics.json或带format=json参数时返回json；
+ * GET /trace导出追踪事件(Chrome/Perfetto json)，带enable=1或enable=0参数时开启或关闭追踪；
+ * 每次请求应答后关闭连接
+ * Minimal http session exporting metrics, used with TcpServer:
+ * GET /metrics returns the Prometheus text format, GET /metrics.json or with the format=json parameter returns json;
+ * GET /trace dumps the trace events (Chrome/Perfetto json), the enable=1 or enable=0 parameter turns tracing on or off;
+ * the connection is closed after each response
+ */
+class MetricsSession : public Session {
+public:
+    MetricsSession(const Socket::Ptr &sock);
+
+    void onRecv(const Buffer::Ptr &buf) override;
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+
+private:
+    void onRequest(const std::string &method, const std::string &url);
+    void sendResponse(const char *status, const char *content_type, const std::string &body);
+
+private:
+    bool _responded = false;
+    std::string _request;
+};
+
+} /* namespace toolkit */
+#endif /* NETWORK_METRICSSESSION_H */
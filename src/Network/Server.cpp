@@ -8,12 +8,17 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <set>
 #include "Server.h"
 
 using namespace std;
 
 namespace toolkit {
 
+// 会话onManager的触发间隔
+// Trigger interval of the onManager of sessions
+static constexpr uint64_t kManagerIntervalMS = 2000;
+
 Server::Server(EventPoller::Ptr poller) {
     _poller = poller ? std::move(poller) : EventPollerPool::Instance().getPoller();
 }
@@ -27,8 +32,7 @@ SessionHelper::SessionHelper(const std::weak_ptr<Server> &server, Session::Ptr s
     //记录session至全局的map，方便后面管理  [AUTO-TRANSLATED:f90fce35]
     //Record the session in the global map for easy management later
     _session_map = SessionMap::Instance().shared_from_this();
-    _identifier = _session->getIdentifier();
-    _session_map->add(_identifier, _session);
+    _session_map->add(_session);
 }
 
 SessionHelper::~SessionHelper() {
@@ -39,7 +43,46 @@ SessionHelper::~SessionHelper() {
     }
     //从全局map移除相关记录  [AUTO-TRANSLATED:f0b0b2ad]
     //Remove the related record from the global map
-    _session_map->del(_identifier);
+    _session_map->del(_session->getSessionId());
+}
+
+void SessionHelper::startManager() {
+    auto server = _server.lock();
+    if (!_session->_idle_timeout_set && server) {
+        _session->_idle_timeout_ms = server->getSessionIdleTimeout();
+    }
+    _session->startIdleTimer();
+    if (!_session->isManagerEnabled()) {
+        if (!_session->_idle_timeout_ms && _session->getSock()->sockType() == SockNum::Sock_UDP) {
+            // udp会话没有断开事件，既无空闲超时也无onManager时永远不会被回收；onManager改为须主动开启，每个类提示一次
+            // A udp session has no disconnection event, it is never reclaimed without an idle timeout or onManager;
+            // onManager now has to be enabled explicitly, warn once per class
+            static mutex s_mtx;
+            static set<string> s_warned;
+            lock_guard<mutex> lck(s_mtx);
+            if (s_warned.emplace(_cls).second) {
+                WarnL << _cls << " has neither idle timeout nor onManager enabled, its udp sessions are never reaped; "
+                      << "call setIdleTimeout or enableManager(true)";
+            }
+        }
+        return;
+    }
+    weak_ptr<Session> weak_session = _session;
+    // 首次触发时间按会话id打散，避免同时创建的大量会话在同一个tick中集中触发
+    // The first trigger is spread by the session id, so that lots of sessions created together do not fire in the same tick
+    auto first_delay = 1 + _session->getSessionId() * 2654435761ULL % kManagerIntervalMS;
+    _manager_timer = TimingWheel::getInstance(_session->getPoller())->add(first_delay, [weak_session]() -> uint64_t {
+        auto strong_session = weak_session.lock();
+        if (!strong_session) {
+            return 0;
+        }
+        try {
+            strong_session->onManager();
+        } catch (exception &ex) {
+            WarnL << "Exception occurred when emit onManager: " << ex.what();
+        }
+        return kManagerIntervalMS;
+    });
 }
 
 const Session::Ptr &SessionHelper::session() const {
@@ -52,35 +95,236 @@ const std::string &SessionHelper::className() const {
 
 ////////////////////////////////////////////////////////////////////////////////////
 
-bool SessionMap::add(const string &tag, const Session::Ptr &session) {
-    lock_guard<mutex> lck(_mtx_session);
-    return _map_session.emplace(tag, session).second;
+SessionMap::Node *const SessionMap::kTombstone = reinterpret_cast<SessionMap::Node *>(uintptr_t(1));
+
+SessionMap::Table::Table(size_t capacity) : mask(capacity - 1), shift(64), slots(new std::atomic<Node *>[capacity]) {
+    for (size_t i = 0; i < capacity; ++i) {
+        slots[i] = nullptr;
+    }
+    for (auto n = capacity; n > 1; n >>= 1) {
+        --shift;
+    }
+}
+
+// 读者临界区：进入时登记到当前纪元，离开时注销
+// Reader critical section: registered in the current epoch on entry and deregistered on exit
+class SessionMap::ReadGuard {
+public:
+    ReadGuard(Shard &shard) : _shard(shard) {
+        while (true) {
+            auto epoch = _shard.epoch.load();
+            _index = epoch & 1;
+            _shard.readers[_index].fetch_add(1);
+            if (_shard.epoch.load() == epoch) {
+                break;
+            }
+            // 登记期间纪元已切换，重新登记到新纪元
+            // The epoch switched while registering, register in the new one again
+            _shard.readers[_index].fetch_sub(1);
+        }
+    }
+    ~ReadGuard() { _shard.readers[_index].fetch_sub(1); }
+
+private:
+    Shard &_shard;
+    size_t _index;
+};
+
+SessionMap::~SessionMap() {
+    for (auto &shard : _shards) {
+        freeRetired(shard.retired_old);
+        freeRetired(shard.retired_new);
+        auto table = shard.table.load();
+        if (!table) {
+            continue;
+        }
+        for (size_t i = 0; i <= table->mask; ++i) {
+            auto node = table->slots[i].load();
+            if (node && node != kTombstone) {
+                delete node;
+            }
+        }
+        delete table;
+    }
+}
+
+bool SessionMap::add(const Session::Ptr &session) {
+    auto id = session->getSessionId();
+    auto &shard = getShard(id);
+    lock_guard<mutex> lck(shard.mtx);
+    auto table = shard.table.load(memory_order_relaxed);
+    if (!table || (shard.occupied + 1) * 2 > table->mask + 1) {
+        // 负载超过一半时重建，同时清除删除标记
+        // Rebuild when more than half loaded, which also clears the deletion markers
+        rehash(shard);
+        table = shard.table.load(memory_order_relaxed);
+    }
+    auto index = slotOf(*table, id);
+    auto insert_at = SIZE_MAX;
+    for (;; index = (index + 1) & table->mask) {
+        auto node = table->slots[index].load(memory_order_relaxed);
+        if (!node) {
+            if (insert_at == SIZE_MAX) {
+                insert_at = index;
+            }
+            break;
+        }
+        if (node == kTombstone) {
+            if (insert_at == SIZE_MAX) {
+                insert_at = index;
+            }
+            continue;
+        }
+        if (node->id == id) {
+            return false;
+        }
+    }
+    if (table->slots[insert_at].load(memory_order_relaxed) != kTombstone) {
+        ++shard.occupied;
+    }
+    table->slots[insert_at].store(new Node { id, session }, memory_order_release);
+    ++shard.live;
+    ++_size;
+    return true;
+}
+
+bool SessionMap::del(uint64_t session_id) {
+    auto &shard = getShard(session_id);
+    lock_guard<mutex> lck(shard.mtx);
+    auto table = shard.table.load(memory_order_relaxed);
+    if (!table) {
+        return false;
+    }
+    for (auto index = slotOf(*table, session_id);; index = (index + 1) & table->mask) {
+        auto node = table->slots[index].load(memory_order_relaxed);
+        if (!node) {
+            return false;
+        }
+        if (node != kTombstone && node->id == session_id) {
+            table->slots[index].store(kTombstone, memory_order_release);
+            shard.retired_new.nodes.emplace_back(node);
+            break;
+        }
+    }
+    --shard.live;
+    --_size;
+    reclaim(shard);
+    return true;
+}
+
+void SessionMap::rehash(Shard &shard) {
+    size_t capacity = 16;
+    while (capacity < (shard.live + 1) * 4) {
+        capacity *= 2;
+    }
+    auto table = new Table(capacity);
+    auto old_table = shard.table.load(memory_order_relaxed);
+    if (old_table) {
+        for (size_t i = 0; i <= old_table->mask; ++i) {
+            auto node = old_table->slots[i].load(memory_order_relaxed);
+            if (!node || node == kTombstone) {
+                continue;
+            }
+            auto index = slotOf(*table, node->id);
+            while (table->slots[index].load(memory_order_relaxed)) {
+                index = (index + 1) & table->mask;
+            }
+            table->slots[index].store(node, memory_order_relaxed);
+        }
+        shard.retired_new.tables.emplace_back(old_table);
+    }
+    shard.occupied = shard.live;
+    shard.table.store(table, memory_order_release);
+    reclaim(shard);
+}
+
+void SessionMap::reclaim(Shard &shard) {
+    // 上一纪元的读者都已离开时，回收上一纪元摘除的对象并切换纪元；否则留待下次写入
+    // Once all the readers of the previous epoch have left, reclaim what was unlinked in the previous epoch and switch
+    // epochs; otherwise leave it to the next write
+    auto epoch = shard.epoch.load();
+    if (shard.readers[(epoch - 1) & 1].load() != 0) {
+        return;
+    }
+    freeRetired(shard.retired_old);
+    std::swap(shard.retired_old, shard.retired_new);
+    shard.epoch.store(epoch + 1);
+}
+
+void SessionMap::freeRetired(Retired &retired) {
+    for (auto node : retired.nodes) {
+        delete node;
+    }
+    for (auto table : retired.tables) {
+        delete table;
+    }
+    retired.nodes.clear();
+    retired.tables.clear();
 }
 
-bool SessionMap::del(const string &tag) {
-    lock_guard<mutex> lck(_mtx_session);
-    return _map_session.erase(tag);
+SessionMap::Node *SessionMap::lookup(Shard &shard, uint64_t session_id) {
+    auto table = shard.table.load(memory_order_acquire);
+    if (!table) {
+        return nullptr;
+    }
+    auto index = slotOf(*table, session_id);
+    for (size_t probes = 0; probes <= table->mask; ++probes, index = (index + 1) & table->mask) {
+        auto node = table->slots[index].load(memory_order_acquire);
+        if (!node) {
+            break;
+        }
+        if (node != kTombstone && node->id == session_id) {
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+Session::Ptr SessionMap::get(uint64_t session_id) {
+    auto &shard = getShard(session_id);
+    ReadGuard guard(shard);
+    auto node = lookup(shard, session_id);
+    return node ? node->session.lock() : nullptr;
 }
 
 Session::Ptr SessionMap::get(const string &tag) {
-    lock_guard<mutex> lck(_mtx_session);
-    auto it = _map_session.find(tag);
-    if (it == _map_session.end()) {
+    // tag格式为"会话id-fd"，由其中的会话id直接定位
+    // The format of tag is "session id-fd", located directly by the session id inside
+    auto session = get(strtoull(tag.data(), nullptr, 10));
+    if (!session || session->getIdentifier() != tag) {
         return nullptr;
     }
-    return it->second.lock();
+    return session;
 }
 
-void SessionMap::for_each_session(const function<void(const string &id, const Session::Ptr &session)> &cb) {
-    lock_guard<mutex> lck(_mtx_session);
-    for (auto it = _map_session.begin(); it != _map_session.end();) {
-        auto session = it->second.lock();
-        if (!session) {
-            it = _map_session.erase(it);
+size_t SessionMap::size() {
+    return _size.load();
+}
+
+vector<SessionHandle> SessionMap::snapshot() {
+    vector<SessionHandle> ret;
+    ret.reserve(_size.load());
+    for (auto &shard : _shards) {
+        ReadGuard guard(shard);
+        auto table = shard.table.load(memory_order_acquire);
+        if (!table) {
             continue;
         }
-        cb(it->first, session);
-        ++it;
+        for (size_t i = 0; i <= table->mask; ++i) {
+            auto node = table->slots[i].load(memory_order_acquire);
+            if (node && node != kTombstone) {
+                ret.emplace_back(node->id, node->session);
+            }
+        }
+    }
+    return ret;
+}
+
+void SessionMap::for_each_session(const function<void(const string &id, const Session::Ptr &session)> &cb) {
+    for (auto &handle : snapshot()) {
+        if (auto session = handle.lock()) {
+            cb(session->getIdentifier(), session);
+        }
     }
 }
 
@@ -11,16 +11,41 @@
 #ifndef ZLTOOLKIT_SERVER_H
 #define ZLTOOLKIT_SERVER_H
 
-#include <unordered_map>
+#include <atomic>
+#include <vector>
+#include <mutex>
 #include "Util/mini.h"
 #include "Session.h"
 
 namespace toolkit {
 
+/**
+ * 会话的弱引用句柄，持有句柄不影响会话生命周期，通过句柄获取会话无需查表也无需加锁
+ * Weak handle of a session, holding a handle does not affect the lifetime of the session,
+ * getting the session through a handle needs neither table lookup nor locking
+ */
+class SessionHandle {
+public:
+    SessionHandle() = default;
+    SessionHandle(uint64_t id, std::weak_ptr<Session> session) : _id(id), _session(std::move(session)) {}
+    SessionHandle(const Session::Ptr &session) : _id(session ? session->getSessionId() : 0), _session(session) {}
+
+    uint64_t id() const { return _id; }
+    Session::Ptr lock() const { return _session.lock(); }
+    bool expired() const { return _session.expired(); }
+
+private:
+    uint64_t _id = 0;
+    std::weak_ptr<Session> _session;
+};
+
 // 全局的 Session 记录对象, 方便后面管理  [AUTO-TRANSLATED:1c2725cb]
 //Global Session record object, convenient for later management
 // 线程安全的  [AUTO-TRANSLATED:efbca605]
 //Thread-safe
+// 按整数会话id分片，增删只锁定其中一个分片，查找与快照不加锁(每个分片为RCU方式发布的开放寻址表)
+// Sharded by integer session id, add/remove only lock one shard, lookups and snapshots take no lock
+// (each shard is an open addressing table published in RCU style)
 class SessionMap : public std::enable_shared_from_this<SessionMap> {
 public:
     friend class SessionHelper;
@@ -29,11 +54,32 @@ public:
     //单例  [AUTO-TRANSLATED:8c2c95b4]
     //Singleton
     static SessionMap &Instance();
-    ~SessionMap() = default;
+    ~SessionMap();
 
     //获取Session  [AUTO-TRANSLATED:08c6e0f2]
     //Get Session
+    // tag须为会话的getIdentifier()，按其中的会话id定位，id对应的会话标识不符时返回空
+    // tag must be the getIdentifier() of the session, it is located by the session id inside, null is returned if the
+    // identifier of that id does not match
     Session::Ptr get(const std::string &tag);
+    Session::Ptr get(uint64_t session_id);
+
+    /**
+     * 获取所有会话的句柄快照，逐个分片拷贝，不加锁
+     * Get a handle snapshot of all sessions, shards are copied one by one without locking
+     */
+    std::vector<SessionHandle> snapshot();
+
+    /**
+     * 会话个数
+     * Number of sessions
+     */
+    size_t size();
+
+    /**
+     * 遍历所有会话，回调在快照上执行，不持有任何锁
+     * Iterate all sessions, the callback runs on a snapshot without holding any lock
+     */
     void for_each_session(const std::function<void(const std::string &id, const Session::Ptr &session)> &cb);
 
 private:
@@ -41,14 +87,83 @@ private:
 
     //移除Session  [AUTO-TRANSLATED:b6023f67]
     //Remove Session
-    bool del(const std::string &tag);
+    bool del(uint64_t session_id);
+
     //添加Session  [AUTO-TRANSLATED:4bdf8277]
     //Add Session
-    bool add(const std::string &tag, const Session::Ptr &session);
+    bool add(const Session::Ptr &session);
+
+private:
+    static constexpr size_t kShardCount = 64;
+
+    struct Node {
+        uint64_t id;
+        std::weak_ptr<Session> session;
+    };
+
+    // 线性探测的开放寻址表，槽位只由持锁的写者修改，节点发布后不再改变
+    // Linear probing open addressing table, slots are only modified by the writer holding the lock, nodes never change once published
+    struct Table {
+        explicit Table(size_t capacity);
+
+        size_t mask;
+        // 斐波那契散列的右移位数，连续的会话id被打散，避免删除标记连成长串
+        // Right shift of the Fibonacci hashing, consecutive session ids are scattered so deletion markers do not form long runs
+        unsigned shift;
+        std::unique_ptr<std::atomic<Node *>[]> slots;
+    };
+
+    // 已摘除、等待没有读者后回收的节点与表
+    // Unlinked nodes and tables waiting to be reclaimed once no reader can see them
+    struct Retired {
+        std::vector<Node *> nodes;
+        std::vector<Table *> tables;
+    };
+
+    struct Shard {
+        // 只有写者加锁
+        // Only writers lock it
+        std::mutex mtx;
+        std::atomic<Table *> table { nullptr };
+        // 已占用的槽位(含删除标记)与有效节点数
+        // Occupied slots (including deletion markers) and live nodes
+        size_t occupied = 0;
+        size_t live = 0;
+        // 读者按进入时纪元的奇偶计数，上一纪元的读者清零后，上一纪元摘除的对象即可回收
+        // Readers are counted by the parity of the epoch they entered, objects unlinked in the previous epoch can be
+        // reclaimed once the readers of the previous epoch drop to zero
+        std::atomic<uint64_t> epoch { 0 };
+        std::atomic<size_t> readers[2];
+        Retired retired_old;
+        Retired retired_new;
+        // 与相邻分片隔开，避免伪共享
+        // Keep away from adjacent shards to avoid false sharing
+        char padding[64];
+
+        Shard() {
+            readers[0] = 0;
+            readers[1] = 0;
+        }
+    };
+
+    class ReadGuard;
+
+    // 删除标记，探测时跳过
+    // Deletion marker, skipped while probing
+    static Node *const kTombstone;
+
+    Shard &getShard(uint64_t session_id) { return _shards[session_id % kShardCount]; }
+    static size_t slotOf(const Table &table, uint64_t session_id) {
+        return (size_t)(((session_id / kShardCount) * 0x9E3779B97F4A7C15ULL) >> table.shift);
+    }
+    static Node *lookup(Shard &shard, uint64_t session_id);
+    static void rehash(Shard &shard);
+    static void reclaim(Shard &shard);
+    static void freeRetired(Retired &retired);
 
 private:
-    std::mutex _mtx_session;
-    std::unordered_map<std::string, std::weak_ptr<Session> > _map_session;
+    std::atomic<size_t> _size { 0 };
+    Shard _shards[kShardCount];
 };
 
 class Server;
@@ -65,10 +180,19 @@ public:
     const Session::Ptr &session() const;
     const std::string &className() const;
 
+    /**
+     * 开始会话的超时管理：启动空闲超时(会话未设置时使用服务器的默认值)，并在会话开启onManager时周期性触发之
+     * 由服务器在attachServer之后、于会话所在poller线程调用；本对象释放后不再触发onManager
+     * Start the timeout management of the session: start the idle timeout (the default of the server if the session does not set it),
+     * and trigger onManager periodically if the session enables it
+     * Called by the server after attachServer in the poller thread of the session; onManager is no longer triggered after this object is released
+     */
+    void startManager();
+
 private:
     std::string _cls;
-    std::string _identifier;
     Session::Ptr _session;
+    TimingWheel::Entry::Ptr _manager_timer;
     SessionMap::Ptr _session_map;
     std::weak_ptr<Server> _server;
 };
@@ -84,7 +208,18 @@ public:
     explicit Server(EventPoller::Ptr poller = nullptr);
     virtual ~Server() = default;
 
+    /**
+     * 设置会话默认的空闲超时，会话没有自行调用setIdleTimeout时生效，0则关闭；须在start之前调用
+     * UDP没有断开事件，UdpServer默认30秒，TcpServer默认关闭
+     * Set the default idle timeout of sessions, effective when the session does not call setIdleTimeout itself, 0 to disable;
+     * must be called before start
+     * UDP has no disconnection event, UdpServer defaults to 30 seconds, TcpServer disables it by default
+     */
+    void setSessionIdleTimeout(uint32_t timeout_ms) { _session_idle_timeout_ms = timeout_ms; }
+    uint32_t getSessionIdleTimeout() const { return _session_idle_timeout_ms; }
+
 protected:
+    uint32_t _session_idle_timeout_ms = 0;
     EventPoller::Ptr _poller;
 };
 
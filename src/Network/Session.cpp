@@ -21,7 +21,10 @@ class UdpSession : public Session {};
 StatisticImp(UdpSession)
 StatisticImp(TcpSession)
 
+static atomic<uint64_t> s_session_index{0};
+
 Session::Session(const Socket::Ptr &sock) : SocketHelper(sock) {
+    _session_id = ++s_session_index;
     if (sock->sockType() == SockNum::Sock_TCP) {
         _statistic_tcp.reset(new ObjectStatistic<TcpSession>);
     } else {
@@ -29,11 +32,43 @@ Session::Session(const Socket::Ptr &sock) : SocketHelper(sock) {
     }
 }
 
-string Session::getIdentifier() const {
-    if (_id.empty()) {
-        static atomic<uint64_t> s_session_index{0};
-        _id = to_string(++s_session_index) + '-' + to_string(getSock()->rawFD());
+void Session::setIdleTimeout(uint32_t timeout_ms) {
+    _idle_timeout_ms = timeout_ms;
+    _idle_timeout_set = true;
+    if (_timer_started) {
+        startIdleTimer();
+    }
+}
+
+void Session::startIdleTimer() {
+    _timer_started = true;
+    if (!_idle_timeout_ms) {
+        _idle_timer = nullptr;
+        return;
+    }
+    if (_idle_timer) {
+        _idle_timer->delay(_idle_timeout_ms);
+        return;
     }
+    weak_ptr<Session> weak_self = static_pointer_cast<Session>(shared_from_this());
+    _idle_timer = TimingWheel::getInstance(getPoller())->add(_idle_timeout_ms, [weak_self]() -> uint64_t {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return 0;
+        }
+        strong_self->onIdleTimeout();
+        return strong_self->_idle_timeout_ms;
+    });
+}
+
+void Session::onIdleTimeout() {
+    shutdown(SockException(Err_timeout, "session idle timeout"));
+}
+
+string Session::getIdentifier() const {
+    // 首次获取时才拼接，可跨线程调用
+    // Only concatenated when first fetched, callable across threads
+    std::call_once(_id_once, [this]() { _id = to_string(_session_id) + '-' + to_string(getSock()->rawFD()); });
     return _id;
 }
 
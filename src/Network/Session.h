@@ -11,17 +11,21 @@
 #ifndef ZLTOOLKIT_SESSION_H
 #define ZLTOOLKIT_SESSION_H
 
+#include <mutex>
 #include <memory>
 #include "Socket.h"
 #include "Util/util.h"
+#include "Poller/TimingWheel.h"
 #include "Util/SSLBox.h"
 #include "Kcp.h"
+#include "KcpMux.h"
 
 namespace toolkit {
 
 // 会话, 用于存储一对客户端与服务端间的关系  [AUTO-TRANSLATED:d69736ea]
 //Session, used to store the relationship between a client and a server
 class Server;
+class SessionHelper;
 class TcpSession;
 class UdpSession;
 
@@ -52,10 +56,75 @@ public:
      */
     std::string getIdentifier() const override;
 
+    /**
+     * 进程内唯一的整数会话id，构造时分配，SessionMap以此为key
+     * Process-wide unique integer session id, allocated when constructing, used as the key of SessionMap
+     */
+    uint64_t getSessionId() const { return _session_id; }
+
+    /**
+     * 设置空闲超时时间，超过该时长没有活动时触发onIdleTimeout，0则关闭；未设置时使用服务器的setSessionIdleTimeout
+     * 超时由poller的时间轮管理，活动时只更新时间戳，不参与周期性的全量扫描；须在poller线程调用
+     * Set the idle timeout, onIdleTimeout is triggered when there is no activity for that long, 0 to disable;
+     * the setSessionIdleTimeout of the server is used if it is not set
+     * The timeout is managed by the timing wheel of the poller, activity only updates a timestamp and no periodic full scan is involved;
+     * must be called in the poller thread
+     */
+    void setIdleTimeout(uint32_t timeout_ms);
+
+    /**
+     * 标记会话活跃，推迟空闲超时；服务器收到数据时会自动调用
+     * Mark the session as active to postpone the idle timeout; the server calls it automatically when data is received
+     */
+    void keepAlive() {
+        if (_idle_timer) {
+            _idle_timer->delay(_idle_timeout_ms);
+        }
+    }
+
+    /**
+     * 是否周期性触发onManager，默认关闭，以免大量空闲会话每个周期都被访问
+     * 依赖onManager做定时管理(如超时断开)的会话须开启，否则onManager不再被调用；须在构造函数或attachServer中设置
+     * Whether to trigger onManager periodically, disabled by default to avoid visiting lots of idle sessions every period
+     * Sessions relying on onManager for periodic management (such as timeout disconnection) must enable it, otherwise
+     * onManager is no longer called; must be set in the constructor or attachServer
+     */
+    void enableManager(bool enable) { _enable_manager = enable; }
+    bool isManagerEnabled() const { return _enable_manager; }
+
+    /**
+     * 开启KCP路由的UdpServer收到同一conv但来自新对端地址(如NAT重绑定)的数据时，在会话所在poller线程调用
+     * 返回true则会话迁移到新地址继续使用，否则丢弃该数据；默认不允许迁移
+     * @param buf 来自新地址的数据
+     * Called in the poller thread of the session when a UdpServer with KCP routing receives data of the same conv
+     * but from a new peer address (such as NAT rebinding)
+     * Return true to migrate the session to the new address, otherwise the data is dropped; migration is not allowed by default
+     * @param buf Data from the new address
+     */
+    virtual bool acceptPeerMigration(const Buffer::Ptr &buf) { return false; }
+
+protected:
+    /**
+     * 空闲超时回调，默认关闭会话；不关闭会话时，每过一个超时时长会再次触发
+     * Idle timeout callback, the session is closed by default; if the session is not closed, it is triggered again after every timeout period
+     */
+    virtual void onIdleTimeout();
+
 private:
+    friend class SessionHelper;
+    void startIdleTimer();
+
+private:
+    bool _enable_manager = false;
+    bool _timer_started = false;
+    bool _idle_timeout_set = false;
+    uint32_t _idle_timeout_ms = 0;
+    uint64_t _session_id;
+    mutable std::once_flag _id_once;
     mutable std::string _id;
     std::unique_ptr<toolkit::ObjectStatistic<toolkit::TcpSession> > _statistic_tcp;
     std::unique_ptr<toolkit::ObjectStatistic<toolkit::UdpSession> > _statistic_udp;
+    TimingWheel::Entry::Ptr _idle_timer;
 };
 
 // 通过该模板可以让TCP服务器快速支持TLS  [AUTO-TRANSLATED:fea218e6]
@@ -99,7 +168,7 @@ public:
     template <typename... ArgsType>
     SessionWithKCP(ArgsType &&...args)
         : SessionType(std::forward<ArgsType>(args)...) {
-        _kcp_box = std::make_shared<KcpTransport>(true, std::forward<ArgsType>(args)...);
+        _kcp_box = std::make_shared<KcpTransport>(true, SessionType::getPoller());
         _kcp_box->setOnWrite([&](const Buffer::Ptr &buf) { public_send(buf); });
         _kcp_box->setOnRead([&](const Buffer::Ptr &buf) { public_onRecv(buf); });
         _kcp_box->setOnErr([&](const SockException &ex) { public_onErr(ex); });
@@ -113,6 +182,12 @@ public:
     inline void public_send(const Buffer::Ptr &buf) { SessionType::send(buf); }
     inline void public_onErr(const SockException &ex) { SessionType::onError(ex); }
 
+    // 只有携带当前收发序号的包才能把会话迁移到新地址
+    // Only packets carrying the current sequence numbers can migrate the session to a new address
+    bool acceptPeerMigration(const Buffer::Ptr &buf) override { return _kcp_box->verifyMigration(buf->data(), buf->size()); }
+
+    const KcpTransport::Ptr &getKcpTransport() const { return _kcp_box; }
+
 protected:
     ssize_t send(Buffer::Ptr buf) override {
         return _kcp_box->send(std::move(buf));
@@ -122,6 +197,49 @@ private:
     KcpTransport::Ptr _kcp_box;
 };
 
+// 通过该模板可以让UDP服务器支持KCP多路复用，各流独立排序重传，不会互相队头阻塞
+// send与onRecv默认使用0号可靠流，其他流通过getKcpMux()打开或重载onStream处理
+// This template allows the UDP server to support KCP multiplexing, each stream orders and retransmits independently without
+// head-of-line blocking each other
+// send and onRecv use the reliable stream 0 by default, other streams are opened with getKcpMux() or handled by overriding onStream
+template <typename SessionType>
+class SessionWithKcpMux : public SessionType {
+public:
+    template <typename... ArgsType>
+    SessionWithKcpMux(ArgsType &&...args)
+        : SessionType(std::forward<ArgsType>(args)...) {
+        _mux = std::make_shared<KcpMux>(true, SessionType::getPoller());
+        _mux->setOnWrite([&](const Buffer::Ptr &buf) { public_send(buf); });
+        _mux->setOnStream([&](const KcpMux::Stream::Ptr &stream) { onStream(stream); });
+        _mux->setOnErr([&](const SockException &ex) { public_onErr(ex); });
+        _mux->openStream(0)->setOnRead([&](const Buffer::Ptr &buf) { public_onRecv(buf); });
+    }
+
+    ~SessionWithKcpMux() override { }
+
+    void onRecv(const Buffer::Ptr &buf) override { _mux->input(buf); }
+
+    inline void public_onRecv(const Buffer::Ptr &buf) { SessionType::onRecv(buf); }
+    inline void public_send(const Buffer::Ptr &buf) { SessionType::send(buf); }
+    inline void public_onErr(const SockException &ex) { SessionType::onError(ex); }
+
+    const KcpMux::Ptr &getKcpMux() const { return _mux; }
+
+protected:
+    // 对端新建流时触发，默认把流的数据交给SessionType::onRecv
+    // Triggered when the peer creates a new stream, the data of the stream is handed to SessionType::onRecv by default
+    virtual void onStream(const KcpMux::Stream::Ptr &stream) {
+        stream->setOnRead([this](const Buffer::Ptr &buf) { public_onRecv(buf); });
+    }
+
+    ssize_t send(Buffer::Ptr buf) override {
+        return _mux->openStream(0)->send(buf);
+    }
+
+private:
+    KcpMux::Ptr _mux;
+};
+
 } // namespace toolkit
 
 #endif // ZLTOOLKIT_SESSION_H
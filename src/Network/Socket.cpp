@@ -8,14 +8,18 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <limits>
 #include <type_traits>
 #include "sockutil.h"
 #include "Socket.h"
+#include "DnsResolver.h"
 #include "Util/util.h"
 #include "Util/logger.h"
 #include "Util/uv_errno.h"
 #include "Thread/semaphore.h"
 #include "Poller/EventPoller.h"
+#include "Poller/PollerMetrics.h"
+#include "Util/Trace.h"
 #include "Thread/WorkThreadPool.h"
 using namespace std;
 
@@ -213,18 +217,48 @@ void Socket::connect_l(const string &url, uint16_t port, const onErrCB &con_cb_i
     } else {
         auto poller = _poller;
         weak_ptr<function<void(const SockNum::Ptr &)>> weak_task = async_con_cb;
-        WorkThreadPool::Instance().getExecutor()->async([url, port, local_ip, local_port, weak_task, poller]() {
-            // 阻塞式dns解析放在后台线程执行  [AUTO-TRANSLATED:e54694ea]
-            //Blocking DNS resolution is executed in the background thread
-            int fd = SockUtil::connect(url.data(), port, true, local_ip.data(), local_port);
-            auto sock = fd == -1 ? nullptr : std::make_shared<SockNum>(fd, SockNum::Sock_TCP);
-            poller->async([sock, weak_task]() {
-                if (auto strong_task = weak_task.lock()) {
-                    (*strong_task)(sock);
-                }
+        auto blocking_connect = [url, port, local_ip, local_port, weak_task, poller]() {
+            WorkThreadPool::Instance().getExecutor()->async([url, port, local_ip, local_port, weak_task, poller]() {
+                // 阻塞式dns解析放在后台线程执行  [AUTO-TRANSLATED:e54694ea]
+                //Blocking DNS resolution is executed in the background thread
+                int fd = SockUtil::connect(url.data(), port, true, local_ip.data(), local_port);
+                auto sock = fd == -1 ? nullptr : std::make_shared<SockNum>(fd, SockNum::Sock_TCP);
+                poller->async([sock, weak_task]() {
+                    if (auto strong_task = weak_task.lock()) {
+                        (*strong_task)(sock);
+                    }
+                });
             });
-        });
+        };
         _async_con_cb = async_con_cb;
+
+        if (!DnsResolver::Instance().hasNameServer()) {
+            blocking_connect();
+            return;
+        }
+        // 在poller线程异步解析域名，不占用后台线程
+        // Resolve the domain name asynchronously in the poller thread without occupying background threads
+        DnsResolver::Instance().resolve(url, AF_INET, [port, local_ip, local_port, weak_task, blocking_connect](const SockException &ex, const DnsResolver::AddressList &addrs) {
+            if (ex && ex.getErrCode() != Err_timeout) {
+                // 可能是search域或本地名称服务等dns查询无法覆盖的情况，回退到系统解析
+                // Probably a case dns queries cannot cover such as search domains or local name services, fall back to the system resolver
+                blocking_connect();
+                return;
+            }
+            auto strong_task = weak_task.lock();
+            if (!strong_task) {
+                return;
+            }
+            if (ex) {
+                // nameserver无响应，系统解析同样会超时，直接失败
+                // The nameservers do not respond, the system resolver would time out as well, fail directly
+                (*strong_task)(nullptr);
+                return;
+            }
+            auto ip = SockUtil::inet_ntoa((struct sockaddr *)&addrs.front());
+            int fd = SockUtil::connect(ip.data(), port, true, local_ip.data(), local_port);
+            (*strong_task)(fd == -1 ? nullptr : std::make_shared<SockNum>(fd, SockNum::Sock_TCP));
+        }, poller);
     }
 }
 
@@ -302,16 +336,39 @@ bool Socket::attachEvent(const SockNum::Ptr &sock) {
 }
 
 ssize_t Socket::onRead(const SockNum::Ptr &sock, const SocketRecvBuffer::Ptr &buffer) noexcept {
+    if (_read_pending == sock.get()) {
+        // 已让出本轮，由推迟事件继续读取
+        // Already yielded this round, the pending event continues reading
+        return 0;
+    }
     ssize_t ret = 0, nread = 0, count = 0;
+    size_t packets = 0;
+    size_t max_bytes = _read_budget_bytes;
+    size_t max_packets = _read_budget_packets;
+    auto record = [&]() {
+        if (ret && MetricsRegistry::enabled()) {
+            PollerMetrics::current().recv_event_bytes->record(ret);
+        }
+    };
 
     while (_enable_recv) {
+        if ((max_bytes && (size_t)ret >= max_bytes) || (max_packets && packets >= max_packets)) {
+            // 读取额度用尽，剩余数据在下一轮继续读取，避免独占poller
+            // The read budget ran out, the remaining data is read in the next round, avoiding monopolizing the poller
+            deferRead(sock, buffer);
+            break;
+        }
         nread = buffer->recvFromSocket(sock->rawFd(), count);
+        if (MetricsRegistry::enabled()) {
+            PollerMetrics::current().onRecvSyscall(nread, count);
+        }
         if (nread == 0) {
             if (sock->type() == SockNum::Sock_TCP) {
                 emitErr(SockException(Err_eof, "end of file"));
             } else {
                 WarnL << "Recv eof on udp socket[" << sock->rawFd() << "]";
             }
+            record();
             return ret;
         }
 
@@ -324,10 +381,12 @@ ssize_t Socket::onRead(const SockNum::Ptr &sock, const SocketRecvBuffer::Ptr &bu
                     WarnL << "Recv err on udp socket[" << sock->rawFd() << "]: " << uv_strerror(err);
                 }
             }
+            record();
             return ret;
         }
 
         ret += nread;
+        packets += count;
         if (_enable_speed) {
             // 更新接收速率  [AUTO-TRANSLATED:1e24774c]
             //Update receive rate
@@ -345,9 +404,40 @@ ssize_t Socket::onRead(const SockNum::Ptr &sock, const SocketRecvBuffer::Ptr &bu
             ErrorL << "Exception occurred when emit on_read: " << ex.what();
         }
     }
+    record();
     return 0;
 }
 
+void Socket::deferRead(const SockNum::Ptr &sock, const SocketRecvBuffer::Ptr &buffer) {
+    if (MetricsRegistry::enabled()) {
+        PollerMetrics::current().recv_yields->add();
+    }
+    _read_pending = sock.get();
+    weak_ptr<Socket> weak_self = shared_from_this();
+    auto poller = _poller;
+    _poller->addPendingEvent([weak_self, sock, buffer, poller]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self || strong_self->_read_pending != sock.get()) {
+            return;
+        }
+        strong_self->_read_pending = nullptr;
+        {
+            // 期间socket可能已关闭、重建或切换poller
+            // The socket may have been closed, recreated or moved to another poller in the meantime
+            LOCK_GUARD(strong_self->_mtx_sock_fd);
+            if (strong_self->_poller != poller || !strong_self->_sock_fd || strong_self->_sock_fd->sockNum() != sock) {
+                return;
+            }
+        }
+        strong_self->onRead(sock, buffer);
+    });
+}
+
+void Socket::setReadBudget(size_t max_bytes, size_t max_packets) {
+    _read_budget_bytes = max_bytes;
+    _read_budget_packets = max_packets;
+}
+
 bool Socket::emitErr(const SockException &err) noexcept {
     if (_err_emit) {
         return true;
@@ -389,6 +479,22 @@ ssize_t Socket::send(string buf, struct sockaddr *addr, socklen_t addr_len, bool
 }
 
 ssize_t Socket::send(Buffer::Ptr buf, struct sockaddr *addr, socklen_t addr_len, bool try_flush) {
+    if (!_udp_send_owner.expired()) {
+        // 共享其他socket的fd，由其批量发送
+        // Sharing the fd of another socket, let it send in batch
+        auto owner = _udp_send_owner.lock();
+        if (!owner) {
+            return -1;
+        }
+        if (!addr) {
+            addr = (struct sockaddr *)_udp_send_dst.get();
+            addr_len = SockUtil::get_sock_len(addr);
+        }
+        if (_enable_speed) {
+            _send_speed += buf->size();
+        }
+        return owner->sendBatched(std::move(buf), addr, addr_len);
+    }
     if (!addr) {
         if (!_udp_send_dst) {
             return send_l(std::move(buf), false, try_flush);
@@ -414,7 +520,32 @@ ssize_t Socket::send_l(Buffer::Ptr buf, bool is_buf_sock, bool try_flush) {
 
     {
         LOCK_GUARD(_mtx_send_buf_waiting);
+        auto congested = isSendCongested();
+        if (!_mem_budget) {
+            // 全局预算设置了上限时才需要记账
+            // Charging is only needed once the global budget has limits
+            auto &global = MemoryBudget::global();
+            if (global->getSoftLimit() || global->getHardLimit()) {
+                ensureMemoryBudget();
+            }
+        }
+        if (buf->isDroppable() && (congested || (_mem_budget && _mem_budget->level() == MemoryBudget::Level::Hard))) {
+            // 持续拥塞或内存预算超过硬上限时可丢弃的数据不再入队
+            // Droppable data is no longer queued while congestion lasts or the memory budget is over the hard limit
+            dropQueued(true);
+            onDropped(buf);
+            return 0;
+        }
+        if (_mem_budget) {
+            _mem_budget->charge(size);
+        }
+        _send_buf_waiting_bytes += size;
+        _send_buf_waiting_droppable += buf->isDroppable();
         _send_buf_waiting.emplace_back(std::move(buf), is_buf_sock);
+        auto max_bytes = _drop_max_bytes.load();
+        if (_send_buf_waiting_droppable && (congested || (max_bytes && _send_buf_waiting_bytes > max_bytes))) {
+            dropQueued(congested);
+        }
     }
 
     if (try_flush) {
@@ -426,6 +557,23 @@ ssize_t Socket::send_l(Buffer::Ptr buf, bool is_buf_sock, bool try_flush) {
     return size;
 }
 
+ssize_t Socket::sendBatched(Buffer::Ptr buf, struct sockaddr *addr, socklen_t addr_len) {
+    auto ret = send_l(std::make_shared<BufferSock>(std::move(buf), addr, addr_len), true, false);
+    if (ret > 0 && !_batch_flush_pending) {
+        // 本轮事件循环内的数据合并到下一次循环统一发送
+        // Data within this event loop iteration is merged and sent together in the next iteration
+        _batch_flush_pending = true;
+        weak_ptr<Socket> weak_self = shared_from_this();
+        _poller->async([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->_batch_flush_pending = false;
+                strong_self->flushAll();
+            }
+        }, false);
+    }
+    return ret;
+}
+
 int Socket::flushAll() {
     LOCK_GUARD(_mtx_sock_fd);
 
@@ -473,6 +621,11 @@ void Socket::closeSock(bool close_fd) {
     {
         LOCK_GUARD(_mtx_send_buf_waiting);
         _send_buf_waiting.clear();
+        if (_mem_budget) {
+            _mem_budget->release(_send_buf_waiting_bytes);
+        }
+        _send_buf_waiting_bytes = 0;
+        _send_buf_waiting_droppable = 0;
     }
 
     {
@@ -485,6 +638,7 @@ void Socket::closeSock(bool close_fd) {
         if (close_fd) {
             _err_emit = false;
             _sock_fd = nullptr;
+            _udp_send_owner.reset();
         } else if (_sock_fd) {
             _sock_fd->delEvent();
         }
@@ -500,7 +654,7 @@ size_t Socket::getSendBufferCount() {
 
     {
         LOCK_GUARD(_mtx_send_buf_sending);
-        _send_buf_sending.for_each([&](BufferList::Ptr &buf) { ret += buf->count(); });
+        _send_buf_sending.for_each([&](std::pair<BufferList::Ptr, MemoryBudget::Charge> &pr) { ret += pr.first->count(); });
     }
     return ret;
 }
@@ -571,6 +725,10 @@ void Socket::moveTo(EventPoller::Ptr poller) {
     if (_sock_fd) {
         _sock_fd = std::make_shared<SockFD>(_sock_fd->sockNum(), _poller);
     }
+    // 之后在新poller的时间轮上预约
+    // Scheduled on the wheel of the new poller afterwards
+    _pacing_wheel = nullptr;
+    _pacing_entry = nullptr;
 }
 
 int Socket::onAccept(const SockNum::Ptr &sock, int event) noexcept {
@@ -701,6 +859,9 @@ void Socket::setSock(SockNum::Ptr sock) {
         _sock_fd = std::make_shared<SockFD>(std::move(sock), _poller);
         SockUtil::get_sock_local_addr(_sock_fd->rawFd(), _local_addr);
         SockUtil::get_sock_peer_addr(_sock_fd->rawFd(), _peer_addr);
+        if (_kernel_pacing_rate) {
+            SockUtil::setMaxPacingRate(_sock_fd->rawFd(), _kernel_pacing_rate);
+        }
     } else {
         _sock_fd = nullptr;
     }
@@ -761,6 +922,7 @@ string Socket::getIdentifier() const {
 }
 
 bool Socket::flushData(const SockNum::Ptr &sock, bool poller_thread) {
+    TRACE_SCOPE("socket_flush", sock->rawFd());
     decltype(_send_buf_sending) send_buf_sending_tmp;
     {
         // 转移出二级缓存  [AUTO-TRANSLATED:a54264d2]
@@ -773,12 +935,38 @@ bool Socket::flushData(const SockNum::Ptr &sock, bool poller_thread) {
 
     if (send_buf_sending_tmp.empty()) {
         _send_flush_ticker.resetTime();
+        // 是否因令牌不足而暂停发送
+        // Whether sending is paused for lack of tokens
+        bool paced = false;
         do {
             {
                 // 二级发送缓存为空，那么我们接着消费一级缓存中的数据  [AUTO-TRANSLATED:8ddb2962]
                 //The secondary send cache is empty, so we continue to consume data from the primary cache
                 LOCK_GUARD(_mtx_send_buf_waiting);
+                decltype(_send_buf_waiting) send_buf;
+                auto waiting_bytes = _send_buf_waiting_bytes;
                 if (!_send_buf_waiting.empty()) {
+                    if (MetricsRegistry::enabled()) {
+                        PollerMetrics::current().send_queue_depth->record(_send_buf_waiting.size());
+                    }
+                    if (_send_bucket || _send_group) {
+                        // 限速时只取出令牌允许的部分，剩余的等待时间轮唤醒
+                        // When shaped, only take out what the tokens allow, the rest waits for the wheel to wake up
+                        uint64_t delay_us = 0;
+                        takePaced(send_buf, delay_us);
+                        if (!_send_buf_waiting.empty()) {
+                            schedulePacing(delay_us);
+                        }
+                    } else {
+                        send_buf.swap(_send_buf_waiting);
+                        _send_buf_waiting_bytes = 0;
+                        _send_buf_waiting_droppable = 0;
+                    }
+                    // 令牌不足时没有可发送的数据，等待时间轮唤醒
+                    // Nothing to send when tokens are not enough, wait for the wheel to wake up
+                    paced = send_buf.empty();
+                }
+                if (!send_buf.empty()) {
                     // 把一级缓中数数据放置到二级缓存中并清空  [AUTO-TRANSLATED:4884aa58]
                     //Put the data from the first-level cache into the second-level cache and clear it
                     LOCK_GUARD(_mtx_event);
@@ -793,7 +981,10 @@ bool Socket::flushData(const SockNum::Ptr &sock, bool poller_thread) {
                             _send_result(buffer, send_success);
                         }
                     } : _send_result;
-                    send_buf_sending_tmp.emplace_back(BufferList::create(std::move(_send_buf_waiting), std::move(send_result), sock->type() == SockNum::Sock_UDP));
+                    // 记账随数据转入二级缓存
+                    // The charge moves into the second-level cache along with the data
+                    MemoryBudget::Charge charge(_mem_budget, waiting_bytes - _send_buf_waiting_bytes);
+                    send_buf_sending_tmp.emplace_back(BufferList::create(std::move(send_buf), std::move(send_result), sock->type() == SockNum::Sock_UDP), std::move(charge));
                     break;
                 }
             }
@@ -805,7 +996,9 @@ bool Socket::flushData(const SockNum::Ptr &sock, bool poller_thread) {
                 // 那么在数据列队清空的情况下，我们需要关闭监听以免触发无意义的事件回调  [AUTO-TRANSLATED:0fb35573]
                 //So, in the case of data queue clearing, we need to close the listening to avoid triggering meaningless event callbacks
                 stopWriteAbleEvent(sock);
-                onFlushed();
+                if (!paced) {
+                    onFlushed();
+                }
             }
             return true;
         } while (false);
@@ -813,11 +1006,11 @@ bool Socket::flushData(const SockNum::Ptr &sock, bool poller_thread) {
 
     while (!send_buf_sending_tmp.empty()) {
         auto &packet = send_buf_sending_tmp.front();
-        auto n = packet->send(sock->rawFd(), _sock_flags);
+        auto n = packet.first->send(sock->rawFd(), _sock_flags);
         if (n > 0) {
             // 全部或部分发送成功  [AUTO-TRANSLATED:0721ed7c]
             //All or part of the data was sent successfully
-            if (packet->empty()) {
+            if (packet.first->empty()) {
                 // 全部发送成功  [AUTO-TRANSLATED:38a7d0ac]
                 //All data was sent successfully
                 send_buf_sending_tmp.pop_front();
@@ -963,6 +1156,196 @@ bool Socket::isSocketBusy() const {
     return !_sendable.load();
 }
 
+void Socket::setSendRate(uint64_t bytes_per_sec, uint64_t burst, bool kernel_pacing) {
+    {
+        LOCK_GUARD(_mtx_send_buf_waiting);
+        if (bytes_per_sec) {
+            _send_bucket.reset(new TokenBucket(bytes_per_sec, burst));
+        } else {
+            _send_bucket = nullptr;
+        }
+    }
+    LOCK_GUARD(_mtx_sock_fd);
+    auto rate = kernel_pacing ? bytes_per_sec : 0;
+    if (_sock_fd && (rate || _kernel_pacing_rate)) {
+        SockUtil::setMaxPacingRate(_sock_fd->rawFd(), rate);
+    }
+    _kernel_pacing_rate = rate;
+}
+
+void Socket::setSendRateGroup(SharedTokenBucket::Ptr group) {
+    LOCK_GUARD(_mtx_send_buf_waiting);
+    _send_group = std::move(group);
+}
+
+void Socket::takePaced(List<std::pair<Buffer::Ptr, bool>> &out, uint64_t &delay_us) {
+    // 按包放行，先检查自身的令牌桶再占用限速组的令牌，避免组令牌被本socket无法发送的包占用
+    // Released packet by packet, the own bucket is checked before taking tokens of the group,
+    // so group tokens are not taken by a packet this socket can not send
+    auto now = getCurrentMicrosecond();
+    delay_us = 0;
+    while (!_send_buf_waiting.empty()) {
+        auto size = _send_buf_waiting.front().first->size();
+        if (_send_bucket && (delay_us = _send_bucket->wait(size, now))) {
+            break;
+        }
+        if (_send_group && (delay_us = _send_group->consume(size, now))) {
+            break;
+        }
+        if (_send_bucket) {
+            _send_bucket->consume(size, now);
+        }
+        _send_buf_waiting_bytes -= size;
+        _send_buf_waiting_droppable -= _send_buf_waiting.front().first->isDroppable();
+        out.emplace_back(std::move(_send_buf_waiting.front()));
+        _send_buf_waiting.pop_front();
+    }
+}
+
+void Socket::setSendDropPolicy(size_t max_bytes, uint32_t max_delay_ms) {
+    _drop_max_bytes = max_bytes;
+    _drop_max_delay_ms = max_delay_ms;
+}
+
+bool Socket::isSendCongested() const {
+    auto max_delay_ms = _drop_max_delay_ms.load();
+    return max_delay_ms && !_sendable && _send_flush_ticker.elapsedTime() > max_delay_ms;
+}
+
+void Socket::dropQueued(bool all) {
+    auto max_bytes = _drop_max_bytes.load();
+    while (_send_buf_waiting_droppable && (all || _send_buf_waiting_bytes > max_bytes)) {
+        // 每轮丢弃最低优先级的可丢弃数据，从旧到新直至低于字节数上限
+        // Each round drops droppable data of the lowest priority, from the oldest until below the byte limit
+        auto priority = std::numeric_limits<int8_t>::max();
+        if (!all) {
+            _send_buf_waiting.for_each([&](std::pair<Buffer::Ptr, bool> &pr) {
+                if (pr.first->isDroppable()) {
+                    priority = std::min(priority, pr.first->getSendPriority());
+                }
+            });
+        }
+        decltype(_send_buf_waiting) kept;
+        while (!_send_buf_waiting.empty()) {
+            auto &pr = _send_buf_waiting.front();
+            if (pr.first->isDroppable() && (all || (pr.first->getSendPriority() == priority && _send_buf_waiting_bytes > max_bytes))) {
+                if (_mem_budget) {
+                    _mem_budget->release(pr.first->size());
+                }
+                _send_buf_waiting_bytes -= pr.first->size();
+                --_send_buf_waiting_droppable;
+                onDropped(pr.first);
+            } else {
+                kept.emplace_back(std::move(pr));
+            }
+            _send_buf_waiting.pop_front();
+        }
+        _send_buf_waiting.swap(kept);
+    }
+}
+
+void Socket::onDropped(const Buffer::Ptr &buf) {
+    ++_send_drop_count;
+    _send_drop_bytes += buf->size();
+    if (MetricsRegistry::enabled()) {
+        PollerMetrics::current().send_dropped_packets->add(1);
+        PollerMetrics::current().send_dropped_bytes->add(buf->size());
+    }
+    LOCK_GUARD(_mtx_event);
+    if (_send_result) {
+        _send_result(buf, false);
+    }
+}
+
+void Socket::setMemoryBudget(const MemoryBudget::Ptr &parent) {
+    auto budget = MemoryBudget::create(0, 0, parent);
+    LOCK_GUARD(_mtx_send_buf_waiting);
+    // 一级缓存的记账转到新预算，二级缓存中的数据仍由原预算归还
+    // Charges of the first-level cache move to the new budget, data in the second-level cache is still released to the old one
+    budget->charge(_send_buf_waiting_bytes);
+    if (_mem_budget) {
+        budget->setLimits(_mem_budget->getSoftLimit(), _mem_budget->getHardLimit());
+        _mem_budget->release(_send_buf_waiting_bytes);
+    }
+    _mem_budget = std::move(budget);
+}
+
+MemoryBudget::Ptr Socket::getMemoryBudget() {
+    LOCK_GUARD(_mtx_send_buf_waiting);
+    ensureMemoryBudget();
+    return _mem_budget;
+}
+
+void Socket::ensureMemoryBudget() {
+    if (!_mem_budget) {
+        // 按需创建，从此开始为一级缓存中的数据记账
+        // Created on demand, data in the first-level cache is charged from now on
+        _mem_budget = MemoryBudget::create();
+        _mem_budget->charge(_send_buf_waiting_bytes);
+    }
+}
+
+void Socket::setRecvBackpressure(const MemoryBudget::Ptr &budget) {
+    if (!budget) {
+        _backpressure_listener = nullptr;
+        return;
+    }
+    weak_ptr<Socket> weak_self = shared_from_this();
+    weak_ptr<MemoryBudget> weak_budget = budget;
+    auto poller = _poller;
+    auto on_level = [weak_self, weak_budget, poller](MemoryBudget::Level) {
+        // 异步任务可能乱序执行，执行时重新读取当前水位，避免读取被永久关闭
+        // Posted tasks may run out of order, the current level is read again when running, so reading is never left disabled
+        poller->async([weak_self, weak_budget]() {
+            auto strong_self = weak_self.lock();
+            auto strong_budget = weak_budget.lock();
+            if (strong_self && strong_budget) {
+                strong_self->enableRecv(strong_budget->level() == MemoryBudget::Level::Normal);
+            }
+        }, false);
+    };
+    _backpressure_listener = budget->addListener(on_level);
+    if (budget->level() != MemoryBudget::Level::Normal) {
+        on_level(budget->level());
+    }
+}
+
+void Socket::schedulePacing(uint64_t delay_us) {
+    if (!_poller->isCurrentThread()) {
+        weak_ptr<Socket> weak_self = shared_from_this();
+        _poller->async([weak_self, delay_us]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->schedulePacing(delay_us);
+            }
+        }, false);
+        return;
+    }
+    if (!_pacing_entry) {
+        weak_ptr<Socket> weak_self = shared_from_this();
+        _pacing_entry = std::make_shared<PacingWheel::Entry>([weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->onPacingTimer();
+            }
+        });
+        _pacing_wheel = PacingWheel::getInstance(_poller);
+    }
+    _pacing_wheel->schedule(_pacing_entry, delay_us);
+}
+
+void Socket::onPacingTimer() {
+    LOCK_GUARD(_mtx_sock_fd);
+    if (!_sock_fd || !_sendable) {
+        // 等待可写事件时由onWriteAble继续发送
+        // While waiting for the writable event, onWriteAble continues sending
+        return;
+    }
+    if (flushData(_sock_fd->sockNum(), false) && _sendable && !getSendBufferCount()) {
+        // 限速的数据已全部写入socket
+        // All shaped data has been written to the socket
+        onFlushed();
+    }
+}
+
 const EventPoller::Ptr &Socket::getPoller() const {
     return _poller;
 }
@@ -1017,6 +1400,32 @@ bool Socket::bindPeerAddr(const struct sockaddr *dst_addr, socklen_t addr_len, b
     return true;
 }
 
+bool Socket::shareUdpSock(const Socket::Ptr &owner, const struct sockaddr *dst_addr, socklen_t addr_len) {
+    closeSock();
+    SockNum::Ptr sock;
+    {
+        LOCK_GUARD(owner->_mtx_sock_fd);
+        if (!owner->_sock_fd || owner->_sock_fd->type() != SockNum::Sock_UDP) {
+            return false;
+        }
+        sock = owner->_sock_fd->sockNum();
+    }
+    if (owner->_poller != _poller) {
+        throw std::invalid_argument("Socket::shareUdpSock with different poller");
+    }
+
+    LOCK_GUARD(_mtx_sock_fd);
+    // 不传入poller，本对象销毁时不会移除owner的io事件
+    // Do not pass the poller, so that destroying this object will not remove the io event of the owner
+    _sock_fd = std::make_shared<SockFD>(std::move(sock), nullptr);
+    memcpy(&_local_addr, &owner->_local_addr, sizeof(_local_addr));
+    _udp_send_owner = owner;
+    addr_len = addr_len ? addr_len : SockUtil::get_sock_len(dst_addr);
+    _udp_send_dst = std::make_shared<struct sockaddr_storage>();
+    memcpy(_udp_send_dst.get(), dst_addr, addr_len);
+    return true;
+}
+
 void Socket::setSendFlags(int flags) {
     _sock_flags = flags;
 }
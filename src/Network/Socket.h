@@ -18,9 +18,12 @@
 #include <sstream>
 #include <functional>
 #include "Util/SpeedStatistic.h"
+#include "Util/TokenBucket.h"
+#include "Util/MemoryBudget.h"
 #include "sockutil.h"
 #include "Poller/Timer.h"
 #include "Poller/EventPoller.h"
+#include "Poller/PacingWheel.h"
 #include "BufferSock.h"
 
 namespace toolkit {
@@ -615,6 +618,91 @@ public:
      */
     bool isSocketBusy() const;
 
+    /**
+     * 设置发送限速，发送缓存按令牌桶的节奏由所属poller的PacingWheel释放，而不是一次性写入内核
+     * @param bytes_per_sec 速率，单位bytes/s，0为不限速
+     * @param burst 令牌桶容量(字节)，即单次释放的最大突发，0为10毫秒的数据量
+     * @param kernel_pacing 是否同时设置内核限速(SO_MAX_PACING_RATE)，在每次释放的突发内部由内核平滑，系统不支持时忽略
+     * Set the send rate, the send buffer is released at the pace of a token bucket by the PacingWheel of the poller
+     * instead of being written to the kernel at once
+     * @param bytes_per_sec Rate in bytes/s, 0 means unlimited
+     * @param burst Size of the token bucket in bytes, that is the max burst of one release, 0 means 10 milliseconds of data
+     * @param kernel_pacing Whether to set the kernel pacing rate (SO_MAX_PACING_RATE) too, so the kernel smooths
+     * each released burst, ignored if not supported by the system
+     */
+    void setSendRate(uint64_t bytes_per_sec, uint64_t burst = 0, bool kernel_pacing = false);
+
+    /**
+     * 加入发送限速组，组内所有socket共享同一令牌桶，可与setSendRate同时生效
+     * @param group 限速组，可跨poller共享，nullptr为退出
+     * Join a send rate group, all sockets in the group share one token bucket, it works together with setSendRate
+     * @param group The rate group, can be shared across pollers, nullptr to leave
+     */
+    void setSendRateGroup(SharedTokenBucket::Ptr group);
+
+    /**
+     * 设置发送拥塞时的丢弃策略，只丢弃一级发送缓存中标记为可丢弃的数据(见Buffer::setSendPriority)，
+     * 使慢速的连接在有限内存下保持连接，而不是缓存堆积直至发送超时断开
+     * @param max_bytes 一级发送缓存超过该字节数时，按优先级从低到高、同优先级从旧到新丢弃可丢弃数据，0为不限制
+     * @param max_delay_ms socket持续不可写超过该毫秒数时，丢弃所有可丢弃数据直至恢复可写，0为不限制
+     * Set the drop policy when sending is congested, only data tagged droppable (see Buffer::setSendPriority)
+     * in the first-level send cache is dropped, so slow connections stay alive with bounded memory,
+     * instead of the cache piling up until the send timeout closes them
+     * @param max_bytes When the first-level send cache exceeds these bytes, droppable data is dropped from the lowest
+     * priority up and from the oldest within the same priority, 0 means unlimited
+     * @param max_delay_ms When the socket stays unwritable longer than these milliseconds, all droppable data is dropped
+     * until it is writable again, 0 means unlimited
+     */
+    void setSendDropPolicy(size_t max_bytes, uint32_t max_delay_ms);
+
+    /**
+     * 获取按丢弃策略丢弃的包数与字节数
+     * Get the packets and bytes dropped by the drop policy
+     */
+    uint64_t getSendDropCount() const { return _send_drop_count; }
+    uint64_t getSendDropBytes() const { return _send_drop_bytes; }
+
+    /**
+     * 设置发送缓存记账的上级预算(如某个分组)，默认为MemoryBudget::global()，应在发送数据前设置
+     * 发送缓存按字节计入本socket的预算及其所有上级，任一预算超过硬上限时丢弃可丢弃的数据
+     * 本socket的预算在调用本函数、getMemoryBudget()或全局预算设置了上限后才创建，此前发送不记账
+     * Set the parent budget (such as a group) charged for the send cache, MemoryBudget::global() by default,
+     * it should be set before sending data
+     * The send cache is charged in bytes to the budget of this socket and all its ancestors, droppable data is dropped
+     * when any of them is over the hard limit
+     * The budget of this socket is only created by this function, getMemoryBudget() or once the global budget has limits,
+     * sending is not charged before that
+     */
+    void setMemoryBudget(const MemoryBudget::Ptr &parent);
+
+    /**
+     * 获取本socket的预算，可用于查询用量、设置上限或监听水位；尚未创建时创建
+     * Get the budget of this socket, used to query usage, set limits or listen to the level; created if not yet
+     */
+    MemoryBudget::Ptr getMemoryBudget();
+
+    /**
+     * 预算超过软上限时暂停读取，回落后恢复读取，用于对生产者施加背压；传入nullptr取消
+     * 暂停期间手动调用enableRecv会被下一次水位变化覆盖
+     * Pause reading when the budget is over the soft limit and resume after it falls back, used to apply backpressure
+     * on producers; pass nullptr to cancel
+     * Calling enableRecv manually during the pause is overridden by the next level change
+     */
+    void setRecvBackpressure(const MemoryBudget::Ptr &budget);
+
+    /**
+     * 设置每次读事件的读取额度，额度用尽后让出poller，剩余数据在下一轮事件循环继续读取，
+     * 避免单个高流量的连接或udp洪水独占poller，增加同线程其他socket的延时
+     * @param max_bytes 每次读事件最多读取的字节数，0为不限制
+     * @param max_packets 每次读事件最多读取的包数(tcp为读系统调用次数)，0为不限制
+     * Set the read budget of each read event, the poller is yielded once it runs out and the remaining data is read in the
+     * next round of the event loop, so that a single high bandwidth connection or udp flood does not monopolize the poller
+     * and add latency to the other sockets of the thread
+     * @param max_bytes Max bytes read in each read event, 0 means unlimited
+     * @param max_packets Max packets read in each read event (read syscalls for tcp), 0 means unlimited
+     */
+    void setReadBudget(size_t max_bytes, size_t max_packets = 0);
+
     /**
      * 获取poller线程对象
      * @return poller线程对象
@@ -641,6 +729,25 @@ public:
      */
     bool bindPeerAddr(const struct sockaddr *dst_addr, socklen_t addr_len = 0, bool soft_bind = false);
 
+    /**
+     * 共享另一个udp socket的fd并软绑定目标地址，本socket不监听io事件，也不另外创建fd
+     * 数据由owner接收后自行派发；发送的数据合并进owner的发送缓存，在本轮事件循环结束后由owner批量(sendmmsg)发送
+     * 本对象与owner必须归属同一个poller线程
+     * @param owner 拥有fd并监听读事件的udp socket
+     * @param dst_addr 目标地址
+     * @param addr_len 目标地址长度
+     * @return 是否成功
+     * Share the fd of another udp socket and soft bind the target address, this socket neither listens io events nor creates a fd
+     * Data is received and dispatched by the owner; sent data is merged into the send buffer of the owner,
+     * and the owner sends them in batch (sendmmsg) after the current event loop iteration
+     * This object and the owner must belong to the same poller thread
+     * @param owner The udp socket that owns the fd and listens read events
+     * @param dst_addr Target address
+     * @param addr_len Target address length
+     * @return Whether successful
+     */
+    bool shareUdpSock(const Socket::Ptr &owner, const struct sockaddr *dst_addr, socklen_t addr_len = 0);
+
     /**
      * 设置发送flags
      * @param flags 发送的flag
@@ -724,6 +831,7 @@ private:
     void setSock(SockNum::Ptr sock);
     int onAccept(const SockNum::Ptr &sock, int event) noexcept;
     ssize_t onRead(const SockNum::Ptr &sock, const SocketRecvBuffer::Ptr &buffer) noexcept;
+    void deferRead(const SockNum::Ptr &sock, const SocketRecvBuffer::Ptr &buffer);
     void onWriteAble(const SockNum::Ptr &sock);
     void onConnected(const SockNum::Ptr &sock, const onErrCB &cb);
     void onFlushed();
@@ -732,6 +840,14 @@ private:
     bool flushData(const SockNum::Ptr &sock, bool poller_thread);
     bool attachEvent(const SockNum::Ptr &sock);
     ssize_t send_l(Buffer::Ptr buf, bool is_buf_sock, bool try_flush = true);
+    ssize_t sendBatched(Buffer::Ptr buf, struct sockaddr *addr, socklen_t addr_len);
+    void takePaced(List<std::pair<Buffer::Ptr, bool>> &out, uint64_t &delay_us);
+    bool isSendCongested() const;
+    void dropQueued(bool all);
+    void onDropped(const Buffer::Ptr &buf);
+    void ensureMemoryBudget();
+    void schedulePacing(uint64_t delay_us);
+    void onPacingTimer();
     void connect_l(const std::string &url, uint16_t port, const onErrCB &con_cb_in, float timeout_sec, const std::string &local_ip, uint16_t local_port);
     bool fromSock_l(SockNum::Ptr sock);
 
@@ -754,9 +870,15 @@ private:
     // 是否启用网速统计  [AUTO-TRANSLATED:c0c0e8ee]
     //Whether to enable network speed statistics
     bool _enable_speed = false;
+    // 是否已经预约了批量发送，只在poller线程访问
+    // Whether a batch flush has been scheduled, only accessed in the poller thread
+    bool _batch_flush_pending = false;
     // udp发送目标地址  [AUTO-TRANSLATED:cce2315a]
     //UDP send target address
     std::shared_ptr<struct sockaddr_storage> _udp_send_dst;
+    // 共享fd的udp socket，发送数据交由其批量发送
+    // The udp socket whose fd is shared, sent data is handed over to it for batch sending
+    std::weak_ptr<Socket> _udp_send_owner;
 
     // 接收速率统计  [AUTO-TRANSLATED:20dcd724]
     //Receiving rate statistics
@@ -812,10 +934,45 @@ private:
     MutexWrapper<std::recursive_mutex> _mtx_send_buf_waiting;
     // 二级发送缓存, socket可写时，会把二级缓存批量写入到socket  [AUTO-TRANSLATED:cc665665]
     //Second-level send cache, when the socket is writable, it will batch the second-level cache into the socket
-    List<BufferList::Ptr> _send_buf_sending;
+    // 每批数据带有其内存记账，发送完毕或丢弃时归还
+    // Each batch carries its memory charge, which is released when it is sent or dropped
+    List<std::pair<BufferList::Ptr, MemoryBudget::Charge>> _send_buf_sending;
     // 二级发送缓存锁  [AUTO-TRANSLATED:306e3472]
     //Second-level send cache lock
     MutexWrapper<std::recursive_mutex> _mtx_send_buf_sending;
+    // 发送限速的令牌桶与限速组，一级缓存按其节奏送入二级缓存，受一级发送缓存锁保护
+    // Token bucket and rate group of send shaping, the first-level cache is moved into the second-level cache at their pace,
+    // protected by the first-level send cache lock
+    std::unique_ptr<TokenBucket> _send_bucket;
+    SharedTokenBucket::Ptr _send_group;
+    // 一级发送缓存的字节数与可丢弃的包数，受一级发送缓存锁保护
+    // Bytes and droppable packets of the first-level send cache, protected by the first-level send cache lock
+    size_t _send_buf_waiting_bytes = 0;
+    size_t _send_buf_waiting_droppable = 0;
+    // 发送拥塞时的丢弃策略与丢弃统计
+    // Drop policy when sending is congested and drop statistics
+    std::atomic<size_t> _drop_max_bytes { 0 };
+    std::atomic<uint32_t> _drop_max_delay_ms { 0 };
+    std::atomic<uint64_t> _send_drop_count { 0 };
+    std::atomic<uint64_t> _send_drop_bytes { 0 };
+    // 本socket的内存预算，按需创建，一级发送缓存的记账受一级发送缓存锁保护
+    // Memory budget of this socket, created on demand, charges of the first-level send cache are protected by the first-level send cache lock
+    MemoryBudget::Ptr _mem_budget;
+    MemoryBudget::Listener _backpressure_listener;
+    // 每次读事件的读取额度
+    // Read budget of each read event
+    std::atomic<size_t> _read_budget_bytes { 0 };
+    std::atomic<size_t> _read_budget_packets { 0 };
+    // 已让出本轮、等待推迟事件继续读取的fd，只在poller线程访问
+    // The fd that yielded this round and waits for the pending event to continue reading, only accessed in the poller thread
+    SockNum *_read_pending = nullptr;
+    // 内核限速，fd重建后重新设置
+    // Kernel pacing rate, set again when the fd is recreated
+    uint64_t _kernel_pacing_rate = 0;
+    // 令牌不足时由时间轮唤醒继续发送，只在poller线程访问
+    // Woken up by the wheel to continue sending when tokens run out, only accessed in the poller thread
+    PacingWheel::Ptr _pacing_wheel;
+    PacingWheel::Entry::Ptr _pacing_entry;
     // 发送buffer结果回调  [AUTO-TRANSLATED:1cac46fd]
     //Send buffer result callback
     BufferList::SendResult _send_result;
@@ -183,15 +183,27 @@ public:
 
     void startConnect(const std::string &url, uint16_t port, float timeout_sec = 5, uint16_t local_port = 0) override {
         _host = url;
+        _port = port;
         TcpClientType::startConnect(url, port, timeout_sec, local_port);
     }
     void startConnectWithProxy(const std::string &url, const std::string &proxy_host, uint16_t proxy_port, float timeout_sec = 5, uint16_t local_port = 0) override {
         _host = url;
+        _port = 0;
         TcpClientType::startConnect(proxy_host, proxy_port, timeout_sec, local_port);
     }
 
     bool overSsl() const override { return (bool)_ssl_box; }
 
+    /**
+     * 连接成功后不等待首个数据包立即开始tls握手，用于连接预热
+     * Start the tls handshake right after connecting without waiting for the first packet, used to pre-warm connections
+     */
+    void startHandshake() {
+        if (_ssl_box) {
+            _ssl_box->startHandshake();
+        }
+    }
+
 protected:
     void onConnect(const SockException &ex) override {
         if (!ex) {
@@ -208,6 +220,9 @@ protected:
                 //Set ssl domain
                 _ssl_box->setHost(_host.data());
             }
+            //复用同一服务器之前的tls会话
+            //Reuse the previous tls session of the same server
+            _ssl_box->setSessionKey(_host + ":" + std::to_string(_port));
         }
         TcpClientType::onConnect(ex);
     }
@@ -222,6 +237,7 @@ protected:
     }
 private:
     std::string _host;
+    uint16_t _port = 0;
     std::shared_ptr<SSL_Box> _ssl_box;
 };
 
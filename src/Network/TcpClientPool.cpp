@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "TcpClientPool.h"
+
+using namespace std;
+
+namespace toolkit {
+
+void PooledTcpClient::onConnect(const SockException &ex) {
+    // 先移出回调，回调持有本对象的强引用
+    // Move the callback out first, it holds a strong reference of this object
+    auto cb = std::move(_on_connect);
+    _on_connect = nullptr;
+    if (cb) {
+        cb(ex);
+    }
+}
+
+void PooledTcpClient::onRecv(const Buffer::Ptr &buf) {
+    if (_on_recv) {
+        _on_recv(buf);
+        return;
+    }
+    if (_idle) {
+        // 空闲连接收到数据说明协议状态已不可知，不再复用
+        // Data on an idle connection means the protocol state is unknown, it is no longer reused
+        shutdown(SockException(Err_other, "unexpected data on idle pooled connection"));
+    }
+}
+
+void PooledTcpClient::onError(const SockException &ex) {
+    if (_idle) {
+        if (auto pool = _pool.lock()) {
+            pool->onIdleBroken(this, ex);
+        }
+        return;
+    }
+    if (_on_err) {
+        _on_err(ex);
+    }
+}
+
+void PooledTcpClient::onFlush() {
+    if (_on_flush) {
+        _on_flush();
+    }
+}
+
+// 连接成功后立即开始tls握手，预热的连接取出时已完成握手
+// Start the tls handshake right after connecting, so pre-warmed connections have completed the handshake when acquired
+class PooledTcpClientWithSSL : public TcpClientWithSSL<PooledTcpClient> {
+public:
+    PooledTcpClientWithSSL(const EventPoller::Ptr &poller) : TcpClientWithSSL<PooledTcpClient>(poller) {}
+
+protected:
+    void onConnect(const SockException &ex) override {
+        TcpClientWithSSL<PooledTcpClient>::onConnect(ex);
+        if (!ex) {
+            startHandshake();
+        }
+    }
+};
+
+TcpClientPool::TcpClientPool(const EventPoller::Ptr &poller) {
+    _poller = poller ? poller : EventPollerPool::Instance().getPoller();
+}
+
+TcpClientPool::~TcpClientPool() {
+    for (auto &pr : _hosts) {
+        for (auto &waiter : pr.second.waiters) {
+            waiter.cb(SockException(Err_other, "tcp client pool destroyed"), nullptr);
+        }
+    }
+}
+
+string TcpClientPool::makeKey(const string &host, uint16_t port, bool ssl) {
+    return host + ":" + to_string(port) + (ssl ? ":ssl" : ":tcp");
+}
+
+TcpClientPool::HostEntry &TcpClientPool::getEntry(const string &host, uint16_t port, bool ssl) {
+    auto &entry = _hosts[makeKey(host, port, ssl)];
+    if (entry.host.empty()) {
+        entry.host = host;
+        entry.port = port;
+        entry.ssl = ssl;
+    }
+    return entry;
+}
+
+const TcpClientPool::HostEntry *TcpClientPool::findEntry(const string &host, uint16_t port, bool ssl) const {
+    auto it = _hosts.find(makeKey(host, port, ssl));
+    return it == _hosts.end() ? nullptr : &it->second;
+}
+
+size_t TcpClientPool::getIdleCount(const string &host, uint16_t port, bool ssl) const {
+    auto entry = findEntry(host, port, ssl);
+    return entry ? entry->idle.size() : 0;
+}
+
+size_t TcpClientPool::getTotalCount(const string &host, uint16_t port, bool ssl) const {
+    auto entry = findEntry(host, port, ssl);
+    return entry ? entry->total : 0;
+}
+
+void TcpClientPool::setMinIdle(const string &host, uint16_t port, bool ssl, size_t min_idle) {
+    weak_ptr<TcpClientPool> weak_self = shared_from_this();
+    _poller->async([weak_self, host, port, ssl, min_idle]() {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->startTimer();
+            auto &entry = strong_self->getEntry(host, port, ssl);
+            entry.min_idle = min_idle;
+            strong_self->prewarm(entry);
+        }
+    });
+}
+
+void TcpClientPool::acquire(const string &host, uint16_t port, bool ssl, onAcquireCB cb) {
+    weak_ptr<TcpClientPool> weak_self = shared_from_this();
+    _poller->async([weak_self, host, port, ssl, cb]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            cb(SockException(Err_other, "tcp client pool destroyed"), nullptr);
+            return;
+        }
+        strong_self->startTimer();
+        strong_self->acquire_l(strong_self->getEntry(host, port, ssl), cb);
+    });
+}
+
+void TcpClientPool::acquire_l(HostEntry &entry, onAcquireCB cb) {
+    while (!entry.idle.empty()) {
+        auto client = std::move(entry.idle.back());
+        entry.idle.pop_back();
+        if (!client->alive()) {
+            drop(entry, client, SockException(Err_eof, "pooled connection is dead"));
+            continue;
+        }
+        ++client->_reuse_count;
+        cb(SockException(), handOut(client));
+        prewarm(entry);
+        return;
+    }
+    if (entry.total < _max_per_host) {
+        createClient(entry, std::move(cb));
+        return;
+    }
+    // 连接数已达上限，等待归还
+    // The connection limit is reached, wait for a connection to be returned
+    entry.waiters.emplace_back(Waiter { getCurrentMillisecond() + _acquire_timeout_ms, std::move(cb) });
+}
+
+void TcpClientPool::createClient(HostEntry &entry, onAcquireCB cb) {
+    PooledTcpClient::Ptr client;
+    if (entry.ssl) {
+        client = std::make_shared<PooledTcpClientWithSSL>(_poller);
+    } else {
+        client = std::make_shared<PooledTcpClient>(_poller);
+    }
+    client->_key = makeKey(entry.host, entry.port, entry.ssl);
+    client->_pool = shared_from_this();
+    ++entry.total;
+    ++entry.connecting;
+
+    // 连接中只有回调持有连接，PooledTcpClient::onConnect时释放
+    // Only the callback holds the connection while connecting, it is released in PooledTcpClient::onConnect
+    weak_ptr<TcpClientPool> weak_self = shared_from_this();
+    client->_on_connect = [weak_self, client, cb](const SockException &ex) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->onClientConnect(client, ex, cb);
+        } else if (cb) {
+            cb(SockException(Err_other, "tcp client pool destroyed"), nullptr);
+        }
+    };
+    client->startConnect(entry.host, entry.port, _connect_timeout);
+}
+
+void TcpClientPool::onClientConnect(const PooledTcpClient::Ptr &client, const SockException &ex, const onAcquireCB &cb) {
+    auto it = _hosts.find(client->_key);
+    if (it == _hosts.end()) {
+        return;
+    }
+    auto &entry = it->second;
+    --entry.connecting;
+    if (ex) {
+        WarnL << "pooled connection to " << client->_key << " failed: " << ex;
+        --entry.total;
+        if (cb) {
+            cb(ex, nullptr);
+        }
+        // 空出的名额交给排队者，并补足预热；预热连接自身失败时由定时器重试，避免连续重连
+        // Hand the freed slot to the waiters and top up the pre-warmed connections; a failed pre-warmed connection is
+        // retried by the timer to avoid reconnecting back to back
+        serveWaiters(entry);
+        if (cb) {
+            prewarm(entry);
+        }
+        return;
+    }
+    if (cb) {
+        cb(ex, handOut(client));
+        return;
+    }
+    // 预热的连接
+    // A pre-warmed connection
+    putIdle(entry, client);
+    serveWaiters(entry);
+}
+
+PooledTcpClient::Ptr TcpClientPool::handOut(const PooledTcpClient::Ptr &client) {
+    client->_idle = false;
+    client->_reusable = true;
+    // 释放时在下个事件循环归还，避免在连接自身的回调中清空正在执行的回调
+    // Returned in the next event loop iteration on release, avoiding clearing the running callback in the connection's own callback
+    weak_ptr<TcpClientPool> weak_self = shared_from_this();
+    auto poller = _poller;
+    return PooledTcpClient::Ptr(client.get(), [weak_self, client, poller](PooledTcpClient *) {
+        poller->async([weak_self, client]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->release(client);
+            } else {
+                client->shutdown();
+            }
+        }, false);
+    });
+}
+
+void TcpClientPool::release(const PooledTcpClient::Ptr &client) {
+    client->_on_recv = nullptr;
+    client->_on_err = nullptr;
+    client->_on_flush = nullptr;
+    auto it = _hosts.find(client->_key);
+    if (it == _hosts.end()) {
+        client->shutdown();
+        return;
+    }
+    auto &entry = it->second;
+    if (!client->_reusable || !client->alive()) {
+        drop(entry, client, SockException(Err_shutdown, "pooled connection is not reusable"));
+    } else {
+        putIdle(entry, client);
+    }
+    serveWaiters(entry);
+    prewarm(entry);
+}
+
+void TcpClientPool::putIdle(HostEntry &entry, const PooledTcpClient::Ptr &client) {
+    client->_idle = true;
+    client->_idle_since = getCurrentMillisecond();
+    entry.idle.emplace_back(client);
+}
+
+void TcpClientPool::drop(HostEntry &entry, const PooledTcpClient::Ptr &client, const SockException &ex) {
+    // 先脱离连接池，shutdown触发的onError不再回到连接池
+    // Detach from the pool first, so the onError triggered by shutdown does not come back to the pool
+    client->_idle = false;
+    client->_pool.reset();
+    client->shutdown(ex);
+    --entry.total;
+}
+
+void TcpClientPool::onIdleBroken(PooledTcpClient *client, const SockException &ex) {
+    auto it = _hosts.find(client->_key);
+    if (it == _hosts.end()) {
+        return;
+    }
+    auto &entry = it->second;
+    for (auto idle = entry.idle.begin(); idle != entry.idle.end(); ++idle) {
+        if (idle->get() == client) {
+            auto strong_client = std::move(*idle);
+            entry.idle.erase(idle);
+            DebugL << "idle pooled connection to " << entry.host << ":" << entry.port << " closed: " << ex;
+            drop(entry, strong_client, ex);
+            break;
+        }
+    }
+    prewarm(entry);
+}
+
+void TcpClientPool::serveWaiters(HostEntry &entry) {
+    while (!entry.waiters.empty() && (!entry.idle.empty() || entry.total < _max_per_host)) {
+        auto cb = std::move(entry.waiters.front().cb);
+        entry.waiters.pop_front();
+        acquire_l(entry, std::move(cb));
+    }
+}
+
+void TcpClientPool::prewarm(HostEntry &entry) {
+    // 连接可能同步失败，按本次的缺口个数创建，避免死循环
+    // A connection may fail synchronously, create as many as the current shortfall to avoid looping forever
+    auto have = entry.idle.size() + entry.connecting;
+    auto count = have < entry.min_idle ? entry.min_idle - have : 0;
+    for (size_t i = 0; i < count && entry.total < _max_per_host; ++i) {
+        createClient(entry, nullptr);
+    }
+}
+
+void TcpClientPool::startTimer() {
+    if (_timer) {
+        return;
+    }
+    weak_ptr<TcpClientPool> weak_self = shared_from_this();
+    _timer = std::make_shared<Timer>(1.0f, [weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return false;
+        }
+        strong_self->onManager();
+        return true;
+    }, _poller);
+}
+
+void TcpClientPool::onManager() {
+    auto now = getCurrentMillisecond();
+    for (auto &pr : _hosts) {
+        auto &entry = pr.second;
+        // 关闭空闲过久的连接，从最早归还的开始，保留预热数量
+        // Close connections idle for too long, starting from the earliest returned, keeping the pre-warmed count
+        while (entry.idle.size() > entry.min_idle && now - entry.idle.front()->_idle_since > _max_idle_ms) {
+            auto client = std::move(entry.idle.front());
+            entry.idle.pop_front();
+            drop(entry, client, SockException(Err_timeout, "pooled connection idle timeout"));
+        }
+        while (!entry.waiters.empty() && entry.waiters.front().deadline <= now) {
+            auto cb = std::move(entry.waiters.front().cb);
+            entry.waiters.pop_front();
+            cb(SockException(Err_timeout, "acquire pooled connection timeout"), nullptr);
+        }
+        prewarm(entry);
+    }
+}
+
+} // namespace toolkit
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TOOLKIT_NETWORK_TCPCLIENTPOOL_H
+#define TOOLKIT_NETWORK_TCPCLIENTPOOL_H
+
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include "TcpClient.h"
+#include "Poller/Timer.h"
+
+namespace toolkit {
+
+class TcpClientPool;
+
+/**
+ * 连接池中的tcp连接，通过回调接收数据，智能指针释放时归还连接池
+ * 回调中不要持有本对象的强引用，否则连接无法归还
+ * A tcp connection of the connection pool, data is received via callbacks, it is returned to the pool when the smart pointer is released
+ * Do not hold strong references of this object in the callbacks, otherwise the connection can never be returned
+ */
+class PooledTcpClient : public TcpClient {
+public:
+    using Ptr = std::shared_ptr<PooledTcpClient>;
+    using onRecvCB = std::function<void(const Buffer::Ptr &buf)>;
+    using onErrCB = std::function<void(const SockException &ex)>;
+    using onFlushCB = std::function<void()>;
+
+    PooledTcpClient(const EventPoller::Ptr &poller = nullptr) : TcpClient(poller) {}
+
+    // 归还连接池时清空
+    // Cleared when returned to the pool
+    void setOnRecv(onRecvCB cb) { _on_recv = std::move(cb); }
+    void setOnErr(onErrCB cb) { _on_err = std::move(cb); }
+    void setOnFlush(onFlushCB cb) { _on_flush = std::move(cb); }
+
+    /**
+     * 协议状态不确定时(如响应未读完)标记为不可复用，归还时直接断开
+     * Mark as not reusable when the protocol state is uncertain (e.g. the response is not fully read), it is closed when returned
+     */
+    void setReusable(bool reusable) { _reusable = reusable; }
+    bool isReusable() const { return _reusable; }
+
+    // 被复用的次数，新建连接为0
+    // Count of reuses, 0 for a new connection
+    size_t getReuseCount() const { return _reuse_count; }
+
+protected:
+    void onConnect(const SockException &ex) override;
+    void onRecv(const Buffer::Ptr &buf) override;
+    void onError(const SockException &ex) override;
+    void onFlush() override;
+
+private:
+    friend class TcpClientPool;
+
+    bool _idle = false;
+    bool _reusable = true;
+    size_t _reuse_count = 0;
+    uint64_t _idle_since = 0;
+    std::string _key;
+    std::weak_ptr<TcpClientPool> _pool;
+    std::function<void(const SockException &ex)> _on_connect;
+    onRecvCB _on_recv;
+    onErrCB _on_err;
+    onFlushCB _on_flush;
+};
+
+/**
+ * 出站tcp连接池，按host:port:ssl分组缓存空闲连接，避免每次请求都进行dns解析、tcp连接与tls握手
+ * 每个poller一个连接池，连接只在所属poller线程中获取、使用与归还，不会跨线程传递
+ * 空闲连接仍挂在poller上，对端关闭或收到意外数据时立即移除；超过最大空闲时间的连接被关闭
+ * Outbound tcp connection pool, idle connections are cached per host:port:ssl, avoiding dns resolution, tcp connect and
+ * tls handshake for every request
+ * One pool per poller, connections are only acquired, used and returned in the owning poller thread and never cross threads
+ * Idle connections stay attached to the poller and are removed as soon as the peer closes them or unexpected data arrives;
+ * connections idle longer than the max idle time are closed
+ */
+class TcpClientPool : public std::enable_shared_from_this<TcpClientPool> {
+public:
+    using Ptr = std::shared_ptr<TcpClientPool>;
+    using onAcquireCB = std::function<void(const SockException &ex, const PooledTcpClient::Ptr &client)>;
+
+    // 须通过std::make_shared创建
+    // Must be created with std::make_shared
+    TcpClientPool(const EventPoller::Ptr &poller = nullptr);
+    ~TcpClientPool();
+
+    const EventPoller::Ptr &getPoller() const { return _poller; }
+
+    // 每个host:port:ssl的最大连接数(含空闲、使用中与连接中)，默认16
+    // Max connections per host:port:ssl (idle, in use and connecting), 16 by default
+    void setMaxPerHost(size_t max_per_host) { _max_per_host = max_per_host ? max_per_host : 1; }
+
+    // 空闲连接最长保留时间，默认60秒
+    // Max time to keep an idle connection, 60 seconds by default
+    void setMaxIdleTime(float sec) { _max_idle_ms = (uint64_t)(sec * 1000); }
+
+    // 新建连接的超时时间，默认5秒
+    // Timeout of new connections, 5 seconds by default
+    void setConnectTimeout(float sec) { _connect_timeout = sec; }
+
+    // 连接数达到上限时等待空闲连接的超时时间，默认5秒
+    // Timeout of waiting for an idle connection when the connection limit is reached, 5 seconds by default
+    void setAcquireTimeout(float sec) { _acquire_timeout_ms = (uint64_t)(sec * 1000); }
+
+    /**
+     * 预热: 保持至少min_idle个空闲连接，tls连接会提前完成握手；可在任意线程调用
+     * Pre-warming: keep at least min_idle idle connections, tls connections complete the handshake in advance;
+     * can be called in any thread
+     */
+    void setMinIdle(const std::string &host, uint16_t port, bool ssl, size_t min_idle);
+
+    /**
+     * 获取连接，优先复用最近归还的空闲连接；可在任意线程调用，回调在poller线程触发
+     * 返回的智能指针析构时连接自动归还连接池
+     * Acquire a connection, the most recently returned idle connection is preferred; can be called in any thread,
+     * the callback is triggered in the poller thread
+     * The connection is returned to the pool automatically when the returned smart pointer is destroyed
+     */
+    void acquire(const std::string &host, uint16_t port, bool ssl, onAcquireCB cb);
+
+    // 以下统计须在poller线程调用
+    // The following statistics must be called in the poller thread
+    size_t getIdleCount(const std::string &host, uint16_t port, bool ssl) const;
+    size_t getTotalCount(const std::string &host, uint16_t port, bool ssl) const;
+
+private:
+    struct Waiter {
+        uint64_t deadline;
+        onAcquireCB cb;
+    };
+
+    struct HostEntry {
+        std::string host;
+        uint16_t port = 0;
+        bool ssl = false;
+        // 空闲、使用中与连接中的连接总数
+        // Total of idle, in use and connecting connections
+        size_t total = 0;
+        size_t connecting = 0;
+        size_t min_idle = 0;
+        // 尾部为最近归还的连接
+        // The most recently returned connection is at the back
+        std::list<PooledTcpClient::Ptr> idle;
+        std::deque<Waiter> waiters;
+    };
+
+    static std::string makeKey(const std::string &host, uint16_t port, bool ssl);
+
+    HostEntry &getEntry(const std::string &host, uint16_t port, bool ssl);
+    const HostEntry *findEntry(const std::string &host, uint16_t port, bool ssl) const;
+    void acquire_l(HostEntry &entry, onAcquireCB cb);
+    void createClient(HostEntry &entry, onAcquireCB cb);
+    void onClientConnect(const PooledTcpClient::Ptr &client, const SockException &ex, const onAcquireCB &cb);
+    PooledTcpClient::Ptr handOut(const PooledTcpClient::Ptr &client);
+    void release(const PooledTcpClient::Ptr &client);
+    void putIdle(HostEntry &entry, const PooledTcpClient::Ptr &client);
+    void drop(HostEntry &entry, const PooledTcpClient::Ptr &client, const SockException &ex);
+    void onIdleBroken(PooledTcpClient *client, const SockException &ex);
+    void serveWaiters(HostEntry &entry);
+    void prewarm(HostEntry &entry);
+    void startTimer();
+    void onManager();
+
+private:
+    friend class PooledTcpClient;
+
+    size_t _max_per_host = 16;
+    uint64_t _max_idle_ms = 60 * 1000;
+    uint64_t _acquire_timeout_ms = 5 * 1000;
+    float _connect_timeout = 5;
+    EventPoller::Ptr _poller;
+    std::shared_ptr<Timer> _timer;
+    std::unordered_map<std::string, HostEntry> _hosts;
+};
+
+} // namespace toolkit
+
+#endif // TOOLKIT_NETWORK_TCPCLIENTPOOL_H
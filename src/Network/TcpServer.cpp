@@ -35,6 +35,12 @@ void TcpServer::setupEvent() {
         return nullptr;
     });
     _socket->setOnAccept([weak_self](Socket::Ptr &sock, shared_ptr<void> &complete) {
+        if (MemoryBudget::global()->level() == MemoryBudget::Level::Hard) {
+            // 全局内存预算超过硬上限时拒绝新连接
+            // Reject new connections when the global memory budget is over the hard limit
+            WarnL << "Memory budget over the hard limit, reject connection from " << sock->get_peer_ip();
+            return;
+        }
         if (auto strong_self = weak_self.lock()) {
             auto ptr = sock->getPoller().get();
             auto server = strong_self->getServer(ptr);
@@ -67,7 +73,6 @@ TcpServer::~TcpServer() {
     if (_main_server && _socket && _socket->rawFD() != -1) {
         InfoL << "Close tcp server [" << _socket->get_local_ip() << "]: " << _socket->get_local_port();
     }
-    _timer.reset();
     //先关闭socket监听，防止收到新的连接  [AUTO-TRANSLATED:cd65064f]
     //First close the socket listening to prevent receiving new connections
     _socket.reset();
@@ -115,15 +120,7 @@ void TcpServer::cloneFrom(const TcpServer &that) {
     _on_create_socket = that._on_create_socket;
     _session_alloc = that._session_alloc;
     _multi_poller = that._multi_poller;
-    weak_ptr<TcpServer> weak_self = std::static_pointer_cast<TcpServer>(shared_from_this());
-    _timer = std::make_shared<Timer>(2.0f, [weak_self]() -> bool {
-        auto strong_self = weak_self.lock();
-        if (!strong_self) {
-            return false;
-        }
-        strong_self->onManagerSession();
-        return true;
-    }, _poller);
+    _session_idle_timeout_ms = that._session_idle_timeout_ms;
     this->mINI::operator=(that);
     _parent = static_pointer_cast<TcpServer>(const_cast<TcpServer &>(that).shared_from_this());
 }
@@ -156,6 +153,7 @@ Session::Ptr TcpServer::onAcceptConnection(const Socket::Ptr &sock) {
         if (!strong_session) {
             return;
         }
+        strong_session->keepAlive();
         try {
             strong_session->onRecv(buf);
         } catch (SockException &ex) {
@@ -185,20 +183,9 @@ Session::Ptr TcpServer::onAcceptConnection(const Socket::Ptr &sock) {
             }
 
             assert(strong_self->_poller->isCurrentThread());
-            if (!strong_self->_is_on_manager) {
-                //该事件不是onManager时触发的，直接操作map  [AUTO-TRANSLATED:d90ee039]
-                //This event is not triggered by onManager, directly operate on the map
-                strong_self->_session_map.erase(ptr);
-            } else {
-                //遍历map时不能直接删除元素  [AUTO-TRANSLATED:0f00040c]
-                //Cannot directly delete elements when traversing the map
-                strong_self->_poller->async([weak_self, ptr]() {
-                    auto strong_self = weak_self.lock();
-                    if (strong_self) {
-                        strong_self->_session_map.erase(ptr);
-                    }
-                }, false);
-            }
+            // onManager由时间轮触发，不会在遍历_session_map时触发本事件，可以直接操作map
+            // onManager is triggered by the timing wheel, this event never fires while traversing _session_map, so operate on the map directly
+            strong_self->_session_map.erase(ptr);
         });
 
         //获取会话强应用  [AUTO-TRANSLATED:187497e6]
@@ -211,24 +198,15 @@ Session::Ptr TcpServer::onAcceptConnection(const Socket::Ptr &sock) {
             strong_session->onError(err);
         }
     });
+    // 由本poller的时间轮管理会话超时
+    // The session timeouts are managed by the timing wheel of this poller
+    helper->startManager();
     return session;
 }
 
 void TcpServer::start_l(uint16_t port, const std::string &host, uint32_t backlog) {
     setupEvent();
 
-    //新建一个定时器定时管理这些tcp会话  [AUTO-TRANSLATED:ef859bd7]
-    //Create a new timer to manage these TCP sessions periodically
-    weak_ptr<TcpServer> weak_self = std::static_pointer_cast<TcpServer>(shared_from_this());
-    _timer = std::make_shared<Timer>(2.0f, [weak_self]() -> bool {
-        auto strong_self = weak_self.lock();
-        if (!strong_self) {
-            return false;
-        }
-        strong_self->onManagerSession();
-        return true;
-    }, _poller);
-
     if (_multi_poller) {
         EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
             EventPoller::Ptr poller = static_pointer_cast<EventPoller>(executor);
@@ -260,26 +238,6 @@ void TcpServer::start_l(uint16_t port, const std::string &host, uint32_t backlog
     InfoL << "TCP server listening on [" << host << "]: " << port;
 }
 
-void TcpServer::onManagerSession() {
-    assert(_poller->isCurrentThread());
-
-    onceToken token([&]() {
-        _is_on_manager = true;
-    }, [&]() {
-        _is_on_manager = false;
-    });
-
-    for (auto &pr : _session_map) {
-        //遍历时，可能触发onErr事件(也会操作_session_map)  [AUTO-TRANSLATED:7760b80d]
-        //When traversing, the onErr event may be triggered (also operates on _session_map)
-        try {
-            pr.second->session()->onManager();
-        } catch (exception &ex) {
-            WarnL << ex.what();
-        }
-    }
-}
-
 Socket::Ptr TcpServer::createSocket(const EventPoller::Ptr &poller) {
     return _on_create_socket(poller);
 }
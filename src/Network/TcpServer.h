@@ -110,7 +110,6 @@ protected:
     virtual Socket::Ptr onBeforeAcceptConnection(const EventPoller::Ptr &poller);
 
 private:
-    void onManagerSession();
     Socket::Ptr createSocket(const EventPoller::Ptr &poller);
     void start_l(uint16_t port, const std::string &host, uint32_t backlog);
     Ptr getServer(const EventPoller *) const;
@@ -118,11 +117,9 @@ private:
 
 private:
     bool _multi_poller;
-    bool _is_on_manager = false;
     bool _main_server = true;
     std::weak_ptr<TcpServer> _parent;
     Socket::Ptr _socket;
-    std::shared_ptr<Timer> _timer;
     Socket::onCreateSocket _on_create_socket;
     std::unordered_map<SessionHelper *, SessionHelper::Ptr> _session_map;
     std::function<SessionHelper::Ptr(const TcpServer::Ptr &server, const Socket::Ptr &)> _session_alloc;
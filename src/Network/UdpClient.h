@@ -15,6 +15,7 @@
 #include "Socket.h"
 #include "Util/SSLBox.h"
 #include "Kcp.h"
+#include "KcpMux.h"
 
 namespace toolkit {
 
@@ -184,11 +185,79 @@ public:
         _kcp_box->setStreamMode(flag);
     }
 
+    void setZeroCopy(bool flag) {
+        _kcp_box->setZeroCopy(flag);
+    }
+
 private:
     struct sockaddr_storage _peer_addr;
     int _peer_addr_len = 0;
     KcpTransport::Ptr _kcp_box;
 };
 
+//用于实现KCP多路复用客户端的模板对象,send与onRecvFrom默认使用0号可靠流,其他流通过getKcpMux()打开
+//Template object for implementing a KCP multiplexing client, send and onRecvFrom use the reliable stream 0 by default,
+//other streams are opened with getKcpMux()
+template<typename UdpClientType>
+class UdpClientWithKcpMux : public UdpClientType {
+public:
+    using Ptr = std::shared_ptr<UdpClientWithKcpMux>;
+
+    template<typename ...ArgsType>
+    UdpClientWithKcpMux(ArgsType &&...args)
+        :UdpClientType(std::forward<ArgsType>(args)...) {
+        _mux = std::make_shared<KcpMux>(false);
+        _mux->setOnWrite([&](const Buffer::Ptr &buf) { public_send(buf); });
+        _mux->setOnStream([&](const KcpMux::Stream::Ptr &stream) { onStream(stream); });
+        _mux->setOnErr([&](const SockException &ex) { public_onErr(ex); });
+        _mux->openStream(0)->setOnRead([&](const Buffer::Ptr &buf) { public_onRecv(buf); });
+    }
+
+    ~UdpClientWithKcpMux() override { }
+
+    void onRecvFrom(const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) override {
+        _mux->input(buf);
+    }
+
+    ssize_t send(Buffer::Ptr buf) override {
+        return _mux->openStream(0)->send(buf);
+    }
+
+    ssize_t sendto(Buffer::Ptr buf, struct sockaddr *addr = nullptr, socklen_t addr_len = 0) override {
+        return _mux->openStream(0)->send(buf);
+    }
+
+    inline void public_onRecv(const Buffer::Ptr &buf) {
+        UdpClientType::onRecvFrom(buf, (struct sockaddr*)&_peer_addr, _peer_addr_len);
+    }
+
+    inline void public_send(const Buffer::Ptr &buf) {
+        UdpClientType::send(buf);
+    }
+
+    inline void public_onErr(const SockException &ex) { UdpClientWithKcpMux::onError(ex); }
+
+    virtual void startConnect(const std::string &peer_host, uint16_t peer_port, uint16_t local_port = 0) override {
+        _mux->setPoller(UdpClientType::getPoller());
+        _peer_addr = SockUtil::make_sockaddr(peer_host.data(), peer_port);
+        _peer_addr_len = SockUtil::get_sock_len((const struct sockaddr*)&_peer_addr);
+        UdpClientType::startConnect(peer_host, peer_port, local_port);
+    }
+
+    const KcpMux::Ptr &getKcpMux() const { return _mux; }
+
+protected:
+    //对端新建流时触发,默认把流的数据交给onRecvFrom
+    //Triggered when the peer creates a new stream, the data of the stream is handed to onRecvFrom by default
+    virtual void onStream(const KcpMux::Stream::Ptr &stream) {
+        stream->setOnRead([this](const Buffer::Ptr &buf) { public_onRecv(buf); });
+    }
+
+private:
+    struct sockaddr_storage _peer_addr;
+    int _peer_addr_len = 0;
+    KcpMux::Ptr _mux;
+};
+
 } /* namespace toolkit */
 #endif /* NETWORK_UDPCLIENT_H */
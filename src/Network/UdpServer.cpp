@@ -20,6 +20,9 @@ static const uint8_t s_in6_addr_maped[]
     = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00 };
 
 static constexpr auto kUdpDelayCloseMS = 3 * 1000;
+// udp会话默认的空闲超时
+// Default idle timeout of udp sessions
+static constexpr uint32_t kUdpSessionIdleTimeoutMS = 30 * 1000;
 
 static UdpServer::PeerIdType makeSockId(sockaddr *addr, int) {
     UdpServer::PeerIdType ret;
@@ -45,6 +48,7 @@ static UdpServer::PeerIdType makeSockId(sockaddr *addr, int) {
 
 UdpServer::UdpServer(const EventPoller::Ptr &poller) : Server(poller) {
     _multi_poller = !poller;
+    _session_idle_timeout_ms = kUdpSessionIdleTimeoutMS;
     setOnCreateSocket(nullptr);
 }
 
@@ -53,7 +57,11 @@ void UdpServer::setupEvent() {
     std::weak_ptr<UdpServer> weak_self = std::static_pointer_cast<UdpServer>(shared_from_this());
     _socket->setOnRead([weak_self](Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
         if (auto strong_self = weak_self.lock()) {
-            strong_self->onRead(buf, addr, addr_len);
+            if (strong_self->_demux) {
+                strong_self->onReadDemux(buf, addr, addr_len);
+            } else {
+                strong_self->onRead(buf, addr, addr_len);
+            }
         }
     });
 }
@@ -62,13 +70,13 @@ UdpServer::~UdpServer() {
     if (!_cloned && _socket && _socket->rawFD() != -1) {
         InfoL << "Close udp server [" << _socket->get_local_ip() << "]: " << _socket->get_local_port();
     }
-    _timer.reset();
     _socket.reset();
     _cloned_server.clear();
     if (!_cloned && _session_mutex && _session_map) {
         lock_guard<std::recursive_mutex> lck(*_session_mutex);
         _session_map->clear();
     }
+    _demux_map.clear();
 }
 
 void UdpServer::start_l(uint16_t port, const std::string &host) {
@@ -77,17 +85,9 @@ void UdpServer::start_l(uint16_t port, const std::string &host) {
     //Only the main server creates a session map, other cloned servers share it
     _session_mutex = std::make_shared<std::recursive_mutex>();
     _session_map = std::make_shared<SessionMapType>();
-
-    // 新建一个定时器定时管理这些 udp 会话,这些对象只由主server做超时管理，cloned server不管理  [AUTO-TRANSLATED:d20478a2]
-    //Create a timer to manage these udp sessions periodically, these objects are only managed by the main server, cloned servers do not manage them
-    std::weak_ptr<UdpServer> weak_self = std::static_pointer_cast<UdpServer>(shared_from_this());
-    _timer = std::make_shared<Timer>(2.0f, [weak_self]() -> bool {
-        if (auto strong_self = weak_self.lock()) {
-            strong_self->onManagerSession();
-            return true;
-        }
-        return false;
-    }, _poller);
+    if (_kcp_routing) {
+        _kcp_routes = std::make_shared<KcpRouteTable>();
+    }
 
     if (_multi_poller) {
         // clone server至不同线程，让udp server支持多线程  [AUTO-TRANSLATED:15a85c8f]
@@ -146,6 +146,10 @@ void UdpServer::cloneFrom(const UdpServer &that) {
     _session_mutex = that._session_mutex;
     _session_map = that._session_map;
     _multi_poller = that._multi_poller;
+    _demux = that._demux;
+    _kcp_routing = that._kcp_routing;
+    _kcp_routes = that._kcp_routes;
+    _session_idle_timeout_ms = that._session_idle_timeout_ms;
     // clone properties
     this->mINI::operator=(that);
 }
@@ -161,6 +165,7 @@ static void emitSessionRecv(const SessionHelper::Ptr &helper, const Buffer::Ptr
         //Delayed destruction in progress
         return;
     }
+    helper->session()->keepAlive();
     try {
         helper->session()->onRecv(buf);
     } catch (SockException &ex) {
@@ -204,40 +209,6 @@ void UdpServer::onRead_l(bool is_server_fd, const UdpServer::PeerIdType &id, Buf
     }
 }
 
-void UdpServer::onManagerSession() {
-    decltype(_session_map) copy_map;
-    {
-        std::lock_guard<std::recursive_mutex> lock(*_session_mutex);
-        //拷贝map，防止遍历时移除对象  [AUTO-TRANSLATED:ebbc7595]
-        //Copy the map to prevent objects from being removed during traversal
-        copy_map = std::make_shared<SessionMapType>(*_session_map);
-    }
-    auto lam = [copy_map]() {
-        for (auto &pr : *copy_map) {
-            auto &session = pr.second->session();
-            if (!session->getPoller()->isCurrentThread()) {
-                // 该session不归属该poller管理  [AUTO-TRANSLATED:d5edb552]
-                //This session does not belong to the management of this poller
-                continue;
-            }
-            try {
-                // UDP 会话需要处理超时  [AUTO-TRANSLATED:0a51f8a1]
-                //UDP sessions need to handle timeouts
-                session->onManager();
-            } catch (exception &ex) {
-                WarnL << "Exception occurred when emit onManager: " << ex.what();
-            }
-        }
-    };
-    if (_multi_poller){
-        EventPollerPool::Instance().for_each([lam](const TaskExecutor::Ptr &executor) {
-            std::static_pointer_cast<EventPoller>(executor)->async(lam);
-        });
-    } else {
-        lam();
-    }
-}
-
 SessionHelper::Ptr UdpServer::getOrCreateSession(const UdpServer::PeerIdType &id, Buffer::Ptr &buf, sockaddr *addr, int addr_len, bool &is_new) {
     {
         //减小临界区  [AUTO-TRANSLATED:3d6089d8]
@@ -347,6 +318,9 @@ SessionHelper::Ptr UdpServer::createSession(const PeerIdType &id, Buffer::Ptr &b
 
         auto pr = _session_map->emplace(id, std::move(helper));
         assert(pr.second);
+        // 由会话所在poller的时间轮管理超时
+        //The timeouts are managed by the timing wheel of the poller the session belongs to
+        pr.first->second->startManager();
         return pr.first->second;
     };
 
@@ -376,6 +350,253 @@ SessionHelper::Ptr UdpServer::createSession(const PeerIdType &id, Buffer::Ptr &b
     return nullptr;
 }
 
+// 只解析conv，不是KCP包时返回false
+// Only parse the conv, false is returned if it is not a KCP packet
+static bool getKcpConv(const Buffer::Ptr &buf, uint32_t &conv) {
+    KcpHeader header;
+    if (buf->size() < KcpHeader::HEADER_SIZE || !header.loadHeaderFromData(buf->data(), buf->size())) {
+        return false;
+    }
+    conv = header.getConv();
+    return true;
+}
+
+void UdpServer::onReadDemux(Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+    const auto id = makeSockId(addr, addr_len);
+    auto it = _demux_map.find(id);
+    if (it != _demux_map.end()) {
+        auto &helper = it->second;
+        if (!_kcp_routes || helper->session()->getPoller() == _poller) {
+            emitSessionRecv(helper, buf);
+            return;
+        }
+        // 迁移过来的会话归属其他poller，需要先转移走buffer再切换线程
+        // The migrated session belongs to another poller, the buffer must be transferred first before switching threads
+        std::weak_ptr<SessionHelper> weak_helper = helper;
+        auto cacheable_buf = std::move(buf);
+        helper->session()->async([weak_helper, cacheable_buf]() {
+            if (auto strong_helper = weak_helper.lock()) {
+                emitSessionRecv(strong_helper, cacheable_buf);
+            }
+        });
+        return;
+    }
+    uint32_t conv;
+    if (_kcp_routes && getKcpConv(buf, conv) && routeKcp(id, conv, buf, addr, addr_len)) {
+        return;
+    }
+    if (auto helper = createSessionDemux(id, buf, addr, addr_len)) {
+        emitSessionRecv(helper, buf);
+    }
+}
+
+bool UdpServer::routeKcp(const PeerIdType &id, uint32_t conv, Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+    SessionHelper::Ptr helper;
+    {
+        lock_guard<std::mutex> lck(_kcp_routes->mtx);
+        auto it = _kcp_routes->routes.find(conv);
+        if (it == _kcp_routes->routes.end()) {
+            return false;
+        }
+        helper = it->second.helper.lock();
+        if (!helper || !helper->enable) {
+            // 会话已销毁或延时销毁中，按新会话处理
+            // The session is destroyed or being destroyed with delay, handle it as a new session
+            _kcp_routes->routes.erase(it);
+            return false;
+        }
+    }
+
+    std::weak_ptr<UdpServer> weak_self = std::static_pointer_cast<UdpServer>(shared_from_this());
+    auto addr_str = string((char *)addr, addr_len);
+    // 会话可能归属其他poller，先转移走buffer
+    // The session may belong to another poller, transfer the buffer first
+    auto cacheable_buf = std::move(buf);
+    helper->session()->async([weak_self, helper, conv, id, addr_str, cacheable_buf]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self || !helper->enable) {
+            return;
+        }
+        auto &session = helper->session();
+        if (!session->acceptPeerMigration(cacheable_buf)) {
+            WarnP(session) << "Drop unverified KCP packet of conv " << conv << " from "
+                           << SockUtil::inet_ntoa((struct sockaddr *)addr_str.data()) << ":"
+                           << SockUtil::inet_port((struct sockaddr *)addr_str.data());
+            return;
+        }
+        InfoP(session) << "KCP session of conv " << conv << " migrated to " << SockUtil::inet_ntoa((struct sockaddr *)addr_str.data())
+                       << ":" << SockUtil::inet_port((struct sockaddr *)addr_str.data());
+        session->getSock()->bindPeerAddr((struct sockaddr *)addr_str.data(), addr_str.size(), true);
+        strong_self->onKcpMigrated(helper, conv, id);
+        emitSessionRecv(helper, cacheable_buf);
+    });
+    return true;
+}
+
+void UdpServer::onKcpMigrated(const SessionHelper::Ptr &helper, uint32_t conv, const PeerIdType &id) {
+    std::weak_ptr<UdpServer> old_server;
+    PeerIdType old_id;
+    auto self = std::static_pointer_cast<UdpServer>(shared_from_this());
+    {
+        lock_guard<std::mutex> lck(_kcp_routes->mtx);
+        auto &route = _kcp_routes->routes[conv];
+        old_server = route.server;
+        old_id = route.id;
+        route.helper = helper;
+        route.server = self;
+        route.id = id;
+    }
+
+    std::weak_ptr<UdpServer> weak_self = self;
+    std::weak_ptr<SessionHelper> weak_helper = helper;
+    _poller->async([weak_self, weak_helper, id]() {
+        auto strong_self = weak_self.lock();
+        auto strong_helper = weak_helper.lock();
+        if (strong_self && strong_helper && strong_helper->enable) {
+            strong_self->_demux_map[id] = std::move(strong_helper);
+            strong_self->_demux_size = strong_self->_demux_map.size();
+        }
+    });
+    auto old = old_server.lock();
+    if (old && !(old == self && old_id == id)) {
+        std::weak_ptr<UdpServer> weak_old = old;
+        old->_poller->async([weak_old, weak_helper, old_id]() {
+            if (auto strong_old = weak_old.lock()) {
+                strong_old->eraseDemux(old_id, weak_helper);
+            }
+        });
+    }
+}
+
+void UdpServer::eraseKcpRoute(uint32_t conv, const std::weak_ptr<SessionHelper> &helper) {
+    std::weak_ptr<UdpServer> server;
+    PeerIdType id;
+    {
+        lock_guard<std::mutex> lck(_kcp_routes->mtx);
+        auto it = _kcp_routes->routes.find(conv);
+        if (it == _kcp_routes->routes.end() || it->second.helper.owner_before(helper) || helper.owner_before(it->second.helper)) {
+            // 路由已指向同conv的新会话
+            // The route already points to a new session of the same conv
+            return;
+        }
+        server = it->second.server;
+        id = it->second.id;
+        _kcp_routes->routes.erase(it);
+    }
+    if (auto strong_server = server.lock()) {
+        strong_server->_poller->async([server, helper, id]() {
+            if (auto strong_server = server.lock()) {
+                strong_server->eraseDemux(id, helper);
+            }
+        });
+    }
+}
+
+void UdpServer::eraseDemux(const PeerIdType &id, const std::weak_ptr<SessionHelper> &helper) {
+    auto it = _demux_map.find(id);
+    if (it == _demux_map.end() || it->second.owner_before(helper) || helper.owner_before(it->second)) {
+        return;
+    }
+    _demux_map.erase(it);
+    _demux_size = _demux_map.size();
+}
+
+SessionHelper::Ptr UdpServer::createSessionDemux(const PeerIdType &id, Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+    auto socket = createSocket(_poller, buf, addr, addr_len);
+    if (!socket) {
+        return nullptr;
+    }
+    if (socket->getPoller() != _poller) {
+        // 对端固定由本poller的socket接收，会话必须归属本poller
+        // The peer is always received by the socket of this poller, so the session must belong to this poller
+        WarnL << "UDP session socket must be created on the receiving poller in demux mode";
+        return nullptr;
+    }
+    if (!socket->shareUdpSock(_socket, addr, addr_len)) {
+        return nullptr;
+    }
+
+    auto server = std::static_pointer_cast<UdpServer>(shared_from_this());
+    auto helper = _session_alloc(server, socket);
+    // 把本服务器的配置传递给 Session
+    //Pass the configuration of this server to the Session
+    helper->session()->attachServer(*this);
+
+    uint32_t conv = 0;
+    bool routed = _kcp_routes && getKcpConv(buf, conv);
+    if (routed) {
+        lock_guard<std::mutex> lck(_kcp_routes->mtx);
+        auto &route = _kcp_routes->routes[conv];
+        route.helper = helper;
+        route.server = server;
+        route.id = id;
+    }
+
+    std::weak_ptr<UdpServer> weak_self = server;
+    std::weak_ptr<SessionHelper> weak_helper = helper;
+    socket->setOnErr([weak_self, weak_helper, id, routed, conv](const SockException &err) {
+        // 在本函数作用域结束时延时移除会话对象，确保移除会话前执行其 onError 函数
+        //Delay removing the session object when this function scope ends, to ensure its onError function is executed before removal
+        onceToken token(nullptr, [&]() {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            strong_self->_poller->doDelayTask(kUdpDelayCloseMS, [weak_self, weak_helper, id, routed, conv]() {
+                if (auto strong_self = weak_self.lock()) {
+                    // 会话可能已迁移到其他地址，按路由表清理
+                    // The session may have migrated to another address, clean up by the route table
+                    if (routed) {
+                        strong_self->eraseKcpRoute(conv, weak_helper);
+                    }
+                    strong_self->eraseDemux(id, weak_helper);
+                }
+                return 0;
+            });
+        });
+
+        if (auto strong_helper = weak_helper.lock()) {
+            TraceP(strong_helper->session()) << strong_helper->className() << " on err: " << err;
+            strong_helper->enable = false;
+            strong_helper->session()->onError(err);
+        }
+    });
+    auto pr = _demux_map.emplace(id, std::move(helper));
+    _demux_size = _demux_map.size();
+    pr.first->second->startManager();
+    return pr.first->second;
+}
+
+void UdpServer::enableDemux(bool enable) {
+    if (_socket) {
+        throw std::runtime_error("UdpServer::enableDemux must be called before start");
+    }
+    _demux = enable;
+}
+
+void UdpServer::enableKcpRouting(bool enable) {
+    if (_socket) {
+        throw std::runtime_error("UdpServer::enableKcpRouting must be called before start");
+    }
+    _kcp_routing = enable;
+    _demux = _demux || enable;
+}
+
+size_t UdpServer::getSessionCount() {
+    if (!_demux) {
+        if (!_session_mutex) {
+            return 0;
+        }
+        lock_guard<std::recursive_mutex> lck(*_session_mutex);
+        return _session_map->size();
+    }
+    size_t ret = _demux_size;
+    for (auto &pr : _cloned_server) {
+        ret += pr.second->_demux_size;
+    }
+    return ret;
+}
+
 void UdpServer::setOnCreateSocket(onCreateSocket cb) {
     if (cb) {
         _on_create_socket = std::move(cb);
@@ -97,6 +97,34 @@ public:
      */
     void setOnCreateSocket(onCreateSocket cb);
 
+    /**
+     * @brief 启用单socket分发模式，必须在start之前调用
+     * 每个poller只拥有一个SO_REUSEPORT的udp socket，通过recvmmsg批量接收后按对端地址在本poller的哈希表中查找会话并分发，
+     * 不再为每个对端创建connect过的fd及注册io事件；会话发送的数据合并至本poller的udp socket，通过sendmmsg批量发送
+     * @brief Enable single socket demultiplexing mode, must be called before start
+     * Each poller only owns one SO_REUSEPORT udp socket, which receives in batch via recvmmsg and dispatches packets by looking up
+     * sessions with the peer address in the hash table of this poller, no connected fd or io event is created per peer any more;
+     * data sent by sessions is merged into the udp socket of this poller and sent in batch via sendmmsg
+     */
+    void enableDemux(bool enable = true);
+
+    /**
+     * @brief 启用KCP路由，必须在start之前调用，隐含开启单socket分发模式
+     * 按对端地址查找不到会话时，再按KCP头中的conv查找会话，经Session::acceptPeerMigration校验通过后会话迁移到新地址继续使用，
+     * 不重建会话；用于客户端NAT重绑定或切换网络，conv须在服务器内唯一
+     * @brief Enable KCP routing, must be called before start, which implies the single socket demultiplexing mode
+     * When no session is found by the peer address, the session is looked up by the conv in the KCP header, and after being verified by
+     * Session::acceptPeerMigration, the session migrates to the new address and goes on without being rebuilt;
+     * used for client NAT rebinding or network switching, conv must be unique in the server
+     */
+    void enableKcpRouting(bool enable = true);
+
+    /**
+     * @brief 获取会话个数
+     * @brief Get the number of sessions
+     */
+    size_t getSessionCount();
+
 protected:
     virtual Ptr onCreatServer(const EventPoller::Ptr &poller);
     virtual void cloneFrom(const UdpServer &that);
@@ -111,6 +139,19 @@ private:
     };
     using SessionMapType = std::unordered_map<PeerIdType, SessionHelper::Ptr, PeerIdHash>;
 
+    // KCP路由表，conv -> 会话及其当前所在的server与对端地址，所有cloned server共享，只在按地址查找不到会话时访问
+    // KCP route table, conv -> the session and the server and peer address it is currently on, shared by all cloned servers,
+    // only accessed when no session is found by the peer address
+    struct KcpRoute {
+        std::weak_ptr<SessionHelper> helper;
+        std::weak_ptr<UdpServer> server;
+        PeerIdType id;
+    };
+    struct KcpRouteTable {
+        std::mutex mtx;
+        std::unordered_map<uint32_t, KcpRoute> routes;
+    };
+
     /**
      * @brief 开始udp server
      * @param port 本机端口，0则随机
@@ -123,14 +164,6 @@ private:
      */
     void start_l(uint16_t port, const std::string &host = "::");
 
-    /**
-     * @brief 定时管理 Session, UDP 会话需要根据需要处理超时
-     * @brief Periodically manage Session, UDP sessions need to handle timeouts as needed
-     
-     * [AUTO-TRANSLATED:86ff2f9c]
-     */
-    void onManagerSession();
-
     void onRead(Buffer::Ptr &buf, struct sockaddr *addr, int addr_len);
 
     /**
@@ -177,16 +210,59 @@ private:
 
     void setupEvent();
 
+    /**
+     * @brief 单socket分发模式下处理收到的数据，只在本poller线程执行
+     * @brief Handle received data in demultiplexing mode, only executed in the poller thread
+     */
+    void onReadDemux(Buffer::Ptr &buf, struct sockaddr *addr, int addr_len);
+
+    /**
+     * @brief 单socket分发模式下创建会话
+     * @brief Create a session in demultiplexing mode
+     */
+    SessionHelper::Ptr createSessionDemux(const PeerIdType &id, Buffer::Ptr &buf, struct sockaddr *addr, int addr_len);
+
+    /**
+     * @brief 按conv把来自新地址的数据交给已有会话，校验通过后迁移会话；返回false表示没有该conv的会话
+     * @brief Hand data from a new address to the existing session by conv, and migrate the session after verification;
+     * false is returned if there is no session of this conv
+     */
+    bool routeKcp(const PeerIdType &id, uint32_t conv, Buffer::Ptr &buf, struct sockaddr *addr, int addr_len);
+
+    /**
+     * @brief 会话迁移到本server的id地址后，更新路由表并移除旧地址
+     * @brief Update the route table and remove the old address after the session migrates to the id address of this server
+     */
+    void onKcpMigrated(const SessionHelper::Ptr &helper, uint32_t conv, const PeerIdType &id);
+
+    /**
+     * @brief 移除会话时同步清理路由表
+     * @brief Clean up the route table when removing a session
+     */
+    void eraseKcpRoute(uint32_t conv, const std::weak_ptr<SessionHelper> &helper);
+
+    /**
+     * @brief id仍指向helper时才从本poller的会话表中移除，只在本poller线程执行
+     * @brief Remove id from the session map of this poller only if it still points to helper, only executed in the poller thread
+     */
+    void eraseDemux(const PeerIdType &id, const std::weak_ptr<SessionHelper> &helper);
+
 private:
     bool _cloned = false;
+    bool _demux = false;
+    bool _kcp_routing = false;
     bool _multi_poller;
     Socket::Ptr _socket;
-    std::shared_ptr<Timer> _timer;
     onCreateSocket _on_create_socket;
     //cloned server共享主server的session map，防止数据在不同server间漂移  [AUTO-TRANSLATED:9a149e52]
     //Cloned server shares the session map with the main server, preventing data drift between different servers
     std::shared_ptr<std::recursive_mutex> _session_mutex;
     std::shared_ptr<SessionMapType> _session_map;
+    // 单socket分发模式下本poller独占的会话表，只在本poller线程访问，无需加锁
+    // Session map owned by this poller in demultiplexing mode, only accessed in the poller thread, no lock needed
+    SessionMapType _demux_map;
+    std::atomic<size_t> _demux_size { 0 };
+    std::shared_ptr<KcpRouteTable> _kcp_routes;
     //主server持有cloned server的引用  [AUTO-TRANSLATED:04a6403a]
     //Main server holds a reference to the cloned server
     std::unordered_map<EventPoller *, Ptr> _cloned_server;
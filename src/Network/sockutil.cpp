@@ -303,6 +303,21 @@ int SockUtil::setSendBuf(int fd, int size) {
     return ret;
 }
 
+int SockUtil::setMaxPacingRate(int fd, uint64_t bytes_per_sec) {
+#if defined(SO_MAX_PACING_RATE)
+    // 内核以~0表示不限速
+    // The kernel uses ~0 for unlimited
+    uint64_t rate = bytes_per_sec ? bytes_per_sec : ~0ULL;
+    int ret = setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, (char *) &rate, sizeof(rate));
+    if (ret == -1) {
+        TraceL << "setsockopt SO_MAX_PACING_RATE failed";
+    }
+    return ret;
+#else
+    return -1;
+#endif
+}
+
 class DnsCache {
 public:
     static DnsCache &Instance() {
@@ -224,6 +224,18 @@ public:
      */
     static int setSendBuf(int fd, int size = SOCKET_DEFAULT_BUF_SIZE);
 
+    /**
+     * 设置内核发送限速(SO_MAX_PACING_RATE)，tcp需配合fq队列规则或内核tcp pacing生效
+     * @param fd socket fd号
+     * @param bytes_per_sec 速率，0为不限速
+     * @return 0代表成功，-1为失败(包括系统不支持)
+     * Set the kernel send pacing rate (SO_MAX_PACING_RATE), tcp takes effect with the fq qdisc or the kernel tcp pacing
+     * @param fd socket fd number
+     * @param bytes_per_sec Rate, 0 means unlimited
+     * @return 0 represents success, -1 represents failure (including not supported by the system)
+     */
+    static int setMaxPacingRate(int fd, uint64_t bytes_per_sec);
+
     /**
      * 设置后续可绑定复用端口(处于TIME_WAITE状态)
      * @param fd socket fd号
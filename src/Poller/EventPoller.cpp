@@ -10,6 +10,9 @@
 
 #include "SelectWrap.h"
 #include "EventPoller.h"
+#include "PollerMetrics.h"
+#include "Util/Trace.h"
+#include "PollerWatchdog.h"
 #include "Util/util.h"
 #include "Util/uv_errno.h"
 #include "Util/TimeTicker.h"
@@ -86,6 +89,8 @@ EventPoller::EventPoller(std::string name) {
 #endif
 
     _name = std::move(name);
+    _metrics = std::make_shared<PollerMetrics>(_name);
+    _heartbeat = std::make_shared<PollerHeartbeat>();
     _logger = Logger::Instance().shared_from_this();
     addEventPipe();
 }
@@ -290,6 +295,7 @@ Task::Ptr EventPoller::async_l(TaskIn task, bool may_sync, bool first) {
         } else {
             _list_task.emplace_back(ret);
         }
+        _metrics->task_queue->set(_list_task.size());
     }
     //写数据到管道,唤醒主线程  [AUTO-TRANSLATED:2ead8182]
     //Write data to the pipe and wake up the main thread
@@ -327,9 +333,13 @@ inline void EventPoller::onPipeEvent(bool flush) {
     {
         lock_guard<mutex> lck(_mtx_task);
         _list_swap.swap(_list_task);
+        _metrics->task_queue->set(0);
     }
 
     _list_swap.for_each([&](const Task::Ptr &task) {
+        ScopedCost cost(*_metrics->task_cost_us);
+        TRACE_SCOPE("task");
+        PollerHeartbeat::Scope heartbeat(*_heartbeat, "task", 0, PollerWatchdog::running() ? &task->target_type() : nullptr);
         try {
             (*task)();
         } catch (ExitException &) {
@@ -362,6 +372,10 @@ const std::string& EventPoller::getThreadName() const {
     return _name;
 }
 
+PollerMetrics &EventPoller::getMetrics() const {
+    return *_metrics;
+}
+
 static thread_local std::weak_ptr<EventPoller> s_current_poller;
 
 // static
@@ -374,16 +388,25 @@ void EventPoller::runLoop(bool blocked, bool ref_self) {
         if (ref_self) {
             s_current_poller = shared_from_this();
         }
+        PollerMetrics::setCurrent(_metrics.get());
+        _heartbeat->attachThread();
         _sem_run_started.post();
         _exit_flag = false;
         int64_t minDelay;
 #if defined(HAS_EPOLL)
         struct epoll_event events[EPOLL_SIZE];
         while (!_exit_flag) {
-            minDelay = getMinDelay();
-            startSleep(); // 用于统计当前线程负载情况
-            int ret = epoll_wait(_event_fd, events, EPOLL_SIZE, minDelay);
-            sleepWakeUp(); // 用于统计当前线程负载情况
+            runPendingEvents();
+            minDelay = _pending_events.empty() ? getMinDelay() : 0;
+            int ret;
+            {
+                TRACE_SCOPE("poll_wait");
+                _heartbeat->sleep();
+                startSleep(); // 用于统计当前线程负载情况
+                ret = epoll_wait(_event_fd, events, EPOLL_SIZE, minDelay);
+                sleepWakeUp(); // 用于统计当前线程负载情况
+                _heartbeat->wakeUp();
+            }
             if (ret <= 0) {
                 // 超时或被打断  [AUTO-TRANSLATED:7005fded]
                 // Timed out or interrupted
@@ -406,6 +429,9 @@ void EventPoller::runLoop(bool blocked, bool ref_self) {
                     continue;
                 }
                 auto cb = it->second;
+                ScopedCost cost(*_metrics->event_cost_us);
+                TRACE_SCOPE("event", fd);
+                PollerHeartbeat::Scope heartbeat(*_heartbeat, "event", fd);
                 try {
                     (*cb)(toPoller(ev.events));
                 } catch (std::exception &ex) {
@@ -416,12 +442,19 @@ void EventPoller::runLoop(bool blocked, bool ref_self) {
 #elif defined(HAS_KQUEUE)
         struct kevent kevents[KEVENT_SIZE];
         while (!_exit_flag) {
-            minDelay = getMinDelay();
+            runPendingEvents();
+            minDelay = _pending_events.empty() ? getMinDelay() : 0;
             struct timespec timeout = { (long)minDelay / 1000, (long)minDelay % 1000 * 1000000 };
 
-            startSleep();
-            int ret = kevent(_event_fd, nullptr, 0, kevents, KEVENT_SIZE, minDelay == -1 ? nullptr : &timeout);
-            sleepWakeUp();
+            int ret;
+            {
+                TRACE_SCOPE("poll_wait");
+                _heartbeat->sleep();
+                startSleep();
+                ret = kevent(_event_fd, nullptr, 0, kevents, KEVENT_SIZE, minDelay == -1 ? nullptr : &timeout);
+                sleepWakeUp();
+                _heartbeat->wakeUp();
+            }
             if (ret <= 0) {
                 continue;
             }
@@ -450,6 +483,9 @@ void EventPoller::runLoop(bool blocked, bool ref_self) {
                     default: WarnL << "unknown kevent filter: " << kev.filter; break;
                 }
 
+                ScopedCost cost(*_metrics->event_cost_us);
+                TRACE_SCOPE("event", fd);
+                PollerHeartbeat::Scope heartbeat(*_heartbeat, "event", fd);
                 try {
                     (*cb)(event);
                 } catch (std::exception &ex) {
@@ -465,7 +501,8 @@ void EventPoller::runLoop(bool blocked, bool ref_self) {
         while (!_exit_flag) {
             // 定时器事件中可能操作_event_map  [AUTO-TRANSLATED:f2a50ee2]
             // Possible operations on _event_map in timer events
-            minDelay = getMinDelay();
+            runPendingEvents();
+            minDelay = _pending_events.empty() ? getMinDelay() : 0;
             tv.tv_sec = (decltype(tv.tv_sec))(minDelay / 1000);
             tv.tv_usec = 1000 * (minDelay % 1000);
 
@@ -488,9 +525,14 @@ void EventPoller::runLoop(bool blocked, bool ref_self) {
                 }
             }
 
-            startSleep(); // 用于统计当前线程负载情况
-            ret = zl_select(max_fd + 1, &set_read, &set_write, &set_err, minDelay == -1 ? nullptr : &tv);
-            sleepWakeUp(); // 用于统计当前线程负载情况
+            {
+                TRACE_SCOPE("poll_wait");
+                _heartbeat->sleep();
+                startSleep(); // 用于统计当前线程负载情况
+                ret = zl_select(max_fd + 1, &set_read, &set_write, &set_err, minDelay == -1 ? nullptr : &tv);
+                sleepWakeUp(); // 用于统计当前线程负载情况
+                _heartbeat->wakeUp();
+            }
 
             if (ret <= 0) {
                 // 超时或被打断  [AUTO-TRANSLATED:7005fded]
@@ -525,6 +567,9 @@ void EventPoller::runLoop(bool blocked, bool ref_self) {
                     return;
                 }
 
+                ScopedCost cost(*_metrics->event_cost_us);
+                TRACE_SCOPE("event", record->fd);
+                PollerHeartbeat::Scope heartbeat(*_heartbeat, "event", record->fd);
                 try {
                     record->call_back(record->attach);
                 } catch (std::exception &ex) {
@@ -535,6 +580,13 @@ void EventPoller::runLoop(bool blocked, bool ref_self) {
         }
 #endif //HAS_EPOLL
     } else {
+        std::weak_ptr<EventPoller> weak_self = shared_from_this();
+        MetricsRegistry::Instance().addCallback("zltoolkit_poller_load", "Load percentage of the poller thread", MetricsRegistry::Type::Gauge,
+                                                { { "poller", _name } }, [weak_self]() -> double {
+            auto strong_self = weak_self.lock();
+            return strong_self ? strong_self->load() : 0;
+        });
+        PollerWatchdog::Instance().addPoller(shared_from_this(), _heartbeat);
         _loop_thread = new thread(&EventPoller::runLoop, this, true, ref_self);
         _sem_run_started.wait();
     }
@@ -547,6 +599,12 @@ int64_t EventPoller::flushDelayTask(uint64_t now_time) {
     for (auto it = task_copy.begin(); it != task_copy.end() && it->first <= now_time; it = task_copy.erase(it)) {
         //已到期的任务  [AUTO-TRANSLATED:849cdc29]
         //Expired tasks
+        if (MetricsRegistry::enabled()) {
+            _metrics->timer_lag_ms->record(now_time - it->first);
+        }
+        ScopedCost cost(*_metrics->timer_cost_us);
+        TRACE_SCOPE("timer");
+        PollerHeartbeat::Scope heartbeat(*_heartbeat, "timer", 0, PollerWatchdog::running() ? &it->second->target_type() : nullptr);
         try {
             auto next_delay = (*(it->second))();
             if (next_delay) {
@@ -591,6 +649,35 @@ int64_t EventPoller::getMinDelay() {
     return flushDelayTask(now);
 }
 
+void EventPoller::addPendingEvent(function<void()> cb) {
+    if (!isCurrentThread()) {
+        async([this, cb]() { _pending_events.emplace_back(cb); });
+        return;
+    }
+    _pending_events.emplace_back(std::move(cb));
+}
+
+void EventPoller::runPendingEvents() {
+    if (_pending_events.empty()) {
+        return;
+    }
+    if (MetricsRegistry::enabled()) {
+        _metrics->pending_events->record(_pending_events.size());
+    }
+    // 本轮再次添加的事件留到下一轮
+    // Events added again in this round are left to the next round
+    decltype(_pending_events) pending;
+    pending.swap(_pending_events);
+    pending.for_each([&](function<void()> &cb) {
+        ScopedCost cost(*_metrics->event_cost_us);
+        try {
+            cb();
+        } catch (std::exception &ex) {
+            ErrorL << "Exception occurred when do pending event: " << ex.what();
+        }
+    });
+}
+
 EventPoller::DelayTask::Ptr EventPoller::doDelayTask(uint64_t delay_ms, function<uint64_t()> task) {
     DelayTask::Ptr ret = std::make_shared<DelayTask>(std::move(task));
     auto time_line = getCurrentMillisecond() + delay_ms;
@@ -46,6 +46,9 @@ constexpr epoll_fd INVALID_EVENT_FD = -1;
 
 namespace toolkit {
 
+class PollerMetrics;
+class PollerHeartbeat;
+
 class EventPoller : public TaskExecutor, public AnyStorage, public std::enable_shared_from_this<EventPoller> {
 public:
     friend class TaskExecutorGetterImp;
@@ -174,6 +177,15 @@ public:
      */
     DelayTask::Ptr doDelayTask(uint64_t delay_ms, std::function<uint64_t()> task);
 
+    /**
+     * 添加推迟事件，在下一轮事件循环开始时执行
+     * 存在推迟事件时poller不休眠；读取额度用尽的socket借此让出本轮，与其他fd轮流读取
+     * Add a pending event, executed at the start of the next round of the event loop
+     * The poller does not sleep while there are pending events; sockets that run out of read budget use it to yield the round
+     * and take turns reading with other fds
+     */
+    void addPendingEvent(std::function<void()> cb);
+
     /**
      * 获取当前线程关联的Poller实例
      * Gets the Poller instance associated with the current thread
@@ -202,6 +214,12 @@ public:
      */
     const std::string &getThreadName() const;
 
+    /**
+     * 获取本poller的指标
+     * Get the metrics of this poller
+     */
+    PollerMetrics &getMetrics() const;
+
 private:
     /**
      * 本对象只允许在EventPollerPool中构造
@@ -228,6 +246,12 @@ private:
      */
     void onPipeEvent(bool flush = false);
 
+    /**
+     * 执行上一轮添加的推迟事件
+     * Execute the pending events added in the last round
+     */
+    void runPendingEvents();
+
     /**
      * 切换线程并执行任务
      * @param task
@@ -335,10 +359,20 @@ private:
     std::unordered_map<int, Poll_Record::Ptr> _event_map;
 #endif // HAS_EPOLL
     std::unordered_set<int> _event_cache_expired;
+    // 推迟到下一轮执行的事件
+    // Events deferred to the next round
+    List<std::function<void()>> _pending_events;
 
     // 定时器相关  [AUTO-TRANSLATED:fa2e84da]
     // Timer related
     std::multimap<uint64_t, DelayTask::Ptr> _delay_task_map;
+
+    // 本poller的指标
+    // Metrics of this poller
+    std::shared_ptr<PollerMetrics> _metrics;
+    // 本poller的心跳，供卡顿看门狗检查
+    // Heartbeat of this poller, checked by the stall watchdog
+    std::shared_ptr<PollerHeartbeat> _heartbeat;
 };
 
 class EventPollerPool : public std::enable_shared_from_this<EventPollerPool>, public TaskExecutorGetterImp {
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include "PacingWheel.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/Metrics.h"
+
+using namespace std;
+
+namespace toolkit {
+
+constexpr uint64_t PacingWheel::kTickUS;
+constexpr uint64_t PacingWheel::kSlotCount;
+
+static mutex s_mtx;
+static unordered_map<EventPoller *, PacingWheel::Ptr> s_wheels;
+
+PacingWheel::Ptr PacingWheel::getInstance(const EventPoller::Ptr &poller) {
+    lock_guard<mutex> lck(s_mtx);
+    auto &ref = s_wheels[poller.get()];
+    if (!ref || ref->getPoller() != poller) {
+        // 同一地址上的poller可能已被销毁重建
+        // The poller at the same address may have been destroyed and recreated
+        ref.reset(new PacingWheel(poller));
+        registerMetrics(ref, poller->getThreadName());
+    }
+    return ref;
+}
+
+void PacingWheel::registerMetrics(const Ptr &wheel, const string &poller_name) {
+    std::weak_ptr<PacingWheel> weak_wheel = wheel;
+    auto add = [&](const char *name, const char *help, MetricsRegistry::Type type, uint64_t Statistic::*field) {
+        MetricsRegistry::Instance().addCallback(name, help, type, { { "poller", poller_name } }, [weak_wheel, field]() -> double {
+            auto strong_wheel = weak_wheel.lock();
+            return strong_wheel ? strong_wheel->getStatistic().*field : 0;
+        });
+    };
+    add("zltoolkit_pacing_wheel_entries", "Sockets waiting for send tokens", MetricsRegistry::Type::Gauge, &Statistic::entries);
+    add("zltoolkit_pacing_wheel_fired_total", "Paced sends released by the pacing wheel", MetricsRegistry::Type::Counter, &Statistic::fired);
+    add("zltoolkit_pacing_wheel_cost_us_total", "Time spent on pacing wheel ticks in microseconds", MetricsRegistry::Type::Counter, &Statistic::total_cost_us);
+}
+
+PacingWheel::PacingWheel(const EventPoller::Ptr &poller) {
+    _poller = poller;
+    _current_tick = getCurrentMicrosecond() / kTickUS;
+}
+
+PacingWheel::~PacingWheel() = default;
+
+void PacingWheel::schedule(const Entry::Ptr &entry, uint64_t delay_us) {
+    auto deadline = getCurrentMicrosecond() + delay_us;
+    if (entry->_scheduled && entry->_deadline_us <= deadline) {
+        return;
+    }
+    // 更早的预约使之前的槽位记录作废
+    // An earlier schedule invalidates the previous record
+    entry->_scheduled = true;
+    entry->_deadline_us = deadline;
+    ++entry->_seq;
+    insert(entry);
+    if (_ticking) {
+        return;
+    }
+    auto poller = _poller.lock();
+    if (!poller) {
+        return;
+    }
+    _ticking = true;
+    weak_ptr<PacingWheel> weak_self = shared_from_this();
+    poller->doDelayTask(1, [weak_self]() -> uint64_t {
+        auto strong_self = weak_self.lock();
+        return strong_self ? strong_self->onTick() : 0;
+    });
+}
+
+void PacingWheel::insert(const Entry::Ptr &entry) {
+    auto tick = std::max(entry->_deadline_us / kTickUS, _current_tick + 1);
+    _slots[tick % kSlotCount].emplace_back(Record { entry, entry->_seq });
+    ++_entries;
+}
+
+uint64_t PacingWheel::onTick() {
+    auto begin = chrono::steady_clock::now();
+    auto now = getCurrentMicrosecond();
+    auto target = now / kTickUS;
+    // 线程卡顿时补上错过的槽位，最多遍历一圈
+    // Catch up the missed slots when the thread stalls, at most one round
+    if (target - _current_tick > kSlotCount) {
+        _current_tick = target - kSlotCount;
+    }
+
+    vector<Record> slot;
+    while (_current_tick < target) {
+        ++_current_tick;
+        slot.clear();
+        slot.swap(_slots[_current_tick % kSlotCount]);
+        _entries -= slot.size();
+        for (auto &record : slot) {
+            auto entry = record.entry.lock();
+            if (!entry || !entry->_scheduled || entry->_seq != record.seq) {
+                continue;
+            }
+            if (entry->_deadline_us / kTickUS > _current_tick) {
+                // 超出一圈跨度，挂到下一圈
+                // Beyond one round, move it to the next round
+                insert(entry);
+                continue;
+            }
+            entry->_scheduled = false;
+            ++_fired;
+            try {
+                entry->_task();
+            } catch (std::exception &ex) {
+                ErrorL << "Exception occurred when do pacing wheel task: " << ex.what();
+            }
+        }
+    }
+    // 把内存还给刚处理完的槽位，避免下一圈重新分配
+    // Give the memory back to the slot just processed, avoiding reallocation in the next round
+    slot.clear();
+    if (_slots[_current_tick % kSlotCount].empty()) {
+        _slots[_current_tick % kSlotCount].swap(slot);
+    }
+
+    ++_ticks;
+    _total_cost_us += (uint64_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count();
+    if (!_entries) {
+        // 没有预约时停止tick，下次预约时再启动
+        // Stop ticking when nothing is scheduled, restart on the next schedule
+        _ticking = false;
+        return 0;
+    }
+    return 1;
+}
+
+PacingWheel::Statistic PacingWheel::getStatistic() const {
+    Statistic ret;
+    ret.entries = _entries;
+    ret.ticks = _ticks;
+    ret.fired = _fired;
+    ret.total_cost_us = _total_cost_us;
+    return ret;
+}
+
+}  // namespace toolkit
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PacingWheel_h
+#define PacingWheel_h
+
+#include <atomic>
+#include <vector>
+#include <functional>
+#include "EventPoller.h"
+
+namespace toolkit {
+
+/**
+ * 每个poller一个的毫秒级时间轮，用于按令牌桶的节奏释放socket的发送缓存
+ * 与TimingWheel不同，定时器为一次性且由使用者反复预约，预约不分配内存；
+ * 已预约的定时器再次预约更早的时间时，旧的槽位记录按序号作废
+ * Millisecond timing wheel, one per poller, used to release the send buffers of sockets at the pace of token buckets
+ * Unlike TimingWheel, timers are one-shot and repeatedly scheduled by the user, scheduling does not allocate memory;
+ * when a scheduled timer is scheduled again to an earlier time, the record in the old slot is invalidated by sequence number
+ */
+class PacingWheel : public std::enable_shared_from_this<PacingWheel> {
+public:
+    using Ptr = std::shared_ptr<PacingWheel>;
+
+    /**
+     * 定时器，由使用者持有，释放后不再触发；时间轮只持有其弱引用，只能在poller线程使用
+     * Timer entry held by the user, it no longer fires after being released; the wheel only holds a weak reference,
+     * it can only be used in the poller thread
+     */
+    class Entry {
+    public:
+        using Ptr = std::shared_ptr<Entry>;
+
+        Entry(std::function<void()> task) : _task(std::move(task)) {}
+
+        bool scheduled() const { return _scheduled; }
+
+    private:
+        friend class PacingWheel;
+        bool _scheduled = false;
+        uint64_t _seq = 0;
+        uint64_t _deadline_us = 0;
+        std::function<void()> _task;
+    };
+
+    struct Statistic {
+        // 已预约的定时器个数，包括作废但尚未回收的记录
+        // Scheduled timers, including invalidated records not yet collected
+        uint64_t entries = 0;
+        uint64_t ticks = 0;
+        uint64_t fired = 0;
+        uint64_t total_cost_us = 0;
+    };
+
+    ~PacingWheel();
+
+    /**
+     * 获取poller对应的时间轮，不存在则创建
+     * Get the wheel of the poller, create it if it does not exist
+     */
+    static Ptr getInstance(const EventPoller::Ptr &poller);
+
+    /**
+     * 预约定时器，必须在poller线程调用；已预约且到期时间更早则忽略
+     * @param delay_us 延时，单位微秒，按毫秒精度到期
+     * Schedule a timer, must be called in the poller thread; ignored if already scheduled with an earlier deadline
+     * @param delay_us Delay in microseconds, due with millisecond precision
+     */
+    void schedule(const Entry::Ptr &entry, uint64_t delay_us);
+
+    Statistic getStatistic() const;
+
+    EventPoller::Ptr getPoller() const { return _poller.lock(); }
+
+private:
+    PacingWheel(const EventPoller::Ptr &poller);
+
+    static void registerMetrics(const Ptr &wheel, const std::string &poller_name);
+    void insert(const Entry::Ptr &entry);
+    uint64_t onTick();
+
+private:
+    // 时间轮精度与槽位数，一圈跨度约1秒
+    // Wheel precision and slot count, one round spans about 1 second
+    static constexpr uint64_t kTickUS = 1000;
+    static constexpr uint64_t kSlotCount = 1024;
+
+    struct Record {
+        std::weak_ptr<Entry> entry;
+        uint64_t seq;
+    };
+
+    bool _ticking = false;
+    uint64_t _current_tick;
+    std::weak_ptr<EventPoller> _poller;
+    std::vector<Record> _slots[kSlotCount];
+
+    std::atomic<uint64_t> _entries { 0 };
+    std::atomic<uint64_t> _ticks { 0 };
+    std::atomic<uint64_t> _fired { 0 };
+    std::atomic<uint64_t> _total_cost_us { 0 };
+};
+
+}  // namespace toolkit
+#endif /* PacingWheel_h */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "PollerMetrics.h"
+#include "Util/uv_errno.h"
+
+using namespace std;
+
+namespace toolkit {
+
+static thread_local PollerMetrics *s_current = nullptr;
+
+PollerMetrics::PollerMetrics(const string &poller_name) {
+    // 提前校准时钟频率，避免在poller线程中忙等
+    // Calibrate the clock frequency in advance to avoid busy waiting in the poller thread
+    CycleClock::ticksPerUS();
+    auto &registry = MetricsRegistry::Instance();
+    MetricsRegistry::Labels poller { { "poller", poller_name } };
+    auto with = [&](const char *key, const char *value) {
+        auto ret = poller;
+        ret.emplace_back(key, value);
+        return ret;
+    };
+    static const string syscalls_help = "Socket read and write syscalls";
+    static const string bytes_help = "Socket bytes read and written";
+    static const string packets_help = "Socket packets read and written";
+    static const string eagain_help = "Socket syscalls returning EAGAIN";
+    static const string cost_help = "Cost of poller callbacks in microseconds";
+    recv_syscalls = registry.counter("zltoolkit_socket_syscalls_total", syscalls_help, with("op", "recv"));
+    send_syscalls = registry.counter("zltoolkit_socket_syscalls_total", syscalls_help, with("op", "send"));
+    recv_bytes = registry.counter("zltoolkit_socket_bytes_total", bytes_help, with("dir", "recv"));
+    send_bytes = registry.counter("zltoolkit_socket_bytes_total", bytes_help, with("dir", "send"));
+    recv_packets = registry.counter("zltoolkit_socket_packets_total", packets_help, with("dir", "recv"));
+    send_packets = registry.counter("zltoolkit_socket_packets_total", packets_help, with("dir", "send"));
+    recv_eagain = registry.counter("zltoolkit_socket_eagain_total", eagain_help, with("dir", "recv"));
+    send_eagain = registry.counter("zltoolkit_socket_eagain_total", eagain_help, with("dir", "send"));
+    send_dropped_packets = registry.counter("zltoolkit_socket_send_dropped_packets_total", "Packets dropped from congested send queues", poller);
+    send_dropped_bytes = registry.counter("zltoolkit_socket_send_dropped_bytes_total", "Bytes dropped from congested send queues", poller);
+    send_queue_depth = registry.histogram("zltoolkit_socket_send_queue_depth", "Packets waiting in the send queue when it is flushed", poller);
+    recv_event_bytes = registry.histogram("zltoolkit_socket_recv_event_bytes", "Bytes read by a socket in one read event", poller);
+    recv_yields = registry.counter("zltoolkit_socket_recv_yields_total", "Read events that yielded with data left because the read budget ran out", poller);
+    pending_events = registry.histogram("zltoolkit_poller_pending_events", "Pending events at the start of each round of the event loop", poller);
+    task_queue = registry.gauge("zltoolkit_poller_task_queue", "Async tasks waiting in the poller", poller);
+    timer_lag_ms = registry.histogram("zltoolkit_poller_timer_lag_ms", "Delay between the deadline and the execution of timers in milliseconds", poller);
+    event_cost_us = registry.histogram("zltoolkit_poller_callback_us", cost_help, with("kind", "event"));
+    task_cost_us = registry.histogram("zltoolkit_poller_callback_us", cost_help, with("kind", "task"));
+    timer_cost_us = registry.histogram("zltoolkit_poller_callback_us", cost_help, with("kind", "timer"));
+}
+
+PollerMetrics &PollerMetrics::current() {
+    if (s_current) {
+        return *s_current;
+    }
+    static PollerMetrics s_other("other");
+    return s_other;
+}
+
+void PollerMetrics::setCurrent(PollerMetrics *metrics) {
+    s_current = metrics;
+}
+
+void PollerMetrics::onRecvSyscall(ssize_t ret, size_t packets) {
+    recv_syscalls->add();
+    if (ret > 0) {
+        recv_bytes->add(ret);
+        recv_packets->add(packets);
+    } else if (ret == -1 && get_uv_error(true) == UV_EAGAIN) {
+        recv_eagain->add();
+    }
+}
+
+void PollerMetrics::onSendSyscall(ssize_t ret) {
+    send_syscalls->add();
+    if (ret > 0) {
+        send_bytes->add(ret);
+    } else if (ret == -1 && get_uv_error(true) == UV_EAGAIN) {
+        send_eagain->add();
+    }
+}
+
+} // namespace toolkit
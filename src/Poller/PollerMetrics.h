@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PollerMetrics_h
+#define PollerMetrics_h
+
+#include <string>
+#include "Util/Metrics.h"
+#include "Util/CycleClock.h"
+
+namespace toolkit {
+
+/**
+ * 单个poller线程的指标，以poller标签注册到MetricsRegistry
+ * 包括socket读写系统调用、字节数、包数、EAGAIN次数、发送列队深度，以及任务列队深度、定时器延迟与各类回调耗时
+ * Metrics of a poller thread, registered to MetricsRegistry with the poller label
+ * Including socket read/write syscalls, bytes, packets, EAGAIN count, send queue depth,
+ * and task queue depth, timer lag and the cost of all kinds of callbacks
+ */
+class PollerMetrics {
+public:
+    using Ptr = std::shared_ptr<PollerMetrics>;
+
+    PollerMetrics(const std::string &poller_name);
+
+    /**
+     * 获取当前线程所属poller的指标，非poller线程返回poller标签为other的共享实例
+     * Get the metrics of the poller the current thread belongs to, a shared instance labeled other is returned for non-poller threads
+     */
+    static PollerMetrics &current();
+    static void setCurrent(PollerMetrics *metrics);
+
+    /**
+     * 记录一次读系统调用
+     * @param ret 系统调用返回值，-1为失败
+     * @param packets 本次读到的包数
+     * Record a read syscall
+     * @param ret Return value of the syscall, -1 for failure
+     * @param packets Packets read this time
+     */
+    void onRecvSyscall(ssize_t ret, size_t packets);
+
+    /**
+     * 记录一次写系统调用
+     * @param ret 系统调用返回值，-1为失败
+     * Record a write syscall
+     * @param ret Return value of the syscall, -1 for failure
+     */
+    void onSendSyscall(ssize_t ret);
+
+public:
+    MetricsCounter::Ptr recv_syscalls;
+    MetricsCounter::Ptr recv_bytes;
+    MetricsCounter::Ptr recv_packets;
+    MetricsCounter::Ptr recv_eagain;
+    MetricsCounter::Ptr send_syscalls;
+    MetricsCounter::Ptr send_bytes;
+    MetricsCounter::Ptr send_packets;
+    MetricsCounter::Ptr send_eagain;
+    // 发送拥塞时按丢弃策略丢弃的包数与字节数
+    // Packets and bytes dropped by the drop policy when sending is congested
+    MetricsCounter::Ptr send_dropped_packets;
+    MetricsCounter::Ptr send_dropped_bytes;
+    // 每次刷新发送缓存时一级缓存中的包数
+    // Packets in the first level cache every time the send cache is flushed
+    MetricsHistogram::Ptr send_queue_depth;
+    // 读取公平性：每次读事件读到的字节数，与读取额度用尽而让出本轮的次数
+    // Read fairness: bytes read in each read event, and times the read budget ran out and the round was yielded
+    MetricsHistogram::Ptr recv_event_bytes;
+    MetricsCounter::Ptr recv_yields;
+    // 每轮事件循环开始时的推迟事件个数
+    // Pending events at the start of each round of the event loop
+    MetricsHistogram::Ptr pending_events;
+    MetricsGauge::Ptr task_queue;
+    MetricsHistogram::Ptr timer_lag_ms;
+    MetricsHistogram::Ptr event_cost_us;
+    MetricsHistogram::Ptr task_cost_us;
+    MetricsHistogram::Ptr timer_cost_us;
+};
+
+/**
+ * 作用域耗时统计，单位微秒，指标关闭时不读取时钟
+ * Scoped cost statistic in microseconds, the clock is not read when metrics are disabled
+ */
+class ScopedCost {
+public:
+    ScopedCost(MetricsHistogram &histogram) {
+        if (MetricsRegistry::enabled()) {
+            _histogram = &histogram;
+            _begin = CycleClock::now();
+        }
+    }
+
+    ~ScopedCost() {
+        if (_histogram) {
+            _histogram->record(CycleClock::toUS(CycleClock::now() - _begin));
+        }
+    }
+
+private:
+    MetricsHistogram *_histogram = nullptr;
+    uint64_t _begin;
+};
+
+} // namespace toolkit
+#endif /* PollerMetrics_h */
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include "PollerWatchdog.h"
+#include "EventPoller.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/Metrics.h"
+
+#if defined(__linux__) && defined(__GLIBC__)
+#include <unistd.h>
+#include <execinfo.h>
+#define HAS_BACKTRACE
+#endif
+
+using namespace std;
+
+namespace toolkit {
+
+PollerHeartbeat::Scope::Scope(PollerHeartbeat &heartbeat, const char *kind, uint64_t arg, const std::type_info *target) : _heartbeat(heartbeat) {
+    _kind = heartbeat._kind.load(memory_order_relaxed);
+    _arg = heartbeat._arg.load(memory_order_relaxed);
+    _target = heartbeat._target.load(memory_order_relaxed);
+    heartbeat.beat(kind, arg, target);
+}
+
+PollerHeartbeat::Scope::~Scope() {
+    _heartbeat.beat(_kind, _arg, _target);
+}
+
+void PollerHeartbeat::attachThread() {
+#if !defined(_WIN32)
+    _thread = pthread_self();
+#endif
+    _attached.store(true, memory_order_release);
+}
+
+void PollerHeartbeat::sleep() {
+    _stamp_ms.store(0, memory_order_relaxed);
+    _seq.store(_seq.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+void PollerHeartbeat::wakeUp() {
+    beat("loop", 0, nullptr);
+}
+
+void PollerHeartbeat::beat(const char *kind, uint64_t arg, const std::type_info *target) {
+    _kind.store(kind, memory_order_relaxed);
+    _arg.store(arg, memory_order_relaxed);
+    _target.store(target, memory_order_relaxed);
+    _stamp_ms.store(getCurrentMillisecond(), memory_order_relaxed);
+    _seq.store(_seq.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+#if defined(HAS_BACKTRACE)
+static constexpr int kMaxFrames = 64;
+static void *s_frames[kMaxFrames];
+static atomic<int> s_frame_count { -1 };
+
+static void onStackSignal(int) {
+    auto saved_errno = errno;
+    s_frame_count.store(backtrace(s_frames, kMaxFrames), memory_order_release);
+    errno = saved_errno;
+}
+#endif
+
+atomic<bool> PollerWatchdog::s_running { false };
+
+PollerWatchdog &PollerWatchdog::Instance() {
+    static PollerWatchdog s_instance;
+    return s_instance;
+}
+
+PollerWatchdog::~PollerWatchdog() {
+    stop();
+}
+
+void PollerWatchdog::start(uint64_t threshold_ms, int signal) {
+    stop();
+    lock_guard<mutex> lck(_mtx);
+    _threshold_ms = std::max<uint64_t>(threshold_ms, 10);
+    _signal = signal;
+#if defined(HAS_BACKTRACE)
+    if (_signal) {
+        // 预先调用一次，加载libgcc，避免在信号处理函数中分配内存
+        // Call it once in advance to load libgcc, to avoid allocating memory in the signal handler
+        void *frames[1];
+        backtrace(frames, 1);
+        struct sigaction action {};
+        action.sa_handler = onStackSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(_signal, &action, nullptr);
+    }
+#endif
+    _exit = false;
+    s_running = true;
+    _thread = std::thread([this]() { run(); });
+}
+
+void PollerWatchdog::stop() {
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (_exit) {
+            return;
+        }
+        _exit = true;
+        s_running = false;
+    }
+    _cond.notify_all();
+    _thread.join();
+}
+
+void PollerWatchdog::setOnStall(onStall cb) {
+    lock_guard<mutex> lck(_mtx);
+    _on_stall = std::move(cb);
+}
+
+void PollerWatchdog::addPoller(const std::shared_ptr<EventPoller> &poller, const PollerHeartbeat::Ptr &heartbeat) {
+    std::weak_ptr<PollerHeartbeat> weak_heartbeat = heartbeat;
+    MetricsRegistry::Instance().addCallback("zltoolkit_poller_blocked_ms", "Time the poller has been running the current callback in milliseconds",
+                                            MetricsRegistry::Type::Gauge, { { "poller", poller->getThreadName() } }, [weak_heartbeat]() -> double {
+        auto strong_heartbeat = weak_heartbeat.lock();
+        if (!strong_heartbeat) {
+            return 0;
+        }
+        auto stamp = strong_heartbeat->_stamp_ms.load(memory_order_relaxed);
+        auto now = getCurrentMillisecond();
+        return stamp && now > stamp ? now - stamp : 0;
+    });
+
+    lock_guard<mutex> lck(_mtx);
+    _pollers.erase(std::remove_if(_pollers.begin(), _pollers.end(), [&](const Watched &watched) {
+        return watched.poller.expired() || watched.heartbeat == heartbeat;
+    }), _pollers.end());
+    Watched watched;
+    watched.poller = poller;
+    watched.heartbeat = heartbeat;
+    watched.name = poller->getThreadName();
+    _pollers.emplace_back(std::move(watched));
+}
+
+void PollerWatchdog::run() {
+    setThreadName("poller watchdog");
+    unique_lock<mutex> lck(_mtx);
+    while (!_exit) {
+        _cond.wait_for(lck, chrono::milliseconds(std::min<uint64_t>(_threshold_ms / 4 + 1, 100)));
+        if (_exit) {
+            break;
+        }
+        auto now = getCurrentMillisecond();
+        auto pollers = _pollers;
+        lck.unlock();
+        for (auto &watched : pollers) {
+            check(watched, now);
+        }
+        lck.lock();
+        // 保存已报告的序号
+        // Save the reported sequence numbers
+        for (auto &watched : _pollers) {
+            for (auto &checked : pollers) {
+                if (checked.heartbeat == watched.heartbeat) {
+                    watched.reported_seq = checked.reported_seq;
+                }
+            }
+        }
+    }
+}
+
+void PollerWatchdog::check(Watched &watched, uint64_t now) {
+    auto &heartbeat = *watched.heartbeat;
+    auto seq = heartbeat._seq.load(memory_order_acquire);
+    auto stamp = heartbeat._stamp_ms.load(memory_order_relaxed);
+    if (!stamp || now < stamp + _threshold_ms || seq == watched.reported_seq || !heartbeat._attached.load(memory_order_acquire)) {
+        return;
+    }
+    // 抓取调用栈期间保持poller线程存活
+    // Keep the poller thread alive while capturing the stack
+    auto poller = watched.poller.lock();
+    if (!poller) {
+        return;
+    }
+    StallInfo info;
+    auto kind = heartbeat._kind.load(memory_order_relaxed);
+    auto target = heartbeat._target.load(memory_order_relaxed);
+    info.kind = kind ? kind : "";
+    info.arg = heartbeat._arg.load(memory_order_relaxed);
+    info.target = target ? demangle(target->name()) : "";
+    info.stack = captureStack(heartbeat);
+    if (heartbeat._seq.load(memory_order_acquire) != seq) {
+        // 抓取期间回调已经结束，下次再检查
+        // The callback ended while capturing, check again next time
+        return;
+    }
+    watched.reported_seq = seq;
+    info.poller = watched.name;
+    info.elapsed_ms = now - stamp;
+
+    MetricsRegistry::Instance().counter("zltoolkit_poller_stalls_total", "Times the poller was stuck in a callback longer than the watchdog threshold",
+                                        { { "poller", info.poller } })->add();
+    _StrPrinter printer;
+    printer << "Poller " << info.poller << " stalled for " << info.elapsed_ms << "ms in " << info.kind;
+    if (info.arg) {
+        printer << "(" << info.arg << ")";
+    }
+    if (!info.target.empty()) {
+        printer << ", target: " << info.target;
+    }
+    for (auto &frame : info.stack) {
+        printer << "\n    " << frame;
+    }
+    ErrorL << printer;
+
+    onStall cb;
+    {
+        lock_guard<mutex> lck(_mtx);
+        cb = _on_stall;
+    }
+    if (cb) {
+        cb(info);
+    }
+}
+
+vector<string> PollerWatchdog::captureStack(PollerHeartbeat &heartbeat) {
+    vector<string> ret;
+#if defined(HAS_BACKTRACE)
+    if (!_signal) {
+        return ret;
+    }
+    s_frame_count.store(-1, memory_order_relaxed);
+    if (pthread_kill(heartbeat._thread, _signal) != 0) {
+        return ret;
+    }
+    int count = -1;
+    for (int i = 0; i < 100 && (count = s_frame_count.load(memory_order_acquire)) < 0; ++i) {
+        usleep(1000);
+    }
+    if (count <= 0) {
+        return ret;
+    }
+    auto symbols = backtrace_symbols(s_frames, count);
+    if (!symbols) {
+        return ret;
+    }
+    // 跳过信号处理函数本身以及信号跳板
+    // Skip the signal handler itself and the signal trampoline
+    for (int i = std::min(count, 2); i < count; ++i) {
+        // 格式为 module(symbol+offset) [address]，还原其中的c++符号
+        // The format is module(symbol+offset) [address], demangle the c++ symbol in it
+        string line = symbols[i];
+        auto begin = line.find('(');
+        auto end = line.find('+', begin);
+        if (begin != string::npos && end != string::npos && end > begin + 1) {
+            line = line.substr(0, begin + 1) + demangle(line.substr(begin + 1, end - begin - 1).data()) + line.substr(end);
+        }
+        ret.emplace_back(std::move(line));
+    }
+    free(symbols);
+#endif
+    return ret;
+}
+
+} // namespace toolkit
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef PollerWatchdog_h
+#define PollerWatchdog_h
+
+#include <csignal>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <typeinfo>
+#include <functional>
+#include <condition_variable>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+namespace toolkit {
+
+class EventPoller;
+
+/**
+ * poller线程的心跳，每次开始或结束一个回调时递增序号并刷新时间戳，同时记录当前回调的身份；
+ * 只有poller线程写入，看门狗线程读取
+ * Heartbeat of a poller thread, the sequence number is increased and the timestamp is refreshed every time a callback
+ * begins or ends, and the identity of the current callback is recorded; only written by the poller thread and read by the watchdog thread
+ */
+class PollerHeartbeat {
+public:
+    using Ptr = std::shared_ptr<PollerHeartbeat>;
+
+    /**
+     * 回调作用域，析构时恢复外层回调的身份，比如管道事件中执行的异步任务
+     * Callback scope, the identity of the outer callback is restored on destruction, such as async tasks executed in the pipe event
+     */
+    class Scope {
+    public:
+        Scope(PollerHeartbeat &heartbeat, const char *kind, uint64_t arg, const std::type_info *target = nullptr);
+        ~Scope();
+
+    private:
+        PollerHeartbeat &_heartbeat;
+        const char *_kind;
+        uint64_t _arg;
+        const std::type_info *_target;
+    };
+
+    /**
+     * 在poller线程中调用，记录线程句柄
+     * Called in the poller thread, record the thread handle
+     */
+    void attachThread();
+
+    /**
+     * 进入或退出poll等待，等待期间不算卡顿
+     * Enter or leave the poll wait, it is not regarded as a stall while waiting
+     */
+    void sleep();
+    void wakeUp();
+
+    void beat(const char *kind, uint64_t arg, const std::type_info *target);
+
+private:
+    friend class PollerWatchdog;
+
+    std::atomic<uint64_t> _seq { 0 };
+    // 最近一次心跳的时间，0表示正在poll等待
+    // Time of the last beat, 0 means waiting in poll
+    std::atomic<uint64_t> _stamp_ms { 0 };
+    std::atomic<const char *> _kind { nullptr };
+    std::atomic<uint64_t> _arg { 0 };
+    std::atomic<const std::type_info *> _target { nullptr };
+#if !defined(_WIN32)
+    pthread_t _thread {};
+#endif
+    std::atomic<bool> _attached { false };
+};
+
+/**
+ * poller卡顿看门狗
+ * 后台线程定时检查各poller的心跳，某个回调执行超过阈值时，
+ * 通过信号抓取卡住线程的调用栈，连同当前回调的身份输出到日志并计入指标
+ * Poller stall watchdog
+ * A background thread checks the heartbeats of the pollers periodically, when a callback runs longer than the threshold,
+ * the stack of the stuck thread is captured via a signal, and reported with the identity of the current callback to the log and the metrics
+ */
+class PollerWatchdog {
+public:
+    struct StallInfo {
+        std::string poller;
+        uint64_t elapsed_ms;
+        // 回调类型(event/task/timer)及参数(比如fd)
+        // Callback kind (event/task/timer) and argument (such as the fd)
+        std::string kind;
+        uint64_t arg;
+        // 回调函数对象的类型名，可以定位到创建任务的代码
+        // Type name of the callback function object, which locates the code creating the task
+        std::string target;
+        std::vector<std::string> stack;
+    };
+
+    using onStall = std::function<void(const StallInfo &info)>;
+
+    static PollerWatchdog &Instance();
+    ~PollerWatchdog();
+
+    /**
+     * 看门狗是否在运行，未运行时poller不获取回调的类型名
+     * Whether the watchdog is running, the pollers do not fetch the type of callbacks when it is not
+     */
+    static bool running() { return s_running.load(std::memory_order_relaxed); }
+
+    /**
+     * 启动看门狗
+     * @param threshold_ms 回调执行超过该时长视为卡顿
+     * @param signal 抓取调用栈使用的信号，0则不抓取
+     * Start the watchdog
+     * @param threshold_ms A callback running longer than this is regarded as a stall
+     * @param signal Signal used to capture the stack, 0 to disable capturing
+     */
+    void start(uint64_t threshold_ms = 500, int signal = kDefaultSignal);
+    void stop();
+
+    /**
+     * 设置额外的卡顿回调，在看门狗线程中执行
+     * Set an extra stall callback, executed in the watchdog thread
+     */
+    void setOnStall(onStall cb);
+
+    /**
+     * poller启动时注册
+     * Registered when a poller starts
+     */
+    void addPoller(const std::shared_ptr<EventPoller> &poller, const PollerHeartbeat::Ptr &heartbeat);
+
+#if defined(_WIN32)
+    static constexpr int kDefaultSignal = 0;
+#else
+    static constexpr int kDefaultSignal = SIGUSR2;
+#endif
+
+private:
+    PollerWatchdog() = default;
+
+    struct Watched {
+        std::weak_ptr<EventPoller> poller;
+        PollerHeartbeat::Ptr heartbeat;
+        std::string name;
+        // 已报告过的心跳序号，同一次卡顿只报告一次
+        // Sequence number already reported, a stall is reported only once
+        uint64_t reported_seq = ~0ULL;
+    };
+
+    void run();
+    void check(Watched &watched, uint64_t now);
+    std::vector<std::string> captureStack(PollerHeartbeat &heartbeat);
+
+private:
+    static std::atomic<bool> s_running;
+
+    bool _exit = true;
+    uint64_t _threshold_ms = 500;
+    int _signal = 0;
+    std::mutex _mtx;
+    std::condition_variable _cond;
+    std::vector<Watched> _pollers;
+    onStall _on_stall;
+    std::thread _thread;
+};
+
+} // namespace toolkit
+#endif /* PollerWatchdog_h */
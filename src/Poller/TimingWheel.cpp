@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include "TimingWheel.h"
+#include "Util/logger.h"
+#include "Util/Metrics.h"
+
+using namespace std;
+
+namespace toolkit {
+
+static mutex s_mtx;
+static unordered_map<EventPoller *, TimingWheel::Ptr> s_wheels;
+
+TimingWheel::Ptr TimingWheel::getInstance(const EventPoller::Ptr &poller) {
+    lock_guard<mutex> lck(s_mtx);
+    auto &ref = s_wheels[poller.get()];
+    if (!ref || ref->getPoller() != poller) {
+        // 同一地址上的poller可能已被销毁重建
+        // The poller at the same address may have been destroyed and recreated
+        ref.reset(new TimingWheel(poller));
+        registerMetrics(ref, poller->getThreadName());
+    }
+    return ref;
+}
+
+void TimingWheel::registerMetrics(const Ptr &wheel, const string &poller_name) {
+    std::weak_ptr<TimingWheel> weak_wheel = wheel;
+    auto add = [&](const char *name, const char *help, MetricsRegistry::Type type, uint64_t Statistic::*field) {
+        MetricsRegistry::Instance().addCallback(name, help, type, { { "poller", poller_name } }, [weak_wheel, field]() -> double {
+            auto strong_wheel = weak_wheel.lock();
+            return strong_wheel ? strong_wheel->getStatistic().*field : 0;
+        });
+    };
+    add("zltoolkit_timing_wheel_entries", "Timers attached to the timing wheel", MetricsRegistry::Type::Gauge, &Statistic::entries);
+    add("zltoolkit_timing_wheel_visited_total", "Timers visited when their slot is due", MetricsRegistry::Type::Counter, &Statistic::visited);
+    add("zltoolkit_timing_wheel_fired_total", "Timers executed by the timing wheel", MetricsRegistry::Type::Counter, &Statistic::fired);
+    add("zltoolkit_timing_wheel_cost_us_total", "Time spent on timing wheel ticks in microseconds", MetricsRegistry::Type::Counter, &Statistic::total_cost_us);
+    // 采集时重置最大值，得到两次采集之间的最大耗时
+    // Reset the max value when scraped, to get the max cost between two scrapes
+    MetricsRegistry::Instance().addCallback("zltoolkit_timing_wheel_max_tick_us", "Max cost of a timing wheel tick since the last scrape in microseconds",
+                                            MetricsRegistry::Type::Gauge, { { "poller", poller_name } }, [weak_wheel]() -> double {
+        auto strong_wheel = weak_wheel.lock();
+        return strong_wheel ? strong_wheel->getStatistic(true).max_cost_us : 0;
+    });
+}
+
+void TimingWheel::for_each(const function<void(const Ptr &wheel)> &cb) {
+    vector<Ptr> wheels;
+    {
+        lock_guard<mutex> lck(s_mtx);
+        for (auto &pr : s_wheels) {
+            wheels.emplace_back(pr.second);
+        }
+    }
+    for (auto &wheel : wheels) {
+        cb(wheel);
+    }
+}
+
+TimingWheel::TimingWheel(const EventPoller::Ptr &poller) {
+    _poller = poller;
+    _current_tick = getCurrentMillisecond() / kTickMS;
+}
+
+TimingWheel::~TimingWheel() = default;
+
+TimingWheel::Entry::Ptr TimingWheel::add(uint64_t delay_ms, function<uint64_t()> task) {
+    auto entry = std::make_shared<Entry>(getCurrentMillisecond() + delay_ms, std::move(task));
+    insert(entry);
+    if (!_ticking) {
+        auto poller = _poller.lock();
+        if (poller) {
+            _ticking = true;
+            weak_ptr<TimingWheel> weak_self = shared_from_this();
+            poller->doDelayTask(kTickMS, [weak_self]() -> uint64_t {
+                auto strong_self = weak_self.lock();
+                return strong_self ? strong_self->onTick() : 0;
+            });
+        }
+    }
+    return entry;
+}
+
+void TimingWheel::insert(const Entry::Ptr &entry) {
+    // 超出一圈跨度的定时器按到期时间散列到槽位上，每圈被访问一次直至到期
+    // Timers beyond one round are hashed to slots by their deadline, and visited once per round until due
+    auto tick = std::max(entry->_deadline / kTickMS, _current_tick + 1);
+    _slots[tick % kSlotCount].emplace_back(entry);
+    ++_entries;
+}
+
+uint64_t TimingWheel::onTick() {
+    auto begin = chrono::steady_clock::now();
+    auto now = getCurrentMillisecond();
+    auto target = now / kTickMS;
+    // 线程卡顿时补上错过的槽位，最多遍历一圈
+    // Catch up the missed slots when the thread stalls, at most one round
+    if (target - _current_tick > kSlotCount) {
+        _current_tick = target - kSlotCount;
+    }
+
+    uint64_t visited = 0;
+    vector<weak_ptr<Entry>> slot;
+    while (_current_tick < target) {
+        ++_current_tick;
+        slot.clear();
+        slot.swap(_slots[_current_tick % kSlotCount]);
+        _entries -= slot.size();
+        visited += slot.size();
+        for (auto &weak_entry : slot) {
+            auto entry = weak_entry.lock();
+            if (!entry || entry->_canceled) {
+                continue;
+            }
+            if (entry->_deadline > now) {
+                // 到期时间已被推迟，挂到新的槽位
+                // The deadline has been postponed, move it to a new slot
+                insert(entry);
+                ++_rearmed;
+                continue;
+            }
+            ++_fired;
+            uint64_t next = 0;
+            try {
+                next = entry->_task();
+            } catch (std::exception &ex) {
+                ErrorL << "Exception occurred when do timing wheel task: " << ex.what();
+            }
+            if (next && !entry->_canceled) {
+                // 按原到期时间递推，保持各定时器的相位分散，避免补偿tick后聚集到同一槽位
+                // Advance from the original deadline to keep the timers spread, so that they do not gather in one slot after a catch-up tick
+                entry->_deadline += next;
+                if (entry->_deadline <= now) {
+                    entry->_deadline = now + next;
+                }
+                insert(entry);
+            }
+        }
+    }
+
+    auto cost = (uint64_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count();
+    ++_ticks;
+    _visited += visited;
+    _last_cost_us = cost;
+    _total_cost_us += cost;
+    if (cost > _max_cost_us) {
+        _max_cost_us = cost;
+    }
+    if (visited > _max_visited) {
+        _max_visited = visited;
+    }
+    if (!_entries) {
+        // 没有定时器时停止tick，下次添加时再启动
+        // Stop ticking when there is no timer, restart on the next add
+        _ticking = false;
+        return 0;
+    }
+    // 对齐到下一个tick边界
+    // Align to the next tick boundary
+    return (_current_tick + 1) * kTickMS - now;
+}
+
+TimingWheel::Statistic TimingWheel::getStatistic(bool reset_max) {
+    Statistic ret;
+    ret.entries = _entries;
+    ret.ticks = _ticks;
+    ret.visited = _visited;
+    ret.fired = _fired;
+    ret.rearmed = _rearmed;
+    ret.max_visited_per_tick = reset_max ? _max_visited.exchange(0) : _max_visited.load();
+    ret.last_cost_us = _last_cost_us;
+    ret.max_cost_us = reset_max ? _max_cost_us.exchange(0) : _max_cost_us.load();
+    ret.total_cost_us = _total_cost_us;
+    return ret;
+}
+
+}  // namespace toolkit
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TimingWheel_h
+#define TimingWheel_h
+
+#include <atomic>
+#include <vector>
+#include <functional>
+#include "EventPoller.h"
+#include "Util/util.h"
+
+namespace toolkit {
+
+/**
+ * 每个poller一个的哈希时间轮，用于管理大量会话的超时
+ * 推迟到期时间(如收到数据)只修改时间戳，不操作时间轮；
+ * 槽位到期时才检查真实到期时间，未到期则惰性挂到新的槽位，因此每次tick只访问该槽位上的定时器
+ * Hashed timing wheel, one per poller, used to manage the timeouts of lots of sessions
+ * Postponing the deadline (such as when data is received) only modifies a timestamp without touching the wheel;
+ * the real deadline is only checked when the slot is due, entries not yet due are lazily moved to a new slot,
+ * so each tick only visits the entries in that slot
+ */
+class TimingWheel : public std::enable_shared_from_this<TimingWheel> {
+public:
+    using Ptr = std::shared_ptr<TimingWheel>;
+
+    /**
+     * 定时器，由使用者持有，释放或cancel后不再触发；时间轮只持有其弱引用
+     * 除cancel外的方法都只能在poller线程调用
+     * Timer entry held by the user, it no longer fires after being released or cancelled; the wheel only holds a weak reference
+     * Methods other than cancel can only be called in the poller thread
+     */
+    class Entry {
+    public:
+        using Ptr = std::shared_ptr<Entry>;
+
+        Entry(uint64_t deadline, std::function<uint64_t()> task) : _deadline(deadline), _task(std::move(task)) {}
+
+        /**
+         * 把到期时间推迟到delay_ms毫秒后
+         * Postpone the deadline to delay_ms milliseconds later
+         */
+        void delay(uint64_t delay_ms) { _deadline = getCurrentMillisecond() + delay_ms; }
+
+        void cancel() { _canceled = true; }
+
+        uint64_t deadline() const { return _deadline; }
+
+    private:
+        friend class TimingWheel;
+        std::atomic<bool> _canceled { false };
+        uint64_t _deadline;
+        std::function<uint64_t()> _task;
+    };
+
+    /**
+     * 时间轮的统计数据，即超时扫描的开销
+     * Statistics of the wheel, that is, the cost of timeout scanning
+     */
+    struct Statistic {
+        // 挂在时间轮上的定时器个数，包括已释放但尚未回收的
+        // Timers attached to the wheel, including released ones not yet collected
+        uint64_t entries = 0;
+        uint64_t ticks = 0;
+        // 槽位到期时访问的定时器个数
+        // Timers visited when their slot is due
+        uint64_t visited = 0;
+        // 真正到期并执行的定时器个数
+        // Timers that were really due and executed
+        uint64_t fired = 0;
+        // 因到期时间被推迟而重新挂载的定时器个数
+        // Timers moved to a new slot because their deadline was postponed
+        uint64_t rearmed = 0;
+        uint64_t max_visited_per_tick = 0;
+        uint64_t last_cost_us = 0;
+        uint64_t max_cost_us = 0;
+        uint64_t total_cost_us = 0;
+    };
+
+    ~TimingWheel();
+
+    /**
+     * 获取poller对应的时间轮，不存在则创建
+     * Get the wheel of the poller, create it if it does not exist
+     */
+    static Ptr getInstance(const EventPoller::Ptr &poller);
+
+    /**
+     * 遍历所有poller的时间轮
+     * Iterate the wheels of all pollers
+     */
+    static void for_each(const std::function<void(const Ptr &wheel)> &cb);
+
+    /**
+     * 添加定时器，必须在poller线程调用
+     * @param delay_ms 首次到期的延时
+     * @param task 到期任务，返回下次到期的延时，返回0则不再重复
+     * Add a timer, must be called in the poller thread
+     * @param delay_ms Delay of the first deadline
+     * @param task The task when due, returns the delay of the next deadline, 0 means no more repetition
+     */
+    Entry::Ptr add(uint64_t delay_ms, std::function<uint64_t()> task);
+
+    /**
+     * 获取统计数据
+     * @param reset_max 是否在读取后重置各最大值，便于按采集周期统计
+     * Get the statistics
+     * @param reset_max Whether to reset the max values after reading, convenient for per-scrape statistics
+     */
+    Statistic getStatistic(bool reset_max = false);
+
+    EventPoller::Ptr getPoller() const { return _poller.lock(); }
+
+private:
+    TimingWheel(const EventPoller::Ptr &poller);
+
+    static void registerMetrics(const Ptr &wheel, const std::string &poller_name);
+    void insert(const Entry::Ptr &entry);
+    uint64_t onTick();
+
+private:
+    // 时间轮精度与槽位数，一圈跨度约16秒
+    // Wheel precision and slot count, one round spans about 16 seconds
+    static constexpr uint64_t kTickMS = 32;
+    static constexpr uint64_t kSlotCount = 512;
+
+    bool _ticking = false;
+    uint64_t _current_tick;
+    std::weak_ptr<EventPoller> _poller;
+    std::vector<std::weak_ptr<Entry>> _slots[kSlotCount];
+
+    std::atomic<uint64_t> _entries { 0 };
+    std::atomic<uint64_t> _ticks { 0 };
+    std::atomic<uint64_t> _visited { 0 };
+    std::atomic<uint64_t> _fired { 0 };
+    std::atomic<uint64_t> _rearmed { 0 };
+    std::atomic<uint64_t> _max_visited { 0 };
+    std::atomic<uint64_t> _last_cost_us { 0 };
+    std::atomic<uint64_t> _max_cost_us { 0 };
+    std::atomic<uint64_t> _total_cost_us { 0 };
+};
+
+}  // namespace toolkit
+#endif /* TimingWheel_h */
@@ -13,6 +13,7 @@
 
 #include <mutex>
 #include <memory>
+#include <typeinfo>
 #include <functional>
 #include "Util/List.h"
 #include "Util/util.h"
@@ -123,6 +124,15 @@ public:
         _strongTask = nullptr;
     }
 
+    /**
+     * 任务函数对象的类型，可用于定位创建任务的代码
+     * Type of the task function object, which can be used to locate the code creating the task
+     */
+    const std::type_info &target_type() const {
+        auto strongTask = _weakTask.lock();
+        return strongTask ? strongTask->target_type() : typeid(void);
+    }
+
     R operator()(ArgTypes ...args) const {
         auto strongTask = _weakTask.lock();
         if (strongTask && *strongTask) {
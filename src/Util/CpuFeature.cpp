@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include "CpuFeature.h"
+
+#if defined(HAS_X86_SIMD)
+#include <cpuid.h>
+#endif
+
+using namespace std;
+
+namespace toolkit {
+
+static uint32_t detect() {
+    uint32_t ret = 0;
+#if defined(HAS_X86_SIMD)
+    unsigned int eax, ebx, ecx, edx;
+    auto max_leaf = __get_cpuid_max(0, nullptr);
+    if (max_leaf < 1) {
+        return ret;
+    }
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (ecx & (1 << 9)) {
+        ret |= CpuFeature::SSSE3;
+    }
+    if (ecx & (1 << 19)) {
+        ret |= CpuFeature::SSE41;
+    }
+    // avx需要操作系统支持保存ymm寄存器
+    // Avx requires the os to save the ymm registers
+    bool os_avx = false;
+    if ((ecx & (1 << 27)) && (ecx & (1 << 28))) {
+        unsigned int xcr0_lo, xcr0_hi;
+        __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        os_avx = (xcr0_lo & 6) == 6;
+    }
+    if (max_leaf < 7) {
+        return ret;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (os_avx && (ebx & (1 << 5))) {
+        ret |= CpuFeature::AVX2;
+    }
+    if (ebx & (1 << 29)) {
+        ret |= CpuFeature::SHA;
+    }
+#endif
+    return ret;
+}
+
+static atomic<uint32_t> &enabledFlags() {
+    static atomic<uint32_t> s_flags { detect() };
+    return s_flags;
+}
+
+bool CpuFeature::has(uint32_t flags) {
+    return (enabledFlags().load(memory_order_relaxed) & flags) == flags;
+}
+
+uint32_t CpuFeature::detected() {
+    static uint32_t s_detected = detect();
+    return s_detected;
+}
+
+void CpuFeature::setEnabled(uint32_t flags) {
+    enabledFlags().store(flags & detected(), memory_order_relaxed);
+}
+
+string CpuFeature::toString(uint32_t flags) {
+    static const pair<uint32_t, const char *> s_names[] = { { SSSE3, "ssse3" }, { SSE41, "sse4.1" }, { AVX2, "avx2" }, { SHA, "sha" } };
+    string ret;
+    for (auto &pr : s_names) {
+        if (flags & pr.first) {
+            ret += ret.empty() ? "" : ",";
+            ret += pr.second;
+        }
+    }
+    return ret.empty() ? "none" : ret;
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_CPUFEATURE_H_
+#define UTIL_CPUFEATURE_H_
+
+#include <cstdint>
+#include <string>
+
+// gcc/clang可以用函数属性单独为某个函数开启指令集，无需修改全局编译选项
+// gcc/clang can enable instruction sets for a single function by attribute without changing the global compile options
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAS_X86_SIMD
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// gcc/clang的向量扩展，在x86上编译为sse/avx，在arm上编译为neon
+// Vector extensions of gcc/clang, compiled into sse/avx on x86 and neon on arm
+#if defined(__GNUC__)
+#define HAS_VECTOR_EXT
+#endif
+
+namespace toolkit {
+
+/**
+ * 运行时cpu特性检测，用于在simd实现与标量实现之间分派
+ * Runtime cpu feature detection, used to dispatch between simd and scalar implementations
+ */
+class CpuFeature {
+public:
+    enum : uint32_t {
+        SSSE3 = 1 << 0,
+        SSE41 = 1 << 1,
+        AVX2 = 1 << 2,
+        // SHA-NI指令集
+        // SHA-NI instruction set
+        SHA = 1 << 3,
+    };
+
+    /**
+     * 是否支持并启用了全部flags特性
+     * Whether all the features in flags are supported and enabled
+     */
+    static bool has(uint32_t flags);
+
+    /**
+     * cpu支持的特性
+     * Features supported by the cpu
+     */
+    static uint32_t detected();
+
+    /**
+     * 限制可用的特性，传0则全部走标量实现，用于测试与性能对比
+     * Restrict the available features, 0 makes everything go through the scalar implementations, used for testing and benchmarking
+     */
+    static void setEnabled(uint32_t flags);
+
+    static std::string toString(uint32_t flags);
+};
+
+} /* namespace toolkit */
+#endif /* UTIL_CPUFEATURE_H_ */
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "CycleClock.h"
+
+using namespace std;
+
+namespace toolkit {
+
+static double calibrate() {
+#if defined(HAS_CYCLE_COUNTER)
+    // 忙等约5毫秒，对比steady_clock计算计数频率
+    // Busy wait for about 5 milliseconds, and compute the counter frequency against steady_clock
+    auto begin = chrono::steady_clock::now();
+    auto begin_ticks = CycleClock::now();
+    chrono::steady_clock::time_point end;
+    do {
+        end = chrono::steady_clock::now();
+    } while (end - begin < chrono::milliseconds(5));
+    auto ticks = CycleClock::now() - begin_ticks;
+    auto us = chrono::duration_cast<chrono::nanoseconds>(end - begin).count() / 1000.0;
+    return ticks / us;
+#else
+    return 1000.0;
+#endif
+}
+
+double CycleClock::ticksPerUS() {
+    static double s_ticks_per_us = calibrate();
+    return s_ticks_per_us;
+}
+
+} /* namespace toolkit */
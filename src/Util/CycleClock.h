@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_CYCLECLOCK_H_
+#define UTIL_CYCLECLOCK_H_
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define HAS_CYCLE_COUNTER
+#elif defined(__aarch64__)
+#define HAS_CYCLE_COUNTER
+#endif
+
+namespace toolkit {
+
+/**
+ * 低开销的单调时钟，x86读取TSC，arm64读取虚拟计数器，其他平台退化为steady_clock
+ * 适合在热路径上打点计时，首次换算时用steady_clock校准频率
+ * Low overhead monotonic clock, reads the TSC on x86 and the virtual counter on arm64, falls back to steady_clock on other platforms
+ * Suitable for timing on hot paths, the frequency is calibrated against steady_clock on the first conversion
+ */
+class CycleClock {
+public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t ret;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(ret));
+        return ret;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /**
+     * 每微秒的计数
+     * Counts per microsecond
+     */
+    static double ticksPerUS();
+
+    static uint64_t toUS(uint64_t ticks) { return (uint64_t)(ticks / ticksPerUS()); }
+    static uint64_t toNS(uint64_t ticks) { return (uint64_t)(ticks * 1000 / ticksPerUS()); }
+};
+
+} /* namespace toolkit */
+#endif /* UTIL_CYCLECLOCK_H_ */
@@ -0,0 +1,251 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "FastLogger.h"
+
+using namespace std;
+
+namespace toolkit {
+
+///////////////////FastLogRing///////////////////
+
+static size_t roundUpPowerOf2(size_t size) {
+    size_t ret = 1024;
+    while (ret < size) {
+        ret <<= 1;
+    }
+    return ret;
+}
+
+FastLogRing::FastLogRing(size_t capacity, std::string thread_name) {
+    _capacity = roundUpPowerOf2(capacity);
+    _data = new char[_capacity];
+    _thread_name = std::move(thread_name);
+}
+
+FastLogRing::~FastLogRing() {
+    // 释放未被消费的普通日志对象
+    // Release the ordinary log contexts that have not been consumed
+    consume([](const RecordHeader &header) {
+        if (header.type == kRecordContext) {
+            delete static_cast<const ContextRecord &>(header).ctx;
+        }
+    });
+    delete[] _data;
+}
+
+size_t FastLogRing::consume(const function<void(const RecordHeader &)> &cb) {
+    auto read_pos = _read_pos.load(std::memory_order_relaxed);
+    auto write_pos = _write_pos.load(std::memory_order_acquire);
+    size_t count = 0;
+    while (read_pos < write_pos) {
+        auto header = reinterpret_cast<const RecordHeader *>(_data + (read_pos & (_capacity - 1)));
+        if (header->type != kRecordPadding) {
+            cb(*header);
+            ++count;
+        }
+        read_pos += header->size;
+    }
+    _read_pos.store(read_pos, std::memory_order_release);
+    return count;
+}
+
+///////////////////FastLogWriter///////////////////
+
+// 当前启用的FastLogWriter，仅在线程首次打印日志时加锁访问
+// The currently enabled FastLogWriter, accessed with the lock only when a thread logs for the first time
+static std::mutex s_mtx_writer;
+static FastLogWriter *s_writer = nullptr;
+static std::atomic<uint64_t> s_generation { 0 };
+static uint64_t s_generation_seed = 0;
+
+struct FastLogRingHolder {
+    uint64_t generation = 0;
+    FastLogRing::Ptr ring;
+
+    ~FastLogRingHolder() {
+        if (ring) {
+            ring->close();
+        }
+    }
+};
+
+static thread_local FastLogRingHolder s_ring_holder;
+
+FastLogRing *FastLogWriter::getRing() {
+    auto generation = s_generation.load(std::memory_order_acquire);
+    if (!generation) {
+        return nullptr;
+    }
+    auto &holder = s_ring_holder;
+    if (holder.generation == generation) {
+        return holder.ring.get();
+    }
+
+    // 本线程首次打印日志或FastLogWriter已经切换
+    // The first log of this thread or FastLogWriter has been switched
+    lock_guard<mutex> lck(s_mtx_writer);
+    if (!s_writer) {
+        return nullptr;
+    }
+    if (holder.ring) {
+        holder.ring->close();
+    }
+    holder.ring = std::make_shared<FastLogRing>(s_writer->_ring_size, getThreadName());
+    holder.generation = s_writer->_generation;
+    s_writer->attach(holder.ring);
+    return holder.ring.get();
+}
+
+FastLogWriter::FastLogWriter(size_t ring_size, unsigned int flush_interval_ms) {
+    _ring_size = ring_size;
+    _flush_interval_ms = flush_interval_ms ? flush_interval_ms : 1;
+    {
+        lock_guard<mutex> lck(s_mtx_writer);
+        _generation = ++s_generation_seed;
+        s_writer = this;
+        s_generation.store(_generation, std::memory_order_release);
+    }
+    _thread = std::make_shared<thread>([this]() { this->run(); });
+}
+
+FastLogWriter::~FastLogWriter() {
+    {
+        lock_guard<mutex> lck(s_mtx_writer);
+        if (s_writer == this) {
+            s_writer = nullptr;
+            s_generation.store(0, std::memory_order_release);
+        }
+    }
+    _exit_flag = true;
+    _sem.post();
+    _thread->join();
+    flushAll();
+}
+
+void FastLogWriter::attach(const FastLogRing::Ptr &ring) {
+    lock_guard<mutex> lck(_mtx_rings);
+    _rings.emplace_back(ring);
+}
+
+void FastLogWriter::write(const LogContextPtr &ctx, Logger &logger) {
+    auto ring = getRing();
+    if (!ring) {
+        // 本对象已经不是当前启用的FastLogWriter
+        // This object is no longer the enabled FastLogWriter
+        logger.writeChannels(ctx);
+        return;
+    }
+    auto size = FastLogRing::align(sizeof(FastLogRing::ContextRecord));
+    auto buf = ring->reserve(size);
+    if (!buf) {
+        ring->onDropped();
+        return;
+    }
+    auto record = reinterpret_cast<FastLogRing::ContextRecord *>(buf);
+    record->size = (uint32_t)size;
+    record->type = FastLogRing::kRecordContext;
+    record->ctx = new LogContextPtr(ctx);
+    record->logger = &logger;
+    ring->commit(size);
+}
+
+uint64_t FastLogWriter::dropped() {
+    lock_guard<mutex> lck(_mtx_rings);
+    auto ret = _dropped_removed;
+    for (auto &ring : _rings) {
+        ret += ring->dropped();
+    }
+    return ret;
+}
+
+void FastLogWriter::run() {
+    setThreadName("fast log");
+    while (!_exit_flag) {
+        if (!flushAll()) {
+            _sem.wait(_flush_interval_ms);
+        }
+    }
+}
+
+static const char *getFileName(const char *file) {
+    auto pos = strrchr(file, '/');
+#ifdef _WIN32
+    if (!pos) {
+        pos = strrchr(file, '\\');
+    }
+#endif
+    return pos ? pos + 1 : file;
+}
+
+static const string s_module_name = exeName(false);
+
+void FastLogWriter::onRecord(const FastLogRing &ring, const FastLogRing::RecordHeader &header) {
+    if (header.type == FastLogRing::kRecordContext) {
+        auto &record = static_cast<const FastLogRing::ContextRecord &>(header);
+        record.logger->writeChannels(*record.ctx);
+        delete record.ctx;
+        return;
+    }
+
+    auto &record = static_cast<const FastLogRing::BinaryRecord &>(header);
+    auto &site = *record.site;
+    string content;
+    record.formatter(site.fmt, reinterpret_cast<const char *>(&record) + sizeof(FastLogRing::BinaryRecord), content);
+
+    auto ctx = std::make_shared<LogContext>();
+    ctx->_level = site.level;
+    ctx->_line = site.line;
+    ctx->_file = getFileName(site.file);
+    ctx->_function = site.function;
+    ctx->_thread_name = ring.threadName();
+    ctx->_module_name = s_module_name;
+    ctx->_tv.tv_sec = (decltype(ctx->_tv.tv_sec))(record.stamp / 1000000);
+    ctx->_tv.tv_usec = (decltype(ctx->_tv.tv_usec))(record.stamp % 1000000);
+    *ctx << content;
+    record.logger->writeChannels(ctx);
+}
+
+bool FastLogWriter::flushAll() {
+    decltype(_rings) rings;
+    {
+        lock_guard<mutex> lck(_mtx_rings);
+        rings = _rings;
+    }
+
+    size_t count = 0;
+    uint64_t dropped = _dropped_removed;
+    for (auto &ring : rings) {
+        count += ring->consume([&](const FastLogRing::RecordHeader &header) { onRecord(*ring, header); });
+        dropped += ring->dropped();
+    }
+
+    if (dropped > _dropped_reported) {
+        auto ctx = std::make_shared<LogContext>(LWarn, __FILE__, __FUNCTION__, __LINE__, s_module_name.c_str(), "");
+        *ctx << "Fast log ring buffer is full, dropped " << dropped - _dropped_reported << " records";
+        _dropped_reported = dropped;
+        getLogger().writeChannels(ctx);
+    }
+
+    // 移除线程已经退出并且已经消费完毕的环形缓存
+    // Remove the ring buffers whose threads have exited and have been consumed
+    lock_guard<mutex> lck(_mtx_rings);
+    for (auto it = _rings.begin(); it != _rings.end();) {
+        if ((*it)->closed() && (*it)->empty()) {
+            _dropped_removed += (*it)->dropped();
+            it = _rings.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    return count > 0;
+}
+
+} /* namespace toolkit */
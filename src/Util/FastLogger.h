@@ -0,0 +1,340 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_FASTLOGGER_H_
+#define UTIL_FASTLOGGER_H_
+
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include "logger.h"
+
+namespace toolkit {
+
+/**
+ * 日志打印点的静态信息，每个FastLogX调用处一个实例，其地址即为打印点id
+ * Static information of a log site, one instance per FastLogX call site, its address is the site id
+ */
+struct FastLogSite {
+    LogLevel level;
+    const char *file;
+    const char *function;
+    int line;
+    const char *fmt;
+};
+
+/**
+ * 日志参数的二进制编解码
+ * 算术类型、枚举、指针按值拷贝；字符串拷贝内容，解码后为const char *
+ * Binary encoding/decoding of log arguments
+ * Arithmetic types, enums and pointers are copied by value; strings copy their content and decode to const char *
+ */
+template <typename T>
+struct FastLogArg {
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value, "unsupported FastLog argument type");
+    static size_t size(const T &) { return sizeof(T); }
+    static char *encode(char *buf, const T &value) {
+        memcpy(buf, &value, sizeof(T));
+        return buf + sizeof(T);
+    }
+    static T decode(const char *&buf) {
+        T value;
+        memcpy(&value, buf, sizeof(T));
+        buf += sizeof(T);
+        return value;
+    }
+};
+
+template <>
+struct FastLogArg<const char *> {
+    static size_t size(const char *str) { return sizeof(uint32_t) + (str ? strlen(str) : 0) + 1; }
+    static char *encode(char *buf, const char *str) { return encode(buf, str ? str : "", str ? strlen(str) : 0); }
+    static char *encode(char *buf, const char *str, uint32_t len) {
+        memcpy(buf, &len, sizeof(len));
+        buf += sizeof(len);
+        memcpy(buf, str, len);
+        buf[len] = '\0';
+        return buf + len + 1;
+    }
+    static const char *decode(const char *&buf) {
+        uint32_t len;
+        memcpy(&len, buf, sizeof(len));
+        auto ret = buf + sizeof(len);
+        buf = ret + len + 1;
+        return ret;
+    }
+};
+
+template <>
+struct FastLogArg<std::string> {
+    static size_t size(const std::string &str) { return sizeof(uint32_t) + str.size() + 1; }
+    static char *encode(char *buf, const std::string &str) { return FastLogArg<const char *>::encode(buf, str.data(), (uint32_t)str.size()); }
+    static const char *decode(const char *&buf) { return FastLogArg<const char *>::decode(buf); }
+};
+
+template <typename T>
+struct FastLogArgType {
+    using decay_type = typename std::decay<T>::type;
+    using type = typename std::conditional<std::is_same<decay_type, char *>::value, const char *, decay_type>::type;
+};
+
+/**
+ * 在写日志线程中把二进制参数还原并格式化
+ * Restore the binary arguments and format them in the log writer thread
+ */
+template <typename... ARGS>
+struct FastLogDecoder;
+
+template <>
+struct FastLogDecoder<> {
+    template <typename... Values>
+    static void format(const char *fmt, const char * /*args*/, std::string &out, Values... values) {
+        auto size = snprintf(nullptr, 0, fmt, values...);
+        if (size <= 0) {
+            out.clear();
+            return;
+        }
+        out.resize(size + 1);
+        snprintf(&out[0], size + 1, fmt, values...);
+        out.resize(size);
+    }
+
+    static void run(const char *fmt, const char *args, std::string &out) { format(fmt, args, out); }
+};
+
+template <typename First, typename... Rest>
+struct FastLogDecoder<First, Rest...> {
+    template <typename... Values>
+    static void format(const char *fmt, const char *args, std::string &out, Values... values) {
+        auto value = FastLogArg<First>::decode(args);
+        FastLogDecoder<Rest...>::format(fmt, args, out, values..., value);
+    }
+
+    static void run(const char *fmt, const char *args, std::string &out) { format(fmt, args, out); }
+};
+
+using FastLogFormatter = void (*)(const char *fmt, const char *args, std::string &out);
+
+/**
+ * 单线程写、写日志线程读的无锁字节环形缓存，每个打印日志的线程一个
+ * 记录按8字节对齐，空间不足时丢弃新记录并计数
+ * Lock-free byte ring buffer written by one thread and read by the log writer thread, one per logging thread
+ * Records are 8-byte aligned, new records are dropped and counted when there is no space
+ */
+class FastLogRing : public noncopyable {
+public:
+    using Ptr = std::shared_ptr<FastLogRing>;
+
+    enum RecordType : uint32_t {
+        kRecordPadding = 0,
+        kRecordBinary,
+        kRecordContext,
+    };
+
+    struct RecordHeader {
+        uint32_t size;
+        uint32_t type;
+    };
+
+    struct BinaryRecord : public RecordHeader {
+        const FastLogSite *site;
+        FastLogFormatter formatter;
+        Logger *logger;
+        uint64_t stamp;
+    };
+
+    struct ContextRecord : public RecordHeader {
+        LogContextPtr *ctx;
+        Logger *logger;
+    };
+
+    FastLogRing(size_t capacity, std::string thread_name);
+    ~FastLogRing();
+
+    /**
+     * 申请一段连续空间，失败返回nullptr，仅限所属线程调用
+     * Reserve contiguous space, return nullptr on failure, only called by the owner thread
+     */
+    char *reserve(size_t size) {
+        auto write_pos = _write_pos.load(std::memory_order_relaxed);
+        auto read_pos = _read_pos.load(std::memory_order_acquire);
+        auto offset = write_pos & (_capacity - 1);
+        auto tail_room = _capacity - offset;
+        _padding = 0;
+        if (size > tail_room) {
+            // 尾部空间不足，填充后回绕到头部
+            // Not enough space at the tail, pad and wrap around to the head
+            if (write_pos + tail_room + size - read_pos > _capacity) {
+                return nullptr;
+            }
+            auto header = reinterpret_cast<RecordHeader *>(_data + offset);
+            header->size = (uint32_t)tail_room;
+            header->type = kRecordPadding;
+            _padding = tail_room;
+            offset = 0;
+        } else if (write_pos + size - read_pos > _capacity) {
+            return nullptr;
+        }
+        return _data + offset;
+    }
+
+    /**
+     * 提交reserve申请的空间，仅限所属线程调用
+     * Commit the space reserved by reserve, only called by the owner thread
+     */
+    void commit(size_t size) { _write_pos.store(_write_pos.load(std::memory_order_relaxed) + _padding + size, std::memory_order_release); }
+
+    void onDropped() { _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    /**
+     * 遍历所有已提交的记录并释放空间，仅限写日志线程调用
+     * @return 处理的记录个数
+     * Traverse all committed records and release the space, only called by the log writer thread
+     * @return Number of records processed
+     */
+    size_t consume(const std::function<void(const RecordHeader &)> &cb);
+
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+    const std::string &threadName() const { return _thread_name; }
+
+    void close() { _closed = true; }
+    bool closed() const { return _closed; }
+    bool empty() const { return _read_pos.load(std::memory_order_acquire) == _write_pos.load(std::memory_order_acquire); }
+
+    static size_t align(size_t size) { return (size + 7) & ~(size_t)7; }
+
+private:
+    std::atomic<bool> _closed { false };
+    size_t _capacity;
+    size_t _padding = 0;
+    char *_data;
+    std::string _thread_name;
+    std::atomic<uint64_t> _dropped { 0 };
+    std::atomic<uint64_t> _write_pos { 0 };
+    char _cache_line_padding[64];
+    std::atomic<uint64_t> _read_pos { 0 };
+};
+
+/**
+ * 低延迟日志写入器
+ * 日志以二进制记录(时间戳、打印点id、参数)写入每个线程独享的无锁环形缓存，只在写日志线程中格式化；
+ * 普通的InfoL等日志也通过该环形缓存投递，打印线程不再竞争互斥锁
+ * Low latency log writer
+ * Logs are written as binary records (timestamp, site id, arguments) into per-thread lock-free ring buffers,
+ * and are formatted only in the writer thread; ordinary InfoL style logs are also delivered by the ring buffers,
+ * so logging threads never contend on a mutex
+ */
+class FastLogWriter : public LogWriter {
+public:
+    /**
+     * @param ring_size 每个线程环形缓存大小，会向上取整为2的幂
+     * @param flush_interval_ms 写日志线程空闲时轮询间隔
+     * @param ring_size Ring buffer size of each thread, rounded up to a power of 2
+     * @param flush_interval_ms Polling interval of the writer thread when idle
+     */
+    FastLogWriter(size_t ring_size = 256 * 1024, unsigned int flush_interval_ms = 5);
+    ~FastLogWriter() override;
+
+    /**
+     * 写入一条二进制日志，未启用FastLogWriter时退化为同步格式化
+     * Write a binary log record, fallback to formatting synchronously if FastLogWriter is not enabled
+     */
+    template <typename... ARGS>
+    static void log(Logger &logger, const FastLogSite &site, ARGS &&...args) {
+        auto args_size = argsSize(args...);
+        auto size = FastLogRing::align(sizeof(FastLogRing::BinaryRecord) + args_size);
+        FastLogFormatter formatter = &FastLogDecoder<typename FastLogArgType<ARGS>::type...>::run;
+        if (auto ring = getRing()) {
+            auto buf = ring->reserve(size);
+            if (!buf) {
+                ring->onDropped();
+                return;
+            }
+            auto record = reinterpret_cast<FastLogRing::BinaryRecord *>(buf);
+            record->size = (uint32_t)size;
+            record->type = FastLogRing::kRecordBinary;
+            record->site = &site;
+            record->formatter = formatter;
+            record->logger = &logger;
+            record->stamp = getCurrentMicrosecond(true);
+            encodeArgs(buf + sizeof(FastLogRing::BinaryRecord), args...);
+            ring->commit(size);
+            return;
+        }
+
+        std::string args_buf(args_size, '\0');
+        encodeArgs(&args_buf[0], args...);
+        std::string content;
+        formatter(site.fmt, args_buf.data(), content);
+        LogContextCapture(logger, site.level, site.file, site.function, site.line) << content;
+    }
+
+    /**
+     * 丢弃的日志条数
+     * Number of dropped log records
+     */
+    uint64_t dropped();
+
+private:
+    void write(const LogContextPtr &ctx, Logger &logger) override;
+    void run();
+    bool flushAll();
+    void onRecord(const FastLogRing &ring, const FastLogRing::RecordHeader &header);
+    void attach(const FastLogRing::Ptr &ring);
+
+    static FastLogRing *getRing();
+
+    static size_t argsSize() { return 0; }
+    template <typename First, typename... ARGS>
+    static size_t argsSize(const First &first, const ARGS &...args) {
+        return FastLogArg<typename FastLogArgType<First>::type>::size(first) + argsSize(args...);
+    }
+
+    static void encodeArgs(char *) {}
+    template <typename First, typename... ARGS>
+    static void encodeArgs(char *buf, const First &first, const ARGS &...args) {
+        encodeArgs(FastLogArg<typename FastLogArgType<First>::type>::encode(buf, first), args...);
+    }
+
+private:
+    bool _exit_flag = false;
+    size_t _ring_size;
+    unsigned int _flush_interval_ms;
+    uint64_t _generation;
+    uint64_t _dropped_reported = 0;
+    uint64_t _dropped_removed = 0;
+    semaphore _sem;
+    std::mutex _mtx_rings;
+    std::vector<FastLogRing::Ptr> _rings;
+    std::shared_ptr<std::thread> _thread;
+};
+
+//用法: FastLogD("%d + %s = %c", 1, "2", 'c');
+//Usage: FastLogD("%d + %s = %c", 1, "2", 'c');
+//格式串必须为字符串常量，参数支持算术类型、指针、const char *和std::string
+//The format must be a string literal, arguments support arithmetic types, pointers, const char * and std::string
+#define FastLogL(level, fmt, ...)                                                                                                                              \
+    do {                                                                                                                                                       \
+        if (LogLevelEnabled(level)) {                                                                                                                          \
+            static const ::toolkit::FastLogSite s_fast_log_site { level, __FILE__, __FUNCTION__, __LINE__, fmt };                                             \
+            ::toolkit::FastLogWriter::log(::toolkit::getLogger(), s_fast_log_site, ##__VA_ARGS__);                                                             \
+        }                                                                                                                                                      \
+    } while (0)
+#define FastLogT(...) FastLogL(::toolkit::LTrace, ##__VA_ARGS__)
+#define FastLogD(...) FastLogL(::toolkit::LDebug, ##__VA_ARGS__)
+#define FastLogI(...) FastLogL(::toolkit::LInfo, ##__VA_ARGS__)
+#define FastLogW(...) FastLogL(::toolkit::LWarn, ##__VA_ARGS__)
+#define FastLogE(...) FastLogL(::toolkit::LError, ##__VA_ARGS__)
+
+} /* namespace toolkit */
+#endif /* UTIL_FASTLOGGER_H_ */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_HASHLANES_H_
+#define UTIL_HASHLANES_H_
+
+#include "CpuFeature.h"
+
+#if defined(HAS_VECTOR_EXT)
+
+#include <cstring>
+#include <string>
+
+namespace toolkit {
+
+typedef uint32_t HashVec4 __attribute__((vector_size(16)));
+typedef uint32_t HashVec8 __attribute__((vector_size(32)));
+
+// 强制内联到带指令集属性的调用者中，由调用者决定生成sse、avx2还是neon指令
+// Force inlining into the caller with the instruction set attribute, the caller decides whether sse, avx2 or neon instructions are generated
+#define HASH_LANES_INLINE inline __attribute__((always_inline))
+#define HASH_LANES_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/**
+ * 多缓冲哈希：N条互相独立的消息各占一个向量通道并行压缩，先算完的通道立即换入下一条消息
+ * Algo需提供kStateWords、kInit、load、storeLength、compress以及store
+ * Multi-buffer hashing: N independent messages occupy one vector lane each and are compressed in parallel,
+ * a lane which finishes first takes the next message immediately
+ * Algo must provide kStateWords, kInit, load, storeLength, compress and store
+ * @param msgs 消息数组
+ * @param count 消息个数
+ * @param out 摘要输出数组，长度为count
+ * @param msgs Message array
+ * @param count Message count
+ * @param out Digest output array, its length is count
+ */
+template <typename V, size_t N, typename Algo>
+HASH_LANES_INLINE void hashLanes(const std::string *msgs, size_t count, std::string *out) {
+    static constexpr size_t kBlockSize = 64;
+    static const uint8_t s_zero_block[kBlockSize] = { 0 };
+
+    struct Lane {
+        bool busy = false;
+        size_t index = 0;
+        // 下一个要压缩的块、消息中完整块的个数、包括填充在内的总块数
+        // The next block to compress, count of full blocks in the message, total blocks including padding
+        size_t block = 0;
+        size_t full = 0;
+        size_t total = 0;
+        uint8_t tail[kBlockSize * 2];
+    };
+
+    Lane lanes[N];
+    V state[Algo::kStateWords];
+    size_t next = 0;
+    size_t active = 0;
+    while (true) {
+        for (size_t i = 0; i < N && next < count; ++i) {
+            auto &lane = lanes[i];
+            if (lane.busy) {
+                continue;
+            }
+            // 把消息末尾不足一块的数据与填充、长度一起放入tail
+            // Put the data shorter than a block at the end of the message with the padding and length into tail
+            auto &msg = msgs[next];
+            auto rest = msg.size() % kBlockSize;
+            lane.busy = true;
+            lane.index = next++;
+            lane.block = 0;
+            lane.full = msg.size() / kBlockSize;
+            lane.total = lane.full + (rest + 9 > kBlockSize ? 2 : 1);
+            auto tail_size = (lane.total - lane.full) * kBlockSize;
+            memset(lane.tail, 0, tail_size);
+            memcpy(lane.tail, msg.data() + lane.full * kBlockSize, rest);
+            lane.tail[rest] = 0x80;
+            Algo::storeLength(lane.tail + tail_size - 8, (uint64_t)msg.size() * 8);
+            for (size_t j = 0; j < Algo::kStateWords; ++j) {
+                state[j][i] = Algo::kInit[j];
+            }
+            ++active;
+        }
+        if (!active) {
+            break;
+        }
+
+        alignas(32) uint32_t words[16][N];
+        for (size_t i = 0; i < N; ++i) {
+            auto &lane = lanes[i];
+            const uint8_t *block = s_zero_block;
+            if (lane.busy) {
+                block = lane.block < lane.full ? (const uint8_t *)msgs[lane.index].data() + lane.block * kBlockSize
+                                               : lane.tail + (lane.block - lane.full) * kBlockSize;
+            }
+            for (size_t j = 0; j < 16; ++j) {
+                words[j][i] = Algo::load(block + j * 4);
+            }
+        }
+        V w[16];
+        memcpy(w, words, sizeof(w));
+        Algo::compress(state, w);
+
+        for (size_t i = 0; i < N; ++i) {
+            auto &lane = lanes[i];
+            if (!lane.busy || ++lane.block != lane.total) {
+                continue;
+            }
+            uint32_t digest[Algo::kStateWords];
+            for (size_t j = 0; j < Algo::kStateWords; ++j) {
+                digest[j] = state[j][i];
+            }
+            Algo::store(digest, out[lane.index]);
+            lane.busy = false;
+            --active;
+        }
+    }
+}
+
+} /* namespace toolkit */
+
+#endif // defined(HAS_VECTOR_EXT)
+#endif /* UTIL_HASHLANES_H_ */
@@ -193,8 +193,7 @@ public:
         if (other.empty()) {
             return;
         }
-        this->insert(this->end(), other.begin(), other.end());
-        other.clear();
+        this->splice(this->end(), other);
     }
 
     template<typename FUNC>
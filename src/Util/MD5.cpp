@@ -35,6 +35,7 @@ documentation and/or software.
 
 /* interface header */
 #include "MD5.h"
+#include "HashLanes.h"
 /* system implementation headers */
 #include <cstdio>
 #include <cstring>
@@ -369,4 +370,112 @@ std::string md5(const std::string str)
 
     return md5.hexdigest();
 }
+
+//////////////////////////////
+
+#if defined(HAS_VECTOR_EXT)
+
+// MD5 of independent messages in vector lanes, used by rawdigestBatch
+struct MD5Lanes
+{
+    static constexpr size_t kStateWords = 4;
+    static const uint32_t kInit[kStateWords];
+    static const uint32_t kSine[64];
+    static const uint32_t kShift[16];
+
+    static uint32_t load(const uint8_t *p)
+    {
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    static void storeLength(uint8_t *p, uint64_t bits)
+    {
+        for (int i = 0; i < 8; i++)
+            p[i] = (uint8_t)(bits >> (8 * i));
+    }
+
+    static void store(const uint32_t words[kStateWords], std::string &out)
+    {
+        out.resize(kStateWords * 4);
+        for (size_t i = 0; i < kStateWords * 4; i++)
+            out[i] = (char)(words[i / 4] >> (8 * (i % 4)));
+    }
+
+    template <typename V>
+    HASH_LANES_INLINE static void compress(V state[kStateWords], const V x[16])
+    {
+        V a = state[0], b = state[1], c = state[2], d = state[3];
+        for (int i = 0; i < 64; i++)
+        {
+            V f;
+            int g;
+            switch (i / 16) {
+                case 0: f = d ^ (b & (c ^ d)); g = i; break;
+                case 1: f = c ^ (d & (b ^ c)); g = (5 * i + 1) % 16; break;
+                case 2: f = b ^ c ^ d; g = (3 * i + 5) % 16; break;
+                default: f = c ^ (b | ~d); g = (7 * i) % 16; break;
+            }
+            V tmp = a + f + x[g] + kSine[i];
+            int n = kShift[i / 16 * 4 + i % 4];
+            a = d;
+            d = c;
+            c = b;
+            b += HASH_LANES_ROTL(tmp, n);
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+};
+
+const uint32_t MD5Lanes::kInit[MD5Lanes::kStateWords] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+
+const uint32_t MD5Lanes::kSine[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+const uint32_t MD5Lanes::kShift[16] = {
+    S11, S12, S13, S14, S21, S22, S23, S24, S31, S32, S33, S34, S41, S42, S43, S44
+};
+
+static void md5Lanes4(const std::string *msgs, size_t count, std::string *out)
+{
+    hashLanes<HashVec4, 4, MD5Lanes>(msgs, count, out);
+}
+
+#if defined(HAS_X86_SIMD)
+SIMD_TARGET("avx2") static void md5Lanes8(const std::string *msgs, size_t count, std::string *out)
+{
+    hashLanes<HashVec8, 8, MD5Lanes>(msgs, count, out);
+}
+#endif
+
+#endif // defined(HAS_VECTOR_EXT)
+
+std::vector<std::string> MD5::rawdigestBatch(const std::vector<std::string> &texts)
+{
+    std::vector<std::string> ret(texts.size());
+#if defined(HAS_X86_SIMD)
+    if (CpuFeature::has(CpuFeature::AVX2))
+    {
+        md5Lanes8(texts.data(), texts.size(), ret.data());
+        return ret;
+    }
+#endif
+#if defined(HAS_VECTOR_EXT)
+    md5Lanes4(texts.data(), texts.size(), ret.data());
+#else
+    for (size_t i = 0; i < texts.size(); i++)
+        ret[i] = MD5(texts[i]).rawdigest();
+#endif
+    return ret;
+}
 } /* namespace toolkit */
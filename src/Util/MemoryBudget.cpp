@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <algorithm>
+#include "MemoryBudget.h"
+#include "Metrics.h"
+
+using namespace std;
+
+namespace toolkit {
+
+MemoryBudget::Charge &MemoryBudget::Charge::operator=(Charge &&that) {
+    if (this != &that) {
+        reset();
+        _budget = std::move(that._budget);
+        _bytes = that._bytes;
+        that._bytes = 0;
+    }
+    return *this;
+}
+
+void MemoryBudget::Charge::reset() {
+    if (_budget && _bytes) {
+        _budget->release(_bytes);
+    }
+    _budget = nullptr;
+    _bytes = 0;
+}
+
+const MemoryBudget::Ptr &MemoryBudget::global() {
+    // 故意不释放，避免静态析构顺序问题
+    // Never released on purpose, avoiding static destruction order issues
+    static auto s_global = []() {
+        auto ret = new Ptr(new MemoryBudget(nullptr));
+        (*ret)->_name = "global";
+        (*ret)->registerMetrics();
+        return ret;
+    }();
+    return *s_global;
+}
+
+MemoryBudget::Ptr MemoryBudget::create(size_t soft_limit, size_t hard_limit, Ptr parent, const string &name) {
+    Ptr ret(new MemoryBudget(std::move(parent)));
+    ret->setLimits(soft_limit, hard_limit);
+    if (!name.empty()) {
+        ret->_name = name;
+        ret->registerMetrics();
+    }
+    return ret;
+}
+
+MemoryBudget::MemoryBudget(Ptr parent) : _parent(std::move(parent)) {}
+
+MemoryBudget::~MemoryBudget() {
+    if (_used) {
+        // 未归还的记账从上级扣除
+        // Charges not yet released are taken off the ancestors
+        for (auto node = _parent.get(); node; node = node->_parent.get()) {
+            node->sub(_used);
+        }
+    }
+    if (!_name.empty()) {
+        auto &registry = MetricsRegistry::Instance();
+        for (auto name : { "zltoolkit_memory_budget_used_bytes", "zltoolkit_memory_budget_peak_bytes", "zltoolkit_memory_budget_level",
+                           "zltoolkit_memory_budget_soft_limit_bytes", "zltoolkit_memory_budget_hard_limit_bytes" }) {
+            registry.remove(name, { { "budget", _name } });
+        }
+    }
+}
+
+void MemoryBudget::registerMetrics() {
+    weak_ptr<MemoryBudget> weak_self = shared_from_this();
+    auto add = [&](const char *name, const char *help, function<double(MemoryBudget &)> getter) {
+        MetricsRegistry::Instance().addCallback(name, help, MetricsRegistry::Type::Gauge, { { "budget", _name } }, [weak_self, getter]() -> double {
+            auto strong_self = weak_self.lock();
+            return strong_self ? getter(*strong_self) : 0;
+        });
+    };
+    add("zltoolkit_memory_budget_used_bytes", "Memory charged to the budget in bytes", [](MemoryBudget &self) { return (double)self.used(); });
+    add("zltoolkit_memory_budget_peak_bytes", "Peak memory charged to the budget in bytes", [](MemoryBudget &self) { return (double)self.peak(); });
+    add("zltoolkit_memory_budget_level", "Budget level, 0 normal, 1 over the soft limit, 2 over the hard limit",
+        [](MemoryBudget &self) { return (double)self._level.load(); });
+    add("zltoolkit_memory_budget_soft_limit_bytes", "Soft limit of the budget in bytes, 0 means unlimited", [](MemoryBudget &self) { return (double)self.getSoftLimit(); });
+    add("zltoolkit_memory_budget_hard_limit_bytes", "Hard limit of the budget in bytes, 0 means unlimited", [](MemoryBudget &self) { return (double)self.getHardLimit(); });
+}
+
+void MemoryBudget::setLimits(size_t soft_limit, size_t hard_limit) {
+    _soft_limit = soft_limit;
+    _hard_limit = hard_limit;
+    updateLevel(used());
+}
+
+void MemoryBudget::charge(size_t bytes) {
+    for (auto node = this; node; node = node->_parent.get()) {
+        node->add(bytes);
+    }
+}
+
+void MemoryBudget::release(size_t bytes) {
+    for (auto node = this; node; node = node->_parent.get()) {
+        node->sub(bytes);
+    }
+}
+
+void MemoryBudget::add(size_t bytes) {
+    auto used = _used.fetch_add(bytes, memory_order_relaxed) + bytes;
+    auto peak = _peak.load(memory_order_relaxed);
+    while (used > peak && !_peak.compare_exchange_weak(peak, used, memory_order_relaxed)) {}
+    auto soft_limit = _soft_limit.load(memory_order_relaxed);
+    auto hard_limit = _hard_limit.load(memory_order_relaxed);
+    if ((soft_limit && used >= soft_limit) || (hard_limit && used >= hard_limit)) {
+        updateLevel(used);
+    }
+}
+
+void MemoryBudget::sub(size_t bytes) {
+    auto used = _used.fetch_sub(bytes, memory_order_relaxed) - bytes;
+    if (_level.load(memory_order_relaxed) != Level::Normal) {
+        updateLevel(used);
+    }
+}
+
+void MemoryBudget::updateLevel(size_t used) {
+    auto soft_limit = _soft_limit.load();
+    auto hard_limit = _hard_limit.load();
+    auto current = _level.load();
+    auto above = [&](size_t limit, Level level) {
+        // 当前已处于该水位时，回落到上限的3/4以下才离开
+        // Once at the level, it is left only after falling below 3/4 of the limit
+        return limit && (used >= limit || (current >= level && used >= limit / 4 * 3));
+    };
+    Level next = Level::Normal;
+    if (above(hard_limit, Level::Hard)) {
+        next = Level::Hard;
+    } else if (above(soft_limit, Level::Soft)) {
+        next = Level::Soft;
+    }
+    if (next == current || !_level.compare_exchange_strong(current, next)) {
+        return;
+    }
+
+    vector<shared_ptr<onLevelChanged>> listeners;
+    {
+        lock_guard<mutex> lck(_mtx_listener);
+        auto it = std::remove_if(_listeners.begin(), _listeners.end(), [&](const weak_ptr<onLevelChanged> &weak_listener) {
+            auto listener = weak_listener.lock();
+            if (!listener) {
+                return true;
+            }
+            listeners.emplace_back(std::move(listener));
+            return false;
+        });
+        _listeners.erase(it, _listeners.end());
+    }
+    for (auto &listener : listeners) {
+        (*listener)(next);
+    }
+}
+
+MemoryBudget::Level MemoryBudget::level() const {
+    auto ret = Level::Normal;
+    for (auto node = this; node; node = node->_parent.get()) {
+        ret = std::max(ret, node->_level.load(memory_order_relaxed));
+    }
+    return ret;
+}
+
+MemoryBudget::Listener MemoryBudget::addListener(onLevelChanged cb) {
+    auto ret = std::make_shared<onLevelChanged>(std::move(cb));
+    lock_guard<mutex> lck(_mtx_listener);
+    _listeners.emplace_back(ret);
+    return ret;
+}
+
+} // namespace toolkit
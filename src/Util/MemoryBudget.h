@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_MEMORYBUDGET_H_
+#define UTIL_MEMORYBUDGET_H_
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace toolkit {
+
+/**
+ * 内存预算，按字节记账，可跨线程使用
+ * 预算组成树状层级(如 全局 <- 分组 <- 单个socket)，记账同时计入所有上级；
+ * 用量超过软/硬上限时切换水位并通知监听者，回落到上限的3/4以下时恢复，避免在边界上反复切换
+ * Memory budget counted in bytes, usable across threads
+ * Budgets form a tree (e.g. global <- group <- single socket), a charge is counted in all the ancestors as well;
+ * the level changes and the listeners are notified when usage exceeds the soft/hard limit, it recovers when usage
+ * falls below 3/4 of the limit, avoiding flapping on the boundary
+ */
+class MemoryBudget : public std::enable_shared_from_this<MemoryBudget> {
+public:
+    using Ptr = std::shared_ptr<MemoryBudget>;
+
+    enum class Level : int {
+        // 未超限
+        // Within limits
+        Normal = 0,
+        // 超过软上限，生产者应暂停
+        // Over the soft limit, producers should pause
+        Soft,
+        // 超过硬上限，应主动丢弃负载
+        // Over the hard limit, load should be shed
+        Hard,
+    };
+
+    using onLevelChanged = std::function<void(Level level)>;
+    using Listener = std::shared_ptr<onLevelChanged>;
+
+    /**
+     * 已记账的内存，析构时归还预算，只能移动
+     * Charged memory, returned to the budget on destruction, move only
+     */
+    class Charge {
+    public:
+        Charge() = default;
+        /**
+         * 接管已记账的字节数，不会再次记账
+         * Take over bytes that are already charged, they are not charged again
+         */
+        Charge(Ptr budget, size_t bytes) : _budget(std::move(budget)), _bytes(bytes) {}
+        Charge(Charge &&that) : _budget(std::move(that._budget)), _bytes(that._bytes) { that._bytes = 0; }
+        Charge &operator=(Charge &&that);
+        ~Charge() { reset(); }
+
+        void reset();
+        size_t bytes() const { return _bytes; }
+
+    private:
+        Ptr _budget;
+        size_t _bytes = 0;
+    };
+
+    ~MemoryBudget();
+
+    /**
+     * 进程全局预算，默认不限制
+     * Process wide budget, unlimited by default
+     */
+    static const Ptr &global();
+
+    /**
+     * 创建预算
+     * @param parent 上级预算，一般为global()或某个分组
+     * @param name 非空时以该名称导出zltoolkit_memory_budget_*指标
+     * Create a budget
+     * @param parent Parent budget, usually global() or a group
+     * @param name If not empty, zltoolkit_memory_budget_* metrics are exported with this name
+     */
+    static Ptr create(size_t soft_limit = 0, size_t hard_limit = 0, Ptr parent = global(), const std::string &name = "");
+
+    /**
+     * 设置软/硬上限，0为不限制
+     * Set the soft/hard limit, 0 means unlimited
+     */
+    void setLimits(size_t soft_limit, size_t hard_limit);
+    size_t getSoftLimit() const { return _soft_limit; }
+    size_t getHardLimit() const { return _hard_limit; }
+
+    /**
+     * 记账与归还，同时作用于所有上级
+     * Charge and release, applied to all the ancestors as well
+     */
+    void charge(size_t bytes);
+    void release(size_t bytes);
+
+    size_t used() const { return _used.load(std::memory_order_relaxed); }
+    size_t peak() const { return _peak.load(std::memory_order_relaxed); }
+    const Ptr &getParent() const { return _parent; }
+
+    /**
+     * 本预算及所有上级中最高的水位
+     * The highest level of this budget and all the ancestors
+     */
+    Level level() const;
+
+    /**
+     * 添加水位变化监听，监听者在越界的线程中被回调；返回值释放后自动取消监听
+     * Add a level change listener, it is called in the thread that crosses the limit;
+     * listening stops automatically once the returned object is released
+     */
+    Listener addListener(onLevelChanged cb);
+
+private:
+    MemoryBudget(Ptr parent);
+
+    void add(size_t bytes);
+    void sub(size_t bytes);
+    void updateLevel(size_t used);
+    void registerMetrics();
+
+private:
+    std::string _name;
+    Ptr _parent;
+    std::atomic<size_t> _soft_limit { 0 };
+    std::atomic<size_t> _hard_limit { 0 };
+    std::atomic<size_t> _used { 0 };
+    std::atomic<size_t> _peak { 0 };
+    std::atomic<Level> _level { Level::Normal };
+
+    std::mutex _mtx_listener;
+    std::vector<std::weak_ptr<onLevelChanged>> _listeners;
+};
+
+} // namespace toolkit
+#endif // UTIL_MEMORYBUDGET_H_
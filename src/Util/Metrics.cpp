@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include "Metrics.h"
+#include "util.h"
+
+using namespace std;
+
+namespace toolkit {
+
+static atomic<bool> s_shard_owned[MetricsCounter::kShardCount] {};
+
+thread_local size_t MetricsCounter::s_shard_index = MetricsCounter::kUnassigned;
+
+namespace {
+// 线程退出时归还分片，分片中已累加的值保留给下一个使用者继续累加
+// Return the shard when the thread exits, the accumulated value is kept for the next owner
+class ShardOwner {
+public:
+    ShardOwner() {
+        for (index = 0; index < MetricsCounter::kShardCount; ++index) {
+            if (!s_shard_owned[index].exchange(true, memory_order_acquire)) {
+                break;
+            }
+        }
+    }
+
+    ~ShardOwner() {
+        if (index < MetricsCounter::kShardCount) {
+            s_shard_owned[index].store(false, memory_order_release);
+        }
+    }
+
+    size_t index;
+};
+} // namespace
+
+size_t MetricsCounter::claimShard() {
+    static thread_local ShardOwner s_owner;
+    s_shard_index = s_owner.index;
+    return s_shard_index;
+}
+
+uint64_t MetricsCounter::value() const {
+    uint64_t ret = 0;
+    for (auto &shard : _shards) {
+        ret += shard.value.load(memory_order_relaxed);
+    }
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    size_t ret = 0;
+    while (value >>= 1) {
+        ++ret;
+    }
+    return ret;
+#endif
+}
+
+size_t MetricsHistogram::bucketIndex(uint64_t value) {
+    if (value < 32) {
+        return (size_t)value;
+    }
+    auto bit = highestBit(value);
+    // 最高位之后的4位作为子桶下标
+    // The 4 bits after the highest bit are used as the sub bucket index
+    return 32 + (bit - 5) * 16 + ((value >> (bit - 4)) & 15);
+}
+
+uint64_t MetricsHistogram::bucketUpperBound(size_t index) {
+    if (index < 32) {
+        return index;
+    }
+    auto bit = (index - 32) / 16 + 5;
+    auto sub = (index - 32) % 16;
+    auto lower = (uint64_t)(16 + sub) << (bit - 4);
+    return lower + ((uint64_t)1 << (bit - 4)) - 1;
+}
+
+void MetricsHistogram::record(uint64_t value) {
+    _buckets[bucketIndex(value)].fetch_add(1, memory_order_relaxed);
+    _sum.fetch_add(value, memory_order_relaxed);
+    auto max = _max.load(memory_order_relaxed);
+    while (value > max && !_max.compare_exchange_weak(max, value, memory_order_relaxed));
+}
+
+MetricsHistogram::Snapshot MetricsHistogram::snapshot() const {
+    Snapshot ret;
+    ret.buckets.resize(kBucketCount);
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        ret.buckets[i] = _buckets[i].load(memory_order_relaxed);
+        // 总数即桶计数之和，记录时无需额外累加，且与桶始终一致
+        // The count is the sum of the buckets, no extra increment is needed when recording, and it is always consistent with the buckets
+        ret.count += ret.buckets[i];
+    }
+    ret.sum = _sum.load(memory_order_relaxed);
+    ret.max = _max.load(memory_order_relaxed);
+    return ret;
+}
+
+uint64_t MetricsHistogram::Snapshot::percentile(double q) const {
+    if (!count) {
+        return 0;
+    }
+    auto rank = (uint64_t)ceil(q * count);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+atomic<bool> MetricsRegistry::s_enabled { true };
+
+INSTANCE_IMP(MetricsRegistry)
+
+MetricsRegistry::MetricsRegistry() {
+    _families = std::make_shared<FamilyMap>();
+}
+
+void MetricsRegistry::setEnabled(bool enabled) {
+    s_enabled = enabled;
+}
+
+shared_ptr<const MetricsRegistry::FamilyMap> MetricsRegistry::getFamilies() const {
+    return std::atomic_load(&_families);
+}
+
+MetricsRegistry::Item &MetricsRegistry::getItem(FamilyMap &families, const string &name, const string &help, Type type, const Labels &labels) {
+    auto it = families.find(name);
+    if (it == families.end()) {
+        it = families.emplace(name, Family { type, help, {} }).first;
+    } else if (it->second.type != type) {
+        throw std::invalid_argument("Metric " + name + " is already registered with another type");
+    }
+    auto &items = it->second.items;
+    for (auto &item : items) {
+        if (item.labels == labels) {
+            return item;
+        }
+    }
+    items.emplace_back();
+    items.back().labels = labels;
+    return items.back();
+}
+
+MetricsCounter::Ptr MetricsRegistry::counter(const string &name, const string &help, const Labels &labels) {
+    lock_guard<mutex> lck(_mtx);
+    auto families = std::make_shared<FamilyMap>(*_families);
+    auto &item = getItem(*families, name, help, Type::Counter, labels);
+    if (!item.counter) {
+        item.counter = std::make_shared<MetricsCounter>();
+        item.getter = nullptr;
+    }
+    auto ret = item.counter;
+    std::atomic_store(&_families, std::shared_ptr<const FamilyMap>(std::move(families)));
+    return ret;
+}
+
+MetricsGauge::Ptr MetricsRegistry::gauge(const string &name, const string &help, const Labels &labels) {
+    lock_guard<mutex> lck(_mtx);
+    auto families = std::make_shared<FamilyMap>(*_families);
+    auto &item = getItem(*families, name, help, Type::Gauge, labels);
+    if (!item.gauge) {
+        item.gauge = std::make_shared<MetricsGauge>();
+        item.getter = nullptr;
+    }
+    auto ret = item.gauge;
+    std::atomic_store(&_families, std::shared_ptr<const FamilyMap>(std::move(families)));
+    return ret;
+}
+
+MetricsHistogram::Ptr MetricsRegistry::histogram(const string &name, const string &help, const Labels &labels) {
+    lock_guard<mutex> lck(_mtx);
+    auto families = std::make_shared<FamilyMap>(*_families);
+    auto &item = getItem(*families, name, help, Type::Histogram, labels);
+    if (!item.histogram) {
+        item.histogram = std::make_shared<MetricsHistogram>();
+    }
+    auto ret = item.histogram;
+    std::atomic_store(&_families, std::shared_ptr<const FamilyMap>(std::move(families)));
+    return ret;
+}
+
+void MetricsRegistry::addCallback(const string &name, const string &help, Type type, const Labels &labels, function<double()> getter) {
+    if (type == Type::Histogram) {
+        throw std::invalid_argument("Histogram metric " + name + " can not be a callback");
+    }
+    lock_guard<mutex> lck(_mtx);
+    auto families = std::make_shared<FamilyMap>(*_families);
+    auto &item = getItem(*families, name, help, type, labels);
+    item.counter = nullptr;
+    item.gauge = nullptr;
+    item.getter = std::move(getter);
+    std::atomic_store(&_families, std::shared_ptr<const FamilyMap>(std::move(families)));
+}
+
+void MetricsRegistry::remove(const string &name, const Labels &labels) {
+    lock_guard<mutex> lck(_mtx);
+    if (_families->find(name) == _families->end()) {
+        return;
+    }
+    auto families = std::make_shared<FamilyMap>(*_families);
+    auto &items = (*families)[name].items;
+    for (auto it = items.begin(); it != items.end(); ++it) {
+        if (it->labels == labels) {
+            items.erase(it);
+            break;
+        }
+    }
+    if (items.empty()) {
+        families->erase(name);
+    }
+    std::atomic_store(&_families, std::shared_ptr<const FamilyMap>(std::move(families)));
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+static const char *typeName(MetricsRegistry::Type type) {
+    switch (type) {
+        case MetricsRegistry::Type::Counter: return "counter";
+        case MetricsRegistry::Type::Gauge: return "gauge";
+        // 直方图以分位数的形式导出
+        // Histograms are exported as quantiles
+        default: return "summary";
+    }
+}
+
+static void escape(ostream &out, const string &str, bool json) {
+    for (auto ch : str) {
+        switch (ch) {
+            case '\\': out << "\\\\"; break;
+            case '"': out << "\\\""; break;
+            case '\n': out << "\\n"; break;
+            default:
+                if (json && (unsigned char)ch < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                    out << buf;
+                } else {
+                    out << ch;
+                }
+                break;
+        }
+    }
+}
+
+static void writeLabels(ostream &out, const MetricsRegistry::Labels &labels, const char *extra_key = nullptr, const char *extra_value = nullptr) {
+    if (labels.empty() && !extra_key) {
+        return;
+    }
+    out << '{';
+    bool first = true;
+    for (auto &pr : labels) {
+        if (!first) {
+            out << ',';
+        }
+        first = false;
+        out << pr.first << "=\"";
+        escape(out, pr.second, false);
+        out << '"';
+    }
+    if (extra_key) {
+        if (!first) {
+            out << ',';
+        }
+        out << extra_key << "=\"" << extra_value << '"';
+    }
+    out << '}';
+}
+
+static const pair<double, const char *> kQuantiles[] = { { 0.5, "0.5" }, { 0.9, "0.9" }, { 0.99, "0.99" }, { 0.999, "0.999" }, { 1.0, "1" } };
+
+string MetricsRegistry::toPrometheus() const {
+    ostringstream out;
+    auto families = getFamilies();
+    for (auto &pr : *families) {
+        auto &name = pr.first;
+        auto &family = pr.second;
+        out << "# HELP " << name << ' ' << family.help << '\n';
+        out << "# TYPE " << name << ' ' << typeName(family.type) << '\n';
+        for (auto &item : family.items) {
+            if (item.histogram) {
+                auto snap = item.histogram->snapshot();
+                for (auto &quantile : kQuantiles) {
+                    out << name;
+                    writeLabels(out, item.labels, "quantile", quantile.second);
+                    out << ' ' << snap.percentile(quantile.first) << '\n';
+                }
+                out << name << "_sum";
+                writeLabels(out, item.labels);
+                out << ' ' << snap.sum << '\n';
+                out << name << "_count";
+                writeLabels(out, item.labels);
+                out << ' ' << snap.count << '\n';
+                continue;
+            }
+            out << name;
+            writeLabels(out, item.labels);
+            if (item.counter) {
+                out << ' ' << item.counter->value() << '\n';
+            } else if (item.gauge) {
+                out << ' ' << item.gauge->value() << '\n';
+            } else {
+                out << ' ' << (item.getter ? item.getter() : 0) << '\n';
+            }
+        }
+    }
+    return out.str();
+}
+
+string MetricsRegistry::toJson() const {
+    ostringstream out;
+    auto families = getFamilies();
+    out << '{';
+    bool first_family = true;
+    for (auto &pr : *families) {
+        auto &family = pr.second;
+        if (!first_family) {
+            out << ',';
+        }
+        first_family = false;
+        out << '"';
+        escape(out, pr.first, true);
+        out << "\":{\"type\":\"" << typeName(family.type) << "\",\"help\":\"";
+        escape(out, family.help, true);
+        out << "\",\"values\":[";
+        bool first_item = true;
+        for (auto &item : family.items) {
+            if (!first_item) {
+                out << ',';
+            }
+            first_item = false;
+            out << "{\"labels\":{";
+            bool first_label = true;
+            for (auto &label : item.labels) {
+                if (!first_label) {
+                    out << ',';
+                }
+                first_label = false;
+                out << '"';
+                escape(out, label.first, true);
+                out << "\":\"";
+                escape(out, label.second, true);
+                out << '"';
+            }
+            out << "},";
+            if (item.histogram) {
+                auto snap = item.histogram->snapshot();
+                out << "\"count\":" << snap.count << ",\"sum\":" << snap.sum << ",\"max\":" << snap.max
+                    << ",\"p50\":" << snap.percentile(0.5) << ",\"p90\":" << snap.percentile(0.9)
+                    << ",\"p99\":" << snap.percentile(0.99) << ",\"p999\":" << snap.percentile(0.999) << '}';
+                continue;
+            }
+            out << "\"value\":";
+            if (item.counter) {
+                out << item.counter->value();
+            } else if (item.gauge) {
+                out << item.gauge->value();
+            } else {
+                auto value = item.getter ? item.getter() : 0;
+                // json不支持nan与inf
+                // json does not support nan and inf
+                out << (std::isfinite(value) ? value : 0);
+            }
+            out << '}';
+        }
+        out << "]}";
+    }
+    out << '}';
+    return out.str();
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_METRICS_H_
+#define UTIL_METRICS_H_
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+namespace toolkit {
+
+/**
+ * 计数器，按线程分片累加，读取时汇总各分片
+ * 每个线程独占一个分片，写入只是一次普通的原子读写，无锁前缀也不竞争缓存行；线程数超过分片数时共用溢出分片
+ * Counter, accumulated in per-thread shards and summed up when read
+ * Each thread owns a shard exclusively, so a write is just a plain atomic load and store without lock prefix or cache line contention;
+ * threads beyond the shard count share the overflow shard
+ */
+class MetricsCounter {
+public:
+    using Ptr = std::shared_ptr<MetricsCounter>;
+
+    void add(uint64_t n = 1) {
+        auto index = shardIndex();
+        if (index < kShardCount) {
+            auto &value = _shards[index].value;
+            value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        } else {
+            _shards[kShardCount].value.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t value() const;
+
+    /**
+     * 当前线程独占的分片下标，等于kShardCount时表示使用溢出分片
+     * Index of the shard owned by the current thread, kShardCount means the overflow shard
+     */
+    static size_t shardIndex() {
+        auto ret = s_shard_index;
+        return ret != kUnassigned ? ret : claimShard();
+    }
+
+    static constexpr size_t kShardCount = 32;
+
+private:
+    static constexpr size_t kUnassigned = ~(size_t)0;
+
+    static size_t claimShard();
+
+    // 常量初始化，访问时无需检查是否已构造
+    // Constant initialized, no construction check is needed when accessed
+    static thread_local size_t s_shard_index;
+
+    struct Shard {
+        std::atomic<uint64_t> value { 0 };
+        // 与相邻分片隔开，避免伪共享
+        // Keep away from adjacent shards to avoid false sharing
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    Shard _shards[kShardCount + 1];
+};
+
+/**
+ * 瞬时值
+ * Instantaneous value
+ */
+class MetricsGauge {
+public:
+    using Ptr = std::shared_ptr<MetricsGauge>;
+
+    void set(int64_t value) { _value.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { _value.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> _value { 0 };
+};
+
+/**
+ * HDR风格的对数线性直方图，每个2的幂区间再均分为16个子桶，相对误差约6%
+ * 记录只是一次无锁的桶计数累加，适合在poller线程中统计耗时
+ * HDR style log-linear histogram, each power-of-two range is split into 16 sub buckets, the relative error is about 6%
+ * Recording is just a lock-free increment of a bucket counter, suitable for timing in poller threads
+ */
+class MetricsHistogram {
+public:
+    using Ptr = std::shared_ptr<MetricsHistogram>;
+
+    // 小于32的值精确记录，其余每个2的幂区间16个桶
+    // Values below 32 are recorded exactly, the others use 16 buckets per power of two
+    static constexpr size_t kBucketCount = 32 + (64 - 5) * 16;
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::vector<uint64_t> buckets;
+
+        /**
+         * 获取分位值，返回所在桶的上界
+         * @param q 分位，范围[0, 1]
+         * Get the quantile value, the upper bound of its bucket is returned
+         * @param q Quantile in the range [0, 1]
+         */
+        uint64_t percentile(double q) const;
+    };
+
+    void record(uint64_t value);
+
+    Snapshot snapshot() const;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    std::atomic<uint64_t> _sum { 0 };
+    std::atomic<uint64_t> _max { 0 };
+    std::atomic<uint64_t> _buckets[kBucketCount] {};
+};
+
+/**
+ * 指标注册表
+ * 注册表是不可变快照，注册时拷贝修改后原子替换，采集时只需原子获取快照，不加锁也不阻塞热路径；
+ * 可以导出Prometheus文本格式或json
+ * Metrics registry
+ * The registry is an immutable snapshot, registration copies, modifies and replaces it atomically,
+ * scraping only loads the snapshot atomically without locking or blocking the hot path;
+ * it can be exported in Prometheus text format or json
+ */
+class MetricsRegistry : public std::enable_shared_from_this<MetricsRegistry> {
+public:
+    using Ptr = std::shared_ptr<MetricsRegistry>;
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    enum class Type { Counter, Gauge, Histogram };
+
+    static MetricsRegistry &Instance();
+
+    /**
+     * 是否采集指标，关闭后各埋点只剩一次分支判断
+     * Whether to collect metrics, when disabled each probe costs only a branch
+     */
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    /**
+     * 获取或创建指标，名称与标签相同时返回同一个对象；名称已被其他类型占用时抛异常
+     * Get or create a metric, the same object is returned for the same name and labels;
+     * an exception is thrown if the name is already used by another type
+     */
+    MetricsCounter::Ptr counter(const std::string &name, const std::string &help, const Labels &labels = {});
+    MetricsGauge::Ptr gauge(const std::string &name, const std::string &help, const Labels &labels = {});
+    MetricsHistogram::Ptr histogram(const std::string &name, const std::string &help, const Labels &labels = {});
+
+    /**
+     * 注册采集时才计算的指标，用于导出已有的统计数据
+     * @param type 只能是Counter或Gauge
+     * Register a metric computed at scrape time, used to export existing statistics
+     * @param type Can only be Counter or Gauge
+     */
+    void addCallback(const std::string &name, const std::string &help, Type type, const Labels &labels, std::function<double()> getter);
+
+    /**
+     * 移除指标
+     * Remove a metric
+     */
+    void remove(const std::string &name, const Labels &labels = {});
+
+    std::string toPrometheus() const;
+    std::string toJson() const;
+
+private:
+    MetricsRegistry();
+
+    struct Item {
+        Labels labels;
+        std::shared_ptr<MetricsCounter> counter;
+        std::shared_ptr<MetricsGauge> gauge;
+        std::shared_ptr<MetricsHistogram> histogram;
+        std::function<double()> getter;
+    };
+
+    struct Family {
+        Type type;
+        std::string help;
+        std::vector<Item> items;
+    };
+
+    using FamilyMap = std::map<std::string, Family>;
+
+    Item &getItem(FamilyMap &families, const std::string &name, const std::string &help, Type type, const Labels &labels);
+    std::shared_ptr<const FamilyMap> getFamilies() const;
+
+private:
+    static std::atomic<bool> s_enabled;
+
+    std::mutex _mtx;
+    std::shared_ptr<const FamilyMap> _families;
+};
+
+} /* namespace toolkit */
+#endif /* UTIL_METRICS_H_ */
@@ -12,7 +12,9 @@
 #define SRC_UTIL_NOTICECENTER_H_
 
 #include <mutex>
+#include <atomic>
 #include <memory>
+#include <vector>
 #include <string>
 #include <exception>
 #include <functional>
@@ -23,6 +25,16 @@
 
 namespace toolkit {
 
+/**
+ * 事件监听者列表
+ * 监听者列表为不可变快照，增删监听时拷贝一份修改后原子替换(RCU)，触发事件时只需原子获取当前快照，不拷贝列表，也不与写者争用锁；
+ * 注意std::atomic_load/atomic_store对shared_ptr不保证无锁(libstdc++按地址使用内部的互斥锁池，只在拷贝指针期间持有)
+ * Event listener list
+ * The listener list is an immutable snapshot, adding or removing a listener copies it, modifies the copy and replaces it atomically (RCU),
+ * emitting an event only atomically loads the current snapshot, without copying the list or contending the writers' lock;
+ * note that std::atomic_load/atomic_store on shared_ptr are not guaranteed lock-free (libstdc++ uses an internal pool of
+ * mutexes picked by address, held only while the pointer is copied)
+ */
 class EventDispatcher {
 public:
     friend class NoticeCenter;
@@ -31,9 +43,9 @@ public:
     ~EventDispatcher() = default;
 
 private:
-    using MapType = std::unordered_multimap<void *, Any>;
+    using ListenerList = std::vector<std::pair<void *, Any>>;
 
-    EventDispatcher() = default;
+    EventDispatcher() : _listeners(std::make_shared<ListenerList>()) {}
 
     class InterruptException : public std::runtime_error {
     public:
@@ -44,18 +56,14 @@ private:
     template <typename... ArgsType>
     int emitEvent(bool safe, ArgsType &&...args) {
         using stl_func = std::function<void(decltype(std::forward<ArgsType>(args))...)>;
-        decltype(_mapListener) copy;
-        {
-            // 先拷贝(开销比较小)，目的是防止在触发回调时还是上锁状态从而导致交叉互锁  [AUTO-TRANSLATED:62bff466]
-            //First copy (lower overhead), to prevent cross-locking when triggering callbacks while still locked
-            std::lock_guard<std::recursive_mutex> lck(_mtxListener);
-            copy = _mapListener;
-        }
+        // 获取当前快照，回调中增删监听只会影响之后的事件，不会导致交叉互锁
+        // Get the current snapshot, adding or removing listeners in callbacks only affects subsequent events and never cross-locks
+        auto listeners = std::atomic_load(&_listeners);
 
         int ret = 0;
-        for (auto &pr : copy) {
+        for (auto &pr : *listeners) {
             try {
-                pr.second.get<stl_func>(safe)(std::forward<ArgsType>(args)...);
+                const_cast<Any &>(pr.second).get<stl_func>(safe)(std::forward<ArgsType>(args)...);
                 ++ret;
             } catch (InterruptException &) {
                 ++ret;
@@ -70,24 +78,52 @@ private:
         using stl_func = typename function_traits<typename std::remove_reference<FUNC>::type>::stl_function_type;
         Any listener;
         listener.set<stl_func>(std::forward<FUNC>(func));
-        std::lock_guard<std::recursive_mutex> lck(_mtxListener);
-        _mapListener.emplace(tag, listener);
+        std::lock_guard<std::mutex> lck(_mtxListener);
+        auto listeners = std::make_shared<ListenerList>(*_listeners);
+        listeners->emplace_back(tag, std::move(listener));
+        std::atomic_store(&_listeners, std::shared_ptr<const ListenerList>(std::move(listeners)));
     }
 
     void delListener(void *tag, bool &empty) {
-        std::lock_guard<std::recursive_mutex> lck(_mtxListener);
-        _mapListener.erase(tag);
-        empty = _mapListener.empty();
+        std::lock_guard<std::mutex> lck(_mtxListener);
+        auto listeners = std::make_shared<ListenerList>();
+        listeners->reserve(_listeners->size());
+        for (auto &pr : *_listeners) {
+            if (pr.first != tag) {
+                listeners->emplace_back(pr);
+            }
+        }
+        empty = listeners->empty();
+        if (listeners->size() != _listeners->size()) {
+            std::atomic_store(&_listeners, std::shared_ptr<const ListenerList>(std::move(listeners)));
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lck(_mtxListener);
+        std::atomic_store(&_listeners, std::shared_ptr<const ListenerList>(std::make_shared<ListenerList>()));
     }
 
 private:
-    std::recursive_mutex _mtxListener;
-    MapType _mapListener;
+    // 是否被事件句柄引用，被引用时监听者清空后也不移除
+    // Whether it is referenced by an event handle, it is not removed even if all listeners are deleted
+    std::atomic<bool> _pinned { false };
+    // 只用于串行化写操作
+    // Only used to serialize writers
+    std::mutex _mtxListener;
+    std::shared_ptr<const ListenerList> _listeners;
 };
 
 class NoticeCenter : public std::enable_shared_from_this<NoticeCenter> {
 public:
     using Ptr = std::shared_ptr<NoticeCenter>;
+    /**
+     * 预先解析的事件句柄，通过句柄触发事件可以跳过事件名查找
+     * Pre-resolved event handle, emitting through a handle skips the event name lookup
+     */
+    using EventHandle = EventDispatcher::Ptr;
+
+    NoticeCenter() : _mapListener(std::make_shared<DispatcherMap>()) {}
 
     static NoticeCenter &Instance();
 
@@ -101,6 +137,27 @@ public:
         return emitEvent_l(true, event, std::forward<ArgsType>(args)...);
     }
 
+    template <typename... ArgsType>
+    int emitEvent(const EventHandle &handle, ArgsType &&...args) {
+        return handle->emitEvent(false, std::forward<ArgsType>(args)...);
+    }
+
+    template <typename... ArgsType>
+    int emitEventSafe(const EventHandle &handle, ArgsType &&...args) {
+        return handle->emitEvent(true, std::forward<ArgsType>(args)...);
+    }
+
+    /**
+     * 获取事件句柄，句柄在本对象生命周期内一直有效，之后对该事件的增删监听均对句柄可见
+     * Get the event handle, the handle stays valid during the lifetime of this object,
+     * listeners added to or removed from the event afterwards are all visible through the handle
+     */
+    EventHandle getEventHandle(const std::string &event) {
+        auto dispatcher = getDispatcher(event, true);
+        dispatcher->_pinned = true;
+        return dispatcher;
+    }
+
     template <typename FUNC>
     void addListener(void *tag, const std::string &event, FUNC &&func) {
         getDispatcher(event, true)->addListener(tag, std::forward<FUNC>(func));
@@ -124,23 +181,34 @@ public:
     //This method has poor performance
     void delListener(void *tag) {
         std::lock_guard<std::recursive_mutex> lck(_mtxListener);
+        auto map = std::make_shared<DispatcherMap>();
         bool empty;
-        for (auto it = _mapListener.begin(); it != _mapListener.end();) {
-            it->second->delListener(tag, empty);
-            if (empty) {
-                it = _mapListener.erase(it);
-                continue;
+        for (auto &pr : *_mapListener) {
+            pr.second->delListener(tag, empty);
+            if (!empty || pr.second->_pinned) {
+                map->emplace(pr);
             }
-            ++it;
         }
+        std::atomic_store(&_mapListener, std::shared_ptr<const DispatcherMap>(std::move(map)));
     }
 
     void clearAll() {
         std::lock_guard<std::recursive_mutex> lck(_mtxListener);
-        _mapListener.clear();
+        // 被句柄引用的事件保留，只清空其监听者
+        // Keep the events referenced by handles and only clear their listeners
+        auto map = std::make_shared<DispatcherMap>();
+        for (auto &pr : *_mapListener) {
+            if (pr.second->_pinned) {
+                pr.second->clear();
+                map->emplace(pr);
+            }
+        }
+        std::atomic_store(&_mapListener, std::shared_ptr<const DispatcherMap>(std::move(map)));
     }
 
 private:
+    using DispatcherMap = std::unordered_map<std::string, EventDispatcher::Ptr>;
+
     template <typename... ArgsType>
     int emitEvent_l(bool safe, const std::string &event, ArgsType &&...args) {
         auto dispatcher = getDispatcher(event);
@@ -153,34 +221,49 @@ private:
     }
 
     EventDispatcher::Ptr getDispatcher(const std::string &event, bool create = false) {
+        {
+            // 读路径不持有_mtxListener，只原子获取当前快照
+            // The read path does not hold _mtxListener, it only atomically loads the current snapshot
+            auto map = std::atomic_load(&_mapListener);
+            auto it = map->find(event);
+            if (it != map->end()) {
+                return it->second;
+            }
+            if (!create) {
+                return nullptr;
+            }
+        }
         std::lock_guard<std::recursive_mutex> lck(_mtxListener);
-        auto it = _mapListener.find(event);
-        if (it != _mapListener.end()) {
+        auto it = _mapListener->find(event);
+        if (it != _mapListener->end()) {
             return it->second;
         }
-        if (create) {
-            // 如果为空则创建一个  [AUTO-TRANSLATED:8412a9ae]
-            //Create one if it is empty
-            EventDispatcher::Ptr dispatcher(new EventDispatcher());
-            _mapListener.emplace(event, dispatcher);
-            return dispatcher;
-        }
-        return nullptr;
+        // 如果为空则创建一个  [AUTO-TRANSLATED:8412a9ae]
+        //Create one if it is empty
+        EventDispatcher::Ptr dispatcher(new EventDispatcher());
+        auto map = std::make_shared<DispatcherMap>(*_mapListener);
+        map->emplace(event, dispatcher);
+        std::atomic_store(&_mapListener, std::shared_ptr<const DispatcherMap>(std::move(map)));
+        return dispatcher;
     }
 
     void delDispatcher(const std::string &event, const EventDispatcher::Ptr &dispatcher) {
         std::lock_guard<std::recursive_mutex> lck(_mtxListener);
-        auto it = _mapListener.find(event);
-        if (it != _mapListener.end() && dispatcher == it->second) {
+        auto it = _mapListener->find(event);
+        if (it != _mapListener->end() && dispatcher == it->second && !dispatcher->_pinned) {
             // 两者相同则删除  [AUTO-TRANSLATED:8d84179d]
             //If both are the same, delete it
-            _mapListener.erase(it);
+            auto map = std::make_shared<DispatcherMap>(*_mapListener);
+            map->erase(event);
+            std::atomic_store(&_mapListener, std::shared_ptr<const DispatcherMap>(std::move(map)));
         }
     }
 
 private:
+    // 只用于串行化写操作
+    // Only used to serialize writers
     std::recursive_mutex _mtxListener;
-    std::unordered_map<std::string, EventDispatcher::Ptr> _mapListener;
+    std::shared_ptr<const DispatcherMap> _mapListener;
 };
 
 template <typename T>
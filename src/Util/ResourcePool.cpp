@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "ResourcePool.h"
+
+using namespace std;
+
+namespace toolkit {
+
+/**
+ * 线程缓存，按池对象地址直接映射到固定个数的槽位；
+ * 槽位被其他池占用时，先把原有节点归还给原来的池再换绑
+ * Thread cache, pools are directly mapped to a fixed number of slots by address;
+ * when a slot is occupied by another pool, its nodes are returned to the original pool before rebinding
+ */
+class PoolThreadCache {
+public:
+    struct Slot {
+        ThreadCachedPoolBase *pool = nullptr;
+        PoolNodeBase *head = nullptr;
+        uint32_t count = 0;
+    };
+
+    ~PoolThreadCache() {
+        s_destroyed = true;
+        for (auto &slot : _slots) {
+            flush(slot);
+        }
+    }
+
+    /**
+     * 获取当前线程中池对应的槽位，线程退出过程中线程缓存已析构时返回nullptr
+     * Get the slot of the pool in the current thread, nullptr is returned if the thread cache is destructed during thread exit
+     */
+    static Slot *get(ThreadCachedPoolBase *pool);
+
+    static void flush(Slot &slot) {
+        if (slot.pool && slot.head) {
+            slot.pool->returnNodes(slot.head, slot.count);
+        }
+        slot.pool = nullptr;
+        slot.head = nullptr;
+        slot.count = 0;
+    }
+
+private:
+    static constexpr size_t kSlotCount = 16;
+    static thread_local bool s_destroyed;
+    Slot _slots[kSlotCount];
+};
+
+thread_local bool PoolThreadCache::s_destroyed = false;
+
+PoolThreadCache::Slot *PoolThreadCache::get(ThreadCachedPoolBase *pool) {
+    if (s_destroyed) {
+        return nullptr;
+    }
+    static thread_local PoolThreadCache s_cache;
+    auto &slot = s_cache._slots[((uintptr_t)pool >> 6) % kSlotCount];
+    if (slot.pool != pool) {
+        flush(slot);
+        slot.pool = pool;
+    }
+    return &slot;
+}
+
+PoolNodeBase *ThreadCachedPoolBase::obtainNode() {
+    auto slot = PoolThreadCache::get(this);
+    if (slot && !slot->head) {
+        uint32_t count;
+        slot->head = popBatch(count);
+        slot->count = count;
+        if (slot->head) {
+            _refill.add();
+        }
+    } else if (slot) {
+        _hit.add();
+    }
+    if (slot && slot->head) {
+        auto ret = slot->head;
+        slot->head = ret->next;
+        --slot->count;
+        ret->next = nullptr;
+        return ret;
+    }
+    _miss.add();
+    _refs.fetch_add(1, memory_order_relaxed);
+    return allocNode();
+}
+
+void ThreadCachedPoolBase::recycleNode(PoolNodeBase *node) {
+    if (_closed.load(memory_order_acquire)) {
+        discardNode(node);
+        return;
+    }
+    auto slot = PoolThreadCache::get(this);
+    if (!slot) {
+        node->next = nullptr;
+        returnNodes(node, 1);
+        return;
+    }
+    node->next = slot->head;
+    slot->head = node;
+    if (++slot->count < kBatchSize * 2) {
+        return;
+    }
+    // 把前一批交给全局栈，保留后一批
+    // Hand the first batch over to the global stack and keep the second
+    auto tail = slot->head;
+    for (uint32_t i = 1; i < kBatchSize; ++i) {
+        tail = tail->next;
+    }
+    auto batch = slot->head;
+    slot->head = tail->next;
+    slot->count -= kBatchSize;
+    tail->next = nullptr;
+    returnNodes(batch, kBatchSize);
+}
+
+void ThreadCachedPoolBase::discardNode(PoolNodeBase *node) {
+    freeNode(node);
+    unref();
+}
+
+void ThreadCachedPoolBase::returnNodes(PoolNodeBase *head, uint32_t count) {
+    // 持有一个引用，防止归还过程中池被其他线程释放
+    // Hold a reference to prevent the pool from being freed by other threads while returning
+    _refs.fetch_add(1, memory_order_relaxed);
+    if (_closed.load(memory_order_acquire)) {
+        freeChain(head);
+    } else if (_global_count.load(memory_order_relaxed) + count > _max_size) {
+        _overflow.add(count);
+        freeChain(head);
+    } else {
+        _drain.add();
+        pushBatch(head, count);
+        if (_closed.load(memory_order_acquire)) {
+            // 与close()竞争，由本线程清理
+            // Racing with close(), clean up by this thread
+            freeStack(_global.exchange(nullptr, memory_order_acquire));
+        }
+    }
+    unref();
+}
+
+void ThreadCachedPoolBase::close() {
+    _closed.store(true, memory_order_release);
+    // 本线程缓存的节点可以立即释放，其他线程缓存的节点在其换绑或退出时释放
+    // Nodes cached by this thread can be freed immediately, nodes cached by other threads are freed when they rebind or exit
+    if (auto slot = PoolThreadCache::get(this)) {
+        PoolThreadCache::flush(*slot);
+    }
+    freeStack(_global.exchange(nullptr, memory_order_acquire));
+    unref();
+}
+
+ThreadCachedPoolBase::Stats ThreadCachedPoolBase::getStats() const {
+    Stats ret;
+    ret.hit = _hit.value();
+    ret.refill = _refill.value();
+    ret.miss = _miss.value();
+    ret.drain = _drain.value();
+    ret.overflow = _overflow.value();
+    ret.alive = _refs.load(memory_order_relaxed) - 1;
+    return ret;
+}
+
+void ThreadCachedPoolBase::freeChain(PoolNodeBase *head) {
+    while (head) {
+        auto next = head->next;
+        discardNode(head);
+        head = next;
+    }
+}
+
+void ThreadCachedPoolBase::freeStack(PoolNodeBase *top) {
+    while (top) {
+        auto next_batch = top->next_batch;
+        freeChain(top);
+        top = next_batch;
+    }
+}
+
+void ThreadCachedPoolBase::pushBatch(PoolNodeBase *head, uint32_t count) {
+    // 批次的个数记在首节点的ref中，节点空闲时ref无其他用途
+    // The count of the batch is stored in the ref of the first node, ref has no other use while the node is idle
+    head->ref.store(count, memory_order_relaxed);
+    _global_count.fetch_add(count, memory_order_relaxed);
+    auto top = _global.load(memory_order_relaxed);
+    do {
+        head->next_batch = top;
+    } while (!_global.compare_exchange_weak(top, head, memory_order_release, memory_order_relaxed));
+}
+
+PoolNodeBase *ThreadCachedPoolBase::popBatch(uint32_t &count) {
+    count = 0;
+    if (!_global.load(memory_order_relaxed)) {
+        return nullptr;
+    }
+    // 整体取出再放回剩余部分，只用exchange与push，避免无锁栈pop的ABA问题
+    // Take all and push the rest back, only exchange and push are used to avoid the ABA problem of lock-free stack pop
+    auto head = _global.exchange(nullptr, memory_order_acquire);
+    if (!head) {
+        return nullptr;
+    }
+    auto rest = head->next_batch;
+    head->next_batch = nullptr;
+    count = head->ref.load(memory_order_relaxed);
+    _global_count.fetch_sub(count, memory_order_relaxed);
+    if (rest) {
+        auto tail = rest;
+        while (tail->next_batch) {
+            tail = tail->next_batch;
+        }
+        auto top = _global.load(memory_order_relaxed);
+        do {
+            tail->next_batch = top;
+        } while (!_global.compare_exchange_weak(top, rest, memory_order_release, memory_order_relaxed));
+    }
+    return head;
+}
+
+void ThreadCachedPoolBase::unref() {
+    if (_refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+} /* namespace toolkit */
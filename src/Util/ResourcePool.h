@@ -12,11 +12,13 @@
 #define UTIL_RECYCLEPOOL_H_
 
 #include "List.h"
+#include "Metrics.h"
 #include <atomic>
 #include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <type_traits>
 #include <unordered_set>
 
 namespace toolkit {
@@ -223,5 +225,252 @@ shared_ptr_imp<C>::shared_ptr_imp(C *ptr,
             }
         }), _quit(std::move(quit)) {}
 
+/**
+ * 线程缓存循环池中对象节点的公共部分
+ * Common part of the object nodes in the thread cached pool
+ */
+struct PoolNodeBase {
+    // 同一批次内的下一个节点
+    // The next node in the same batch
+    PoolNodeBase *next = nullptr;
+    // 全局栈中的下一个批次，仅批次首节点有效
+    // The next batch in the global stack, only valid on the first node of a batch
+    PoolNodeBase *next_batch = nullptr;
+    std::atomic<uint32_t> ref { 0 };
+    // 释放时不回收
+    // Do not recycle when released
+    bool quit = false;
+};
+
+/**
+ * 线程缓存循环池的非模板部分
+ * 每个线程缓存少量空闲对象，获取与归还只操作线程缓存；缓存为空时从全局无锁栈整批取回，缓存过多时整批归还；
+ * 池对象销毁后，仍在外部或线程缓存中的节点在归还时释放，最后一个节点释放时池本身才释放
+ * Non-template part of the thread cached pool
+ * Each thread caches a few idle objects, obtaining and returning only touch the thread cache;
+ * when the cache is empty a whole batch is taken from the global lock-free stack, and when it holds too many a whole batch is returned;
+ * after the pool object is destroyed, nodes still held outside or in thread caches are freed when returned,
+ * and the pool itself is freed with the last node
+ */
+class ThreadCachedPoolBase {
+public:
+    struct Stats {
+        // 命中线程缓存
+        // Served by the thread cache
+        uint64_t hit = 0;
+        // 从全局栈整批取回
+        // Batches taken from the global stack
+        uint64_t refill = 0;
+        // 无空闲对象，新建
+        // No idle object, newly created
+        uint64_t miss = 0;
+        // 整批归还到全局栈
+        // Batches returned to the global stack
+        uint64_t drain = 0;
+        // 全局栈已满而销毁的对象
+        // Objects destroyed because the global stack was full
+        uint64_t overflow = 0;
+        // 当前存活的对象数
+        // Objects currently alive
+        uint64_t alive = 0;
+    };
+
+    // 每批次的对象数，线程缓存最多缓存两批
+    // Objects per batch, a thread cache holds two batches at most
+    static constexpr uint32_t kBatchSize = 32;
+
+    void setSize(size_t size) { _max_size = size; }
+    Stats getStats() const;
+
+    PoolNodeBase *obtainNode();
+    void recycleNode(PoolNodeBase *node);
+    // 直接销毁节点，不回收
+    // Destroy the node directly without recycling
+    void discardNode(PoolNodeBase *node);
+
+    /**
+     * 由池的持有者在析构时调用，之后归还的节点都被销毁
+     * Called by the owner of the pool on destruction, nodes returned afterwards are all destroyed
+     */
+    void close();
+
+    /**
+     * 把一串节点归还给池，线程缓存换绑或线程退出时调用
+     * Return a chain of nodes to the pool, called when a thread cache is rebound or the thread exits
+     */
+    void returnNodes(PoolNodeBase *head, uint32_t count);
+
+protected:
+    ThreadCachedPoolBase() = default;
+    virtual ~ThreadCachedPoolBase() = default;
+
+    virtual PoolNodeBase *allocNode() = 0;
+    virtual void freeNode(PoolNodeBase *node) = 0;
+
+private:
+    void freeChain(PoolNodeBase *head);
+    void freeStack(PoolNodeBase *top);
+    void pushBatch(PoolNodeBase *head, uint32_t count);
+    PoolNodeBase *popBatch(uint32_t &count);
+    void unref();
+
+private:
+    std::atomic<bool> _closed { false };
+    // 存活的节点数，加上持有者的1个引用，归零时释放自身
+    // Alive nodes plus 1 reference of the owner, the pool frees itself when it reaches zero
+    std::atomic<size_t> _refs { 1 };
+    std::atomic<size_t> _global_count { 0 };
+    std::atomic<PoolNodeBase *> _global { nullptr };
+    size_t _max_size = 1024;
+    MetricsCounter _hit;
+    MetricsCounter _refill;
+    MetricsCounter _miss;
+    MetricsCounter _drain;
+    MetricsCounter _overflow;
+};
+
+template <typename C>
+class ThreadCachedPool;
+
+template <typename C>
+class ThreadCachedPool_l final : public ThreadCachedPoolBase {
+public:
+    struct Node : public PoolNodeBase {
+        ThreadCachedPool_l *pool;
+        typename std::aligned_storage<sizeof(C), alignof(C)>::type storage;
+
+        C *get() { return reinterpret_cast<C *>(&storage); }
+    };
+
+    ThreadCachedPool_l() {
+        _construct = [](void *ptr) { new (ptr) C(); };
+    }
+
+#if defined(SUPPORT_DYNAMIC_TEMPLATE)
+    template <typename... ArgTypes>
+    ThreadCachedPool_l(ArgTypes &&...args) {
+        _construct = [args...](void *ptr) { new (ptr) C(args...); };
+    }
+#endif // defined(SUPPORT_DYNAMIC_TEMPLATE)
+
+protected:
+    PoolNodeBase *allocNode() override {
+        auto node = new Node;
+        node->pool = this;
+        _construct(&node->storage);
+        return node;
+    }
+
+    void freeNode(PoolNodeBase *node) override {
+        auto ptr = static_cast<Node *>(node);
+        ptr->get()->~C();
+        delete ptr;
+    }
+
+private:
+    std::function<void(void *)> _construct;
+};
+
+/**
+ * 线程缓存循环池返回的侵入式智能指针，引用计数存放在对象节点中，复制与释放都不分配内存
+ * Intrusive smart pointer returned by the thread cached pool, the reference count is stored in the object node,
+ * neither copying nor releasing allocates memory
+ */
+template <typename C>
+class pooled_ptr {
+public:
+    using Node = typename ThreadCachedPool_l<C>::Node;
+
+    pooled_ptr() = default;
+    explicit pooled_ptr(Node *node) : _node(node) {
+        _node->ref.store(1, std::memory_order_relaxed);
+    }
+    pooled_ptr(const pooled_ptr &that) : _node(that._node) {
+        if (_node) {
+            _node->ref.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    pooled_ptr(pooled_ptr &&that) : _node(that._node) { that._node = nullptr; }
+    ~pooled_ptr() { reset(); }
+
+    pooled_ptr &operator=(pooled_ptr that) {
+        std::swap(_node, that._node);
+        return *this;
+    }
+
+    void reset() {
+        if (_node && _node->ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (_node->quit) {
+                _node->pool->discardNode(_node);
+            } else {
+                _node->pool->recycleNode(_node);
+            }
+        }
+        _node = nullptr;
+    }
+
+    /**
+     * 放弃或恢复回到循环池继续使用
+     * Abandon or recover to continue using in the circular pool
+     */
+    void quit(bool flag = true) {
+        if (_node) {
+            _node->quit = flag;
+        }
+    }
+
+    C *get() const { return _node ? _node->get() : nullptr; }
+    C &operator*() const { return *get(); }
+    C *operator->() const { return get(); }
+    explicit operator bool() const { return _node != nullptr; }
+    uint32_t use_count() const { return _node ? _node->ref.load(std::memory_order_relaxed) : 0; }
+
+private:
+    Node *_node = nullptr;
+};
+
+/**
+ * 线程缓存循环池，多线程并发获取与归还时不加锁、不分配内存
+ * 与ResourcePool相同，对象只构造一次，回收后保留原有内容
+ * Thread cached circular pool, concurrent obtaining and returning from multiple threads neither lock nor allocate memory
+ * Same as ResourcePool, objects are constructed only once and keep their content after being recycled
+ * @tparam C
+ */
+template <typename C>
+class ThreadCachedPool {
+public:
+    using ValuePtr = pooled_ptr<C>;
+    using Stats = ThreadCachedPoolBase::Stats;
+
+    ThreadCachedPool() {
+        _pool = new ThreadCachedPool_l<C>();
+    }
+
+#if defined(SUPPORT_DYNAMIC_TEMPLATE)
+    template <typename... ArgTypes>
+    ThreadCachedPool(ArgTypes &&...args) {
+        _pool = new ThreadCachedPool_l<C>(std::forward<ArgTypes>(args)...);
+    }
+#endif // defined(SUPPORT_DYNAMIC_TEMPLATE)
+
+    ~ThreadCachedPool() { _pool->close(); }
+
+    ThreadCachedPool(const ThreadCachedPool &) = delete;
+    ThreadCachedPool &operator=(const ThreadCachedPool &) = delete;
+
+    /**
+     * 设置全局栈最多保存的空闲对象数，超出的对象被销毁；线程缓存另外最多保存两批
+     * Set the max idle objects kept in the global stack, the excess is destroyed; each thread cache additionally keeps two batches at most
+     */
+    void setSize(size_t size) { _pool->setSize(size); }
+
+    ValuePtr obtain() { return ValuePtr(static_cast<typename ValuePtr::Node *>(_pool->obtainNode())); }
+
+    Stats getStats() const { return _pool->getStats(); }
+
+private:
+    ThreadCachedPool_l<C> *_pool;
+};
+
 } /* namespace toolkit */
 #endif /* UTIL_RECYCLEPOOL_H_ */
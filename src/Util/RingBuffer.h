@@ -20,6 +20,7 @@
 #include <functional>
 #include "util.h"
 #include "List.h"
+#include "SpscQueue.h"
 #include "Poller/EventPoller.h"
 
 // GOP缓存最大长度下限值  [AUTO-TRANSLATED:63162058]
@@ -282,6 +283,37 @@ private:
         _storage->write(std::move(in), is_key);
     }
 
+    /**
+     * 批量派发模式下由写线程调用，把数据追加到无锁列队
+     * @return 列队是否由空变为非空，为true时调用者需要切换到poller线程执行flushBatch
+     * Called by the writer thread in batch delivery mode, append data to the lock-free queue
+     * @return Whether the queue went from empty to non-empty, if true the caller should run flushBatch in the poller thread
+     */
+    bool pushBatch(T in, bool is_key) {
+        _batch_queue.emplace(is_key, std::move(in));
+        return _batch_pending.fetch_add(1) == 0;
+    }
+
+    /**
+     * 在poller线程中一次性派发列队中所有数据
+     * Dispatch all queued data in one pass in the poller thread
+     */
+    void flushBatch() {
+        std::pair<bool, T> item;
+        for (;;) {
+            int64_t count = 0;
+            while (_batch_queue.try_pop(item)) {
+                write(std::move(item.second), item.first);
+                ++count;
+            }
+            if (_batch_pending.fetch_sub(count) <= count) {
+                // 列队已经清空，下次写入时再唤醒本线程
+                // The queue is drained, the next write will wake up this thread again
+                break;
+            }
+        }
+    }
+
     void sendMessage(const Any &data) {
         for (auto it = _reader_map.begin(); it != _reader_map.end();) {
             auto reader = it->second.lock();
@@ -349,6 +381,10 @@ private:
     std::function<void(int, bool)> _on_size_changed;
     typename RingStorage::Ptr _storage;
     std::unordered_map<void *, std::weak_ptr<RingReader>> _reader_map;
+    // 批量派发列队，写线程生产，poller线程消费
+    // Batch delivery queue, produced by the writer thread and consumed by the poller thread
+    std::atomic<int64_t> _batch_pending { 0 };
+    SpscQueue<std::pair<bool, T>> _batch_queue;
 };
 
 template <typename T>
@@ -380,6 +416,14 @@ public:
         LOCK_GUARD(_mtx_map);
         for (auto &pr : _dispatcher_map) {
             auto &second = pr.second;
+            if (_batch_delivery) {
+                // 批量派发模式，只有列队由空变为非空时才切换线程
+                // Batch delivery mode, switch thread only when the queue goes from empty to non-empty
+                if (second->pushBatch(in, is_key)) {
+                    pr.first->async([second]() { second->flushBatch(); }, false);
+                }
+                continue;
+            }
             //切换线程后触发onRead事件  [AUTO-TRANSLATED:4ca6647d]
             //Switch thread and trigger onRead event
             pr.first->async([second, in, is_key]() mutable { second->write(std::move(in), is_key); }, false);
@@ -399,6 +443,20 @@ public:
 
     void setDelegate(const typename RingDelegate<T>::Ptr &delegate) { _delegate = delegate; }
 
+    /**
+     * 开启或关闭批量派发模式
+     * 开启后，每个poller的数据先写入无锁列队，列队由空变为非空时才切换一次线程，
+     * 然后在poller线程中一次性派发所有积压的数据，减少高帧率下的线程切换和内存分配
+     * Enable or disable batch delivery mode
+     * When enabled, data for each poller is appended to a lock-free queue and the thread switch is only scheduled
+     * when the queue goes from empty to non-empty, then all pending data is dispatched in one pass in the poller thread,
+     * which reduces thread switches and allocations at high frame rates
+     */
+    void enableBatchDelivery(bool enable = true) {
+        LOCK_GUARD(_mtx_map);
+        _batch_delivery = enable;
+    }
+
     std::shared_ptr<RingReader> attach(const EventPoller::Ptr &poller, bool use_cache = true) {
         typename RingReaderDispatcher::Ptr dispatcher;
         {
@@ -495,6 +553,7 @@ private:
     };
 
 private:
+    bool _batch_delivery = false;
     std::mutex _mtx_map;
     std::atomic_int _total_count { 0 };
     typename RingStorage::Ptr _storage;
@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace toolkit {
 
@@ -29,6 +30,7 @@ public:
     SHA1();
 
     void update(const std::string &s);
+    void update(const char *data, size_t size);
     void update(std::istream &is);
     std::string final();
     std::string final_bin();
@@ -38,6 +40,12 @@ public:
     static std::string encode(const std::string &s);
     static std::string encode_bin(const std::string &s);
 
+    /**
+     * 批量计算多条独立消息的摘要，支持时使用SHA-NI或者多通道simd并行计算
+     * Compute the digests of multiple independent messages, SHA-NI or multi-lane simd is used when supported
+     */
+    static std::vector<std::string> encode_bin_batch(const std::vector<std::string> &msgs);
+
 private:
     uint32_t digest[5];
     std::string buffer;
@@ -11,6 +11,8 @@
 #include "SSLBox.h"
 #include "onceToken.h"
 #include "SSLUtil.h"
+#include "SSLSessionCache.h"
+#include "Trace.h"
 
 #if defined(ENABLE_OPENSSL)
 #include <openssl/ssl.h>
@@ -115,28 +117,65 @@ int SSL_Initor::findCertificate(SSL *ssl, int *, void *arg) {
     if (!ssl) {
         return SSL_TLSEXT_ERR_ALERT_FATAL;
     }
+    auto ctx = selectCertificate(SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name), (bool) (arg));
+    if (!ctx) {
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+    }
+    SSL_set_SSL_CTX(ssl, ctx);
+    return SSL_TLSEXT_ERR_OK;
+#endif
+}
 
+int SSL_Initor::onClientHello(SSL *ssl, int *al, void *arg) {
+#if !defined(ENABLE_OPENSSL) || OPENSSL_VERSION_NUMBER < 0x10101000L
+    return 1;
+#else
+    // server_name扩展: 2字节列表长度，之后为1字节名称类型、2字节名称长度与名称
+    // server_name extension: 2 bytes list length, followed by 1 byte name type, 2 bytes name length and the name
+    string vhost;
+    const unsigned char *ext = nullptr;
+    size_t ext_len = 0;
+    if (SSL_client_hello_get0_ext(ssl, TLSEXT_TYPE_server_name, &ext, &ext_len) && ext_len > 5
+        && ((size_t)ext[0] << 8 | ext[1]) + 2 == ext_len && ext[2] == TLSEXT_NAMETYPE_host_name) {
+        auto name_len = (size_t)ext[3] << 8 | ext[4];
+        if (name_len + 5 <= ext_len) {
+            vhost.assign((const char *)ext + 5, name_len);
+        }
+    }
+    auto ctx = selectCertificate(vhost.empty() ? nullptr : vhost.data(), (bool) (arg));
+    if (!ctx) {
+        *al = SSL_AD_UNRECOGNIZED_NAME;
+        return SSL_CLIENT_HELLO_ERROR;
+    }
+    SSL_set_SSL_CTX(ssl, ctx);
+    return SSL_CLIENT_HELLO_SUCCESS;
+#endif
+}
+
+SSL_CTX *SSL_Initor::selectCertificate(const char *vhost, bool server_mode) {
+#if !defined(ENABLE_OPENSSL)
+    return nullptr;
+#else
     SSL_CTX *ctx = nullptr;
     static auto &ref = SSL_Initor::Instance();
-    const char *vhost = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
 
     if (vhost && vhost[0] != '\0') {
         //根据域名找到证书  [AUTO-TRANSLATED:783a55d8]
         //Find the certificate based on the domain name
-        ctx = ref.getSSLCtx(vhost, (bool) (arg)).get();
+        ctx = ref.getSSLCtx(vhost, server_mode).get();
         if (!ctx) {
             //未找到对应的证书  [AUTO-TRANSLATED:d4550e6f]
             //No corresponding certificate found
             std::lock_guard<std::recursive_mutex> lck(ref._mtx);
             WarnL << "Can not find any certificate of host: " << vhost
-                  << ", select default certificate of: " << ref._default_vhost[(bool) (arg)];
+                  << ", select default certificate of: " << ref._default_vhost[server_mode];
         }
     }
 
     if (!ctx) {
         //客户端未指定域名或者指定的证书不存在，那么选择一个默认的证书  [AUTO-TRANSLATED:35115b5c]
         //The client did not specify a domain name or the specified certificate does not exist, so a default certificate is selected
-        ctx = ref.getSSLCtx("", (bool) (arg)).get();
+        ctx = ref.getSSLCtx("", server_mode).get();
     }
 
     if (!ctx) {
@@ -144,11 +183,8 @@ int SSL_Initor::findCertificate(SSL *ssl, int *, void *arg) {
         //No valid certificate available
         WarnL << "Can not find any available certificate of host: " << (vhost ? vhost : "default host")
               << ", tls handshake failed";
-        return SSL_TLSEXT_ERR_ALERT_FATAL;
     }
-
-    SSL_set_SSL_CTX(ssl, ctx);
-    return SSL_TLSEXT_ERR_OK;
+    return ctx;
 #endif
 }
 
@@ -159,12 +195,23 @@ bool SSL_Initor::setContext(const string &vhost, const shared_ptr<SSL_CTX> &ctx,
     }
     setupCtx(ctx.get());
 #if defined(ENABLE_OPENSSL)
+    SSLSessionCache::Instance().setupCtx(ctx.get(), server_mode, vhost);
+    if (server_mode && !_session_tickets) {
+        SSL_CTX_set_options(ctx.get(), SSL_OP_NO_TICKET);
+    }
     if (vhost.empty()) {
         _ctx_empty[server_mode] = ctx;
 #ifdef SSL_ENABLE_SNI
         if (server_mode) {
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            // 在会话恢复之前选择证书，servername回调触发时会话已经按初始SSL_CTX查找过了
+            // Select the certificate before session resumption, sessions have already been looked up with the initial
+            // SSL_CTX when the servername callback fires
+            SSL_CTX_set_client_hello_cb(ctx.get(), onClientHello, (void *) server_mode);
+#else
             SSL_CTX_set_tlsext_servername_callback(ctx.get(), findCertificate);
             SSL_CTX_set_tlsext_servername_arg(ctx.get(), (void *) server_mode);
+#endif
         }
 #endif // SSL_ENABLE_SNI
 
@@ -313,6 +360,49 @@ std::shared_ptr<SSL_CTX> SSL_Initor::getSSLCtx_l(const string &vhost_in, bool se
     return it->second;
 }
 
+void SSL_Initor::forEachCtx(bool server_mode, const function<void(SSL_CTX *ctx)> &cb) {
+    std::lock_guard<std::recursive_mutex> lck(_mtx);
+    if (_ctx_empty[server_mode]) {
+        cb(_ctx_empty[server_mode].get());
+    }
+    for (auto &pr : _ctxs[server_mode]) {
+        cb(pr.second.get());
+    }
+}
+
+void SSL_Initor::setSessionCache(size_t max_sessions, uint32_t timeout_sec) {
+    auto &cache = SSLSessionCache::Instance();
+    cache.setMaxSessions(max_sessions);
+    cache.setTimeout(timeout_sec);
+#if defined(ENABLE_OPENSSL)
+    for (auto server_mode : { false, true }) {
+        forEachCtx(server_mode, [&](SSL_CTX *ctx) { SSL_CTX_set_timeout(ctx, cache.getTimeout()); });
+    }
+#endif //defined(ENABLE_OPENSSL)
+}
+
+void SSL_Initor::setTicketKeyRotation(uint32_t sec) {
+    SSLSessionCache::Instance().setTicketKeyRotation(sec);
+}
+
+void SSL_Initor::enableSessionTickets(bool enable) {
+    std::lock_guard<std::recursive_mutex> lck(_mtx);
+    _session_tickets = enable;
+#if defined(ENABLE_OPENSSL)
+    forEachCtx(true, [&](SSL_CTX *ctx) {
+        enable ? SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET) : SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    });
+#endif //defined(ENABLE_OPENSSL)
+}
+
+void SSL_Initor::enableClientSessionResumption(bool enable) {
+    SSLSessionCache::Instance().enableClientResumption(enable);
+}
+
+uint64_t SSL_Initor::getHandshakeCount(bool server_mode, bool resumed) const {
+    return SSLSessionCache::Instance().getHandshakeCount(server_mode, resumed);
+}
+
 string SSL_Initor::defaultVhost(bool server_mode) {
     std::lock_guard<std::recursive_mutex> lck(_mtx);
     return _default_vhost[server_mode];
@@ -403,6 +493,25 @@ void SSL_Box::onSend(Buffer::Ptr buffer) {
 #endif //defined(ENABLE_OPENSSL)
 }
 
+void SSL_Box::startHandshake() {
+#if defined(ENABLE_OPENSSL)
+    if (!_ssl || _server_mode || _send_handshake) {
+        return;
+    }
+    _send_handshake = true;
+    SSL_do_handshake(_ssl.get());
+    flush();
+#endif //defined(ENABLE_OPENSSL)
+}
+
+void SSL_Box::setSessionKey(const string &key) {
+#if defined(ENABLE_OPENSSL)
+    if (_ssl && !_server_mode && !_send_handshake) {
+        SSLSessionCache::Instance().setClientSession(_ssl.get(), key);
+    }
+#endif //defined(ENABLE_OPENSSL)
+}
+
 void SSL_Box::setOnDecData(const function<void(const Buffer::Ptr &)> &cb) {
     _on_dec = cb;
 }
@@ -454,12 +563,15 @@ void SSL_Box::flushReadBio() {
     auto buffer_bio = _buffer_pool.obtain2();
     buffer_bio->setCapacity(_buff_size);
     auto buf_size = buffer_bio->getCapacity() - 1;
-    do {
-        nread = SSL_read(_ssl.get(), buffer_bio->data() + total, buf_size - total);
-        if (nread > 0) {
-            total += nread;
-        }
-    } while (nread > 0 && buf_size - total > 0);
+    {
+        TRACE_SCOPE("ssl_decrypt");
+        do {
+            nread = SSL_read(_ssl.get(), buffer_bio->data() + total, buf_size - total);
+            if (nread > 0) {
+                total += nread;
+            }
+        } while (nread > 0 && buf_size - total > 0);
+    }
 
     if (!total) {
         //未有数据  [AUTO-TRANSLATED:9ae3aaa5]
@@ -495,6 +607,10 @@ void SSL_Box::flush() {
     });
 
     flushReadBio();
+    if (!_handshake_done && SSL_is_init_finished(_ssl.get())) {
+        _handshake_done = true;
+        SSLSessionCache::Instance().onHandshakeDone(_ssl.get(), _server_mode);
+    }
     if (!SSL_is_init_finished(_ssl.get()) || _buffer_send.empty()) {
         //ssl未握手结束或没有需要发送的数据  [AUTO-TRANSLATED:39f8490c]
         //SSL handshake not finished or no data to send
@@ -508,7 +624,11 @@ void SSL_Box::flush() {
         auto &front = _buffer_send.front();
         uint32_t offset = 0;
         while (offset < front->size()) {
-            auto nwrite = SSL_write(_ssl.get(), front->data() + offset, front->size() - offset);
+            int nwrite;
+            {
+                TRACE_SCOPE("ssl_encrypt", front->size() - offset);
+                nwrite = SSL_write(_ssl.get(), front->data() + offset, front->size() - offset);
+            }
             if (nwrite > 0) {
                 //部分或全部写入完毕  [AUTO-TRANSLATED:661163d2]
                 //Partial or complete write finished
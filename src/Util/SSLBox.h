@@ -118,6 +118,45 @@ public:
      */
     std::shared_ptr<SSL_CTX> getSSLCtx(const std::string &vhost, bool server_mode);
 
+    /**
+     * 设置tls会话缓存的会话个数上限与有效期，服务端与客户端分别缓存，有效期同时用于会话票据
+     * 服务端默认缓存20480个会话，有效期300秒
+     * Set the max sessions and the lifetime of the tls session cache, the server and the client are cached separately,
+     * the lifetime applies to session tickets too
+     * The server caches 20480 sessions by default with a lifetime of 300 seconds
+     */
+    void setSessionCache(size_t max_sessions, uint32_t timeout_sec);
+
+    /**
+     * 会话票据密钥轮换周期，默认3600秒；旧密钥保留两个周期，用其解密的票据会被更新
+     * Rotation period of the session ticket keys, 3600 seconds by default; old keys are kept for two periods and
+     * tickets decrypted with them are renewed
+     */
+    void setTicketKeyRotation(uint32_t sec);
+
+    /**
+     * 服务端是否签发会话票据，默认开启；关闭后客户端通过会话id在服务端缓存中恢复会话
+     * Whether the server issues session tickets, enabled by default; when disabled, clients resume sessions by session id
+     * from the server side cache
+     */
+    void enableSessionTickets(bool enable);
+
+    /**
+     * 客户端是否按host:port复用会话，默认开启
+     * Whether the client reuses sessions by host:port, enabled by default
+     */
+    void enableClientSessionResumption(bool enable);
+
+    /**
+     * 完成的握手次数
+     * @param server_mode 是否为服务器模式
+     * @param resumed 会话恢复或完整握手
+     * Count of completed handshakes
+     * @param server_mode Whether it is in server mode
+     * @param resumed Resumed or full handshakes
+     */
+    uint64_t getHandshakeCount(bool server_mode, bool resumed) const;
+
 private:
     SSL_Initor();
     ~SSL_Initor();
@@ -160,6 +199,8 @@ private:
 
     std::shared_ptr<SSL_CTX> getSSLCtxWildcards(const std::string &vhost, bool server_mode);
 
+    void forEachCtx(bool server_mode, const std::function<void(SSL_CTX *ctx)> &cb);
+
     /**
      * 获取默认的虚拟主机
      * Get the default virtual host
@@ -176,6 +217,19 @@ private:
      */
     static int findCertificate(SSL *ssl, int *ad, void *arg);
 
+    /**
+     * 收到ClientHello时按sni切换到虚拟主机的SSL_CTX，早于会话恢复，会话按该虚拟主机的会话id上下文查找
+     * Switch to the SSL_CTX of the virtual host by sni when the ClientHello is received, which is earlier than session
+     * resumption, so sessions are looked up in the session id context of that virtual host
+     */
+    static int onClientHello(SSL *ssl, int *al, void *arg);
+
+    /**
+     * 按虚拟主机名选择证书，找不到时使用默认证书
+     * Select the certificate by the virtual host name, the default certificate is used if not found
+     */
+    static SSL_CTX *selectCertificate(const char *vhost, bool server_mode);
+
 private:
     struct less_nocase {
         bool operator()(const std::string &x, const std::string &y) const {
@@ -185,6 +239,7 @@ private:
 
 private:
     std::recursive_mutex _mtx;
+    bool _session_tickets = true;
     std::string _default_vhost[2];
     std::shared_ptr<SSL_CTX> _ctx_empty[2];
     std::map<std::string, std::shared_ptr<SSL_CTX>, less_nocase> _ctxs[2];
@@ -219,6 +274,18 @@ public:
      */
     void onSend(Buffer::Ptr buffer);
 
+    /**
+     * 客户端模式下不等待首个数据包立即开始握手，已开始握手时无效果
+     * Start the handshake immediately in client mode without waiting for the first packet, no effect if it has already started
+     */
+    void startHandshake();
+
+    /**
+     * 客户端按key(一般为host:port)复用之前的tls会话，须在握手前调用
+     * The client reuses the previous tls session by key (usually host:port), must be called before the handshake
+     */
+    void setSessionKey(const std::string &key);
+
     /**
      * 设置解密后获取明文的回调
      * @param cb 回调对象
@@ -276,6 +343,7 @@ private:
     bool _server_mode;
     bool _send_handshake;
     bool _is_flush = false;
+    bool _handshake_done = false;
     int _buff_size;
     BIO *_read_bio;
     BIO *_write_bio;
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <ctime>
+#include <cstring>
+#include "SSLSessionCache.h"
+
+#if defined(ENABLE_OPENSSL)
+#include <openssl/ssl.h>
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+#endif //defined(ENABLE_OPENSSL)
+
+using namespace std;
+
+namespace toolkit {
+
+constexpr size_t SSLSessionCache::kShards;
+
+static const size_t kDefaultMaxSessions = 20 * 1024;
+
+template <typename Value>
+void SSLSessionCache::Shard<Value>::put(const string &key, Value value, uint64_t expire, size_t max_size) {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+        _lru.erase(it->second);
+        _index.erase(it);
+    }
+    _lru.emplace_front(Entry { key, std::move(value), expire });
+    _index.emplace(key, _lru.begin());
+    while (_lru.size() > max_size) {
+        _index.erase(_lru.back().key);
+        _lru.pop_back();
+    }
+}
+
+template <typename Value>
+bool SSLSessionCache::Shard<Value>::get(const string &key, Value &value, uint64_t now) {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+        return false;
+    }
+    if (it->second->expire <= now) {
+        _lru.erase(it->second);
+        _index.erase(it);
+        return false;
+    }
+    _lru.splice(_lru.begin(), _lru, it->second);
+    value = it->second->value;
+    return true;
+}
+
+template <typename Value>
+size_t SSLSessionCache::Shard<Value>::size() const {
+    lock_guard<mutex> lck(_mtx);
+    return _lru.size();
+}
+
+SSLSessionCache &SSLSessionCache::Instance() {
+    static SSLSessionCache s_instance;
+    return s_instance;
+}
+
+SSLSessionCache::SSLSessionCache() {
+    setMaxSessions(kDefaultMaxSessions);
+    static const string help = "TLS handshakes completed";
+    auto &registry = MetricsRegistry::Instance();
+    _handshakes[false][false] = registry.counter("zltoolkit_tls_handshakes_total", help, { { "role", "client" }, { "mode", "full" } });
+    _handshakes[false][true] = registry.counter("zltoolkit_tls_handshakes_total", help, { { "role", "client" }, { "mode", "resumed" } });
+    _handshakes[true][false] = registry.counter("zltoolkit_tls_handshakes_total", help, { { "role", "server" }, { "mode", "full" } });
+    _handshakes[true][true] = registry.counter("zltoolkit_tls_handshakes_total", help, { { "role", "server" }, { "mode", "resumed" } });
+#if defined(ENABLE_OPENSSL)
+    // 客户端会话的缓存key，随SSL对象释放
+    // Cache key of the client session, freed with the SSL object
+    _client_key_index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, [](void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *) {
+        delete static_cast<string *>(ptr);
+    });
+    // 服务端SSL_CTX的会话id上下文，随SSL_CTX释放
+    // Session id context of a server SSL_CTX, freed with the SSL_CTX
+    _ctx_sid_index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, [](void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *) {
+        delete static_cast<string *>(ptr);
+    });
+#endif //defined(ENABLE_OPENSSL)
+}
+
+void SSLSessionCache::setMaxSessions(size_t max_sessions) {
+    _max_per_shard = max_sessions / kShards ? max_sessions / kShards : 1;
+}
+
+size_t SSLSessionCache::shardOf(const string &key) {
+    return std::hash<string>()(key) % kShards;
+}
+
+string SSLSessionCache::sidCtxOf(SSL *ssl) const {
+#if defined(ENABLE_OPENSSL)
+    if (auto sid_ctx = static_cast<string *>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), _ctx_sid_index))) {
+        return *sid_ctx;
+    }
+#endif //defined(ENABLE_OPENSSL)
+    return "";
+}
+
+#if defined(ENABLE_OPENSSL)
+static string sha256(const string &data) {
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int size = 0;
+    if (EVP_Digest(data.data(), data.size(), md, &size, EVP_sha256(), nullptr) != 1) {
+        return "";
+    }
+    return string((const char *)md, size);
+}
+
+// 由虚拟主机名与证书派生会话id上下文，不同虚拟主机或证书的SSL_CTX互不相同
+// Derive the session id context from the virtual host and the certificate, it differs between SSL_CTX of different
+// virtual hosts or certificates
+static string makeSidCtx(SSL_CTX *ctx, const string &vhost) {
+    auto material = vhost;
+    material.push_back('\0');
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+    if (auto cert = SSL_CTX_get0_certificate(ctx)) {
+        auto size = i2d_X509(cert, nullptr);
+        if (size > 0) {
+            string der(size, '\0');
+            auto ptr = (unsigned char *)&der[0];
+            i2d_X509(cert, &ptr);
+            material.append(der);
+        }
+    }
+#endif
+    auto ret = sha256(material);
+    return ret.substr(0, SSL_MAX_SID_CTX_LENGTH);
+}
+#endif //defined(ENABLE_OPENSSL)
+
+size_t SSLSessionCache::size(bool server_mode) const {
+    size_t ret = 0;
+    for (size_t i = 0; i < kShards; ++i) {
+        ret += server_mode ? _server[i].size() : _client[i].size();
+    }
+    return ret;
+}
+
+uint64_t SSLSessionCache::getHandshakeCount(bool server_mode, bool resumed) const {
+    return _handshakes[server_mode][resumed]->value();
+}
+
+void SSLSessionCache::onHandshakeDone(SSL *ssl, bool server_mode) {
+#if defined(ENABLE_OPENSSL)
+    _handshakes[server_mode][SSL_session_reused(ssl) ? 1 : 0]->add();
+#endif //defined(ENABLE_OPENSSL)
+}
+
+shared_ptr<const SSLSessionCache::TicketKeys> SSLSessionCache::currentKeys() {
+    auto now = (uint64_t)time(nullptr);
+    auto keys = std::atomic_load(&_keys);
+    if (keys && now - keys->keys[0].created < _rotation_sec) {
+        return keys;
+    }
+    lock_guard<mutex> lck(_keys_mtx);
+    keys = std::atomic_load(&_keys);
+    if (keys && now - keys->keys[0].created < _rotation_sec) {
+        return keys;
+    }
+    // 轮换: 生成新密钥，保留之前未过期的密钥用于解密
+    // Rotate: generate a new key and keep the previous unexpired keys for decryption
+    auto fresh = std::make_shared<TicketKeys>();
+    fresh->count = 1;
+    auto &key = fresh->keys[0];
+    key.created = now;
+#if defined(ENABLE_OPENSSL)
+    if (RAND_bytes(key.name, sizeof(key.name)) != 1 || RAND_bytes(key.aes_key, sizeof(key.aes_key)) != 1
+        || RAND_bytes(key.hmac_key, sizeof(key.hmac_key)) != 1) {
+        return keys;
+    }
+#endif //defined(ENABLE_OPENSSL)
+    for (size_t i = 0; keys && i < keys->count && fresh->count < 3; ++i) {
+        if (!isKeyExpired(keys->keys[i], now)) {
+            fresh->keys[fresh->count++] = keys->keys[i];
+        }
+    }
+    keys = fresh;
+    std::atomic_store(&_keys, keys);
+    return keys;
+}
+
+bool SSLSessionCache::isKeyExpired(const TicketKey &key, uint64_t now) const {
+    return now - key.created >= 3 * (uint64_t)_rotation_sec;
+}
+
+void SSLSessionCache::setClientSession(SSL *ssl, const string &key) {
+#if defined(ENABLE_OPENSSL)
+    if (!_client_resumption || key.empty()) {
+        return;
+    }
+    // 重复设置时复用已有的key，避免泄漏
+    // Reuse the existing key when set again, avoiding a leak
+    if (auto old_key = static_cast<string *>(SSL_get_ex_data(ssl, _client_key_index))) {
+        *old_key = key;
+    } else {
+        SSL_set_ex_data(ssl, _client_key_index, new string(key));
+    }
+    shared_ptr<SSL_SESSION> session;
+    if (!_client[shardOf(key)].get(key, session, (uint64_t)time(nullptr))) {
+        return;
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    // 同样使用副本，缓存中的会话不随连接的关闭方式失效
+    // Use a copy as well, so the cached session is not invalidated by how the connection is closed
+    session.reset(SSL_SESSION_dup(session.get()), SSL_SESSION_free);
+    if (!session) {
+        return;
+    }
+#endif
+    SSL_set_session(ssl, session.get());
+#endif //defined(ENABLE_OPENSSL)
+}
+
+void SSLSessionCache::setupCtx(SSL_CTX *ctx, bool server_mode, const string &vhost) {
+#if defined(ENABLE_OPENSSL)
+    SSL_CTX_set_timeout(ctx, _timeout_sec);
+    if (!server_mode) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, [](SSL *ssl, SSL_SESSION *sess) -> int {
+            auto &ref = Instance();
+            auto key = static_cast<string *>(SSL_get_ex_data(ssl, ref._client_key_index));
+            if (!key) {
+                return 0;
+            }
+            auto expire = (uint64_t)time(nullptr) + SSL_SESSION_get_timeout(sess);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            if (!SSL_SESSION_is_resumable(sess)) {
+                return 0;
+            }
+            // 缓存副本: 连接未正常关闭时openssl会将其当前会话标记为不可恢复
+            // Cache a copy: openssl marks the current session of a connection not resumable if it is not closed gracefully
+            auto copy = SSL_SESSION_dup(sess);
+            if (copy) {
+                ref._client[shardOf(*key)].put(*key, shared_ptr<SSL_SESSION>(copy, SSL_SESSION_free), expire, ref._max_per_shard);
+            }
+            return 0;
+#else
+            // 返回1表示接管会话的引用
+            // Returning 1 means taking over the reference of the session
+            ref._client[shardOf(*key)].put(*key, shared_ptr<SSL_SESSION>(sess, SSL_SESSION_free), expire, ref._max_per_shard);
+            return 1;
+#endif
+        });
+        return;
+    }
+
+    // 每个SSL_CTX使用自己的会话id上下文，openssl不会恢复其他上下文的会话
+    // Each SSL_CTX uses its own session id context, openssl never resumes a session of another context
+    auto sid_ctx = makeSidCtx(ctx, vhost);
+    SSL_CTX_set_session_id_context(ctx, (const unsigned char *)sid_ctx.data(), (unsigned int)sid_ctx.size());
+    delete static_cast<string *>(SSL_CTX_get_ex_data(ctx, _ctx_sid_index));
+    SSL_CTX_set_ex_data(ctx, _ctx_sid_index, new string(std::move(sid_ctx)));
+
+    // 服务端不使用openssl内部的缓存(全局锁)，由分片缓存接管
+    // The server does not use the internal cache of openssl (global lock), the sharded cache takes over
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL | SSL_SESS_CACHE_NO_AUTO_CLEAR);
+    // 不设置删除回调: 连接未收到close_notify即释放时openssl会删除其会话，而本库的连接通常直接关闭，
+    // 会话只按有效期与容量淘汰
+    // No remove callback: openssl removes the session of a connection freed without close_notify, while connections of
+    // this library are usually closed directly, so sessions are evicted by lifetime and capacity only
+    SSL_CTX_sess_set_new_cb(ctx, [](SSL *ssl, SSL_SESSION *sess) -> int {
+        auto &ref = Instance();
+        unsigned int id_len = 0;
+        auto id = SSL_SESSION_get_id(sess, &id_len);
+        auto size = i2d_SSL_SESSION(sess, nullptr);
+        if (!id_len || size <= 0) {
+            return 0;
+        }
+        string der(size, '\0');
+        auto ptr = (unsigned char *)&der[0];
+        i2d_SSL_SESSION(sess, &ptr);
+        // 缓存key包含会话id上下文，相同的会话id在其他虚拟主机上查找不到
+        // The cache key includes the session id context, the same session id is not found on other virtual hosts
+        auto key = ref.sidCtxOf(ssl).append((const char *)id, id_len);
+        ref._server[shardOf(key)].put(key, std::move(der), (uint64_t)time(nullptr) + ref._timeout_sec, ref._max_per_shard);
+        return 0;
+    });
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    using SessionId = const unsigned char;
+#else
+    using SessionId = unsigned char;
+#endif
+    SSL_CTX_sess_set_get_cb(ctx, [](SSL *ssl, SessionId *id, int len, int *copy) -> SSL_SESSION * {
+        auto &ref = Instance();
+        auto key = ref.sidCtxOf(ssl).append((const char *)id, len);
+        string der;
+        *copy = 0;
+        if (!ref._server[shardOf(key)].get(key, der, (uint64_t)time(nullptr))) {
+            return nullptr;
+        }
+        auto ptr = (const unsigned char *)der.data();
+        return d2i_SSL_SESSION(nullptr, &ptr, (long)der.size());
+    });
+
+    // 所有服务端SSL_CTX共享同一组轮换的票据密钥，票据的hmac密钥再与会话id上下文混合，其他虚拟主机上校验不通过
+    // All server SSL_CTX share the same set of rotated ticket keys, the hmac key of tickets is further mixed with the
+    // session id context, so the ticket fails verification on other virtual hosts
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    using HmacCtx = EVP_MAC_CTX;
+#else
+    using HmacCtx = HMAC_CTX;
+#endif
+    auto on_ticket_key = [](SSL *ssl, unsigned char *name, unsigned char *iv, EVP_CIPHER_CTX *cipher_ctx, HmacCtx *hmac_ctx, int enc) -> int {
+        auto keys = Instance().currentKeys();
+        if (!keys) {
+            return -1;
+        }
+        const TicketKey *key = nullptr;
+        size_t index = 0;
+        if (enc) {
+            key = &keys->keys[0];
+            memcpy(name, key->name, sizeof(key->name));
+            if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+                return -1;
+            }
+        } else {
+            auto now = (uint64_t)time(nullptr);
+            for (; index < keys->count; ++index) {
+                if (memcmp(name, keys->keys[index].name, sizeof(key->name)) == 0) {
+                    key = &keys->keys[index];
+                    break;
+                }
+            }
+            if (!key || Instance().isKeyExpired(*key, now)) {
+                // 密钥已轮换出去，进行完整握手
+                // The key has been rotated out, do a full handshake
+                return 0;
+            }
+        }
+        auto hmac_key = sha256(string((const char *)key->hmac_key, sizeof(key->hmac_key)) + Instance().sidCtxOf(ssl));
+        if (hmac_key.empty()) {
+            return -1;
+        }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        OSSL_PARAM params[] = { OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0), OSSL_PARAM_construct_end() };
+        if (EVP_MAC_init(hmac_ctx, (const unsigned char *)hmac_key.data(), hmac_key.size(), params) != 1) {
+            return -1;
+        }
+#else
+        if (HMAC_Init_ex(hmac_ctx, hmac_key.data(), (int)hmac_key.size(), EVP_sha256(), nullptr) != 1) {
+            return -1;
+        }
+#endif
+        auto ret = enc ? EVP_EncryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr, key->aes_key, iv)
+                       : EVP_DecryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr, key->aes_key, iv);
+        if (ret != 1) {
+            return -1;
+        }
+        // 用旧密钥解密的票据需要更新
+        // Tickets decrypted with an old key need to be renewed
+        return (!enc && index) ? 2 : 1;
+    };
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, on_ticket_key);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, +on_ticket_key);
+#endif
+#endif //defined(ENABLE_OPENSSL)
+}
+
+} // namespace toolkit
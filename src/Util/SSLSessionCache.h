@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_SSLSESSIONCACHE_H_
+#define UTIL_SSLSESSIONCACHE_H_
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "Metrics.h"
+
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+typedef struct ssl_session_st SSL_SESSION;
+
+namespace toolkit {
+
+/**
+ * 进程内tls会话缓存，供SSL_Initor配置所有SSL_CTX使用
+ * 服务端: 按会话id分片缓存序列化的会话(不支持票据的客户端使用)，并为所有poller共享的SSL_CTX提供定期轮换的票据密钥；
+ * 客户端: 按host:port缓存可恢复的会话，下次连接时发起会话恢复
+ * 各分片独立加锁，票据密钥通过原子快照读取，握手路径上无全局锁
+ * In-process tls session cache, used by SSL_Initor to configure all SSL_CTX
+ * Server side: serialized sessions are cached in shards by session id (used by clients without ticket support), and periodically
+ * rotated ticket keys are provided for the SSL_CTX shared by all pollers;
+ * client side: resumable sessions are cached by host:port and offered on the next connection
+ * Each shard has its own lock and ticket keys are read through atomic snapshots, no global lock on the handshake path
+ */
+class SSLSessionCache {
+public:
+    static SSLSessionCache &Instance();
+
+    // 配置SSL_CTX的会话缓存模式与回调；服务端的会话id上下文由虚拟主机名与证书派生，会话缓存key与票据都与之绑定，
+    // 一个虚拟主机的会话不能在另一个虚拟主机上恢复
+    // Configure the session cache mode and callbacks of an SSL_CTX; on the server side the session id context is derived
+    // from the virtual host and the certificate, and both the session cache key and tickets are bound to it, so a session
+    // of one virtual host can not be resumed on another
+    void setupCtx(SSL_CTX *ctx, bool server_mode, const std::string &vhost = "");
+
+    // 客户端握手前调用，按key查找缓存的会话并发起恢复，握手后收到的新会话也按key缓存
+    // Called before the client handshake, looks up the cached session by key and offers it for resumption,
+    // new sessions received after the handshake are cached by key too
+    void setClientSession(SSL *ssl, const std::string &key);
+
+    // 握手完成时调用，统计完整握手与会话恢复次数
+    // Called when the handshake completes, counts full and resumed handshakes
+    void onHandshakeDone(SSL *ssl, bool server_mode);
+
+    uint64_t getHandshakeCount(bool server_mode, bool resumed) const;
+
+    // 每个缓存的会话个数上限，服务端与客户端分别计算
+    // Max sessions of each cache, counted separately for the server and the client
+    void setMaxSessions(size_t max_sessions);
+    void setTimeout(uint32_t sec) { _timeout_sec = sec ? sec : 1; }
+    uint32_t getTimeout() const { return _timeout_sec; }
+    void setTicketKeyRotation(uint32_t sec) { _rotation_sec = sec ? sec : 1; }
+    void enableClientResumption(bool enable) { _client_resumption = enable; }
+
+    size_t size(bool server_mode) const;
+
+    static constexpr size_t kShards = 16;
+
+private:
+    SSLSessionCache();
+
+    template <typename Value>
+    class Shard {
+    public:
+        void put(const std::string &key, Value value, uint64_t expire, size_t max_size);
+        bool get(const std::string &key, Value &value, uint64_t now);
+        size_t size() const;
+
+    private:
+        struct Entry {
+            std::string key;
+            Value value;
+            uint64_t expire;
+        };
+        mutable std::mutex _mtx;
+        // 头部为最近使用
+        // The most recently used is at the front
+        std::list<Entry> _lru;
+        std::unordered_map<std::string, typename std::list<Entry>::iterator> _index;
+    };
+
+    struct TicketKey {
+        uint64_t created;
+        unsigned char name[16];
+        unsigned char aes_key[32];
+        unsigned char hmac_key[32];
+    };
+
+    // 当前密钥与之前的两个，每个密钥自创建起可用三个轮换周期，用旧密钥解密的票据会被更新
+    // The current key and the previous two, each key is usable for three rotation periods since its creation,
+    // tickets decrypted with an old key are renewed
+    struct TicketKeys {
+        TicketKey keys[3];
+        size_t count;
+    };
+
+    static size_t shardOf(const std::string &key);
+    // ssl当前所用SSL_CTX的会话id上下文
+    // Session id context of the SSL_CTX currently used by the ssl
+    std::string sidCtxOf(SSL *ssl) const;
+    std::shared_ptr<const TicketKeys> currentKeys();
+    bool isKeyExpired(const TicketKey &key, uint64_t now) const;
+
+private:
+    std::atomic<size_t> _max_per_shard;
+    std::atomic<uint32_t> _timeout_sec { 300 };
+    std::atomic<uint32_t> _rotation_sec { 3600 };
+    std::atomic<bool> _client_resumption { true };
+    int _client_key_index = -1;
+    int _ctx_sid_index = -1;
+
+    std::mutex _keys_mtx;
+    std::shared_ptr<const TicketKeys> _keys;
+
+    Shard<std::string> _server[kShards];
+    Shard<std::shared_ptr<SSL_SESSION>> _client[kShards];
+
+    MetricsCounter::Ptr _handshakes[2][2];
+};
+
+} // namespace toolkit
+
+#endif // UTIL_SSLSESSIONCACHE_H_
@@ -11,10 +11,15 @@
 #ifndef SPEED_STATISTIC_H_
 #define SPEED_STATISTIC_H_
 
+#include <atomic>
 #include "TimeTicker.h"
 
 namespace toolkit {
 
+/**
+ * 网速统计，可在poller线程累加的同时在其他线程读取
+ * Network speed statistic, can be read from other threads while accumulated in the poller thread
+ */
 class BytesSpeed {
 public:
     BytesSpeed() = default;
@@ -27,13 +32,12 @@ public:
      * [AUTO-TRANSLATED:d6697ac9]
      */
     BytesSpeed &operator+=(size_t bytes) {
-        _bytes += bytes;
-        if (_bytes > 1024 * 1024) {
+        if (_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes > 1024 * 1024) {
             // 数据大于1MB就计算一次网速  [AUTO-TRANSLATED:897af4d6]
             // Data greater than 1MB is calculated once for network speed
             computeSpeed();
         }
-        _total_bytes +=  bytes;
+        _total_bytes.fetch_add(bytes, std::memory_order_relaxed);
         return *this;
     }
 
@@ -44,34 +48,36 @@ public:
      * [AUTO-TRANSLATED:41e26e29]
      */
     size_t getSpeed() {
-        if (_ticker.elapsedTime() < 1000) {
-            // 获取频率小于1秒，那么返回上次计算结果  [AUTO-TRANSLATED:b687b762]
-            // Get frequency less than 1 second, return the last calculation result
-            return _speed;
-        }
-        return computeSpeed();
+        // 获取频率小于1秒，那么返回上次计算结果  [AUTO-TRANSLATED:b687b762]
+        // Get frequency less than 1 second, return the last calculation result
+        return computeSpeed(1000);
     }
 
     size_t getTotalBytes() const {
-        return _total_bytes;
+        return _total_bytes.load(std::memory_order_relaxed);
     }
 
 private:
-    size_t computeSpeed() {
+    size_t computeSpeed(uint64_t min_elapsed = 1) {
+        // 其他线程正在计算时直接返回上次结果
+        // Return the last result directly if another thread is computing
+        if (_computing.test_and_set(std::memory_order_acquire)) {
+            return _speed.load(std::memory_order_relaxed);
+        }
         auto elapsed = _ticker.elapsedTime();
-        if (!elapsed) {
-            return _speed;
+        if (elapsed >= min_elapsed) {
+            _speed.store((size_t)(_bytes.exchange(0, std::memory_order_relaxed) * 1000 / elapsed), std::memory_order_relaxed);
+            _ticker.resetTime();
         }
-        _speed = (size_t)(_bytes * 1000 / elapsed);
-        _ticker.resetTime();
-        _bytes = 0;
-        return _speed;
+        _computing.clear(std::memory_order_release);
+        return _speed.load(std::memory_order_relaxed);
     }
 
 private:
-    size_t _speed = 0;
-    size_t _bytes = 0;
-    size_t _total_bytes = 0;
+    std::atomic<size_t> _speed { 0 };
+    std::atomic<size_t> _bytes { 0 };
+    std::atomic<size_t> _total_bytes { 0 };
+    std::atomic_flag _computing = ATOMIC_FLAG_INIT;
     Ticker _ticker;
 };
 
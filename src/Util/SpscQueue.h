@@ -0,0 +1,115 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_SPSCQUEUE_H_
+#define UTIL_SPSCQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+#include "util.h"
+
+namespace toolkit {
+
+/**
+ * 单生产者单消费者无锁无界列队
+ * 内部由固定大小的块组成链表，每个块只分配一次，摊薄了内存分配开销
+ * 生产者之间如果有外部锁串行化，也可以安全的作为多生产者使用
+ * Single producer single consumer lock-free unbounded queue
+ * Internally a linked list of fixed-size blocks, each block is allocated once to amortize allocation cost
+ * Multiple producers serialized by an external lock can also use it safely
+ */
+template <typename T, size_t kBlockSize = 64>
+class SpscQueue : public noncopyable {
+public:
+    SpscQueue() {
+        _head_block = _tail_block = new Block;
+    }
+
+    ~SpscQueue() {
+        while (_head_block) {
+            auto committed = _head_block->committed.load(std::memory_order_acquire);
+            for (; _head_index < committed; ++_head_index) {
+                _head_block->slot(_head_index)->~T();
+            }
+            auto next = _head_block->next.load(std::memory_order_acquire);
+            delete _head_block;
+            _head_block = next;
+            _head_index = 0;
+        }
+    }
+
+    /**
+     * 写入一个元素，只能在生产者线程调用
+     * Push an element, can only be called by the producer thread
+     */
+    template <typename... ARGS>
+    void emplace(ARGS &&...args) {
+        if (_tail_index == kBlockSize) {
+            auto block = new Block;
+            _tail_block->next.store(block, std::memory_order_release);
+            _tail_block = block;
+            _tail_index = 0;
+        }
+        new (_tail_block->slot(_tail_index)) T(std::forward<ARGS>(args)...);
+        _tail_block->committed.store(++_tail_index, std::memory_order_release);
+    }
+
+    /**
+     * 读取一个元素，只能在消费者线程调用
+     * @return 列队为空时返回false
+     * Pop an element, can only be called by the consumer thread
+     * @return false if the queue is empty
+     */
+    bool try_pop(T &out) {
+        if (_head_index == kBlockSize) {
+            auto next = _head_block->next.load(std::memory_order_acquire);
+            if (!next) {
+                return false;
+            }
+            delete _head_block;
+            _head_block = next;
+            _head_index = 0;
+        }
+        if (_head_index >= _head_block->committed.load(std::memory_order_acquire)) {
+            return false;
+        }
+        auto ptr = _head_block->slot(_head_index++);
+        out = std::move(*ptr);
+        ptr->~T();
+        return true;
+    }
+
+private:
+    struct Block {
+        std::atomic<size_t> committed { 0 };
+        std::atomic<Block *> next { nullptr };
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data[kBlockSize];
+
+        T *slot(size_t index) { return reinterpret_cast<T *>(&data[index]); }
+    };
+
+private:
+    // 消费者私有
+    // Consumer only
+    Block *_head_block;
+    size_t _head_index = 0;
+    // 与消费者数据隔开，避免伪共享
+    // Keep away from the consumer side to avoid false sharing
+    char _padding[64];
+    // 生产者私有
+    // Producer only
+    Block *_tail_block;
+    size_t _tail_index = 0;
+};
+
+} /* namespace toolkit */
+#endif /* UTIL_SPSCQUEUE_H_ */
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <algorithm>
+#include "TokenBucket.h"
+
+namespace toolkit {
+
+static constexpr uint64_t kDefaultBurstMS = 10;
+static constexpr uint64_t kMinBurst = 1500;
+
+TokenBucket::TokenBucket(uint64_t bytes_per_sec, uint64_t burst) {
+    setRate(bytes_per_sec, burst);
+}
+
+void TokenBucket::setRate(uint64_t bytes_per_sec, uint64_t burst) {
+    _rate = bytes_per_sec;
+    _burst = burst ? burst : std::max(bytes_per_sec * kDefaultBurstMS / 1000, kMinBurst);
+    // 修改速率后从满桶开始
+    // Start with a full bucket after the rate changes
+    _tokens = (double)_burst;
+    _last_us = 0;
+}
+
+void TokenBucket::refill(uint64_t now_us) {
+    if (_last_us && now_us > _last_us) {
+        _tokens = std::min((double)_burst, _tokens + (double)(now_us - _last_us) * _rate / 1000000.0);
+    }
+    _last_us = now_us;
+}
+
+uint64_t TokenBucket::wait(size_t bytes, uint64_t now_us) {
+    if (!_rate) {
+        return 0;
+    }
+    refill(now_us);
+    auto need = (double)std::min<uint64_t>(bytes, _burst);
+    if (_tokens >= need) {
+        return 0;
+    }
+    // 向上取整，避免到期后仍差一点令牌
+    // Round up, so that the tokens are enough when due
+    return (uint64_t)((need - _tokens) * 1000000.0 / _rate) + 1;
+}
+
+uint64_t TokenBucket::consume(size_t bytes, uint64_t now_us) {
+    auto ret = wait(bytes, now_us);
+    if (!ret && _rate) {
+        _tokens -= (double)bytes;
+    }
+    return ret;
+}
+
+} // namespace toolkit
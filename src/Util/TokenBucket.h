@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_TOKENBUCKET_H_
+#define UTIL_TOKENBUCKET_H_
+
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace toolkit {
+
+/**
+ * 令牌桶，按字节计数，非线程安全
+ * 桶内令牌足够(或桶满)时放行，大于桶容量的数据包在桶满时放行并透支，之后按速率偿还
+ * Token bucket counted in bytes, not thread safe
+ * Data passes when there are enough tokens (or the bucket is full), a packet larger than the bucket passes when the bucket
+ * is full and overdraws it, which is then paid back at the rate
+ */
+class TokenBucket {
+public:
+    /**
+     * @param bytes_per_sec 速率，0为不限速
+     * @param burst 桶容量(字节)，0则取10毫秒的数据量且不小于1500字节
+     * @param bytes_per_sec Rate, 0 means unlimited
+     * @param burst Bucket size in bytes, 0 means 10 milliseconds of data and no less than 1500 bytes
+     */
+    TokenBucket(uint64_t bytes_per_sec = 0, uint64_t burst = 0);
+
+    void setRate(uint64_t bytes_per_sec, uint64_t burst = 0);
+    uint64_t getRate() const { return _rate; }
+    uint64_t getBurst() const { return _burst; }
+
+    /**
+     * 尝试放行数据
+     * @param bytes 数据大小
+     * @param now_us 当前时间，单位微秒
+     * @return 0表示已放行并扣除令牌，否则为需等待的微秒数
+     * Try to let data pass
+     * @param bytes Data size
+     * @param now_us Current time in microseconds
+     * @return 0 means it passed and the tokens were taken, otherwise the microseconds to wait
+     */
+    uint64_t consume(size_t bytes, uint64_t now_us);
+
+    /**
+     * 同consume，但不扣除令牌
+     * The same as consume but without taking the tokens
+     */
+    uint64_t wait(size_t bytes, uint64_t now_us);
+
+private:
+    void refill(uint64_t now_us);
+
+private:
+    uint64_t _rate = 0;
+    uint64_t _burst = 0;
+    uint64_t _last_us = 0;
+    double _tokens = 0;
+};
+
+/**
+ * 多个socket共享的令牌桶，可跨线程使用，用于按组整形
+ * Token bucket shared by multiple sockets, usable across threads, used for per-group shaping
+ */
+class SharedTokenBucket {
+public:
+    using Ptr = std::shared_ptr<SharedTokenBucket>;
+
+    SharedTokenBucket(uint64_t bytes_per_sec = 0, uint64_t burst = 0) : _bucket(bytes_per_sec, burst) {}
+
+    void setRate(uint64_t bytes_per_sec, uint64_t burst = 0) {
+        std::lock_guard<std::mutex> lck(_mtx);
+        _bucket.setRate(bytes_per_sec, burst);
+    }
+
+    uint64_t getRate() {
+        std::lock_guard<std::mutex> lck(_mtx);
+        return _bucket.getRate();
+    }
+
+    uint64_t consume(size_t bytes, uint64_t now_us) {
+        std::lock_guard<std::mutex> lck(_mtx);
+        return _bucket.consume(bytes, now_us);
+    }
+
+private:
+    std::mutex _mtx;
+    TokenBucket _bucket;
+};
+
+} // namespace toolkit
+#endif // UTIL_TOKENBUCKET_H_
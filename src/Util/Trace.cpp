@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <sstream>
+#include "Trace.h"
+#include "util.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) || defined(__linux)
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace toolkit {
+
+static uint64_t currentThreadId() {
+#if defined(__linux__) || defined(__linux)
+    return (uint64_t)syscall(SYS_gettid);
+#else
+    return (uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+}
+
+/**
+ * 单个线程的环形缓存，只有所属线程写入；
+ * 字段均为原子变量，导出线程可以并发读取，读取后根据写入位置丢弃已被覆盖的事件
+ * Ring buffer of a single thread, only written by the owner thread;
+ * all fields are atomic so the dumping thread can read concurrently, events overwritten meanwhile are discarded by the write position
+ */
+class TraceBuffer : public std::enable_shared_from_this<TraceBuffer> {
+public:
+    struct Event {
+        std::atomic<const char *> name { nullptr };
+        std::atomic<uint64_t> begin { 0 };
+        std::atomic<uint64_t> end { 0 };
+        std::atomic<uint64_t> arg { 0 };
+    };
+
+    struct Snapshot {
+        const char *name;
+        uint64_t begin;
+        uint64_t end;
+        uint64_t arg;
+    };
+
+    TraceBuffer() {
+        _tid = currentThreadId();
+        _thread_name = getThreadName();
+    }
+
+    void write(const char *name, uint64_t begin, uint64_t end, uint64_t arg) {
+        auto pos = _pos.load(std::memory_order_relaxed);
+        auto &event = _events[pos % Tracer::kBufferSize];
+        event.name.store(name, std::memory_order_relaxed);
+        event.begin.store(begin, std::memory_order_relaxed);
+        event.end.store(end, std::memory_order_relaxed);
+        event.arg.store(arg, std::memory_order_relaxed);
+        _pos.store(pos + 1, std::memory_order_release);
+    }
+
+    vector<Snapshot> read() {
+        auto end = _pos.load(std::memory_order_acquire);
+        auto begin = std::max(end, (uint64_t)Tracer::kBufferSize) - Tracer::kBufferSize;
+        begin = std::max(begin, _cleared.load(std::memory_order_relaxed));
+        vector<Snapshot> ret;
+        ret.reserve(end - begin);
+        for (auto i = begin; i < end; ++i) {
+            auto &event = _events[i % Tracer::kBufferSize];
+            ret.push_back({ event.name.load(std::memory_order_relaxed), event.begin.load(std::memory_order_relaxed),
+                            event.end.load(std::memory_order_relaxed), event.arg.load(std::memory_order_relaxed) });
+        }
+        // 读取期间写入线程可能已经绕回覆盖了最旧的事件
+        // The writer may have wrapped around and overwritten the oldest events during reading
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto now = _pos.load(std::memory_order_relaxed);
+        if (now > begin + Tracer::kBufferSize) {
+            auto overwritten = std::min<uint64_t>(now - begin - Tracer::kBufferSize, ret.size());
+            ret.erase(ret.begin(), ret.begin() + overwritten);
+        }
+        return ret;
+    }
+
+    void clear() { _cleared.store(_pos.load(std::memory_order_acquire), std::memory_order_relaxed); }
+
+    uint64_t tid() const { return _tid; }
+    const string &threadName() const { return _thread_name; }
+
+private:
+    uint64_t _tid;
+    string _thread_name;
+    std::atomic<uint64_t> _pos { 0 };
+    std::atomic<uint64_t> _cleared { 0 };
+    Event _events[Tracer::kBufferSize];
+};
+
+// 线程退出时从追踪器中移除其缓存
+// Remove the buffer of a thread from the tracer when the thread exits
+class TraceBufferHolder {
+public:
+    TraceBufferHolder() {
+        buffer = std::make_shared<TraceBuffer>();
+        Tracer::Instance().addBuffer(buffer);
+    }
+
+    ~TraceBufferHolder() {
+        Tracer::Instance().delBuffer(buffer);
+    }
+
+    std::shared_ptr<TraceBuffer> buffer;
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+
+atomic<bool> Tracer::s_enabled { false };
+
+Tracer &Tracer::Instance() {
+    // 不随main函数退出而析构，保证其他线程退出时仍可访问
+    // Not destroyed when main exits, so that it is still accessible when other threads exit
+    static Tracer *s_instance = new Tracer();
+    return *s_instance;
+}
+
+Tracer::Tracer() {
+    _base_ticks = CycleClock::now();
+}
+
+void Tracer::setEnabled(bool enabled) {
+    if (enabled) {
+        // 提前校准时钟频率，避免在首个追踪点中忙等
+        // Calibrate the clock frequency in advance to avoid busy waiting in the first trace point
+        CycleClock::ticksPerUS();
+    }
+    s_enabled = enabled;
+}
+
+void Tracer::record(const char *name, uint64_t begin, uint64_t end, uint64_t arg) {
+    static thread_local toolkit::TraceBufferHolder s_holder;
+    s_holder.buffer->write(name, begin, end, arg);
+}
+
+void Tracer::addBuffer(const std::shared_ptr<TraceBuffer> &buffer) {
+    lock_guard<mutex> lck(_mtx);
+    _buffers.emplace_back(buffer);
+}
+
+void Tracer::delBuffer(const std::shared_ptr<TraceBuffer> &buffer) {
+    lock_guard<mutex> lck(_mtx);
+    _buffers.remove(buffer);
+}
+
+void Tracer::clear() {
+    lock_guard<mutex> lck(_mtx);
+    for (auto &buffer : _buffers) {
+        buffer->clear();
+    }
+}
+
+static void writeJsonString(ostream &out, const string &str) {
+    out << '"';
+    for (auto ch : str) {
+        if (ch == '"' || ch == '\\') {
+            out << '\\' << ch;
+        } else if ((unsigned char)ch < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            out << buf;
+        } else {
+            out << ch;
+        }
+    }
+    out << '"';
+}
+
+string Tracer::dumpChromeJson() {
+    decltype(_buffers) buffers;
+    {
+        lock_guard<mutex> lck(_mtx);
+        buffers = _buffers;
+    }
+#if !defined(_WIN32)
+    auto pid = getpid();
+#else
+    auto pid = 0;
+#endif
+    auto ticks_per_us = CycleClock::ticksPerUS();
+    ostringstream out;
+    out.setf(ios::fixed);
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (auto &buffer : buffers) {
+        if (!first) {
+            out << ',';
+        }
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid() << ",\"args\":{\"name\":";
+        writeJsonString(out, buffer->threadName());
+        out << "}}";
+        for (auto &event : buffer->read()) {
+            if (!event.name || event.begin < _base_ticks) {
+                continue;
+            }
+            out << ",{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << buffer->tid()
+                << ",\"ts\":" << (event.begin - _base_ticks) / ticks_per_us
+                << ",\"dur\":" << (event.end - event.begin) / ticks_per_us;
+            if (event.arg) {
+                out << ",\"args\":{\"arg\":" << event.arg << '}';
+            }
+            out << '}';
+        }
+    }
+    out << "]}";
+    return out.str();
+}
+
+bool Tracer::dumpToFile(const string &path) {
+    auto json = dumpChromeJson();
+    auto fp = fopen(path.data(), "wb");
+    if (!fp) {
+        return false;
+    }
+    auto ok = fwrite(json.data(), 1, json.size(), fp) == json.size();
+    fclose(fp);
+    return ok;
+}
+
+} /* namespace toolkit */
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_TRACE_H_
+#define UTIL_TRACE_H_
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include "CycleClock.h"
+
+namespace toolkit {
+
+class TraceBuffer;
+class TraceBufferHolder;
+
+/**
+ * 轻量级追踪器
+ * 追踪点记录在每个线程独有的定长环形缓存中，时间戳来自CycleClock；
+ * 运行时关闭时每个追踪点只剩一次分支判断；可随时导出为Chrome/Perfetto可打开的json
+ * Lightweight tracer
+ * Trace points are recorded in a fixed-size ring buffer owned by each thread, timestamps come from CycleClock;
+ * when disabled at runtime each trace point costs only a branch; can be dumped as json readable by Chrome/Perfetto at any time
+ */
+class Tracer {
+public:
+    /**
+     * 每个线程环形缓存可保存的事件数
+     * Events a ring buffer of each thread can hold
+     */
+    static constexpr size_t kBufferSize = 8192;
+
+    static Tracer &Instance();
+
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * 开启或关闭追踪，关闭时已记录的事件仍可导出
+     * Enable or disable tracing, recorded events can still be dumped when disabled
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * 记录一个已完成的事件
+     * @param name 事件名，必须是静态字符串
+     * @param begin 开始时间，CycleClock计数
+     * @param end 结束时间，CycleClock计数
+     * @param arg 附加参数，比如fd，0表示无
+     * Record a completed event
+     * @param name Event name, must be a static string
+     * @param begin Begin time in CycleClock ticks
+     * @param end End time in CycleClock ticks
+     * @param arg Extra argument such as the fd, 0 for none
+     */
+    static void record(const char *name, uint64_t begin, uint64_t end, uint64_t arg);
+
+    /**
+     * 导出所有线程的事件为Chrome trace event格式的json
+     * Dump the events of all threads as json in the Chrome trace event format
+     */
+    std::string dumpChromeJson();
+
+    /**
+     * 导出到文件
+     * Dump to a file
+     */
+    bool dumpToFile(const std::string &path);
+
+    /**
+     * 清空所有已记录的事件
+     * Clear all recorded events
+     */
+    void clear();
+
+private:
+    Tracer();
+
+    friend class TraceBufferHolder;
+    void addBuffer(const std::shared_ptr<TraceBuffer> &buffer);
+    void delBuffer(const std::shared_ptr<TraceBuffer> &buffer);
+
+private:
+    static std::atomic<bool> s_enabled;
+
+    uint64_t _base_ticks;
+    std::mutex _mtx;
+    std::list<std::shared_ptr<TraceBuffer>> _buffers;
+};
+
+/**
+ * 作用域追踪点，构造时记录开始时间，析构时写入事件
+ * Scoped trace point, the begin time is taken on construction and the event is written on destruction
+ */
+class TraceScope {
+public:
+    TraceScope(const char *name, uint64_t arg = 0) {
+        if (Tracer::enabled()) {
+            _name = name;
+            _arg = arg;
+            _begin = CycleClock::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (_name) {
+            Tracer::record(_name, _begin, CycleClock::now(), _arg);
+        }
+    }
+
+private:
+    const char *_name = nullptr;
+    uint64_t _arg;
+    uint64_t _begin;
+};
+
+#define TRACE_CONCAT_L(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_L(a, b)
+#define TRACE_SCOPE(...) ::toolkit::TraceScope TRACE_CONCAT(__trace_scope_, __LINE__)(__VA_ARGS__)
+
+} /* namespace toolkit */
+#endif /* UTIL_TRACE_H_ */
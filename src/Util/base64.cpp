@@ -27,9 +27,14 @@
 //#include "common.h"
 #include "stdio.h"
 #include "base64.h"
+#include "CpuFeature.h"
 #include <memory>
 #include <limits.h>
 
+#if defined(HAS_X86_SIMD)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 /* ---------------- private code */
@@ -107,6 +112,185 @@ char *av_base64_encode(char *out, int out_size, const uint8_t *in, int in_size)
     return av_base64_encode_l(out, &out_size, in, in_size);
 }
 
+/*****************************************************************************
+* simd编解码，算法参考Wojciech Muła与Daniel Lemire的base64 simd论文
+* 每次处理12/24字节明文或16/32字节密文，剩余部分以及非法字符、'='所在的块交给标量实现
+* Simd encoding and decoding, the algorithms are based on the base64 simd papers of Wojciech Muła and Daniel Lemire
+* Each step handles 12/24 bytes of plaintext or 16/32 bytes of ciphertext,
+* the remainder and the blocks containing invalid characters or '=' are left to the scalar implementation
+*****************************************************************************/
+
+#if defined(HAS_X86_SIMD)
+
+SIMD_TARGET("ssse3") static inline __m128i base64EncodeLookup(__m128i indices) {
+    // 把索引映射为字符的偏移量：0-25 'A'，26-51 'a'-26，52-61 '0'-52，62 '+'-62，63 '/'-63
+    // Map the indices to character offsets: 0-25 'A', 26-51 'a'-26, 52-61 '0'-52, 62 '+'-62, 63 '/'-63
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    auto ret = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    auto less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    ret = _mm_or_si128(ret, _mm_and_si128(less, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, ret), indices);
+}
+
+SIMD_TARGET("ssse3") static inline __m128i base64EncodeBlock(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    auto t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    auto t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return base64EncodeLookup(_mm_or_si128(t0, t1));
+}
+
+SIMD_TARGET("avx2") static inline __m256i base64EncodeBlock(__m256i in) {
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    const __m128i shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    in = _mm256_shuffle_epi8(in, _mm256_broadcastsi128_si256(shuffle));
+    auto t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+    auto t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+    auto indices = _mm256_or_si256(t0, t1);
+    auto ret = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    auto less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    ret = _mm256_or_si256(ret, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(shift_lut), ret), indices);
+}
+
+SIMD_TARGET("avx2") static size_t base64EncodeAvx2(char *out, const uint8_t *in, size_t in_size) {
+    size_t done = 0;
+    // 每次读取两个16字节，各使用前12字节
+    // Read two 16-byte blocks each time, and use the first 12 bytes of each
+    while (in_size - done >= 28) {
+        auto lo = _mm_loadu_si128((const __m128i *)(in + done));
+        auto hi = _mm_loadu_si128((const __m128i *)(in + done + 12));
+        auto block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256((__m256i *)out, base64EncodeBlock(block));
+        out += 32;
+        done += 24;
+    }
+    return done;
+}
+
+SIMD_TARGET("ssse3") static size_t base64EncodeSsse3(char *out, const uint8_t *in, size_t in_size) {
+    size_t done = 0;
+    while (in_size - done >= 16) {
+        auto block = _mm_loadu_si128((const __m128i *)(in + done));
+        _mm_storeu_si128((__m128i *)out, base64EncodeBlock(block));
+        out += 16;
+        done += 12;
+    }
+    return done;
+}
+
+// 校验字符并把字符映射为6bit值，有非法字符时返回false
+// Validate the characters and map them to 6-bit values, false is returned if there are invalid characters
+SIMD_TARGET("ssse3,sse4.1") static inline bool base64DecodeLookup(__m128i &str) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    auto hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+    auto lo_nibbles = _mm_and_si128(str, mask_2f);
+    auto hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    auto lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    if (!_mm_testz_si128(lo, hi)) {
+        return false;
+    }
+    auto eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+    str = _mm_add_epi8(str, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles)));
+    return true;
+}
+
+SIMD_TARGET("avx2") static inline bool base64DecodeLookup(__m256i &str) {
+    const __m256i lut_lo = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A));
+    const __m256i lut_hi = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+    const __m256i lut_roll = _mm256_broadcastsi128_si256(_mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    auto hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+    auto lo_nibbles = _mm256_and_si256(str, mask_2f);
+    auto hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    auto lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    if (!_mm256_testz_si256(lo, hi)) {
+        return false;
+    }
+    auto eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+    str = _mm256_add_epi8(str, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles)));
+    return true;
+}
+
+// 把每4个6bit值合并为3字节，结果位于每128bit的前12字节
+// Merge every 4 6-bit values into 3 bytes, the result is in the first 12 bytes of each 128 bits
+#define B64_DEC_PACK_SHUFFLE 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+SIMD_TARGET("avx2") static size_t base64DecodeAvx2(uint8_t *out, size_t out_size, const char *in, size_t in_size, size_t &consumed) {
+    size_t written = 0;
+    const __m256i pack_shuffle = _mm256_broadcastsi128_si256(_mm_setr_epi8(B64_DEC_PACK_SHUFFLE));
+    while (in_size - consumed >= 32 && out_size - written >= 28) {
+        auto str = _mm256_loadu_si256((const __m256i *)(in + consumed));
+        if (!base64DecodeLookup(str)) {
+            break;
+        }
+        auto merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        merged = _mm256_shuffle_epi8(merged, pack_shuffle);
+        _mm_storeu_si128((__m128i *)(out + written), _mm256_castsi256_si128(merged));
+        _mm_storeu_si128((__m128i *)(out + written + 12), _mm256_extracti128_si256(merged, 1));
+        written += 24;
+        consumed += 32;
+    }
+    return written;
+}
+
+SIMD_TARGET("ssse3,sse4.1") static size_t base64DecodeSse41(uint8_t *out, size_t out_size, const char *in, size_t in_size, size_t &consumed) {
+    size_t written = 0;
+    const __m128i pack_shuffle = _mm_setr_epi8(B64_DEC_PACK_SHUFFLE);
+    while (in_size - consumed >= 16 && out_size - written >= 16) {
+        auto str = _mm_loadu_si128((const __m128i *)(in + consumed));
+        if (!base64DecodeLookup(str)) {
+            break;
+        }
+        auto merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i *)(out + written), _mm_shuffle_epi8(merged, pack_shuffle));
+        written += 12;
+        consumed += 16;
+    }
+    return written;
+}
+
+#endif // defined(HAS_X86_SIMD)
+
+// 返回simd处理掉的明文字节数，为3的倍数
+// Return the plaintext bytes handled by simd, a multiple of 3
+static size_t base64EncodeSimd(char *out, const uint8_t *in, size_t in_size) {
+    size_t done = 0;
+#if defined(HAS_X86_SIMD)
+    if (toolkit::CpuFeature::has(toolkit::CpuFeature::AVX2)) {
+        done = base64EncodeAvx2(out, in, in_size);
+    }
+    if (toolkit::CpuFeature::has(toolkit::CpuFeature::SSSE3)) {
+        done += base64EncodeSsse3(out + done / 3 * 4, in + done, in_size - done);
+    }
+#endif
+    return done;
+}
+
+// 返回simd写入的明文字节数，consumed为处理掉的密文字节数，为4的倍数
+// Return the plaintext bytes written by simd, consumed is the ciphertext bytes handled, a multiple of 4
+static size_t base64DecodeSimd(uint8_t *out, size_t out_size, const char *in, size_t in_size, size_t &consumed) {
+    size_t written = 0;
+    consumed = 0;
+#if defined(HAS_X86_SIMD)
+    if (toolkit::CpuFeature::has(toolkit::CpuFeature::AVX2)) {
+        written = base64DecodeAvx2(out, out_size, in, in_size, consumed);
+    }
+    if (toolkit::CpuFeature::has(toolkit::CpuFeature::SSSE3 | toolkit::CpuFeature::SSE41)) {
+        written += base64DecodeSse41(out + written, out_size - written, in, in_size, consumed);
+    }
+#endif
+    return written;
+}
+
 string encodeBase64(const string &txt) {
     if (txt.empty()) {
         return "";
@@ -115,10 +299,14 @@ string encodeBase64(const string &txt) {
     string ret;
     ret.resize(size);
 
-    if (!av_base64_encode_l((char *) ret.data(), &size, (const uint8_t *) txt.data(), txt.size())) {
+    auto in = (const uint8_t *) txt.data();
+    auto done = base64EncodeSimd((char *) ret.data(), in, txt.size());
+    auto offset = done / 3 * 4;
+    size -= offset;
+    if (!av_base64_encode_l((char *) ret.data() + offset, &size, in + done, txt.size() - done)) {
         return "";
     }
-    ret.resize(size);
+    ret.resize(offset + size);
     return ret;
 }
 
@@ -128,12 +316,14 @@ string decodeBase64(const string &txt){
     }
     string ret;
     ret.resize(txt.size() * 3 / 4 + 10);
-    auto size = av_base64_decode((uint8_t *) ret.data(), txt.data(), ret.size());
+    size_t consumed;
+    auto written = base64DecodeSimd((uint8_t *) ret.data(), ret.size(), txt.data(), txt.size(), consumed);
+    auto size = av_base64_decode((uint8_t *) ret.data() + written, txt.data() + consumed, ret.size() - written);
 
-    if (size <= 0) {
+    if (size < 0 || written + size == 0) {
         return "";
     }
-    ret.resize(size);
+    ret.resize(written + size);
     return ret;
 }
 
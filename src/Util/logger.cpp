@@ -27,6 +27,11 @@
 #include <sys/syslog.h>
 #endif
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 using namespace std;
 
 namespace toolkit {
@@ -95,10 +100,12 @@ Logger::~Logger() {
 
 void Logger::add(const std::shared_ptr<LogChannel> &channel) {
     _channels[channel->name()] = channel;
+    updateLevel();
 }
 
 void Logger::del(const string &name) {
     _channels.erase(name);
+    updateLevel();
 }
 
 std::shared_ptr<LogChannel> Logger::get(const string &name) {
@@ -125,6 +132,21 @@ void Logger::setLevel(LogLevel level) {
     for (auto &chn : _channels) {
         chn.second->setLevel(level);
     }
+    updateLevel();
+}
+
+void Logger::updateLevel() {
+    if (_channels.empty()) {
+        // 使用默认日志通道
+        // Use the default log channel
+        _level = _default_channel->level();
+        return;
+    }
+    auto level = LError;
+    for (auto &chn : _channels) {
+        level = std::min(level, chn.second->level());
+    }
+    _level = level;
 }
 
 void Logger::writeChannels_l(const LogContextPtr &ctx) {
@@ -204,23 +226,21 @@ const string &LogContext::str() {
 
 static string s_module_name = exeName(false);
 
-LogContextCapture::LogContextCapture(Logger &logger, LogLevel level, const char *file, const char *function, int line, const char *flag) :
-        _ctx(new LogContext(level, file, function, line, s_module_name.c_str() ? s_module_name.c_str() : "", flag)), _logger(logger) {
+LogContextCapture::LogContextCapture(Logger &logger, LogLevel level, const char *file, const char *function, int line, const char *flag) : _logger(&logger) {
+    if (logger.isLevelEnabled(level)) {
+        _ctx.reset(new LogContext(level, file, function, line, s_module_name.c_str() ? s_module_name.c_str() : "", flag));
+    }
 }
 
 LogContextCapture::LogContextCapture(const LogContextCapture &that) : _ctx(that._ctx), _logger(that._logger) {
     const_cast<LogContextPtr &>(that._ctx).reset();
 }
 
-LogContextCapture::~LogContextCapture() {
-    *this << endl;
-}
-
 LogContextCapture &LogContextCapture::operator<<(ostream &(*f)(ostream &)) {
     if (!_ctx) {
         return *this;
     }
-    _logger.write(_ctx);
+    _logger->write(_ctx);
     _ctx.reset();
     return *this;
 }
@@ -348,6 +368,8 @@ const string &LogChannel::name() const { return _name; }
 
 void LogChannel::setLevel(LogLevel level) { _level = level; }
 
+LogLevel LogChannel::level() const { return _level; }
+
 std::string LogChannel::printTime(const timeval &tv) {
     auto tm = getLocalTime(tv.tv_sec);
     char buf[128];
@@ -628,9 +650,366 @@ void FileChannel::setFileMaxCount(size_t max_count) {
     _log_max_count = max_count > 1 ? max_count : 1;
 }
 
+///////////////////MmapFileChannel///////////////////
+
+#if !defined(_WIN32)
+
+struct MmapFileChannel::Segment {
+    int fd = -1;
+    char *data = nullptr;
+    size_t capacity = 0;
+    uint64_t day = 0;
+    // 只在后台线程中访问，已经落盘的位置
+    // Only accessed in the background thread, the position that has been committed to disk
+    size_t synced = 0;
+    std::string path;
+    // 已预留的字节数，可能超过capacity
+    // Bytes reserved, may exceed capacity
+    std::atomic<size_t> reserved { 0 };
+    // 首个越界预留的起始位置，即分片的有效长度
+    // Start of the first reservation that overflowed, namely the valid length of the segment
+    std::atomic<size_t> end { SIZE_MAX };
+    // 分片写满但是没有可用的下一个分片，需要后台线程完成切换
+    // The segment is full but no next segment is available, the background thread should finish switching
+    std::atomic<bool> orphan { false };
+    std::atomic<Segment *> successor { nullptr };
+};
+
+// 写者临界区：进入时登记到当前纪元，离开时注销
+// Writer critical section: registered in the current epoch on entry and deregistered on exit
+class MmapFileChannel::WriteGuard {
+public:
+    WriteGuard(MmapFileChannel &channel) : _channel(channel) {
+        while (true) {
+            auto epoch = _channel._epoch.load();
+            _index = epoch & 1;
+            _channel._writers[_index].fetch_add(1);
+            if (_channel._epoch.load() == epoch) {
+                break;
+            }
+            // 登记期间纪元已切换，重新登记到新纪元
+            // The epoch switched while registering, register in the new one again
+            _channel._writers[_index].fetch_sub(1);
+        }
+    }
+    ~WriteGuard() { _channel._writers[_index].fetch_sub(1); }
+
+private:
+    MmapFileChannel &_channel;
+    size_t _index;
+};
+
+static const char *kMmapLogSuffix = ".mlog";
+
+static string getMmapLogFilePath(const string &dir, time_t second, size_t index) {
+    auto tm = getLocalTime(second);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%d-%02d-%02d_%02d%s", 1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday, (int)index, kMmapLogSuffix);
+    return dir + buf;
+}
+
+MmapFileChannel::MmapFileChannel(const string &name, const string &dir, LogLevel level, size_t segment_size, unsigned int flush_interval_ms)
+    : LogChannel(name, level) {
+    _writers[0] = 0;
+    _writers[1] = 0;
+    _dir = dir;
+    if (_dir.back() != '/') {
+        _dir.append("/");
+    }
+    _segment_size = (segment_size ? segment_size : 1) * 1024 * 1024;
+    _flush_interval_ms = flush_interval_ms ? flush_interval_ms : 1;
+
+    File::scanDir(_dir, [this](const string &path, bool isDir) -> bool {
+        if (!isDir && end_with(path, kMmapLogSuffix)) {
+            _log_file_map.emplace(path);
+        }
+        return true;
+    }, false);
+
+    // 获取今天日志文件的最大index号
+    // Get the maximum index of today's log files
+    auto log_name_prefix = getTimeStr("%Y-%m-%d_");
+    for (auto &path : _log_file_map) {
+        auto name = getFileName(path.data());
+        int tm_year, tm_mon, tm_mday;
+        uint32_t index;
+        if (start_with(name, log_name_prefix) && sscanf(name, "%d-%02d-%02d_%d", &tm_year, &tm_mon, &tm_mday, &index) == 4) {
+            _index = index + 1 > _index ? index + 1 : _index;
+        }
+    }
+
+    _tracked = createSegment();
+    _current = _tracked;
+    _next = createSegment();
+    _thread = std::make_shared<thread>([this]() { run(); });
+}
+
+MmapFileChannel::~MmapFileChannel() {
+    _exit_flag = true;
+    _sem.post();
+    _thread->join();
+
+    // 后台线程最后一轮之后切换掉的分片只挂在_tracked的后继链上，一并回收
+    // Segments switched out after the last round of the background thread are only on the successor chain of _tracked,
+    // reclaim them as well
+    auto current = _current.exchange(nullptr);
+    for (auto segment = _tracked; segment && segment != current; segment = segment->successor.load()) {
+        _retired_new.emplace_back(segment);
+    }
+    _tracked = nullptr;
+    _retired_old.for_each([&](Segment *segment) { release(segment); });
+    _retired_old.clear();
+    _retired_new.for_each([&](Segment *segment) { release(segment); });
+    _retired_new.clear();
+    if (current) {
+        release(current);
+    }
+    if (auto next = _next.exchange(nullptr)) {
+        // 未使用的分片直接删除
+        // Delete the unused segment directly
+        auto path = next->path;
+        release(next);
+        File::delete_file(path);
+    }
+}
+
+void MmapFileChannel::write(const Logger &logger, const LogContextPtr &ctx) {
+    if (_level > ctx->_level) {
+        return;
+    }
+    static thread_local std::ostringstream s_stream;
+    s_stream.str("");
+    s_stream.clear();
+    format(logger, s_stream, ctx, false);
+    auto str = s_stream.str();
+    append(str.data(), str.size());
+}
+
+bool MmapFileChannel::append(const char *data, size_t size) {
+    if (!size) {
+        return true;
+    }
+    bool ret = false;
+    WriteGuard guard(*this);
+    for (auto segment = _current.load(); segment && size <= segment->capacity;) {
+        auto offset = segment->reserved.fetch_add(size);
+        if (offset + size <= segment->capacity) {
+            memcpy(segment->data + offset, data, size);
+            ret = true;
+            break;
+        }
+        if (offset <= segment->capacity) {
+            // 本线程的预留首先越界，由本线程负责切换分片
+            // The reservation of this thread overflowed first, so this thread is responsible for switching segments
+            segment->end = offset;
+            if (auto next = _next.exchange(nullptr)) {
+                rotate(segment, next);
+            } else {
+                segment->orphan = true;
+                _sem.post();
+            }
+        }
+        auto current = _current.load();
+        if (current == segment) {
+            // 下一个分片尚未就绪，丢弃本条日志而不是等待
+            // The next segment is not ready yet, drop this log instead of waiting
+            break;
+        }
+        segment = current;
+    }
+    if (!ret) {
+        ++_dropped;
+    }
+    return ret;
+}
+
+void MmapFileChannel::rotate(Segment *full, Segment *next) {
+    full->successor = next;
+    _current = next;
+    // 唤醒后台线程尽快准备下一个分片
+    // Wake up the background thread to prepare the next segment as soon as possible
+    _sem.post();
+}
+
+void MmapFileChannel::setFileMaxCount(size_t max_count) {
+    _log_max_count = max_count > 1 ? max_count : 1;
+}
+
+uint64_t MmapFileChannel::dropped() const {
+    return _dropped.load();
+}
+
+MmapFileChannel::Segment *MmapFileChannel::createSegment() {
+    auto now = time(nullptr);
+    File::create_path(_dir, S_IRWXO | S_IRWXG | S_IRWXU);
+    int fd = -1;
+    string path;
+    for (int i = 0; i < 100 && fd == -1; ++i) {
+        path = getMmapLogFilePath(_dir, now, _index++);
+        fd = ::open(path.data(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    }
+    if (fd == -1) {
+        return nullptr;
+    }
+
+#if defined(__linux__) || defined(__linux)
+    // 预先分配磁盘空间，防止磁盘满时写映射内存触发SIGBUS
+    // Allocate disk space in advance to prevent SIGBUS when writing to mapped memory with a full disk
+    auto err = posix_fallocate(fd, 0, _segment_size);
+#else
+    auto err = ftruncate(fd, _segment_size);
+#endif
+    int flags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+    flags |= MAP_POPULATE;
+#endif
+    void *data = err ? MAP_FAILED : mmap(nullptr, _segment_size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        File::delete_file(path);
+        return nullptr;
+    }
+
+    auto segment = new Segment;
+    segment->fd = fd;
+    segment->data = (char *)data;
+    segment->capacity = _segment_size;
+    segment->day = getDay(now);
+    segment->path = std::move(path);
+    _log_file_map.emplace(segment->path);
+    return segment;
+}
+
+void MmapFileChannel::commit(Segment *segment, bool final) {
+    auto end = std::min(std::min(segment->reserved.load(), segment->end.load()), segment->capacity);
+    if (end <= segment->synced && !final) {
+        return;
+    }
+    static const size_t s_page_size = sysconf(_SC_PAGESIZE);
+    // 从上次落盘位置所在的页开始，并发写入可能在上次落盘后才完成
+    // Start from the page of the last committed position, concurrent writes may complete after the last commit
+    auto start = final ? 0 : segment->synced / s_page_size * s_page_size;
+    if (end > start) {
+        msync(segment->data + start, end - start, MS_SYNC);
+    }
+    segment->synced = end;
+}
+
+void MmapFileChannel::release(Segment *segment) {
+    commit(segment, true);
+    munmap(segment->data, segment->capacity);
+    // 截掉预分配但未使用的部分
+    // Truncate the pre-allocated but unused part
+    if (ftruncate(segment->fd, segment->synced) == -1) {
+        WarnL << "Truncate log segment failed: " << segment->path;
+    }
+    ::close(segment->fd);
+    delete segment;
+}
+
+void MmapFileChannel::reclaim() {
+    // 上一纪元的写者都已离开时，回收上一纪元之前切换掉的分片并切换纪元；否则留待下一轮
+    // Once all the writers of the previous epoch have left, reclaim the segments switched out before the previous epoch
+    // and switch epochs; otherwise leave it to the next round
+    auto epoch = _epoch.load();
+    if (_writers[(epoch - 1) & 1].load() != 0) {
+        return;
+    }
+    bool released = !_retired_old.empty();
+    _retired_old.for_each([&](Segment *segment) { release(segment); });
+    _retired_old.clear();
+    _retired_old.swap(_retired_new);
+    _epoch.store(epoch + 1);
+    if (released) {
+        clean();
+    }
+}
+
+void MmapFileChannel::clean() {
+    while (_log_file_map.size() > _log_max_count) {
+        auto it = _log_file_map.begin();
+        auto current = _current.load();
+        auto next = _next.load();
+        if ((current && *it == current->path) || (next && *it == next->path)) {
+            break;
+        }
+        bool in_use = false;
+        _retired_old.for_each([&](Segment *segment) { in_use = in_use || segment->path == *it; });
+        _retired_new.for_each([&](Segment *segment) { in_use = in_use || segment->path == *it; });
+        if (in_use) {
+            break;
+        }
+        File::delete_file(*it);
+        _log_file_map.erase(it);
+    }
+}
+
+void MmapFileChannel::run() {
+    setThreadName("mmap log");
+    while (!_exit_flag) {
+        _sem.wait(_flush_interval_ms);
+
+        // 预先创建下一个分片
+        // Prepare the next segment in advance
+        if (!_next.load()) {
+            _next = createSegment();
+        }
+
+        auto current = _current.load();
+        if (current && current->orphan.exchange(false)) {
+            // 写满时下一个分片尚未就绪，由本线程完成切换
+            // The next segment was not ready when it was full, finish switching in this thread
+            if (auto next = _next.exchange(nullptr)) {
+                rotate(current, next);
+            } else {
+                current->orphan = true;
+            }
+        } else if (current && current->day != getDay(time(nullptr))) {
+            // 新的一天，主动切换分片：像写日志线程一样预留全部空间，如果本线程首先越界则负责切换
+            // A new day, switch segments actively: reserve the whole space like a logging thread,
+            // and be responsible for switching if this thread overflowed first
+            auto offset = current->reserved.fetch_add(current->capacity + 1);
+            if (offset <= current->capacity) {
+                current->end = offset;
+                if (auto next = _next.exchange(nullptr)) {
+                    rotate(current, next);
+                } else {
+                    current->orphan = true;
+                }
+            }
+        }
+
+        // 收集已经被切换掉的分片
+        // Collect the segments that have been switched out
+        current = _current.load();
+        while (_tracked && _tracked != current) {
+            _retired_new.emplace_back(_tracked);
+            _tracked = _tracked->successor.load();
+        }
+        if (!_tracked) {
+            _tracked = current;
+        }
+
+        // 批量落盘
+        // Group commit
+        if (current) {
+            commit(current, false);
+        }
+
+        // 按纪元逐批回收被切换掉的分片，持续写日志也不会推迟回收
+        // Reclaim the switched out segments batch by batch by epoch, sustained logging does not postpone it
+        reclaim();
+    }
+}
+
+#endif // !defined(_WIN32)
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 void LoggerWrapper::printLogV(Logger &logger, int level, const char *file, const char *function, int line, const char *fmt, va_list ap) {
+    if (!logger.isLevelEnabled((LogLevel)level)) {
+        return;
+    }
     LogContextCapture info(logger, (LogLevel) level, file, function, line);
     char *str = nullptr;
     if (vasprintf(&str, fmt, ap) >= 0 && str) {
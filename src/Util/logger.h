@@ -18,6 +18,7 @@
 #include <thread>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include "util.h"
 #include "List.h"
 #include "Thread/semaphore.h"
@@ -35,6 +36,12 @@ typedef enum {
     LTrace = 0, LDebug, LInfo, LWarn, LError
 } LogLevel;
 
+// 编译期最低日志等级，低于该等级的日志语句会被编译器直接移除，可以通过cmake -DLOG_MIN_LEVEL=N修改
+// Compile-time minimum log level, log statements below it are removed by the compiler, can be changed by cmake -DLOG_MIN_LEVEL=N
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
 Logger &getLogger();
 void setLogger(Logger *logger);
 
@@ -47,6 +54,7 @@ void setLogger(Logger *logger);
 class Logger : public std::enable_shared_from_this<Logger>, public noncopyable {
 public:
     friend class AsyncLogWriter;
+    friend class FastLogWriter;
     using Ptr = std::shared_ptr<Logger>;
 
     /**
@@ -114,6 +122,17 @@ public:
      */
     void setLevel(LogLevel level);
 
+    /**
+     * 判断该等级的日志是否会被任意日志通道输出，日志宏在构造日志对象前通过它过滤
+     * 该值为add/del/setLevel时所有日志通道等级的最小值，添加日志通道后如果直接修改通道等级，请再调用一次setLevel或add
+     * @param level log等级
+     * Whether logs of this level will be output by any log channel, log macros filter by it before building the log object
+     * The value is the minimum level of all log channels at add/del/setLevel, if the channel level is changed directly after
+     * being added, please call setLevel or add again
+     * @param level log level
+     */
+    bool isLevelEnabled(LogLevel level) const { return level >= _level.load(std::memory_order_relaxed); }
+
     /**
      * 获取logger名
      * @return logger名
@@ -145,8 +164,10 @@ private:
      */
     void writeChannels(const LogContextPtr &ctx);
     void writeChannels_l(const LogContextPtr &ctx);
+    void updateLevel();
 
 private:
+    std::atomic<LogLevel> _level { LTrace };
     LogContextPtr _last_log;
     std::string _logger_name;
     std::shared_ptr<LogWriter> _writer;
@@ -199,8 +220,17 @@ public:
     using Ptr = std::shared_ptr<LogContextCapture>;
 
     LogContextCapture(Logger &logger, LogLevel level, const char *file, const char *function, int line, const char *flag = "");
+    /**
+     * 空对象，不输出任何日志，供等级被过滤的日志宏使用
+     * Empty object that outputs nothing, used by log macros whose level is filtered
+     */
+    LogContextCapture() = default;
     LogContextCapture(const LogContextCapture &that);
-    ~LogContextCapture();
+    ~LogContextCapture() {
+        if (_ctx) {
+            *this << std::endl;
+        }
+    }
 
     /**
      * 输入std::endl(回车符)立即输出日志
@@ -227,7 +257,7 @@ public:
 
 private:
     LogContextPtr _ctx;
-    Logger &_logger;
+    Logger *_logger = nullptr;
 };
 
 
@@ -279,6 +309,7 @@ public:
     virtual void write(const Logger &logger, const LogContextPtr &ctx) = 0;
     const std::string &name() const;
     void setLevel(LogLevel level);
+    LogLevel level() const;
     static std::string printTime(const timeval &tv);
 
 protected:
@@ -466,6 +497,92 @@ private:
     std::set<std::string> _log_file_map;
 };
 
+#if !defined(_WIN32)
+/**
+ * 基于内存映射的日志文件通道
+ * 日志追加到预先分配大小并映射到内存的文件分片中，写日志只需原子地预留空间并拷贝，不会阻塞在磁盘io上；
+ * 后台线程负责按间隔批量落盘(group commit)、预先创建下一个分片以及回收写满的分片，切换分片时不阻塞写日志线程
+ * Memory-mapped log file channel
+ * Logs are appended into pre-sized memory-mapped file segments, writing a log only atomically reserves space and copies,
+ * it never blocks on disk io; a background thread commits to disk in groups at an interval, prepares the next segment
+ * in advance and reclaims full segments, so switching segments never blocks the logging threads
+ */
+class MmapFileChannel : public LogChannel {
+public:
+    /**
+     * @param dir 日志目录
+     * @param segment_size 每个分片文件大小，单位MB
+     * @param flush_interval_ms 批量落盘间隔，单位毫秒
+     * @param dir Log directory
+     * @param segment_size Size of each segment file, unit: MB
+     * @param flush_interval_ms Group commit interval, unit: milliseconds
+     */
+    MmapFileChannel(const std::string &name = "MmapFileChannel", const std::string &dir = exeDir() + "log/", LogLevel level = LTrace,
+                    size_t segment_size = 32, unsigned int flush_interval_ms = 1000);
+    ~MmapFileChannel() override;
+
+    void write(const Logger &logger, const LogContextPtr &ctx) override;
+
+    /**
+     * 追加一段已格式化的日志，可被多线程并发调用
+     * @return 没有可用分片时丢弃并返回false
+     * Append a formatted log, can be called by multiple threads concurrently
+     * @return false if it is dropped because no segment is available
+     */
+    bool append(const char *data, size_t size);
+
+    /**
+     * 设置日志分片文件最大个数
+     * Set the maximum number of log segment files
+     */
+    void setFileMaxCount(size_t max_count);
+
+    /**
+     * 因没有可用分片而丢弃的日志条数
+     * Number of logs dropped because no segment was available
+     */
+    uint64_t dropped() const;
+
+private:
+    struct Segment;
+    class WriteGuard;
+
+    void run();
+    Segment *createSegment();
+    void rotate(Segment *full, Segment *next);
+    void commit(Segment *segment, bool final);
+    void release(Segment *segment);
+    void reclaim();
+    void clean();
+
+private:
+    std::atomic<bool> _exit_flag { false };
+    size_t _segment_size;
+    size_t _log_max_count = 30;
+    size_t _index = 0;
+    unsigned int _flush_interval_ms;
+    std::string _dir;
+    semaphore _sem;
+    std::atomic<uint64_t> _dropped { 0 };
+    // 写日志线程按进入时纪元的奇偶计数，上一纪元的写者清零后，此前切换掉的分片不会再被访问
+    // Logging threads are counted by the parity of the epoch they entered, once the writers of the previous epoch drop to zero,
+    // the segments switched out before will never be accessed again
+    std::atomic<uint64_t> _epoch { 0 };
+    std::atomic<size_t> _writers[2];
+    std::atomic<Segment *> _current { nullptr };
+    std::atomic<Segment *> _next { nullptr };
+    // 以下成员只在后台线程中访问
+    // The following members are only accessed in the background thread
+    Segment *_tracked = nullptr;
+    // 已切换掉、等待上一纪元写者离开后回收的分片
+    // Segments switched out, waiting to be reclaimed once the writers of the previous epoch have left
+    List<Segment *> _retired_old;
+    List<Segment *> _retired_new;
+    std::set<std::string> _log_file_map;
+    std::shared_ptr<std::thread> _thread;
+};
+#endif // !defined(_WIN32)
+
 #if defined(__MACH__) || ((defined(__linux) || defined(__linux__)) && !defined(ANDROID))
 class SysLogChannel : public LogChannel {
 public:
@@ -494,12 +611,18 @@ class LoggerWrapper {
 public:
     template<typename First, typename ...ARGS>
     static inline void printLogArray(Logger &logger, LogLevel level, const char *file, const char *function, int line, First &&first, ARGS &&...args) {
+        if (!logger.isLevelEnabled(level)) {
+            return;
+        }
         LogContextCapture log(logger, level, file, function, line);
         log << std::forward<First>(first);
         appendLog(log, std::forward<ARGS>(args)...);
     }
 
     static inline void printLogArray(Logger &logger, LogLevel level, const char *file, const char *function, int line) {
+        if (!logger.isLevelEnabled(level)) {
+            return;
+        }
         LogContextCapture log(logger, level, file, function, line);
     }
 
@@ -522,9 +645,22 @@ public:
 //Can reset default value
 extern Logger *g_defaultLogger;
 
+//日志等级被过滤时只需一次比较，不会构造日志对象，也不会对<<后的参数求值；低于LOG_MIN_LEVEL的语句在编译期被移除
+//When the level is filtered only one comparison is needed, neither the log object is built nor the arguments after << are evaluated;
+//statements below LOG_MIN_LEVEL are removed at compile time
+#define LogLevelEnabled(level) ((level) >= LOG_MIN_LEVEL && ::toolkit::getLogger().isLevelEnabled(level))
+
+//不检查等级直接构造LogContextCapture，等级被过滤时不会构造日志内容，但<<后的参数仍会求值
+//Build a LogContextCapture without checking the level first, no log content is built when the level is filtered,
+//but the arguments after << are still evaluated
+#define CaptureL(level) ::toolkit::LogContextCapture(::toolkit::getLogger(), level, __FILE__, __FUNCTION__, __LINE__)
+
 //用法: DebugL << 1 << "+" << 2 << '=' << 3;  [AUTO-TRANSLATED:e6efe6cb]
 //Usage: DebugL << 1 << "+" << 2 << '=' << 3;
-#define WriteL(level) ::toolkit::LogContextCapture(::toolkit::getLogger(), level, __FILE__, __FUNCTION__, __LINE__)
+//三目运算符的两个分支都是LogContextCapture对象，<<只绑定到启用的分支，因此宏仍可作为对象传递(如TimeTicker2(tm, WarnL))
+//Both branches of the conditional operator are LogContextCapture objects and << only binds to the enabled one, so the
+//macros can still be passed as objects (e.g. TimeTicker2(tm, WarnL))
+#define WriteL(level) !LogLevelEnabled(level) ? ::toolkit::LogContextCapture() : ::toolkit::LogContextCapture(::toolkit::getLogger(), level, __FILE__, __FUNCTION__, __LINE__)
 #define TraceL WriteL(::toolkit::LTrace)
 #define DebugL WriteL(::toolkit::LDebug)
 #define InfoL WriteL(::toolkit::LInfo)
@@ -533,7 +669,7 @@ extern Logger *g_defaultLogger;
 
 //只能在虚继承BaseLogFlagInterface的类中使用  [AUTO-TRANSLATED:a395e54d]
 //Can only be used in classes that virtually inherit from BaseLogFlagInterface
-#define WriteF(level) ::toolkit::LogContextCapture(::toolkit::getLogger(), level, __FILE__, __FUNCTION__, __LINE__, getLogFlag())
+#define WriteF(level) !LogLevelEnabled(level) ? ::toolkit::LogContextCapture() : ::toolkit::LogContextCapture(::toolkit::getLogger(), level, __FILE__, __FUNCTION__, __LINE__, getLogFlag())
 #define TraceF WriteF(::toolkit::LTrace)
 #define DebugF WriteF(::toolkit::LDebug)
 #define InfoF WriteF(::toolkit::LInfo)
@@ -542,7 +678,7 @@ extern Logger *g_defaultLogger;
 
 //用法: PrintD("%d + %s = %c", 1 "2", 'c');  [AUTO-TRANSLATED:1217cc82]
 //Usage: PrintD("%d + %s = %c", 1, "2", 'c');
-#define PrintLog(level, ...) ::toolkit::LoggerWrapper::printLog(::toolkit::getLogger(), level, __FILE__, __FUNCTION__, __LINE__, ##__VA_ARGS__)
+#define PrintLog(level, ...) !LogLevelEnabled(level) ? (void)0 : ::toolkit::LoggerWrapper::printLog(::toolkit::getLogger(), level, __FILE__, __FUNCTION__, __LINE__, ##__VA_ARGS__)
 #define PrintT(...) PrintLog(::toolkit::LTrace, ##__VA_ARGS__)
 #define PrintD(...) PrintLog(::toolkit::LDebug, ##__VA_ARGS__)
 #define PrintI(...) PrintLog(::toolkit::LInfo, ##__VA_ARGS__)
@@ -553,7 +689,7 @@ extern Logger *g_defaultLogger;
 //Usage: LogD(1, "+", "2", '=', 3);
 //用于模板实例化的原因，如果每次打印参数个数和类型不一致，可能会导致二进制代码膨胀  [AUTO-TRANSLATED:c40b3f4e]
 //Used for template instantiation, because if the number and type of print parameters are inconsistent each time, it may cause binary code bloat
-#define LogL(level, ...) ::toolkit::LoggerWrapper::printLogArray(::toolkit::getLogger(), (LogLevel)level, __FILE__, __FUNCTION__, __LINE__, ##__VA_ARGS__)
+#define LogL(level, ...) !LogLevelEnabled((::toolkit::LogLevel)level) ? (void)0 : ::toolkit::LoggerWrapper::printLogArray(::toolkit::getLogger(), (::toolkit::LogLevel)level, __FILE__, __FUNCTION__, __LINE__, ##__VA_ARGS__)
 #define LogT(...) LogL(::toolkit::LTrace, ##__VA_ARGS__)
 #define LogD(...) LogL(::toolkit::LDebug, ##__VA_ARGS__)
 #define LogI(...) LogL(::toolkit::LInfo, ##__VA_ARGS__)
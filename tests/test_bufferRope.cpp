@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <string>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Network/Buffer.h"
+#include "Network/BufferSock.h"
+#include "test_check.h"
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+static Buffer::Ptr makeBuffer(const string &str) {
+    auto ret = BufferRaw::create();
+    ret->assign(str.data(), str.size());
+    return ret;
+}
+
+static bool testBasic() {
+    auto rope = BufferRope::create();
+    rope->append(makeBuffer("hello "));
+    rope->append(makeBuffer("xxworldxx"), 2, 5);
+    rope->prepend(makeBuffer(">> "));
+    CHECK(rope->size() == 14);
+    CHECK(rope->slices().size() == 3);
+    CHECK(rope->toString() == ">> hello world");
+    CHECK((*rope)[3] == 'h' && (*rope)[13] == 'd');
+
+    // 跨片段查找
+    // Find across slices
+    CHECK(rope->find("o w") == 7);
+    CHECK(rope->find("lo wo") == 6);
+    CHECK(rope->find("world", 9) == 9);
+    CHECK(rope->find("world", 10) == string::npos);
+    CHECK(rope->find("xx") == string::npos);
+
+    auto sub = rope->slice(5, 6);
+    CHECK(sub->toString() == "llo wo");
+    CHECK(sub->slices().size() == 2);
+
+    auto head = rope->split(9);
+    CHECK(head->toString() == ">> hello ");
+    CHECK(rope->toString() == "world");
+    rope->erase(2);
+    CHECK(rope->toString() == "rld");
+
+    // data()返回连续拷贝，片段保持不变；修改后重新合并
+    // data() returns a contiguous copy while the slices stay untouched; merged again after modification
+    head->append(*rope);
+    CHECK(head->slices().size() == 3);
+    CHECK(string(head->data(), head->size()) == ">> hello rld");
+    CHECK(head->slices().size() == 3 && head->data() == head->data());
+    head->append(makeBuffer("!"));
+    CHECK(string(head->data(), head->size()) == ">> hello rld!");
+
+    // 空片段不会被加入
+    // Empty slices are never added
+    head->append(makeBuffer("abc"), 1, 0);
+    head->prepend(makeBuffer("abc"), 0, 0);
+    head->append("", 0);
+    CHECK(head->slices().size() == 4);
+
+    // 拷贝式追加写入共享块
+    // Copying appends write into a shared chunk
+    auto copied = BufferRope::create();
+    for (int i = 0; i < 1000; ++i) {
+        copied->append("abc", 3);
+    }
+    CHECK(copied->size() == 3000);
+    CHECK(copied->slices().size() == 1);
+    auto tail = copied->split(1500);
+    copied->append("def", 3);
+    CHECK(copied->find("cdef") == 1499);
+    CHECK(tail->size() == 1500 && tail->toString().substr(0, 6) == "abcabc");
+    return true;
+}
+
+#if !defined(_WIN32)
+static bool testSendMsg() {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    auto rope = BufferRope::create();
+    rope->append(makeBuffer("GET / HTTP/1.1\r\n"));
+    rope->append(makeBuffer("Host: localhost\r\n"));
+    rope->append(makeBuffer("\r\n"));
+    List<std::pair<Buffer::Ptr, bool> > list;
+    list.emplace_back(makeBuffer("[begin]"), false);
+    list.emplace_back(rope, false);
+    list.emplace_back(makeBuffer("[end]"), false);
+
+    vector<string> sent;
+    auto buffers = BufferList::create(std::move(list), [&](const Buffer::Ptr &buf, bool ok) {
+        if (ok) {
+            sent.emplace_back(buf->toString());
+        }
+    }, false);
+    CHECK(buffers->count() == 3);
+    CHECK(buffers->send(fds[0], 0) == 7 + 35 + 5);
+    CHECK(buffers->empty());
+    buffers = nullptr;
+    CHECK(sent.size() == 3);
+    CHECK(sent[1] == "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+    char buf[128];
+    auto n = recv(fds[1], buf, sizeof(buf), 0);
+    CHECK(string(buf, n) == "[begin]GET / HTTP/1.1\r\nHost: localhost\r\n\r\n[end]");
+    close(fds[0]);
+    close(fds[1]);
+    return true;
+}
+#else
+static bool testSendMsg() {
+    return true;
+}
+#endif
+
+// 模拟网络收包的分片大小
+// Chunk size simulating network receiving
+static constexpr size_t kChunkSize = 1400;
+
+static string makeRequest(size_t body_size) {
+    string body(body_size, 'x');
+    return "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/octet-stream\r\nContent-Length: "
+        + to_string(body_size) + "\r\n\r\n" + body;
+}
+
+static size_t contentLength(const char *header, size_t size) {
+    static const char kKey[] = "Content-Length: ";
+    string str(header, size);
+    auto pos = str.find(kKey);
+    return pos == string::npos ? 0 : atoi(str.data() + pos + sizeof(kKey) - 1);
+}
+
+/**
+ * 以BufferLikeString作为接收缓存的http解析：追加、查找、拷贝、擦除
+ * Http parsing with BufferLikeString as the receive cache: append, find, copy and erase
+ */
+static size_t parseWithString(const vector<Buffer::Ptr> &chunks) {
+    BufferLikeString cache;
+    size_t content_len = 0, total = 0, searched = 0;
+    bool in_header = true;
+    for (auto &chunk : chunks) {
+        cache.append(chunk->data(), chunk->size());
+        while (true) {
+            if (in_header) {
+                auto ptr = strstr(cache.data() + searched, "\r\n\r\n");
+                if (!ptr) {
+                    searched = cache.size() > 3 ? cache.size() - 3 : 0;
+                    break;
+                }
+                auto pos = ptr - cache.data();
+                string header(cache.data(), pos + 4);
+                content_len = contentLength(header.data(), header.size());
+                cache.erase(0, pos + 4);
+                in_header = false;
+                searched = 0;
+            }
+            if (cache.size() < content_len) {
+                break;
+            }
+            string body(cache.data(), content_len);
+            total += body.size();
+            cache.erase(0, content_len);
+            in_header = true;
+        }
+    }
+    return total;
+}
+
+/**
+ * 以BufferRope作为接收缓存的http解析：追加、查找、切分，body不发生拷贝
+ * Http parsing with BufferRope as the receive cache: append, find and split, the body is not copied
+ */
+static size_t parseWithRope(const vector<Buffer::Ptr> &chunks) {
+    BufferRope cache;
+    size_t content_len = 0, total = 0, searched = 0;
+    bool in_header = true;
+    for (auto &chunk : chunks) {
+        cache.append(chunk);
+        while (true) {
+            if (in_header) {
+                auto pos = cache.find("\r\n\r\n", searched);
+                if (pos == string::npos) {
+                    searched = cache.size() > 3 ? cache.size() - 3 : 0;
+                    break;
+                }
+                auto header = cache.split(pos + 4);
+                content_len = contentLength(header->data(), header->size());
+                in_header = false;
+                searched = 0;
+            }
+            if (cache.size() < content_len) {
+                break;
+            }
+            auto body = cache.split(content_len);
+            total += body->size();
+            in_header = true;
+        }
+    }
+    return total;
+}
+
+static void benchmark(size_t body_size, size_t requests) {
+    string stream;
+    for (size_t i = 0; i < requests; ++i) {
+        stream += makeRequest(body_size);
+    }
+    vector<Buffer::Ptr> chunks;
+    for (size_t pos = 0; pos < stream.size(); pos += kChunkSize) {
+        chunks.emplace_back(makeBuffer(stream.substr(pos, kChunkSize)));
+    }
+
+    Ticker ticker;
+    auto total_string = parseWithString(chunks);
+    auto string_ms = ticker.elapsedTime();
+    ticker.resetTime();
+    auto total_rope = parseWithRope(chunks);
+    auto rope_ms = ticker.elapsedTime();
+
+    cout << "body: " << body_size << " bytes x " << requests << ", BufferLikeString: " << string_ms << "ms, BufferRope: " << rope_ms
+         << "ms, parsed: " << total_string << "/" << total_rope << endl;
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    bool ok = testBasic() && testSendMsg();
+    benchmark(256, 20000);
+    benchmark(64 * 1024, 2000);
+    benchmark(1024 * 1024, 100);
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
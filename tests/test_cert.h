@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_TESTS_TEST_CERT_H
+#define ZLTOOLKIT_TESTS_TEST_CERT_H
+
+#include <string>
+#include <memory>
+
+#if defined(ENABLE_OPENSSL)
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#endif //defined(ENABLE_OPENSSL)
+
+/**
+ * 生成一次性的自签名证书，返回私钥与证书拼接的pem字符串，可直接传给SSL_Initor::loadCertificate(..., is_file = false)；失败返回空
+ * @param common_name 证书的CN，即SNI匹配的虚拟主机名
+ * Generate a throwaway self-signed certificate, returns the pem string of the private key followed by the certificate,
+ * which can be passed to SSL_Initor::loadCertificate(..., is_file = false) directly; empty on failure
+ * @param common_name CN of the certificate, namely the virtual host name matched by SNI
+ */
+inline std::string makeTestCertificate(const std::string &common_name) {
+#if defined(ENABLE_OPENSSL)
+    EVP_PKEY *raw_key = nullptr;
+    std::shared_ptr<EVP_PKEY_CTX> key_ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), EVP_PKEY_CTX_free);
+    if (!key_ctx || EVP_PKEY_keygen_init(key_ctx.get()) != 1
+        || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx.get(), NID_X9_62_prime256v1) != 1
+        || EVP_PKEY_keygen(key_ctx.get(), &raw_key) != 1) {
+        return "";
+    }
+    std::shared_ptr<EVP_PKEY> key(raw_key, EVP_PKEY_free);
+
+    std::shared_ptr<X509> cert(X509_new(), X509_free);
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert.get()), -3600);
+    X509_gmtime_adj(X509_get_notAfter(cert.get()), 24 * 3600);
+    X509_set_pubkey(cert.get(), key.get());
+    auto name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)common_name.data(), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+    if (!X509_sign(cert.get(), key.get(), EVP_sha256())) {
+        return "";
+    }
+
+    std::shared_ptr<BIO> bio(BIO_new(BIO_s_mem()), BIO_free);
+    if (!PEM_write_bio_PrivateKey(bio.get(), key.get(), nullptr, nullptr, 0, nullptr, nullptr) || !PEM_write_bio_X509(bio.get(), cert.get())) {
+        return "";
+    }
+    char *data = nullptr;
+    auto size = BIO_get_mem_data(bio.get(), &data);
+    return std::string(data, size);
+#else
+    return "";
+#endif //defined(ENABLE_OPENSSL)
+}
+
+#endif // ZLTOOLKIT_TESTS_TEST_CERT_H
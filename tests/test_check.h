@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLTOOLKIT_TESTS_TEST_CHECK_H
+#define ZLTOOLKIT_TESTS_TEST_CHECK_H
+
+#include <iostream>
+
+// 校验失败时打印表达式与行号，并让当前用例函数返回false
+// On failure, print the expression and line number, and make the current case function return false
+#define CHECK(exp) \
+    do { \
+        if (!(exp)) { \
+            std::cout << "check failed: " << #exp << " at line " << __LINE__ << std::endl; \
+            return false; \
+        } \
+    } while (0)
+
+#endif // ZLTOOLKIT_TESTS_TEST_CHECK_H
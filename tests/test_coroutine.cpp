@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Thread/semaphore.h"
+#include "Network/TcpServer.h"
+#include "Network/Session.h"
+#include "Network/Coroutine.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+#if defined(ENABLE_COROUTINE)
+
+// 协程中的检查结果，协程结束后由主线程检查
+// Check results in coroutines, checked by the main thread after the coroutine finishes
+struct CoResult {
+    std::atomic<bool> ok { true };
+    semaphore done;
+
+    void expect(bool exp, const char *str) {
+        if (!exp) {
+            cout << "check failed: " << str << endl;
+            ok = false;
+        }
+    }
+};
+
+#define CO_EXPECT(result, exp) (result).expect(exp, #exp)
+
+static CoTask<int> answer(EventPoller::Ptr poller) {
+    co_await coSleep(poller, 1);
+    co_return 42;
+}
+
+static CoTask<void> throwing() {
+    throw std::runtime_error("coroutine exception");
+    co_return;
+}
+
+static CoTask<void> basics(EventPoller::Ptr poller, EventPoller::Ptr other, CoResult &result) {
+    Ticker ticker;
+    co_await coSleep(poller, 50);
+    CO_EXPECT(result, ticker.elapsedTime() >= 45);
+    CO_EXPECT(result, poller->isCurrentThread());
+
+    CO_EXPECT(result, co_await answer(poller) == 42);
+    CO_EXPECT(result, poller->isCurrentThread());
+
+    co_await coSwitchTo(other);
+    CO_EXPECT(result, other->isCurrentThread());
+    co_await coSwitchTo(poller);
+    CO_EXPECT(result, poller->isCurrentThread());
+
+    bool caught = false;
+    try {
+        co_await throwing();
+    } catch (std::runtime_error &) {
+        caught = true;
+    }
+    CO_EXPECT(result, caught);
+    result.done.post();
+}
+
+static bool testBasics() {
+    auto poller = EventPollerPool::Instance().getPoller(false);
+    auto other = EventPollerPool::Instance().getPoller(false);
+    for (size_t i = 0; i < 4 && other == poller; ++i) {
+        other = EventPollerPool::Instance().getPoller(false);
+    }
+    CoResult result;
+    coSpawn(poller, basics(poller, other, result));
+    CHECK(result.done.wait(5 * 1000));
+    CHECK(result.ok);
+    return true;
+}
+
+static CoTask<void> echoLoop(CoSocket::Ptr sock) {
+    while (auto buf = co_await sock->read()) {
+        if (co_await sock->write(std::move(buf)) < 0) {
+            break;
+        }
+    }
+}
+
+static CoTask<void> acceptLoop(CoSocket::Ptr server) {
+    while (auto sock = co_await server->accept()) {
+        auto poller = sock->getSock()->getPoller();
+        coSpawn(poller, echoLoop(std::move(sock)));
+    }
+}
+
+// 协程版echo服务器
+// Coroutine based echo server
+static CoSocket::Ptr startCoEchoServer(const EventPoller::Ptr &poller) {
+    CoSocket::Ptr server;
+    poller->sync([&]() {
+        server = CoSocket::create(poller);
+        if (server->listen(0, "127.0.0.1")) {
+            coSpawn(poller, acceptLoop(server));
+        }
+    });
+    return server;
+}
+
+static void stopCoEchoServer(CoSocket::Ptr &server) {
+    auto poller = server->getSock()->getPoller();
+    poller->sync([&]() { server->getSock()->emitErr(SockException(Err_eof, "server stopped")); });
+    poller->sync([&]() { server = nullptr; });
+}
+
+static CoTask<void> echoClient(EventPoller::Ptr poller, uint16_t port, CoResult &result) {
+    auto client = std::make_shared<CoTcpClient>(poller);
+    auto ex = co_await client->connect("127.0.0.1", port);
+    CO_EXPECT(result, !ex);
+    if (!ex) {
+        std::string sent, received;
+        for (size_t i = 0; i < 100; ++i) {
+            auto msg = std::string(1 + i * 100, 'a' + i % 26);
+            sent += msg;
+            CO_EXPECT(result, co_await client->write(std::make_shared<BufferString>(std::move(msg))) >= 0);
+        }
+        while (received.size() < sent.size()) {
+            auto buf = co_await client->read();
+            if (!buf) {
+                break;
+            }
+            received.append(buf->data(), buf->size());
+        }
+        CO_EXPECT(result, received == sent);
+    }
+    client->shutdown();
+    result.done.post();
+}
+
+static bool testEcho() {
+    auto poller = EventPollerPool::Instance().getPoller(false);
+    auto server = startCoEchoServer(poller);
+    CHECK(server->getSock()->get_local_port() != 0);
+
+    CoResult result;
+    coSpawn(poller, echoClient(poller, server->getSock()->get_local_port(), result));
+    CHECK(result.done.wait(5 * 1000));
+    CHECK(result.ok);
+
+    // 连接失败
+    // Connection failure
+    CoResult refused;
+    coSpawn(poller, [](EventPoller::Ptr poller, CoResult &result) -> CoTask<void> {
+        auto sock = CoSocket::create(poller);
+        auto ex = co_await sock->connect("127.0.0.1", 1, 2);
+        CO_EXPECT(result, (bool)ex);
+        CO_EXPECT(result, co_await sock->read() == nullptr);
+        result.done.post();
+    }(poller, refused));
+    CHECK(refused.done.wait(5 * 1000));
+    CHECK(refused.ok);
+
+    stopCoEchoServer(server);
+    return true;
+}
+
+class EchoSession : public Session {
+public:
+    EchoSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { send(buf); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+// n个连接各自64字节ping-pong，返回每秒往返次数
+// n connections each doing 64-byte ping-pong, return round trips per second
+static double pingPong(uint16_t port, size_t n, uint64_t duration_ms) {
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    vector<struct pollfd> fds(n);
+    vector<size_t> received(n, 0);
+    char msg[64];
+    memset(msg, 'x', sizeof(msg));
+    for (auto &pfd : fds) {
+        pfd.fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::connect(pfd.fd, (struct sockaddr *)&addr, sizeof(addr));
+        SockUtil::setNoDelay(pfd.fd);
+        pfd.events = POLLIN;
+        ::send(pfd.fd, msg, sizeof(msg), 0);
+    }
+
+    uint64_t round_trips = 0;
+    char buf[4096];
+    Ticker ticker;
+    while (ticker.elapsedTime() < duration_ms) {
+        if (::poll(fds.data(), fds.size(), 100) <= 0) {
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            auto ret = ::recv(fds[i].fd, buf, sizeof(buf), 0);
+            if (ret <= 0) {
+                continue;
+            }
+            received[i] += ret;
+            while (received[i] >= sizeof(msg)) {
+                received[i] -= sizeof(msg);
+                ++round_trips;
+                ::send(fds[i].fd, msg, sizeof(msg), 0);
+            }
+        }
+    }
+    auto elapsed = ticker.elapsedTime();
+    for (auto &pfd : fds) {
+        ::close(pfd.fd);
+    }
+    return round_trips * 1000.0 / elapsed;
+}
+
+static void benchmark() {
+    static constexpr size_t kConnections = 32;
+    static constexpr uint64_t kDurationMS = 3000;
+
+    double callback_rate = 0;
+    {
+        TcpServer::Ptr server(new TcpServer());
+        server->start<EchoSession>(0, "127.0.0.1");
+        callback_rate = pingPong(server->getPort(), kConnections, kDurationMS);
+    }
+    usleep(100 * 1000);
+
+    double coroutine_rate = 0;
+    {
+        auto server = startCoEchoServer(EventPollerPool::Instance().getPoller(false));
+        coroutine_rate = pingPong(server->getSock()->get_local_port(), kConnections, kDurationMS);
+        stopCoEchoServer(server);
+    }
+
+    cout << "echo " << kConnections << " connections x 64 bytes, round trips per second:" << endl;
+    cout << "  TcpServer + Session callbacks: " << (uint64_t)callback_rate << endl;
+    cout << "  CoSocket coroutines:           " << (uint64_t)coroutine_rate << endl;
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    bool ok = testBasics() && testEcho();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (ok && !(argc > 1 && string(argv[1]) == "--no-bench")) {
+        benchmark();
+    }
+    return ok ? 0 : 1;
+}
+
+#else
+
+int main() {
+    cout << "c++20 coroutines are not available, skipped" << endl;
+    return 0;
+}
+
+#endif // defined(ENABLE_COROUTINE)
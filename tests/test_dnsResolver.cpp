@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Thread/semaphore.h"
+#include "Network/Socket.h"
+#include "Network/DnsResolver.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+/**
+ * 本地dns桩服务器，*.test域名应答A记录10.0.0.x(x为应答次数)，ttl 1秒，missing.test应答NXDOMAIN
+ * Local stub dns server, *.test names are answered with A record 10.0.0.x (x is the answer count), ttl 1 second,
+ * missing.test is answered with NXDOMAIN
+ */
+class StubDnsServer {
+public:
+    StubDnsServer() {
+        _sock = Socket::createSocket(EventPollerPool::Instance().getPoller(), false);
+        _sock->bindUdpSock(0, "127.0.0.1");
+        _sock->setOnRead([this](Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) { onQuery(buf, addr, addr_len); });
+    }
+
+    uint16_t port() { return _sock->get_local_port(); }
+    size_t queries() { return _queries.load(); }
+
+private:
+    void onQuery(const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+        ++_queries;
+        string query(buf->data(), buf->size());
+        // 解析question中的域名
+        // Parse the name in the question
+        string name;
+        size_t pos = 12;
+        while (pos < query.size() && query[pos]) {
+            auto len = (uint8_t)query[pos];
+            name.append(name.empty() ? "" : ".").append(query.substr(pos + 1, len));
+            pos += len + 1;
+        }
+        auto question_end = pos + 5;
+
+        string answer = query.substr(0, question_end);
+        answer[2] = (char)0x81;
+        if (name == "missing.test") {
+            answer[3] = (char)0x83;
+        } else {
+            answer[3] = (char)0x80;
+            answer[7] = 1;
+            // name指针, type A, class IN, ttl 1, rdlength 4, rdata
+            // name pointer, type A, class IN, ttl 1, rdlength 4, rdata
+            const char record[] = { (char)0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0, 1, 0, 4, 10, 0, 0, (char)(++_answers) };
+            answer.append(record, sizeof(record));
+        }
+        _sock->send(std::move(answer), addr, addr_len);
+    }
+
+private:
+    atomic<size_t> _queries { 0 };
+    uint8_t _answers = 0;
+    Socket::Ptr _sock;
+};
+
+static bool resolveSync(DnsResolver &resolver, const string &host, string &ip) {
+    semaphore sem;
+    bool ret = false;
+    resolver.resolve(host, AF_INET, [&](const SockException &ex, const DnsResolver::AddressList &addrs) {
+        if (!ex) {
+            ip = SockUtil::inet_ntoa((struct sockaddr *)&addrs.front());
+            ret = true;
+        }
+        sem.post();
+    });
+    sem.wait();
+    return ret;
+}
+
+static bool testResolver() {
+    StubDnsServer server;
+    auto resolver = std::make_shared<DnsResolver>();
+    resolver->setNameServers({ "127.0.0.1" }, server.port());
+    resolver->setStaleSecond(5);
+
+    string ip;
+    // 首次查询
+    // The first lookup
+    CHECK(resolveSync(*resolver, "a.test", ip) && ip == "10.0.0.1" && server.queries() == 1);
+    // 命中缓存，不再发送查询
+    // Cache hit, no query is sent
+    CHECK(resolveSync(*resolver, "A.TEST.", ip) && ip == "10.0.0.1" && server.queries() == 1);
+
+    // 并发查询同一域名只发送一次
+    // Concurrent lookups of the same name only send one query
+    {
+        static constexpr size_t kConcurrent = 100;
+        semaphore sem;
+        atomic<size_t> success(0);
+        for (size_t i = 0; i < kConcurrent; ++i) {
+            resolver->resolve("b.test", AF_INET, [&](const SockException &ex, const DnsResolver::AddressList &) {
+                if (!ex) {
+                    ++success;
+                }
+                sem.post();
+            });
+        }
+        sem.wait(kConcurrent);
+        CHECK(success == kConcurrent && server.queries() == 2);
+    }
+
+    // 过期后先返回旧结果，同时在后台刷新
+    // After expiration the old result is returned first while it is refreshed in the background
+    sleep(2);
+    CHECK(resolveSync(*resolver, "a.test", ip) && ip == "10.0.0.1");
+    usleep(200 * 1000);
+    CHECK(server.queries() == 3);
+    CHECK(resolveSync(*resolver, "a.test", ip) && ip == "10.0.0.3");
+
+    // 域名不存在
+    // Name not exist
+    CHECK(!resolveSync(*resolver, "missing.test", ip));
+
+    // nameserver无响应时超时
+    // Timeout when the nameserver does not respond
+    resolver->setNameServers({ "127.0.0.1" }, 1);
+    resolver->setTimeout(100, 1);
+    CHECK(!resolveSync(*resolver, "c.test", ip));
+    return true;
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    bool ok = testResolver();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
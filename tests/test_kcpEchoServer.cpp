@@ -33,6 +33,9 @@ public:
     EchoSession(const Socket::Ptr &sock) :
             Session(sock) {
         DebugL;
+        // 使用onManager做定时管理
+        // Use onManager for periodic management
+        enableManager(true);
     }
     ~EchoSession() {
         DebugL;
@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/Byte.hpp"
+#include "Thread/semaphore.h"
+#include "Network/KcpMux.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+using Sender = function<void(const Buffer::Ptr &buf)>;
+
+/**
+ * 模拟带延时与丢包的单向udp链路，链路销毁后在途的包被丢弃，须在poller线程使用
+ * Emulated one-way udp link with delay and loss, packets in flight are dropped after the link is destroyed, must be used in the poller thread
+ */
+class LossyLink {
+public:
+    using Ptr = shared_ptr<LossyLink>;
+
+    LossyLink(EventPoller::Ptr poller, uint32_t delay_ms, double loss, uint32_t seed)
+        : _poller(std::move(poller)), _delay_ms(delay_ms), _loss(loss), _rand(seed) {
+        _receiver = make_shared<Sender>();
+    }
+
+    void setReceiver(Sender cb) { *_receiver = std::move(cb); }
+
+    void send(const Buffer::Ptr &buf) {
+        if (_dist(_rand) < _loss) {
+            return;
+        }
+        auto wire = make_shared<string>();
+        auto rope = dynamic_pointer_cast<BufferRope>(buf);
+        if (rope) {
+            for (auto &slice : rope->slices()) {
+                wire->append(slice.data(), slice.size);
+            }
+        } else {
+            wire->assign(buf->data(), buf->size());
+        }
+        weak_ptr<Sender> weak_receiver = _receiver;
+        _poller->doDelayTask(_delay_ms, [weak_receiver, wire]() {
+            auto receiver = weak_receiver.lock();
+            if (receiver && *receiver) {
+                auto buf = BufferRaw::create();
+                buf->assign(wire->data(), wire->size());
+                (*receiver)(buf);
+            }
+            return 0;
+        });
+    }
+
+private:
+    EventPoller::Ptr _poller;
+    uint32_t _delay_ms;
+    double _loss;
+    mt19937 _rand;
+    uniform_real_distribution<double> _dist { 0, 1 };
+    shared_ptr<Sender> _receiver;
+};
+
+static void configure(const KcpTransport::Ptr &kcp) {
+    kcp->setInterval(10);
+    kcp->setDelayMode(KcpTransport::DelayMode::DELAY_MODE_NO_DELAY);
+    kcp->setFastResend(2);
+    kcp->setWndSize(1024, 1024);
+    kcp->setNoCwnd(true);
+}
+
+static string makeMessage(uint16_t stream, size_t index, size_t size) {
+    string ret(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        ret[i] = (char)(stream * 31 + index * 7 + i);
+    }
+    return ret;
+}
+
+// 两个流可靠有序，一个流不可靠；对端新建的流通过onStream接收
+// Two streams are reliable and ordered, one is unreliable; streams created by the peer are received by onStream
+static bool testStreams() {
+    static constexpr size_t kCount = 200;
+    auto poller = EventPollerPool::Instance().getPoller();
+    KcpMux::Ptr client, server;
+    LossyLink::Ptr to_server, to_client;
+    semaphore sem;
+    size_t received[3] = { 0 };
+    size_t remote_streams = 0;
+    bool ok = true;
+
+    poller->sync([&]() {
+        client = make_shared<KcpMux>(false, poller);
+        server = make_shared<KcpMux>(true, poller);
+        to_server = make_shared<LossyLink>(poller, 5, 0.05, 1);
+        to_client = make_shared<LossyLink>(poller, 5, 0.05, 2);
+        client->setOnWrite([&](const Buffer::Ptr &buf) { to_server->send(buf); });
+        server->setOnWrite([&](const Buffer::Ptr &buf) { to_client->send(buf); });
+        to_server->setReceiver([&](const Buffer::Ptr &buf) { server->input(buf); });
+        to_client->setReceiver([&](const Buffer::Ptr &buf) { client->input(buf); });
+        server->setOnStream([&](const KcpMux::Stream::Ptr &stream) {
+            ++remote_streams;
+            auto id = stream->getId();
+            if (stream->getKcpTransport()) {
+                configure(stream->getKcpTransport());
+            }
+            stream->setOnRead([&, id](const Buffer::Ptr &buf) {
+                auto &index = received[id - 1];
+                if (id != 3 && buf->toString() != makeMessage(id, index, 100 + index * 13)) {
+                    ok = false;
+                }
+                if (id == 3 && buf->size() != 100) {
+                    ok = false;
+                }
+                ++index;
+                if (received[0] == kCount && received[1] == kCount) {
+                    sem.post();
+                }
+            });
+        });
+    });
+
+    poller->async([&]() {
+        auto first = client->openStream(1);
+        auto second = client->openStream(2, KcpMux::StreamMode::RELIABLE, 3);
+        auto third = client->openStream(3, KcpMux::StreamMode::UNRELIABLE, 7);
+        configure(first->getKcpTransport());
+        configure(second->getKcpTransport());
+        for (size_t i = 0; i < kCount; ++i) {
+            // 超过mtu的消息被分片
+            // Messages larger than the mtu are fragmented
+            first->send(std::make_shared<BufferString>(makeMessage(1, i, 100 + i * 13)), i + 1 == kCount);
+            second->send(std::make_shared<BufferString>(makeMessage(2, i, 100 + i * 13)), i + 1 == kCount);
+            third->send(std::make_shared<BufferString>(string(100, 'x')));
+        }
+    });
+    auto done = sem.wait(30 * 1000);
+    poller->sync([&]() {
+        client->setOnWrite(nullptr);
+        server->setOnWrite(nullptr);
+        to_server = nullptr;
+        to_client = nullptr;
+    });
+    poller->sync([&]() {
+        client = nullptr;
+        server = nullptr;
+    });
+    CHECK(done && ok);
+    CHECK(remote_streams == 3);
+    // 5%丢包下不可靠流大部分到达且不重传
+    // Most of the unreliable stream arrives with 5% loss and nothing is retransmitted
+    CHECK(received[2] > kCount / 2 && received[2] <= kCount);
+    return true;
+}
+
+// 达到流个数上限后，对端新建流的数据被丢弃，已有的流不受影响
+// Once the stream limit is reached, data of streams newly created by the peer is dropped, existing streams are not affected
+static bool testMaxStreams() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    KcpMux::Ptr client, server;
+    size_t remote_streams = 0;
+    size_t received = 0;
+    poller->sync([&]() {
+        client = make_shared<KcpMux>(false, poller);
+        server = make_shared<KcpMux>(true, poller);
+        server->setMaxStreams(2);
+        client->setOnWrite([&](const Buffer::Ptr &buf) {
+            auto copy = BufferRaw::create();
+            copy->assign(buf->data(), buf->size());
+            server->input(copy);
+        });
+        server->setOnStream([&](const KcpMux::Stream::Ptr &stream) {
+            ++remote_streams;
+            stream->setOnRead([&](const Buffer::Ptr &buf) { ++received; });
+        });
+        for (uint16_t id = 1; id <= 4; ++id) {
+            client->openStream(id, KcpMux::StreamMode::UNRELIABLE)->send(std::make_shared<BufferString>("x"));
+        }
+        client->getStream(1)->send(std::make_shared<BufferString>("y"));
+    });
+    usleep(100 * 1000);
+    poller->sync([&]() {
+        client = nullptr;
+        server = nullptr;
+    });
+    CHECK(remote_streams == 2 && received == 3);
+    return true;
+}
+
+// 一个事件循环只发送一个包时，高优先级流先发送
+// When only one packet is sent per event loop iteration, the stream with higher priority is sent first
+static bool testPriority() {
+    auto poller = EventPollerPool::Instance().getPoller();
+    KcpMux::Ptr mux;
+    vector<uint16_t> order;
+    size_t pending = 0;
+    poller->sync([&]() {
+        mux = make_shared<KcpMux>(false, poller);
+        mux->setMaxBurst(1);
+        mux->setOnWrite([&](const Buffer::Ptr &buf) { order.emplace_back(Byte::Get2BytesLE((const uint8_t *)buf->data(), 1)); });
+        auto low = mux->openStream(1, KcpMux::StreamMode::UNRELIABLE, 6);
+        auto high = mux->openStream(2, KcpMux::StreamMode::UNRELIABLE, 1);
+        for (int i = 0; i < 3; ++i) {
+            low->send(std::make_shared<BufferString>("low"));
+        }
+        high->send(std::make_shared<BufferString>("high"));
+        pending = mux->getPendingCount();
+    });
+    // 等待4个事件循环
+    // Wait for 4 event loop iterations
+    semaphore sem;
+    poller->doDelayTask(50, [&]() {
+        sem.post();
+        return 0;
+    });
+    sem.wait();
+    poller->sync([&]() { mux = nullptr; });
+    CHECK(pending == 4);
+    CHECK(order == vector<uint16_t>({ 2, 1, 1, 1 }));
+    return true;
+}
+
+/**
+ * 控制流每10ms发送一条小消息，视频流每33ms突发一帧，统计控制消息的单向时延
+ * The control stream sends a small message every 10ms, the video stream bursts a frame every 33ms, the one-way latency of control messages is measured
+ */
+class Traffic {
+public:
+    static constexpr uint32_t kControlIntervalMs = 10;
+    static constexpr uint32_t kVideoIntervalMs = 33;
+    static constexpr size_t kVideoPackets = 16;
+    static constexpr size_t kVideoPacketSize = 1000;
+
+    void start(const EventPoller::Ptr &poller, Sender control, Sender video) {
+        auto alive = _alive;
+        poller->doDelayTask(kControlIntervalMs, [alive, control]() {
+            if (!*alive) {
+                return 0u;
+            }
+            auto buf = BufferRaw::create();
+            buf->setCapacity(64);
+            buf->setSize(64);
+            auto now = getCurrentMicrosecond();
+            memcpy(buf->data(), &now, sizeof(now));
+            buf->data()[sizeof(now)] = 'c';
+            control(buf);
+            return kControlIntervalMs;
+        });
+        poller->doDelayTask(kVideoIntervalMs, [alive, video]() {
+            if (!*alive) {
+                return 0u;
+            }
+            for (size_t i = 0; i < kVideoPackets; ++i) {
+                auto buf = std::make_shared<BufferString>(string(kVideoPacketSize, 'v'));
+                video(buf);
+            }
+            return kVideoIntervalMs;
+        });
+    }
+
+    void stop() { *_alive = false; }
+
+    // 单连接场景下通过标记区分控制消息
+    // Control messages are distinguished by the tag in the single connection case
+    void onRecv(const Buffer::Ptr &buf) {
+        if (buf->size() < 9 || buf->data()[8] != 'c') {
+            return;
+        }
+        uint64_t stamp;
+        memcpy(&stamp, buf->data(), sizeof(stamp));
+        _latency.emplace_back(getCurrentMicrosecond() - stamp);
+    }
+
+    string report() {
+        if (_latency.empty()) {
+            return "no control message received";
+        }
+        sort(_latency.begin(), _latency.end());
+        auto at = [&](double ratio) { return _latency[min(_latency.size() - 1, (size_t)(_latency.size() * ratio))] / 1000.0; };
+        return StrPrinter << "control msgs: " << _latency.size() << ", latency p50: " << at(0.5) << "ms, p99: " << at(0.99)
+                          << "ms, max: " << _latency.back() / 1000.0 << "ms";
+    }
+
+private:
+    shared_ptr<bool> _alive = make_shared<bool>(true);
+    vector<uint64_t> _latency;
+};
+
+constexpr uint32_t Traffic::kControlIntervalMs;
+constexpr uint32_t Traffic::kVideoIntervalMs;
+constexpr size_t Traffic::kVideoPackets;
+constexpr size_t Traffic::kVideoPacketSize;
+
+static constexpr uint32_t kDelayMs = 20;
+static constexpr double kLoss = 0.05;
+static constexpr uint32_t kDurationMs = 3000;
+
+// 一对链路的两端
+// The two ends of a pair of links
+struct LinkPair {
+    LinkPair(const EventPoller::Ptr &poller, uint32_t seed)
+        : to_server(make_shared<LossyLink>(poller, kDelayMs, kLoss, seed))
+        , to_client(make_shared<LossyLink>(poller, kDelayMs, kLoss, seed + 1)) {}
+
+    LossyLink::Ptr to_server;
+    LossyLink::Ptr to_client;
+};
+
+/**
+ * 在poller线程中搭建场景并运行kDurationMs，setup返回的对象在poller线程中销毁
+ * Build the scenario in the poller thread and run for kDurationMs, the object returned by setup is destroyed in the poller thread
+ */
+static string runScenario(const function<shared_ptr<void>(const EventPoller::Ptr &, Traffic &)> &setup) {
+    auto poller = EventPollerPool::Instance().getPoller();
+    Traffic traffic;
+    shared_ptr<void> holder;
+    poller->sync([&]() { holder = setup(poller, traffic); });
+    usleep(kDurationMs * 1000);
+    poller->sync([&]() { traffic.stop(); });
+    poller->sync([&]() { holder = nullptr; });
+    return traffic.report();
+}
+
+// 一个KcpTransport承载两种消息，视频丢包会阻塞控制消息
+// One KcpTransport carries both kinds of messages, lost video packets stall control messages
+static shared_ptr<void> setupSingle(const EventPoller::Ptr &poller, Traffic &traffic) {
+    struct Holder {
+        LinkPair links;
+        KcpTransport::Ptr client, server;
+        Holder(const EventPoller::Ptr &poller) : links(poller, 100) {}
+        ~Holder() {
+            client->setOnWrite(nullptr);
+            server->setOnWrite(nullptr);
+        }
+    };
+    auto holder = make_shared<Holder>(poller);
+    auto ptr = holder.get();
+    holder->client = make_shared<KcpTransport>(false, poller);
+    holder->server = make_shared<KcpTransport>(true, poller);
+    configure(holder->client);
+    configure(holder->server);
+    holder->client->setOnWrite([ptr](const Buffer::Ptr &buf) { ptr->links.to_server->send(buf); });
+    holder->server->setOnWrite([ptr](const Buffer::Ptr &buf) { ptr->links.to_client->send(buf); });
+    holder->links.to_server->setReceiver([ptr](const Buffer::Ptr &buf) { ptr->server->input(buf); });
+    holder->links.to_client->setReceiver([ptr](const Buffer::Ptr &buf) { ptr->client->input(buf); });
+    holder->server->setOnRead([&traffic](const Buffer::Ptr &buf) { traffic.onRecv(buf); });
+    traffic.start(poller, [ptr](const Buffer::Ptr &buf) { ptr->client->send(buf, true); },
+                  [ptr](const Buffer::Ptr &buf) { ptr->client->send(buf); });
+    return holder;
+}
+
+// 两个独立的KCP连接，各自使用一对链路
+// Two independent KCP connections, each uses a pair of links
+static shared_ptr<void> setupSeparate(const EventPoller::Ptr &poller, Traffic &traffic) {
+    struct Connection {
+        LinkPair links;
+        KcpTransport::Ptr client, server;
+        Connection(const EventPoller::Ptr &poller, uint32_t seed) : links(poller, seed) {
+            client = make_shared<KcpTransport>(false, poller);
+            server = make_shared<KcpTransport>(true, poller);
+            configure(client);
+            configure(server);
+            client->setOnWrite([this](const Buffer::Ptr &buf) { links.to_server->send(buf); });
+            server->setOnWrite([this](const Buffer::Ptr &buf) { links.to_client->send(buf); });
+            links.to_server->setReceiver([this](const Buffer::Ptr &buf) { server->input(buf); });
+            links.to_client->setReceiver([this](const Buffer::Ptr &buf) { client->input(buf); });
+        }
+        ~Connection() {
+            client->setOnWrite(nullptr);
+            server->setOnWrite(nullptr);
+        }
+    };
+    auto holder = make_shared<pair<Connection, Connection> >(piecewise_construct, forward_as_tuple(poller, 100), forward_as_tuple(poller, 200));
+    auto control = &holder->first;
+    auto video = &holder->second;
+    control->server->setOnRead([&traffic](const Buffer::Ptr &buf) { traffic.onRecv(buf); });
+    traffic.start(poller, [control](const Buffer::Ptr &buf) { control->client->send(buf, true); },
+                  [video](const Buffer::Ptr &buf) { video->client->send(buf); });
+    return holder;
+}
+
+// 一个KcpMux承载控制流与视频流，控制流可选不可靠模式
+// One KcpMux carries the control stream and the video stream, the control stream is optionally unreliable
+static shared_ptr<void> setupMux(const EventPoller::Ptr &poller, Traffic &traffic, KcpMux::StreamMode control_mode) {
+    struct Holder {
+        LinkPair links;
+        KcpMux::Ptr client, server;
+        Holder(const EventPoller::Ptr &poller) : links(poller, 100) {}
+        ~Holder() {
+            client->setOnWrite(nullptr);
+            server->setOnWrite(nullptr);
+        }
+    };
+    auto holder = make_shared<Holder>(poller);
+    auto ptr = holder.get();
+    holder->client = make_shared<KcpMux>(false, poller);
+    holder->server = make_shared<KcpMux>(true, poller);
+    holder->client->setOnWrite([ptr](const Buffer::Ptr &buf) { ptr->links.to_server->send(buf); });
+    holder->server->setOnWrite([ptr](const Buffer::Ptr &buf) { ptr->links.to_client->send(buf); });
+    holder->links.to_server->setReceiver([ptr](const Buffer::Ptr &buf) { ptr->server->input(buf); });
+    holder->links.to_client->setReceiver([ptr](const Buffer::Ptr &buf) { ptr->client->input(buf); });
+    holder->server->setOnStream([&traffic](const KcpMux::Stream::Ptr &stream) {
+        if (stream->getKcpTransport()) {
+            configure(stream->getKcpTransport());
+        }
+        if (stream->getId() == 1) {
+            stream->setOnRead([&traffic](const Buffer::Ptr &buf) { traffic.onRecv(buf); });
+        }
+    });
+    auto control = holder->client->openStream(1, control_mode, 0);
+    auto video = holder->client->openStream(2, KcpMux::StreamMode::RELIABLE, 4);
+    if (control->getKcpTransport()) {
+        configure(control->getKcpTransport());
+    }
+    configure(video->getKcpTransport());
+    traffic.start(poller, [control](const Buffer::Ptr &buf) { control->send(buf, true); },
+                  [video](const Buffer::Ptr &buf) { video->send(buf); });
+    return holder;
+}
+
+static void benchmark() {
+    cout << "one-way delay " << kDelayMs << "ms, loss " << kLoss * 100 << "%, control 64B/" << Traffic::kControlIntervalMs << "ms, video "
+         << Traffic::kVideoPackets << "x" << Traffic::kVideoPacketSize << "B/" << Traffic::kVideoIntervalMs << "ms" << endl;
+    cout << "  single KCP connection:    " << runScenario(setupSingle) << endl;
+    cout << "  separate KCP connections: " << runScenario(setupSeparate) << endl;
+    cout << "  KcpMux reliable streams:  " << runScenario([](const EventPoller::Ptr &poller, Traffic &traffic) {
+        return setupMux(poller, traffic, KcpMux::StreamMode::RELIABLE);
+    }) << endl;
+    cout << "  KcpMux unreliable control: " << runScenario([](const EventPoller::Ptr &poller, Traffic &traffic) {
+        return setupMux(poller, traffic, KcpMux::StreamMode::UNRELIABLE);
+    }) << endl;
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    bool ok = testStreams() && testMaxStreams() && testPriority();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (ok && (argc < 2 || string(argv[1]) != "--no-bench")) {
+        benchmark();
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <string>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/Byte.hpp"
+#include "Util/TimeTicker.h"
+#include "Thread/semaphore.h"
+#include "Network/UdpServer.h"
+#include "Network/Session.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+class EchoSession : public Session {
+public:
+    EchoSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { send(buf); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+using KcpEchoSession = SessionWithKCP<EchoSession>;
+
+/**
+ * KCP客户端，通过切换本地udp socket模拟NAT重绑定后源端口改变
+ * KCP client, switches the local udp socket to emulate the source port changing after NAT rebinding
+ */
+class RebindingClient {
+public:
+    RebindingClient(const EventPoller::Ptr &poller, uint16_t server_port) : _poller(poller) {
+        _server.sin_family = AF_INET;
+        _server.sin_port = htons(server_port);
+        _server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        poller->sync([&]() {
+            _kcp = make_shared<KcpTransport>(false, poller);
+            _kcp->setInterval(10);
+            _kcp->setDelayMode(KcpTransport::DelayMode::DELAY_MODE_NO_DELAY);
+            _kcp->setNoCwnd(true);
+            for (auto &sock : _socks) {
+                sock = Socket::createSocket(poller, false);
+                sock->bindUdpSock(0, "127.0.0.1");
+                sock->setOnRead([this](Buffer::Ptr &buf, struct sockaddr *, int) { _kcp->input(buf); });
+            }
+            _kcp->setOnWrite([this](const Buffer::Ptr &buf) {
+                _conv = Byte::Get4BytesLE((const uint8_t *)buf->data(), 0);
+                _socks[_current]->send(buf, (struct sockaddr *)&_server, sizeof(_server));
+            });
+            _kcp->setOnRead([this](const Buffer::Ptr &buf) {
+                _echoed += buf->size();
+                if (_echoed >= _expected) {
+                    _sem.post();
+                }
+            });
+        });
+    }
+
+    ~RebindingClient() {
+        _poller->sync([&]() {
+            _kcp->setOnWrite(nullptr);
+            for (auto &sock : _socks) {
+                sock->setOnRead(nullptr);
+            }
+        });
+        _poller->sync([&]() {
+            _kcp = nullptr;
+            for (auto &sock : _socks) {
+                sock = nullptr;
+            }
+        });
+    }
+
+    // 经第index个socket发送count个消息，等待全部回显
+    // Send count messages through the index-th socket and wait for all of them to be echoed
+    bool echo(size_t index, size_t count) {
+        _poller->sync([&]() {
+            _current = index;
+            _echoed = 0;
+            _expected = count * kMessageSize;
+            for (size_t i = 0; i < count; ++i) {
+                _kcp->send(std::make_shared<BufferString>(string(kMessageSize, 'a' + i % 26)), i + 1 == count);
+            }
+        });
+        return _sem.wait(5 * 1000);
+    }
+
+    uint16_t localPort(size_t index) const { return _socks[index]->get_local_port(); }
+
+    uint32_t conv() const { return _conv; }
+
+private:
+    static constexpr size_t kMessageSize = 1000;
+
+    size_t _current = 0;
+    size_t _echoed = 0;
+    size_t _expected = 0;
+    std::atomic<uint32_t> _conv { 0 };
+    semaphore _sem;
+    struct sockaddr_in _server {};
+    EventPoller::Ptr _poller;
+    KcpTransport::Ptr _kcp;
+    Socket::Ptr _socks[2];
+};
+
+/**
+ * 伪造同一conv但序号不在当前窗口内的数据包
+ * Forge a packet of the same conv but with sequence numbers out of the current window
+ */
+static void sendSpoofed(uint16_t server_port, uint32_t conv) {
+    char data[KcpHeader::HEADER_SIZE] = { 0 };
+    Byte::Set4BytesLE((uint8_t *)data, 0, conv);
+    Byte::Set1Byte((uint8_t *)data, 4, (uint8_t)KcpHeader::Cmd::CMD_PUSH);
+    Byte::Set2BytesLE((uint8_t *)data, 6, 128);
+    Byte::Set4BytesLE((uint8_t *)data, 12, 0x40000000);
+    Byte::Set4BytesLE((uint8_t *)data, 16, 0x40000000);
+
+    struct sockaddr_in server {};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(server_port);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    auto fd = SockUtil::bindUdpSock(0, "127.0.0.1", false);
+    ::sendto(fd, data, sizeof(data), 0, (struct sockaddr *)&server, sizeof(server));
+    close(fd);
+}
+
+static uint16_t peerPort(const weak_ptr<KcpEchoSession> &weak_session) {
+    uint16_t ret = 0;
+    if (auto session = weak_session.lock()) {
+        session->getPoller()->sync([&]() { ret = session->get_peer_port(); });
+    }
+    return ret;
+}
+
+// 迁移后旧地址的会话表项是异步移除的
+// The session map entry of the old address is removed asynchronously after migration
+static bool waitSessionCount(const UdpServer::Ptr &server, size_t count) {
+    Ticker ticker;
+    while (server->getSessionCount() != count && ticker.elapsedTime() < 1000) {
+        usleep(10 * 1000);
+    }
+    return server->getSessionCount() == count;
+}
+
+static bool testRouting() {
+    std::atomic<size_t> created { 0 };
+    weak_ptr<KcpEchoSession> weak_session;
+    UdpServer::Ptr server(new UdpServer());
+    server->enableKcpRouting();
+    server->start<KcpEchoSession>(0, "127.0.0.1", [&](std::shared_ptr<KcpEchoSession> &session) {
+        ++created;
+        weak_session = session;
+    });
+
+    {
+        RebindingClient client(EventPollerPool::Instance().getPoller(), server->getPort());
+        CHECK(client.echo(0, 100));
+        CHECK(created == 1);
+        CHECK(peerPort(weak_session) == client.localPort(0));
+
+        // 源端口改变后会话迁移，不重建
+        // The session migrates without being rebuilt after the source port changes
+        CHECK(client.echo(1, 100));
+        CHECK(created == 1);
+        CHECK(peerPort(weak_session) == client.localPort(1));
+        CHECK(waitSessionCount(server, 1));
+
+        // 序号不对的伪造包被丢弃，会话不受影响
+        // The forged packet with wrong sequence numbers is dropped, the session is not affected
+        sendSpoofed(server->getPort(), client.conv());
+        usleep(200 * 1000);
+        CHECK(created == 1);
+        CHECK(peerPort(weak_session) == client.localPort(1));
+        CHECK(waitSessionCount(server, 1));
+        CHECK(client.echo(1, 100));
+
+        // 迁移回原端口
+        // Migrate back to the original port
+        CHECK(client.echo(0, 100));
+        CHECK(created == 1);
+        CHECK(peerPort(weak_session) == client.localPort(0));
+        CHECK(waitSessionCount(server, 1));
+    }
+    server = nullptr;
+    return true;
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    bool ok = testRouting();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Thread/semaphore.h"
+#include "Network/Kcp.h"
+#include "Network/BufferSock.h"
+#include "test_check.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <sys/socket.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+static Buffer::Ptr makeBuffer(const string &str) {
+    auto ret = BufferRaw::create();
+    ret->assign(str.data(), str.size());
+    return ret;
+}
+
+#if defined(__linux__) || defined(__linux)
+// BufferRope经sendmmsg聚集发送，每个rope是一个完整的udp包
+// BufferRope is gathered by sendmmsg, each rope is a complete udp packet
+static bool testSendMMsg() {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == 0);
+
+    auto rope = BufferRope::create();
+    rope->append(makeBuffer("header|"));
+    rope->append(makeBuffer("xxpayloadxx"), 2, 7);
+    List<std::pair<Buffer::Ptr, bool> > list;
+    list.emplace_back(std::make_shared<BufferSock>(rope), true);
+    list.emplace_back(makeBuffer("plain"), false);
+    list.emplace_back(rope, false);
+
+    size_t sent = 0;
+    auto buffers = BufferList::create(std::move(list), [&](const Buffer::Ptr &buf, bool ok) { sent += ok; }, true);
+    CHECK(buffers->count() == 3);
+    CHECK(buffers->send(fds[0], 0) == 14 + 5 + 14);
+    CHECK(buffers->empty());
+    buffers = nullptr;
+    CHECK(sent == 3);
+    CHECK(rope->slices().size() == 2);
+
+    char buf[64];
+    for (auto expected : { "header|payload", "plain", "header|payload" }) {
+        auto n = recv(fds[0 + 1], buf, sizeof(buf), 0);
+        CHECK(string(buf, n) == expected);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return true;
+}
+#else
+static bool testSendMMsg() {
+    return true;
+}
+#endif
+
+/**
+ * 模拟带丢包的udp链路：发出的udp包先拷贝到线上(模拟内核拷贝)，下一轮事件循环再拷贝到复用的接收缓存中交给对端，
+ * 交付后立即覆写接收缓存，引用了已复用缓存的包会导致校验失败
+ * Emulated udp link with loss: sent udp packets are copied onto the wire first (emulating the kernel copy),
+ * then copied into a reused receive buffer and handed to the peer in the next event loop iteration,
+ * the receive buffer is overwritten right after delivery, so packets referencing the reused buffer fail the check
+ */
+class EmulatedLink {
+public:
+    EmulatedLink(EventPoller::Ptr poller, KcpTransport *peer, double loss)
+        : _poller(std::move(poller)), _peer(peer), _loss(loss) {
+        _recv_buffer = BufferRaw::create(4096);
+    }
+
+    void onWrite(const Buffer::Ptr &buf) {
+        if (_dist(_rand) < _loss) {
+            return;
+        }
+        auto wire = make_shared<string>();
+        auto rope = dynamic_pointer_cast<BufferRope>(buf);
+        if (rope) {
+            for (auto &slice : rope->slices()) {
+                wire->append(slice.data(), slice.size);
+            }
+        } else {
+            wire->assign(buf->data(), buf->size());
+        }
+        _poller->async([this, wire]() {
+            memcpy(_recv_buffer->data(), wire->data(), wire->size());
+            _recv_buffer->setSize(wire->size());
+            _peer->input(_recv_buffer);
+            memset(_recv_buffer->data(), 0xcc, wire->size());
+        }, false);
+    }
+
+private:
+    EventPoller::Ptr _poller;
+    KcpTransport *_peer;
+    double _loss;
+    BufferRaw::Ptr _recv_buffer;
+    mt19937 _rand { 12345 };
+    uniform_real_distribution<double> _dist { 0, 1 };
+};
+
+static string makeMessage(size_t index, size_t size) {
+    string ret(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        ret[i] = (char)(index * 7 + i);
+    }
+    return ret;
+}
+
+struct TransferResult {
+    bool ok = false;
+    uint64_t elapsed = 0;
+    uint64_t sender_copied = 0;
+    uint64_t receiver_copied = 0;
+};
+
+static void configure(const KcpTransport::Ptr &kcp, bool zero_copy) {
+    kcp->setInterval(10);
+    kcp->setDelayMode(KcpTransport::DelayMode::DELAY_MODE_NO_DELAY);
+    kcp->setFastResend(2);
+    kcp->setWndSize(1024, 1024);
+    kcp->setNoCwnd(true);
+    kcp->setZeroCopy(zero_copy);
+}
+
+/**
+ * 单向发送count个大小为size的消息，校验内容与顺序，并统计KCP层拷贝的字节数
+ * Send count messages of size bytes in one direction, check their content and order, and count the bytes copied by the KCP layer
+ */
+static TransferResult transfer(bool zero_copy, size_t size, size_t count, double loss) {
+    auto poller = EventPollerPool::Instance().getPoller();
+    KcpTransport::Ptr sender, receiver;
+    shared_ptr<EmulatedLink> to_receiver, to_sender;
+    semaphore sem;
+    size_t received = 0;
+    bool ok = true;
+
+    poller->sync([&]() {
+        sender = make_shared<KcpTransport>(false, poller);
+        receiver = make_shared<KcpTransport>(true, poller);
+        configure(sender, zero_copy);
+        configure(receiver, zero_copy);
+        to_receiver = make_shared<EmulatedLink>(poller, receiver.get(), loss);
+        to_sender = make_shared<EmulatedLink>(poller, sender.get(), loss);
+        sender->setOnWrite([&](const Buffer::Ptr &buf) { to_receiver->onWrite(buf); });
+        receiver->setOnWrite([&](const Buffer::Ptr &buf) { to_sender->onWrite(buf); });
+        receiver->setOnRead([&](const Buffer::Ptr &buf) {
+            if (buf->toString() != makeMessage(received, size)) {
+                ok = false;
+            }
+            if (++received == count) {
+                sem.post();
+            }
+        });
+    });
+
+    Ticker ticker;
+    poller->async([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            sender->send(makeBuffer(makeMessage(i, size)), i + 1 == count);
+        }
+    });
+    TransferResult ret;
+    ret.ok = sem.wait(30 * 1000) && ok;
+    ret.elapsed = ticker.elapsedTime();
+    poller->sync([&]() {
+        ret.sender_copied = sender->getCopiedBytes();
+        ret.receiver_copied = receiver->getCopiedBytes();
+        sender->setOnWrite(nullptr);
+        receiver->setOnWrite(nullptr);
+    });
+    // 等待已投递的udp包处理完再销毁
+    // Wait for the udp packets already posted to be handled before destroying
+    poller->sync([&]() {
+        sender = nullptr;
+        receiver = nullptr;
+    });
+    return ret;
+}
+
+static bool benchmark() {
+    for (size_t size : { 1000, 16000 }) {
+        for (double loss : { 0.0, 0.02 }) {
+            size_t count = 8 * 1024 * 1024 / size;
+            auto copy = transfer(false, size, count, loss);
+            auto zero = transfer(true, size, count, loss);
+            CHECK(copy.ok && zero.ok);
+            double total = (double)size * count;
+            cout << "message " << size << " bytes x " << count << ", loss " << loss * 100 << "%:" << endl;
+            cout << "  copy mode: sender copies " << copy.sender_copied / total << "x, receiver copies " << copy.receiver_copied / total
+                 << "x, " << copy.elapsed << "ms" << endl;
+            cout << "  zero-copy: sender copies " << zero.sender_copied / total << "x, receiver copies " << zero.receiver_copied / total
+                 << "x, " << zero.elapsed << "ms" << endl;
+        }
+    }
+    return true;
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    bool ok = testSendMMsg() && benchmark();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
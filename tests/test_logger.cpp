@@ -8,8 +8,12 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <chrono>
 #include <iostream>
 #include "Util/logger.h"
+#include "Util/FastLogger.h"
+#include "Util/TimeTicker.h"
+#include "Thread/threadgroup.h"
 #include "Network/Socket.h"
 using namespace std;
 using namespace toolkit;
@@ -32,6 +36,96 @@ private:
     stringstream _ss;
 };
 
+//丢弃所有日志的通道，用于只统计日志框架本身的开销
+//A channel that discards all logs, used to count only the cost of the logging framework itself
+class NullChannel : public LogChannel {
+public:
+    NullChannel() : LogChannel("NullChannel", LTrace) {}
+    void write(const Logger &logger, const LogContextPtr &ctx) override { ctx->str(); }
+};
+
+//日志吞吐量测试，日志不输出，只统计打印线程耗时和写日志线程处理耗时
+//Logging throughput benchmark, logs are not output, only count the cost of logging threads and writer thread
+static void benchmark(const char *name, bool fast_writer, bool fast_log) {
+    static constexpr int kThreadCount = 4;
+    static constexpr int kLogCount = 100 * 1000;
+
+    Logger logger("benchmark");
+    logger.add(std::make_shared<NullChannel>());
+    std::shared_ptr<FastLogWriter> writer;
+    if (fast_writer) {
+        writer = std::make_shared<FastLogWriter>(16 * 1024 * 1024);
+        logger.setWriter(writer);
+    } else {
+        logger.setWriter(std::make_shared<AsyncLogWriter>());
+    }
+    auto old_logger = &getLogger();
+    setLogger(&logger);
+
+    atomic<uint64_t> cost_ns(0);
+    thread_group group;
+    Ticker ticker;
+    for (int i = 0; i < kThreadCount; ++i) {
+        group.create_thread([&, i]() {
+            auto start = getCurrentMicrosecond();
+            for (int j = 0; j < kLogCount; ++j) {
+                if (fast_log) {
+                    FastLogI("thread %d log %d: %s %f", i, j, "benchmark", 3.1415926);
+                } else {
+                    InfoL << "thread " << i << " log " << j << ": " << "benchmark " << 3.1415926;
+                }
+            }
+            cost_ns += (getCurrentMicrosecond() - start) * 1000;
+        });
+    }
+    group.join_all();
+    auto produce_ms = ticker.elapsedTime();
+    auto dropped = writer ? writer->dropped() : 0;
+    // 等待写日志线程处理完毕
+    // Wait for the writer thread to finish
+    writer = nullptr;
+    logger.setWriter(nullptr);
+    setLogger(old_logger);
+    InfoL << name << ": " << kThreadCount * kLogCount << " logs, " << cost_ns / (kThreadCount * kLogCount) << " ns/log per thread, produce cost "
+          << produce_ms << "ms, total cost " << ticker.elapsedTime() << "ms, dropped " << dropped;
+}
+
+//被过滤日志的开销测试，日志等级被过滤时不应该构造日志对象，也不应该对参数求值
+//Cost benchmark of filtered logs, neither the log object should be built nor the arguments evaluated when the level is filtered
+static void benchmarkDisabled() {
+    static constexpr int kLogCount = 10 * 1000 * 1000;
+
+    Logger logger("benchmark");
+    logger.add(std::make_shared<ConsoleChannel>("benchmark", LInfo));
+    auto old_logger = &getLogger();
+    setLogger(&logger);
+
+    int evaluated = 0;
+    auto arg = [&]() { return ++evaluated; };
+    auto now_ns = []() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); };
+    auto start = now_ns();
+    for (int i = 0; i < kLogCount; ++i) {
+        TraceL << "disabled trace log " << i << arg();
+    }
+    auto stream_cost = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < kLogCount; ++i) {
+        LogT("disabled trace log ", i, arg());
+    }
+    auto array_cost = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < kLogCount; ++i) {
+        PrintT("disabled trace log %d %d", i, arg());
+    }
+    auto printf_cost = now_ns() - start;
+
+    setLogger(old_logger);
+    InfoL << "disabled TraceL: " << (double)stream_cost / kLogCount << " ns/log, disabled LogT: " << (double)array_cost / kLogCount
+          << " ns/log, disabled PrintT: " << (double)printf_cost / kLogCount << " ns/log, arguments evaluated " << evaluated << " times";
+}
+
 int main() {
     //初始化日志系统  [AUTO-TRANSLATED:25c549de]
     // Initialize the logging system
@@ -93,6 +187,22 @@ int main() {
     toolkit::SockException ex((ErrCode)1, "test");
     DebugL << "sock exception: " << ex;
 
+    //日志宏也可以作为LogContextCapture对象传递
+    // Log macros can also be passed as LogContextCapture objects
+    {
+        Ticker ticker(0, InfoL << "Ticker with InfoL, ", true);
+        TimeTicker2(0, WarnL << "TimeTicker2 with WarnL, ");
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+
+    FastLogI("测试二进制低延迟日志打印：");
+    FastLogD("this is a %s test:%d %s %.3f", "fast log", 124, string("std::string"), 1.5);
+
+    benchmarkDisabled();
+    benchmark("AsyncLogWriter + InfoL", false, false);
+    benchmark("FastLogWriter + InfoL", true, false);
+    benchmark("FastLogWriter + FastLogI", true, true);
+
     InfoL << "done!";
     return 0;
 }
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Util/MemoryBudget.h"
+#include "Thread/semaphore.h"
+#include "Network/Socket.h"
+#include "Network/TcpServer.h"
+#include "Network/Session.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+static bool testBudget() {
+    auto root = MemoryBudget::create(0, 0, nullptr);
+    auto group = MemoryBudget::create(1000, 2000, root);
+    auto leaf = MemoryBudget::create(0, 0, group);
+
+    vector<MemoryBudget::Level> levels;
+    auto listener = group->addListener([&](MemoryBudget::Level level) { levels.emplace_back(level); });
+
+    leaf->charge(999);
+    CHECK(leaf->used() == 999 && group->used() == 999 && root->used() == 999);
+    CHECK(leaf->level() == MemoryBudget::Level::Normal);
+    leaf->charge(1);
+    CHECK(leaf->level() == MemoryBudget::Level::Soft);
+    leaf->charge(1000);
+    CHECK(leaf->level() == MemoryBudget::Level::Hard);
+
+    // 回落到上限的3/4以下才恢复
+    // Recover only after falling below 3/4 of the limit
+    leaf->release(500);
+    CHECK(group->level() == MemoryBudget::Level::Hard);
+    leaf->release(1);
+    CHECK(group->level() == MemoryBudget::Level::Soft);
+    leaf->release(749);
+    CHECK(group->level() == MemoryBudget::Level::Soft);
+    {
+        MemoryBudget::Charge charge(leaf, 1);
+        leaf->release(1);
+        CHECK(group->used() == 749 && group->level() == MemoryBudget::Level::Normal);
+        leaf->charge(1);
+    }
+    CHECK(root->used() == 749 && group->peak() == 2000);
+    CHECK((levels == vector<MemoryBudget::Level> { MemoryBudget::Level::Soft, MemoryBudget::Level::Hard, MemoryBudget::Level::Soft,
+                                                    MemoryBudget::Level::Normal }));
+
+    // 释放后不再回调
+    // No more callbacks after being released
+    listener = nullptr;
+    leaf->charge(2000);
+    CHECK(levels.size() == 4);
+    leaf->release(2749);
+    CHECK(root->used() == 0);
+    return true;
+}
+
+// 预算超过硬上限时可丢弃的数据被丢弃，其余数据发送后全部归还
+// Droppable data is dropped when the budget is over the hard limit, everything else is released after being sent
+static bool testSocketCharge() {
+    auto group = MemoryBudget::create(0, 10000);
+    auto recv_sock = Socket::createSocket();
+    recv_sock->bindUdpSock(0, "127.0.0.1");
+    std::atomic<size_t> received { 0 };
+    recv_sock->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *, int) { received += buf->size(); });
+
+    auto sock = Socket::createSocket();
+    sock->bindUdpSock(0, "127.0.0.1");
+    auto addr = SockUtil::make_sockaddr("127.0.0.1", recv_sock->get_local_port());
+    sock->bindPeerAddr((struct sockaddr *)&addr, 0, true);
+    sock->setMemoryBudget(group);
+
+    size_t used = 0;
+    sock->getPoller()->sync([&]() {
+        // 偶数包可丢弃，第5个包入队后达到硬上限，第7个包入队时丢弃它及已入队的可丢弃数据
+        // Even packets are droppable, the hard limit is reached after the 5th packet, the 7th packet is dropped together
+        // with the queued droppable data
+        for (int i = 0; i < 8; ++i) {
+            auto buf = BufferRaw::create();
+            buf->assign(string(2000, 'x').data(), 2000);
+            buf->setSendPriority(0, i % 2 == 0);
+            sock->send(buf, nullptr, 0, false);
+        }
+        used = sock->getMemoryBudget()->used();
+        sock->flushAll();
+    });
+    CHECK(used == 8000);
+    CHECK(sock->getSendDropCount() == 4);
+    for (int i = 0; i < 100 && received < 8000; ++i) {
+        usleep(10 * 1000);
+    }
+    CHECK(received == 8000);
+    CHECK(group->used() == 0 && group->level() == MemoryBudget::Level::Normal);
+
+    // 未设置预算且全局预算不限制时不记账，全局预算设置上限后开始记账
+    // Nothing is charged without a budget while the global budget is unlimited, charging starts once it has limits
+    auto &global = MemoryBudget::global();
+    auto plain = Socket::createSocket();
+    plain->bindUdpSock(0, "127.0.0.1");
+    plain->bindPeerAddr((struct sockaddr *)&addr, 0, true);
+    size_t global_used = 0;
+    plain->getPoller()->sync([&]() {
+        auto before = global->used();
+        plain->send(string(1000, 'x'), nullptr, 0, false);
+        global_used = global->used() - before;
+        global->setLimits(0, 1024 * 1024 * 1024);
+        plain->send(string(1000, 'x'), nullptr, 0, false);
+        global_used += global->used() - before;
+        global->setLimits(0, 0);
+        used = plain->getMemoryBudget()->used();
+        plain->flushAll();
+    });
+    CHECK(global_used == 2000 && used == 2000);
+    return true;
+}
+
+// 慢速读取的消费者，每50毫秒只读取10毫秒
+// Slow consumer, reading only 10 milliseconds every 50 milliseconds
+class SlowSession : public Session {
+public:
+    static std::atomic<uint64_t> s_bytes;
+
+    SlowSession(const Socket::Ptr &sock) : Session(sock) {
+        std::weak_ptr<Socket> weak_sock = sock;
+        auto reading = std::make_shared<bool>(true);
+        sock->getPoller()->doDelayTask(10, [weak_sock, reading]() -> uint64_t {
+            auto strong_sock = weak_sock.lock();
+            if (!strong_sock) {
+                return 0;
+            }
+            *reading = !*reading;
+            strong_sock->enableRecv(*reading);
+            return *reading ? 10 : 40;
+        });
+    }
+
+    void onRecv(const Buffer::Ptr &buf) override { s_bytes += buf->size(); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+std::atomic<uint64_t> SlowSession::s_bytes { 0 };
+
+// 把收到的数据转发给所有慢速消费者，读取受消费者的内存预算反压
+// Relays the received data to all the slow consumers, reading is throttled by the memory budget of the consumers
+class RelaySession : public Session {
+public:
+    static MemoryBudget::Ptr s_budget;
+    static uint16_t s_consumer_port;
+    static size_t s_consumers;
+    static std::atomic<uint64_t> s_bytes;
+
+    RelaySession(const Socket::Ptr &sock) : Session(sock) {
+        sock->setRecvBackpressure(s_budget);
+        for (size_t i = 0; i < s_consumers; ++i) {
+            auto consumer = Socket::createSocket(sock->getPoller(), false);
+            consumer->setMemoryBudget(s_budget);
+            consumer->connect("127.0.0.1", s_consumer_port, [](const SockException &) {});
+            _consumers.emplace_back(std::move(consumer));
+        }
+    }
+
+    void onRecv(const Buffer::Ptr &buf) override {
+        s_bytes += buf->size();
+        auto copy = BufferRaw::create();
+        copy->assign(buf->data(), buf->size());
+        for (auto &consumer : _consumers) {
+            consumer->send(copy);
+        }
+    }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+
+private:
+    vector<Socket::Ptr> _consumers;
+};
+
+MemoryBudget::Ptr RelaySession::s_budget;
+uint16_t RelaySession::s_consumer_port = 0;
+size_t RelaySession::s_consumers = 4;
+std::atomic<uint64_t> RelaySession::s_bytes { 0 };
+
+static bool testSlowReaders() {
+    static constexpr size_t kSoftLimit = 2 * 1024 * 1024;
+    static constexpr size_t kHardLimit = 8 * 1024 * 1024;
+    static constexpr size_t kTotal = 32 * 1024 * 1024;
+    auto budget = MemoryBudget::create(kSoftLimit, kHardLimit, MemoryBudget::global(), "slow_readers");
+    std::atomic<size_t> paused { 0 };
+    auto listener = budget->addListener([&](MemoryBudget::Level level) { paused += level != MemoryBudget::Level::Normal; });
+
+    TcpServer::Ptr consumer_server(new TcpServer());
+    consumer_server->start<SlowSession>(0, "127.0.0.1");
+    RelaySession::s_budget = budget;
+    RelaySession::s_consumer_port = consumer_server->getPort();
+    TcpServer::Ptr relay_server(new TcpServer());
+    relay_server->start<RelaySession>(0, "127.0.0.1");
+
+    semaphore connected;
+    auto producer = Socket::createSocket();
+    producer->connect("127.0.0.1", relay_server->getPort(), [&](const SockException &ex) { connected.post(); });
+    CHECK(connected.wait(3000) && producer->alive());
+
+    // 生产者尽快写入，自身发送缓存保持在1MB以内
+    // The producer writes as fast as it can, keeping its own send cache within 1MB
+    auto start = getCurrentMillisecond();
+    size_t sent = 0;
+    semaphore done;
+    producer->getPoller()->doDelayTask(1, [&]() -> uint64_t {
+        while (sent < kTotal && producer->getMemoryBudget()->used() < 1024 * 1024) {
+            producer->send(string(64 * 1024, 'x'));
+            sent += 64 * 1024;
+        }
+        if (sent < kTotal) {
+            return 1;
+        }
+        done.post();
+        return 0;
+    });
+    CHECK(done.wait(60 * 1000));
+    auto expect = kTotal * RelaySession::s_consumers;
+    for (int i = 0; i < 6000 && SlowSession::s_bytes < expect; ++i) {
+        usleep(10 * 1000);
+    }
+    auto elapsed = getCurrentMillisecond() - start;
+    cout << "relayed " << kTotal * RelaySession::s_consumers / 1024 / 1024 << "MB to " << RelaySession::s_consumers << " slow readers in "
+         << elapsed << "ms, budget peak " << budget->peak() / 1024 << "KB, paused " << paused << " times" << endl;
+    CHECK(producer->alive());
+    CHECK(RelaySession::s_bytes == kTotal);
+    CHECK(SlowSession::s_bytes == expect);
+    CHECK(paused > 0);
+    CHECK(budget->peak() < kHardLimit);
+    CHECK(budget->used() == 0);
+    RelaySession::s_budget = nullptr;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    bool ok = testBudget() && testSocketCharge() && testSlowReaders();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
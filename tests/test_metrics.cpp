@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/Metrics.h"
+#include "Network/sockutil.h"
+#include "Network/TcpServer.h"
+#include "Network/Session.h"
+#include "Network/MetricsSession.h"
+#include "Poller/PollerMetrics.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+class EchoSession : public Session {
+public:
+    EchoSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { send(buf); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+static bool testCounter() {
+    auto counter = MetricsRegistry::Instance().counter("test_counter_total", "test counter");
+    CHECK(counter == MetricsRegistry::Instance().counter("test_counter_total", "test counter"));
+    vector<thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([counter]() {
+            for (int j = 0; j < 100000; ++j) {
+                counter->add();
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    CHECK(counter->value() == 800000);
+    try {
+        MetricsRegistry::Instance().gauge("test_counter_total", "test counter");
+        CHECK(false);
+    } catch (std::invalid_argument &) {
+    }
+    return true;
+}
+
+static bool testHistogram() {
+    for (uint64_t value : { 0ULL, 1ULL, 31ULL, 32ULL, 33ULL, 1000ULL, 123456789ULL, ~0ULL }) {
+        auto index = MetricsHistogram::bucketIndex(value);
+        CHECK(index < MetricsHistogram::kBucketCount);
+        CHECK(MetricsHistogram::bucketUpperBound(index) >= value);
+        CHECK(index == 0 || MetricsHistogram::bucketUpperBound(index - 1) < value);
+    }
+    MetricsHistogram histogram;
+    for (uint64_t i = 1; i <= 10000; ++i) {
+        histogram.record(i);
+    }
+    auto snap = histogram.snapshot();
+    CHECK(snap.count == 10000);
+    CHECK(snap.max == 10000);
+    // 相对误差不超过1/16
+    // The relative error does not exceed 1/16
+    auto p50 = snap.percentile(0.5), p99 = snap.percentile(0.99);
+    CHECK(p50 >= 5000 && p50 <= 5000 + 5000 / 16);
+    CHECK(p99 >= 9900 && p99 <= 10000);
+    CHECK(snap.percentile(1) == 10000);
+    return true;
+}
+
+static bool testExport() {
+    auto &registry = MetricsRegistry::Instance();
+    registry.gauge("test_gauge", "test \"gauge\"", { { "key", "va\"lue" } })->set(-3);
+    registry.histogram("test_latency_us", "test histogram")->record(100);
+    auto text = registry.toPrometheus();
+    CHECK(text.find("# TYPE test_gauge gauge\n") != string::npos);
+    CHECK(text.find("test_gauge{key=\"va\\\"lue\"} -3\n") != string::npos);
+    CHECK(text.find("test_latency_us{quantile=\"0.5\"} 100\n") != string::npos);
+    CHECK(text.find("test_latency_us_count 1\n") != string::npos);
+    auto json = registry.toJson();
+    CHECK(json.find("\"test_gauge\":{\"type\":\"gauge\"") != string::npos);
+    CHECK(json.find("{\"labels\":{\"key\":\"va\\\"lue\"},\"value\":-3}") != string::npos);
+    registry.remove("test_gauge", { { "key", "va\"lue" } });
+    CHECK(registry.toPrometheus().find("test_gauge") == string::npos);
+    return true;
+}
+
+/**
+ * 通过原始socket请求http接口并返回整个应答
+ * Request the http interface via a raw socket and return the whole response
+ */
+static string httpGet(uint16_t port, const string &url) {
+    auto fd = SockUtil::connect("127.0.0.1", port, false);
+    if (fd == -1) {
+        return "";
+    }
+    auto request = "GET " + url + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    ::send(fd, request.data(), request.size(), 0);
+    string ret;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) {
+        ret.append(buf, n);
+    }
+    close(fd);
+    return ret;
+}
+
+/**
+ * 单连接小包ping-pong，返回每秒往返次数，这是每次系统调用埋点开销占比最大的场景
+ * Single connection ping-pong with small packets, return round trips per second, this is the worst case for per-syscall probe overhead
+ */
+static double pingPong(uint16_t port, size_t rounds) {
+    auto fd = SockUtil::connect("127.0.0.1", port, false);
+    SockUtil::setNoDelay(fd, true);
+    char buf[128] = { 0 };
+    auto begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        ::send(fd, buf, sizeof(buf), 0);
+        size_t received = 0;
+        while (received < sizeof(buf)) {
+            auto n = ::recv(fd, buf, sizeof(buf) - received, 0);
+            if (n <= 0) {
+                close(fd);
+                return 0;
+            }
+            received += n;
+        }
+    }
+    auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count();
+    close(fd);
+    return rounds * 1000000.0 / (elapsed ? elapsed : 1);
+}
+
+/**
+ * 单次埋点的耗时，由于单核环境下回环测试噪声较大，用于估算开销占比
+ * Cost of a single probe, used to estimate the overhead ratio since the loopback test is noisy on a single core
+ */
+static void benchmarkProbe() {
+    auto counter = MetricsRegistry::Instance().counter("test_bench_total", "test counter");
+    MetricsHistogram histogram;
+    static constexpr size_t kCount = 10000000;
+    auto begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < kCount; ++i) {
+        counter->add(i);
+    }
+    auto counter_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count() / (double)kCount;
+    begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < kCount; ++i) {
+        histogram.record(i & 0xFFFF);
+    }
+    auto histogram_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count() / (double)kCount;
+    begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < kCount; ++i) {
+        ScopedCost cost(histogram);
+    }
+    auto scoped_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count() / (double)kCount;
+    cout << "counter add: " << counter_ns << "ns, histogram record: " << histogram_ns << "ns, scoped cost: " << scoped_ns << "ns" << endl;
+}
+
+static bool testServer() {
+    TcpServer::Ptr echo_server(new TcpServer());
+    echo_server->start<EchoSession>(0, "127.0.0.1");
+    TcpServer::Ptr metrics_server(new TcpServer());
+    metrics_server->start<MetricsSession>(0, "127.0.0.1");
+
+    pingPong(echo_server->getPort(), 1000);
+    auto text = httpGet(metrics_server->getPort(), "/metrics");
+    CHECK(start_with(text, "HTTP/1.1 200 OK\r\n"));
+    CHECK(text.find("zltoolkit_socket_syscalls_total{poller=") != string::npos);
+    CHECK(text.find("zltoolkit_poller_callback_us{poller=") != string::npos);
+    auto json = httpGet(metrics_server->getPort(), "/metrics?format=json");
+    CHECK(json.find("application/json") != string::npos);
+    CHECK(json.find("\"zltoolkit_socket_bytes_total\"") != string::npos);
+    CHECK(start_with(httpGet(metrics_server->getPort(), "/other"), "HTTP/1.1 404"));
+
+    // 交替测试多轮，取各自最好成绩以减少噪声
+    // Alternate several rounds and take the best result of each to reduce noise
+    double best_on = 0, best_off = 0;
+    for (int i = 0; i < 5; ++i) {
+        MetricsRegistry::setEnabled(true);
+        best_on = std::max(best_on, pingPong(echo_server->getPort(), 20000));
+        MetricsRegistry::setEnabled(false);
+        best_off = std::max(best_off, pingPong(echo_server->getPort(), 20000));
+    }
+    MetricsRegistry::setEnabled(true);
+    cout << "echo ping-pong, metrics on: " << (uint64_t)best_on << " rtt/s, off: " << (uint64_t)best_off
+         << " rtt/s, overhead: " << (best_off - best_on) * 100 / best_off << "%" << endl;
+    return true;
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    bool ok = testCounter() && testHistogram() && testExport();
+    benchmarkProbe();
+    ok = ok && testServer();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Util/File.h"
+#include "Thread/threadgroup.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+// 写日志线程数
+// Logging threads
+static constexpr size_t kThreadCount = 4;
+// 每个线程写入的日志条数
+// Logs written by each thread
+static constexpr size_t kLogCount = 100 * 1000;
+
+#if !defined(_WIN32)
+// 目录下所有日志文件(按文件名排序)
+// All log files under the directory (sorted by file name)
+static vector<string> listFiles(const string &dir) {
+    vector<string> ret;
+    File::scanDir(dir, [&](const string &path, bool isDir) -> bool {
+        if (!isDir) {
+            ret.emplace_back(path);
+        }
+        return true;
+    }, true);
+    sort(ret.begin(), ret.end());
+    return ret;
+}
+
+static uint64_t totalSize(const string &dir) {
+    uint64_t ret = 0;
+    for (auto &path : listFiles(dir)) {
+        ret += File::fileSize(path);
+    }
+    return ret;
+}
+
+// 多线程追加到1MB的小分片，读回各分片校验：记录完整、每个线程内有序、发生了分片切换，且读回条数加丢弃条数等于写入条数
+// Append from multiple threads into small 1MB segments and read every segment back: records are intact, ordered within each
+// thread, segments were switched, and the records read back plus the dropped ones equal the records written
+static bool testReadBack(const string &dir) {
+    static constexpr size_t kRecords = 20 * 1000;
+    static const string kPayload(40, 'x');
+    File::delete_file(dir);
+    uint64_t dropped = 0;
+    {
+        MmapFileChannel channel("MmapFileChannel", dir, LTrace, 1, 10);
+        channel.setFileMaxCount(1000);
+        thread_group group;
+        for (size_t i = 0; i < kThreadCount; ++i) {
+            group.create_thread([&, i]() {
+                for (size_t j = 0; j < kRecords; ++j) {
+                    auto record = "T" + to_string(i) + " " + to_string(j) + " " + kPayload + "\n";
+                    channel.append(record.data(), record.size());
+                }
+            });
+        }
+        group.join_all();
+        dropped = channel.dropped();
+    }
+
+    auto files = listFiles(dir);
+    CHECK(files.size() > 1);
+    vector<int64_t> last(kThreadCount, -1);
+    size_t found = 0;
+    for (auto &path : files) {
+        auto content = File::loadFile(path);
+        CHECK(!content.empty() && content.back() == '\n');
+        for (size_t pos = 0; pos < content.size();) {
+            auto end = content.find('\n', pos);
+            auto line = content.substr(pos, end - pos + 1);
+            pos = end + 1;
+            size_t thread_index, seq;
+            char prefix;
+            CHECK(sscanf(line.data(), "%c%zu %zu ", &prefix, &thread_index, &seq) == 3);
+            CHECK(prefix == 'T' && thread_index < kThreadCount && seq < kRecords);
+            // 与写入的记录逐字节一致，否则为撕裂或交错的记录
+            // Byte for byte identical to the record written, otherwise it is torn or interleaved
+            CHECK(line == "T" + to_string(thread_index) + " " + to_string(seq) + " " + kPayload + "\n");
+            CHECK((int64_t)seq > last[thread_index]);
+            last[thread_index] = seq;
+            ++found;
+        }
+    }
+    CHECK(found + dropped == kThreadCount * kRecords);
+    CHECK(found > 0);
+    File::delete_file(dir);
+    return true;
+}
+
+// 返回耗时，单位微秒
+// Returns the elapsed time, unit: microseconds
+static int64_t benchmark(const char *name, const function<void(const LogContextPtr &ctx)> &write) {
+    vector<vector<uint32_t>> costs(kThreadCount);
+    thread_group group;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < kThreadCount; ++i) {
+        group.create_thread([&, i]() {
+            auto &cost = costs[i];
+            cost.reserve(kLogCount);
+            for (size_t j = 0; j < kLogCount; ++j) {
+                auto ctx = std::make_shared<LogContext>(LInfo, __FILE__, __FUNCTION__, __LINE__, "bench", "");
+                *ctx << "thread " << i << " log " << j << ", payload: " << string(64, 'x');
+                auto begin = chrono::steady_clock::now();
+                write(ctx);
+                cost.emplace_back((uint32_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count());
+            }
+        });
+    }
+    group.join_all();
+    auto elapsed_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+
+    vector<uint32_t> all;
+    for (auto &cost : costs) {
+        all.insert(all.end(), cost.begin(), cost.end());
+    }
+    sort(all.begin(), all.end());
+    cout << name << ": " << all.size() << " logs"
+         << ", p50: " << all[all.size() / 2] << "ns"
+         << ", p99: " << all[all.size() * 99 / 100] << "ns"
+         << ", max: " << all.back() << "ns" << endl;
+    return elapsed_us;
+}
+
+// 吞吐按通道关闭后实际落盘的字节数计算，不含丢弃的日志
+// Throughput is computed from the bytes actually on disk after the channel is closed, dropped logs are not included
+static void printThroughput(const char *name, const string &dir, int64_t elapsed_us) {
+    auto bytes = totalSize(dir);
+    cout << name << ": " << bytes << " bytes written, " << (double)bytes / (elapsed_us ? elapsed_us : 1) << " MB/s" << endl;
+}
+#endif // !defined(_WIN32)
+
+int main(int argc, char *argv[]) {
+#if !defined(_WIN32)
+    Logger logger("bench");
+    auto dir = exeDir() + "mmap_log_bench/";
+    File::delete_file(dir);
+
+    bool ok = testReadBack(dir + "check/");
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (!ok || (argc > 1 && string(argv[1]) == "--no-bench")) {
+        File::delete_file(dir);
+        return ok ? 0 : 1;
+    }
+
+    int64_t elapsed_us;
+    {
+        // FileChannel不是线程安全的，与AsyncLogWriter一样串行写入
+        // FileChannel is not thread-safe, write serially just like AsyncLogWriter
+        FileChannel channel("FileChannel", dir + "file/");
+        mutex mtx;
+        elapsed_us = benchmark("FileChannel", [&](const LogContextPtr &ctx) {
+            lock_guard<mutex> lck(mtx);
+            channel.write(logger, ctx);
+        });
+    }
+    printThroughput("FileChannel", dir + "file/", elapsed_us);
+    uint64_t dropped;
+    {
+        MmapFileChannel channel("MmapFileChannel", dir + "mmap/", LTrace, 8, 100);
+        elapsed_us = benchmark("MmapFileChannel", [&](const LogContextPtr &ctx) { channel.write(logger, ctx); });
+        dropped = channel.dropped();
+    }
+    printThroughput("MmapFileChannel", dir + "mmap/", elapsed_us);
+    cout << "MmapFileChannel dropped: " << dropped << endl;
+    File::delete_file(dir);
+#endif
+    return 0;
+}
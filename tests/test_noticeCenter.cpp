@@ -9,9 +9,12 @@
  */
 
 #include <csignal>
+#include <atomic>
 #include "Util/util.h"
 #include "Util/logger.h"
+#include "Util/TimeTicker.h"
 #include "Util/NoticeCenter.h"
+#include "Thread/threadgroup.h"
 using namespace std;
 using namespace toolkit;
 
@@ -26,6 +29,42 @@ using namespace toolkit;
 // Program Exit Flag
 bool g_bExitFlag = false;
 
+//广播性能测试：多线程并发广播，对比按事件名与按事件句柄广播
+// Emit benchmark: emit concurrently from multiple threads, comparing emitting by event name and by event handle
+static void benchmark(bool use_handle) {
+    static constexpr size_t kThreadCount = 4;
+    static constexpr size_t kEmitCount = 1000 * 1000;
+    static constexpr size_t kListenerCount = 8;
+    static const string kEvent = "NOTICE_BENCHMARK";
+
+    NoticeCenter center;
+    atomic<size_t> counter(0);
+    for (size_t i = 0; i < kListenerCount; ++i) {
+        center.addListener((void *)i, kEvent, [&](int &value) { counter.fetch_add(value, memory_order_relaxed); });
+    }
+    auto handle = center.getEventHandle(kEvent);
+
+    thread_group group;
+    Ticker ticker;
+    for (size_t i = 0; i < kThreadCount; ++i) {
+        group.create_thread([&]() {
+            int value = 1;
+            for (size_t j = 0; j < kEmitCount; ++j) {
+                if (use_handle) {
+                    center.emitEvent(handle, value);
+                } else {
+                    center.emitEvent(kEvent, value);
+                }
+            }
+        });
+    }
+    group.join_all();
+    auto ms = ticker.elapsedTime();
+    InfoL << "emit by " << (use_handle ? "handle" : "name") << ", threads: " << kThreadCount << ", listeners: " << kListenerCount
+          << ", emits: " << kThreadCount * kEmitCount << ", cost: " << ms << "ms, ns/emit: " << ms * 1000000.0 / (kThreadCount * kEmitCount)
+          << ", callbacks: " << counter.load();
+}
+
 
 int main() {
     //设置程序退出信号处理函数  [AUTO-TRANSLATED:419fb1c3]
@@ -35,6 +74,9 @@ int main() {
     // Set Log
     Logger::Instance().add(std::make_shared<ConsoleChannel>());
 
+    benchmark(false);
+    benchmark(true);
+
     //对事件NOTICE_NAME1新增一个监听  [AUTO-TRANSLATED:c8e83e55]
     // Add a Listener to the Event NOTICE_NAME1
     //addListener方法第一个参数是标签，用来删除监听时使用  [AUTO-TRANSLATED:918a506c]
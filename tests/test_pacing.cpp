@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Util/TokenBucket.h"
+#include "Thread/semaphore.h"
+#include "Network/Socket.h"
+#include "Network/TcpServer.h"
+#include "Network/Session.h"
+#include "test_check.h"
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+static bool near(double value, double expect, double tolerance) {
+    auto ok = fabs(value - expect) <= expect * tolerance;
+    if (!ok) {
+        cout << "value " << value << " is not near " << expect << endl;
+    }
+    return ok;
+}
+
+static bool testTokenBucket() {
+    TokenBucket bucket(1000, 100);
+    uint64_t now = 1000000;
+    CHECK(bucket.consume(100, now) == 0);
+    auto wait = bucket.consume(50, now);
+    CHECK(wait >= 50000 && wait <= 50001);
+    CHECK(bucket.consume(50, now + wait) == 0);
+
+    // 大于桶容量的包在桶满时放行并透支
+    // A packet larger than the bucket passes when the bucket is full and overdraws it
+    now += 1000000;
+    CHECK(bucket.consume(500, now) == 0);
+    wait = bucket.consume(100, now);
+    CHECK(wait >= 500000 && wait <= 500001);
+
+    // 不限速
+    // Unlimited
+    bucket.setRate(0);
+    CHECK(bucket.consume(1000000, now) == 0);
+    return true;
+}
+
+// 记录收到的字节数与首个数据的到达时间
+// Record the received bytes and the arrival time of the first data
+struct Receiver {
+    std::atomic<uint64_t> bytes { 0 };
+    std::atomic<uint64_t> first_us { 0 };
+
+    void onData(size_t size) {
+        if (!first_us) {
+            first_us = getCurrentMicrosecond();
+        }
+        bytes += size;
+    }
+
+    // 首个数据到达后sec秒内收到的字节数
+    // Bytes received within sec seconds after the first data arrives
+    uint64_t bytesAfter(double sec) {
+        while (!first_us) {
+            usleep(1000);
+        }
+        auto deadline = first_us + (uint64_t)(sec * 1000000);
+        while (getCurrentMicrosecond() < deadline) {
+            usleep(1000);
+        }
+        return bytes;
+    }
+};
+
+static Socket::Ptr makeUdpReceiver(Receiver &receiver) {
+    auto sock = Socket::createSocket();
+    sock->bindUdpSock(0, "127.0.0.1");
+    SockUtil::setRecvBuf(sock->rawFD(), 4 * 1024 * 1024);
+    sock->setOnRead([&receiver](const Buffer::Ptr &buf, struct sockaddr *, int) { receiver.onData(buf->size()); });
+    return sock;
+}
+
+static Socket::Ptr makeUdpSender(const Socket::Ptr &receiver, const EventPoller::Ptr &poller = nullptr) {
+    auto sock = Socket::createSocket(poller);
+    sock->bindUdpSock(0, "127.0.0.1");
+    auto addr = SockUtil::make_sockaddr("127.0.0.1", receiver->get_local_port());
+    sock->bindPeerAddr((struct sockaddr *)&addr, 0, true);
+    return sock;
+}
+
+static void sendPackets(const Socket::Ptr &sock, size_t count, size_t size) {
+    sock->getPoller()->sync([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            sock->send(string(size, 'x'));
+        }
+    });
+}
+
+static bool testUdpRate() {
+    static constexpr uint64_t kRate = 200 * 1000;
+    Receiver receiver;
+    auto recv_sock = makeUdpReceiver(receiver);
+    auto sock = makeUdpSender(recv_sock);
+    sock->setSendRate(kRate);
+
+    semaphore flushed;
+    sock->setOnFlush([&]() {
+        flushed.post();
+        return true;
+    });
+    // 3秒的数据一次性写入，按速率释放
+    // 3 seconds of data are written at once and released at the rate
+    sendPackets(sock, 600, 1000);
+    CHECK(sock->getSendBufferCount() > 500);
+    auto burst = kRate / 100;
+    CHECK(near(receiver.bytesAfter(1), burst + kRate, 0.05));
+    CHECK(near(receiver.bytesAfter(2), burst + kRate * 2, 0.05));
+    CHECK(flushed.wait(2000));
+    CHECK(receiver.bytes == 600 * 1000);
+    return true;
+}
+
+static bool testGroupRate() {
+    static constexpr uint64_t kRate = 200 * 1000;
+    Receiver receiver;
+    auto recv_sock = makeUdpReceiver(receiver);
+    auto group = std::make_shared<SharedTokenBucket>(kRate);
+    // 各自限速1MB/s，组限速200KB/s，分属不同poller
+    // 1MB/s each and 200KB/s for the group, on different pollers
+    vector<Socket::Ptr> socks;
+    for (size_t i = 0; i < 4; ++i) {
+        socks.emplace_back(makeUdpSender(recv_sock, EventPollerPool::Instance().getPoller(false)));
+        socks.back()->setSendRate(1000 * 1000);
+        socks.back()->setSendRateGroup(group);
+    }
+    for (auto &sock : socks) {
+        sendPackets(sock, 200, 1000);
+    }
+    auto burst = kRate / 100;
+    CHECK(near(receiver.bytesAfter(2), burst + kRate * 2, 0.05));
+    return true;
+}
+
+class CountSession : public Session {
+public:
+    static Receiver *s_receiver;
+
+    CountSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { s_receiver->onData(buf->size()); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+Receiver *CountSession::s_receiver = nullptr;
+
+static bool testTcpRate() {
+    static constexpr uint64_t kRate = 500 * 1000;
+    Receiver receiver;
+    CountSession::s_receiver = &receiver;
+    TcpServer::Ptr server(new TcpServer());
+    server->start<CountSession>(0, "127.0.0.1");
+
+    semaphore connected;
+    auto sock = Socket::createSocket();
+    sock->connect("127.0.0.1", server->getPort(), [&](const SockException &ex) { connected.post(); });
+    CHECK(connected.wait(3000) && sock->alive());
+    sock->setSendRate(kRate, 0, true);
+    sendPackets(sock, 2000, 1000);
+    auto burst = kRate / 100;
+    CHECK(near(receiver.bytesAfter(2), burst + kRate * 2, 0.05));
+    return true;
+}
+
+static double cpuSeconds() {
+#if !defined(_WIN32)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+#else
+    return 0;
+#endif
+}
+
+// 大量低码率socket同时限速发送，统计时间轮的唤醒次数与cpu开销
+// Lots of low bitrate sockets sending with shaping at the same time, count wakeups of the wheel and the cpu cost
+static void benchmark() {
+    size_t count = 10000;
+#if !defined(_WIN32)
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+        if (limit.rlim_cur < count + 100) {
+            count = limit.rlim_cur > 200 ? limit.rlim_cur - 100 : 100;
+        }
+    }
+#endif
+    static constexpr uint64_t kRate = 2000;
+    static constexpr size_t kPacket = 1000;
+    static constexpr double kSeconds = 3;
+    auto packets = (size_t)(kRate * kSeconds / kPacket);
+
+    // 接收端不读取数据，只测量发送侧开销
+    // The receiver does not read, only the cost of the sending side is measured
+    auto recv_sock = Socket::createSocket();
+    recv_sock->bindUdpSock(0, "127.0.0.1");
+    recv_sock->enableRecv(false);
+    auto poller = EventPollerPool::Instance().getPoller(false);
+    vector<Socket::Ptr> socks(count);
+    poller->sync([&]() {
+        for (auto &sock : socks) {
+            sock = makeUdpSender(recv_sock, poller);
+        }
+    });
+
+    auto run = [&](bool paced) {
+        poller->sync([&]() {
+            for (auto &sock : socks) {
+                sock->setSendRate(paced ? kRate : 0);
+            }
+        });
+        auto wheel = PacingWheel::getInstance(poller);
+        auto fired = wheel->getStatistic().fired;
+        auto cpu = cpuSeconds();
+        auto start = getCurrentMicrosecond();
+        poller->sync([&]() {
+            for (auto &sock : socks) {
+                for (size_t i = 0; i < packets; ++i) {
+                    sock->send(string(kPacket, 'x'));
+                }
+            }
+        });
+        // 等待全部发送完毕
+        // Wait until everything is sent
+        size_t pending = 0;
+        do {
+            usleep(50 * 1000);
+            pending = 0;
+            poller->sync([&]() {
+                for (auto &sock : socks) {
+                    pending += sock->getSendBufferCount();
+                }
+            });
+        } while (pending && getCurrentMicrosecond() - start < (kSeconds + 10) * 1000000);
+        auto elapsed = (getCurrentMicrosecond() - start) / 1000000.0;
+        cpu = cpuSeconds() - cpu;
+        fired = wheel->getStatistic().fired - fired;
+        cout << count << (paced ? " paced" : " unpaced") << " sockets: drained in " << elapsed << "s";
+        if (paced) {
+            cout << " (ideal " << kSeconds - 1500.0 / kRate << "s), wakeups " << (uint64_t)(fired / elapsed) << "/s";
+        }
+        cout << ", cpu " << cpu << "s, " << (uint64_t)(cpu * 1000000 / (count * packets)) << "us per packet" << endl;
+    };
+    cout << packets << " packets of " << kPacket << " bytes per socket, " << kRate << " B/s when paced:" << endl;
+    run(false);
+    run(true);
+    poller->sync([&]() { socks.clear(); });
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    bool bench = !(argc > 1 && string(argv[1]) == "--no-bench");
+    bool ok = testTokenBucket() && testUdpRate() && testGroupRate() && testTcpRate();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (ok && bench) {
+        benchmark();
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <thread>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/Metrics.h"
+#include "Thread/semaphore.h"
+#include "Poller/EventPoller.h"
+#include "Poller/PollerWatchdog.h"
+
+using namespace std;
+using namespace toolkit;
+
+// 故意阻塞poller的函数，它或其中的sleep应出现在抓取到的调用栈中
+// Function blocking the poller deliberately, it or the sleep in it should appear in the captured stack
+__attribute__((noinline)) static void blockPollerDeliberately(int ms) {
+    this_thread::sleep_for(chrono::milliseconds(ms));
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    semaphore sem;
+    PollerWatchdog::StallInfo stall;
+    PollerWatchdog::Instance().setOnStall([&](const PollerWatchdog::StallInfo &info) {
+        stall = info;
+        sem.post();
+    });
+    PollerWatchdog::Instance().start(200);
+
+    auto poller = EventPollerPool::Instance().getPoller();
+    // 短任务不应被报告
+    // Short tasks should not be reported
+    for (int i = 0; i < 10; ++i) {
+        poller->async([]() { blockPollerDeliberately(20); });
+    }
+    this_thread::sleep_for(chrono::milliseconds(500));
+
+    poller->async([]() { blockPollerDeliberately(800); });
+    sem.wait();
+    bool ok = true;
+    ok = ok && stall.poller == poller->getThreadName();
+    ok = ok && stall.kind == "task";
+    ok = ok && stall.elapsed_ms >= 200;
+    ok = ok && stall.target.find("main") != string::npos;
+#if defined(__linux__) && defined(__GLIBC__)
+    bool found = false;
+    for (auto &frame : stall.stack) {
+        found = found || frame.find("blockPollerDeliberately") != string::npos || frame.find("nanosleep") != string::npos;
+    }
+    ok = ok && found;
+#endif
+    auto text = MetricsRegistry::Instance().toPrometheus();
+    ok = ok && text.find("zltoolkit_poller_stalls_total{poller=\"" + stall.poller + "\"} 1") != string::npos;
+
+    cout << "stall detected, poller: " << stall.poller << ", elapsed: " << stall.elapsed_ms << "ms, kind: " << stall.kind
+         << ", target: " << stall.target << ", frames: " << stall.stack.size() << endl;
+    this_thread::sleep_for(chrono::milliseconds(800));
+    PollerWatchdog::Instance().stop();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
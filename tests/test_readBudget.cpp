@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Thread/semaphore.h"
+#include "Network/Socket.h"
+#include "Network/TcpServer.h"
+#include "Network/Session.h"
+#include "test_check.h"
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+static size_t s_read_budget = 0;
+
+// 精确时钟，getCurrentMicrosecond由后台线程定时刷新，精度不足以测量往返延时
+// Precise clock, getCurrentMicrosecond is refreshed periodically by a background thread and is too coarse for round trips
+static uint64_t nowUS() {
+    return (uint64_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static Socket::Ptr createBudgetSocket(const EventPoller::Ptr &poller) {
+    auto ret = Socket::createSocket(poller, false);
+    ret->setReadBudget(s_read_budget, 1);
+    return ret;
+}
+
+// 校验收到的字节序列
+// Verify the received byte sequence
+class SequenceSession : public Session {
+public:
+    static std::atomic<uint64_t> s_bytes;
+    static std::atomic<bool> s_corrupted;
+
+    SequenceSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override {
+        auto data = (const uint8_t *)buf->data();
+        for (size_t i = 0; i < buf->size(); ++i) {
+            if (data[i] != (uint8_t)(_offset++ % 251)) {
+                s_corrupted = true;
+            }
+        }
+        s_bytes += buf->size();
+    }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+
+private:
+    uint64_t _offset = 0;
+};
+
+std::atomic<uint64_t> SequenceSession::s_bytes { 0 };
+std::atomic<bool> SequenceSession::s_corrupted { false };
+
+// 小额度下tcp数据完整有序，udp包不丢失
+// With a small budget tcp data stays complete and in order, udp packets are not lost
+static bool testBudgetedRead() {
+    static constexpr size_t kTotal = 8 * 1024 * 1024;
+    s_read_budget = 4096;
+    TcpServer::Ptr server(new TcpServer());
+    server->setOnCreateSocket(createBudgetSocket);
+    server->start<SequenceSession>(0, "127.0.0.1");
+
+    semaphore connected;
+    auto sock = Socket::createSocket();
+    sock->connect("127.0.0.1", server->getPort(), [&](const SockException &ex) { connected.post(); });
+    CHECK(connected.wait(3000) && sock->alive());
+    sock->getPoller()->sync([&]() {
+        string data(kTotal, 0);
+        for (size_t i = 0; i < kTotal; ++i) {
+            data[i] = (char)(i % 251);
+        }
+        sock->send(std::move(data));
+    });
+    for (int i = 0; i < 1000 && SequenceSession::s_bytes < kTotal; ++i) {
+        usleep(10 * 1000);
+    }
+    CHECK(SequenceSession::s_bytes == kTotal && !SequenceSession::s_corrupted);
+
+    std::atomic<size_t> packets { 0 };
+    auto recv_sock = createBudgetSocket(nullptr);
+    recv_sock->setReadBudget(0, 1);
+    recv_sock->bindUdpSock(0, "127.0.0.1");
+    SockUtil::setRecvBuf(recv_sock->rawFD(), 4 * 1024 * 1024);
+    recv_sock->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *, int) { ++packets; });
+    auto send_sock = Socket::createSocket();
+    send_sock->bindUdpSock(0, "127.0.0.1");
+    auto addr = SockUtil::make_sockaddr("127.0.0.1", recv_sock->get_local_port());
+    send_sock->bindPeerAddr((struct sockaddr *)&addr, 0, true);
+    send_sock->getPoller()->sync([&]() {
+        for (int i = 0; i < 1000; ++i) {
+            send_sock->send(string(1000, 'x'));
+        }
+    });
+    for (int i = 0; i < 300 && packets < 1000; ++i) {
+        usleep(10 * 1000);
+    }
+    CHECK(packets == 1000);
+    return true;
+}
+
+class EchoSession : public Session {
+public:
+    EchoSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { send(buf); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+class SinkSession : public Session {
+public:
+    static std::atomic<uint64_t> s_bytes;
+
+    SinkSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { s_bytes += buf->size(); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+std::atomic<uint64_t> SinkSession::s_bytes { 0 };
+
+static void raiseFdLimit(size_t count) {
+#if !defined(_WIN32)
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < count) {
+        limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, count);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+// 一条大流量连接与大量小流量连接共用一个poller，测量小流量连接的往返延时
+// One elephant flow shares a poller with lots of mice flows, the round trip latency of the mice is measured
+static void benchmark(size_t read_budget) {
+    static constexpr size_t kMice = 1000;
+    static constexpr size_t kSeconds = 3;
+    s_read_budget = read_budget;
+    SinkSession::s_bytes = 0;
+    auto server_poller = EventPollerPool::Instance().getPoller(false);
+    TcpServer::Ptr echo_server(new TcpServer(server_poller));
+    TcpServer::Ptr sink_server(new TcpServer(server_poller));
+    echo_server->setOnCreateSocket(createBudgetSocket);
+    sink_server->setOnCreateSocket(createBudgetSocket);
+    echo_server->start<EchoSession>(0, "127.0.0.1");
+    sink_server->start<SinkSession>(0, "127.0.0.1");
+
+    // 大流量客户端尽快写入，自身发送缓存保持在4MB以内
+    // The elephant client writes as fast as it can, keeping its own send cache within 4MB
+    auto elephant = Socket::createSocket(EventPollerPool::Instance().getPoller(false), false);
+    elephant->connect("127.0.0.1", sink_server->getPort(), [](const SockException &) {});
+    std::atomic<bool> running { true };
+    auto chunk = BufferRaw::create();
+    chunk->assign(string(256 * 1024, 'E').data(), 256 * 1024);
+    elephant->getPoller()->doDelayTask(1, [&, chunk]() -> uint64_t {
+        while (running && elephant->alive() && elephant->getMemoryBudget()->used() < 4 * 1024 * 1024) {
+            elephant->send(chunk);
+        }
+        return running ? 1 : 0;
+    });
+
+    // 每个小流量客户端每100毫秒发送一个带时间戳的16字节请求
+    // Each mouse client sends a 16 bytes request with a timestamp every 100 milliseconds
+    mutex mtx;
+    vector<uint64_t> rtts;
+    auto mice_poller = EventPollerPool::Instance().getPoller(false);
+    vector<Socket::Ptr> mice(kMice);
+    mice_poller->sync([&]() {
+        for (auto &mouse : mice) {
+            mouse = Socket::createSocket(mice_poller, false);
+            mouse->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *, int) {
+                auto now = nowUS();
+                lock_guard<mutex> lck(mtx);
+                for (size_t i = 0; i + 16 <= buf->size(); i += 16) {
+                    uint64_t stamp;
+                    memcpy(&stamp, buf->data() + i, sizeof(stamp));
+                    rtts.emplace_back(now - stamp);
+                }
+            });
+            mouse->connect("127.0.0.1", echo_server->getPort(), [](const SockException &) {});
+        }
+    });
+    usleep(500 * 1000);
+    size_t index = 0;
+    auto ticker = mice_poller->doDelayTask(1, [&]() -> uint64_t {
+        // 每毫秒发送1/100的连接，使请求均匀分布
+        // Send on 1/100 of the connections every millisecond, spreading the requests evenly
+        for (size_t i = 0; i < kMice / 100; ++i) {
+            char req[16] = { 0 };
+            auto stamp = nowUS();
+            memcpy(req, &stamp, sizeof(stamp));
+            mice[index++ % kMice]->send(req, sizeof(req));
+        }
+        return 1;
+    });
+    usleep(kSeconds * 1000 * 1000);
+    ticker->cancel();
+    running = false;
+    usleep(200 * 1000);
+
+    lock_guard<mutex> lck(mtx);
+    std::sort(rtts.begin(), rtts.end());
+    auto percentile = [&](double q) { return rtts.empty() ? 0 : rtts[std::min(rtts.size() - 1, (size_t)(rtts.size() * q))]; };
+    cout << "read budget " << (read_budget ? to_string(read_budget / 1024) + "KB" : string("unlimited")) << ": elephant "
+         << SinkSession::s_bytes / 1024 / 1024 / kSeconds << "MB/s, " << rtts.size() << " mouse rtts, p50 " << percentile(0.5) << "us, p99 "
+         << percentile(0.99) << "us, max " << (rtts.empty() ? 0 : rtts.back()) << "us" << endl;
+    mice_poller->sync([&]() { mice.clear(); });
+    elephant->getPoller()->sync([&]() { elephant = nullptr; });
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    // 服务端、大流量客户端与小流量客户端各用一个poller
+    // The server, the elephant client and the mice clients use one poller each
+    EventPollerPool::setPoolSize(3);
+    bool bench = !(argc > 1 && string(argv[1]) == "--no-bench");
+    bool ok = testBudgetedRead();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (ok && bench) {
+        raiseFdLimit(4096);
+        benchmark(0);
+        benchmark(64 * 1024);
+        benchmark(16 * 1024);
+    }
+    return ok ? 0 : 1;
+}
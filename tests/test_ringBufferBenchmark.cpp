@@ -0,0 +1,80 @@
+﻿/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <csignal>
+#include <atomic>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Util/RingBuffer.h"
+#include "Poller/EventPoller.h"
+
+using namespace std;
+using namespace toolkit;
+
+// 每个poller上的读取器个数
+// Readers per poller
+static constexpr size_t kReaderPerPoller = 4;
+// 写入的帧数
+// Frames to write
+static constexpr size_t kFrameCount = 200 * 1000;
+
+static void benchmark(bool batch) {
+    using RingType = RingBuffer<std::shared_ptr<string>>;
+    auto ring = std::make_shared<RingType>(1024);
+    ring->enableBatchDelivery(batch);
+
+    auto poller_count = EventPollerPool::Instance().getExecutorSize();
+    auto total = kFrameCount * kReaderPerPoller * poller_count;
+    atomic<size_t> received(0);
+    semaphore sem;
+    list<RingType::RingReader::Ptr> readers;
+    mutex mtx;
+
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+        auto poller = static_pointer_cast<EventPoller>(executor);
+        poller->sync([&]() {
+            for (size_t i = 0; i < kReaderPerPoller; ++i) {
+                auto reader = ring->attach(poller, false);
+                reader->setReadCB([&](const std::shared_ptr<string> &) {
+                    if (++received == total) {
+                        sem.post();
+                    }
+                });
+                lock_guard<mutex> lck(mtx);
+                readers.emplace_back(std::move(reader));
+            }
+        });
+    });
+
+    auto frame = std::make_shared<string>(1024, 'a');
+    Ticker ticker;
+    for (size_t i = 0; i < kFrameCount; ++i) {
+        ring->write(frame, i % 60 == 0);
+    }
+    auto write_ms = ticker.elapsedTime();
+    sem.wait();
+    InfoL << (batch ? "batch" : "async") << " delivery, pollers: " << poller_count << ", frames: " << kFrameCount
+          << ", write cost: " << write_ms << "ms, delivery cost: " << ticker.elapsedTime() << "ms";
+
+    readers.clear();
+    ring.reset();
+}
+
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    benchmark(false);
+    benchmark(true);
+    sleep(1);
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Thread/semaphore.h"
+#include "Network/Socket.h"
+#include "Network/TcpServer.h"
+#include "Network/Session.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+static Buffer::Ptr makeBuffer(char tag, size_t size, int8_t priority = 0, bool droppable = false) {
+    auto ret = BufferRaw::create();
+    ret->assign(string(size, tag).data(), size);
+    if (droppable) {
+        ret->setSendPriority(priority, true);
+    }
+    return ret;
+}
+
+// 超过字节数上限时按优先级从低到高、同优先级从旧到新丢弃
+// Over the byte limit, data is dropped from the lowest priority, and from the oldest within the same priority
+static bool testDropOrder() {
+    mutex mtx;
+    string received;
+    auto recv_sock = Socket::createSocket();
+    recv_sock->bindUdpSock(0, "127.0.0.1");
+    recv_sock->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *, int) {
+        lock_guard<mutex> lck(mtx);
+        received.push_back(buf->data()[0]);
+    });
+
+    auto sock = Socket::createSocket();
+    sock->bindUdpSock(0, "127.0.0.1");
+    auto addr = SockUtil::make_sockaddr("127.0.0.1", recv_sock->get_local_port());
+    sock->bindPeerAddr((struct sockaddr *)&addr, 0, true);
+    sock->setSendDropPolicy(10000, 0);
+    string dropped;
+    sock->setOnSendResult([&](const Buffer::Ptr &buf, bool success) {
+        if (!success) {
+            dropped.push_back(buf->data()[0]);
+        }
+    });
+
+    sock->getPoller()->sync([&]() {
+        // 不立即发送，全部积压在一级缓存
+        // Do not flush, everything piles up in the first-level cache
+        sock->send(makeBuffer('A', 3000), nullptr, 0, false);
+        sock->send(makeBuffer('b', 3000, 1, true), nullptr, 0, false);
+        sock->send(makeBuffer('c', 3000, 0, true), nullptr, 0, false);
+        sock->send(makeBuffer('d', 3000, 1, true), nullptr, 0, false);
+        sock->send(makeBuffer('e', 3000, 0, true), nullptr, 0, false);
+        sock->send(makeBuffer('f', 3000, 2, true), nullptr, 0, false);
+        sock->flushAll();
+    });
+    CHECK(dropped == "ceb");
+    CHECK(sock->getSendDropCount() == 3);
+    CHECK(sock->getSendDropBytes() == 9000);
+
+    for (int i = 0; i < 100; ++i) {
+        {
+            lock_guard<mutex> lck(mtx);
+            if (received.size() == 3) {
+                break;
+            }
+        }
+        usleep(10 * 1000);
+    }
+    lock_guard<mutex> lck(mtx);
+    CHECK(received == "Adf");
+    return true;
+}
+
+class PausedSession : public Session {
+public:
+    static std::atomic<uint64_t> s_bytes;
+    static std::atomic<uint64_t> s_reliable_bytes;
+
+    PausedSession(const Socket::Ptr &sock) : Session(sock) {
+        // 连接后1秒内不读取，模拟拥塞的接收端
+        // Do not read within 1 second after connected, simulating a congested receiver
+        sock->enableRecv(false);
+        std::weak_ptr<Socket> weak_sock = sock;
+        sock->getPoller()->doDelayTask(1000, [weak_sock]() -> uint64_t {
+            if (auto strong_sock = weak_sock.lock()) {
+                strong_sock->enableRecv(true);
+            }
+            return 0;
+        });
+    }
+
+    void onRecv(const Buffer::Ptr &buf) override {
+        s_bytes += buf->size();
+        for (size_t i = 0; i < buf->size(); ++i) {
+            s_reliable_bytes += buf->data()[i] == 'A';
+        }
+    }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+std::atomic<uint64_t> PausedSession::s_bytes { 0 };
+std::atomic<uint64_t> PausedSession::s_reliable_bytes { 0 };
+
+// 接收端停读期间，可丢弃的数据被丢弃，连接保持且不可丢弃的数据全部送达
+// While the receiver stops reading, droppable data is dropped, the connection stays and all reliable data arrives
+static bool testCongestion() {
+    static constexpr size_t kFrames = 300;
+    static constexpr size_t kFrameSize = 32 * 1024;
+    static constexpr size_t kReliableSize = 200;
+    TcpServer::Ptr server(new TcpServer());
+    server->start<PausedSession>(0, "127.0.0.1");
+
+    semaphore connected;
+    auto sock = Socket::createSocket();
+    sock->connect("127.0.0.1", server->getPort(), [&](const SockException &ex) { connected.post(); });
+    CHECK(connected.wait(3000) && sock->alive());
+    SockUtil::setSendBuf(sock->rawFD(), 64 * 1024);
+    sock->setSendDropPolicy(512 * 1024, 300);
+
+    std::atomic<bool> error { false };
+    sock->setOnErr([&](const SockException &ex) { error = true; });
+
+    // 每10毫秒发送一帧可丢弃的大帧和一个不可丢弃的小包，共3秒
+    // Send a large droppable frame and a small reliable packet every 10 milliseconds, 3 seconds in total
+    size_t sent = 0;
+    size_t max_queued = 0;
+    semaphore done;
+    sock->getPoller()->doDelayTask(10, [&]() -> uint64_t {
+        sock->send(makeBuffer('V', kFrameSize, 0, true));
+        sock->send(makeBuffer('A', kReliableSize));
+        max_queued = std::max(max_queued, sock->getSendBufferCount());
+        if (++sent == kFrames) {
+            done.post();
+            return 0;
+        }
+        return 10;
+    });
+    CHECK(done.wait(10000));
+
+    auto total = kFrames * (kFrameSize + kReliableSize);
+    for (int i = 0; i < 500 && sock->getSendDropBytes() + PausedSession::s_bytes < total; ++i) {
+        usleep(10 * 1000);
+    }
+    CHECK(!error && sock->alive());
+    CHECK(PausedSession::s_reliable_bytes == kFrames * kReliableSize);
+    CHECK(sock->getSendDropCount() > 0);
+    CHECK(sock->getSendDropBytes() + PausedSession::s_bytes == total);
+    cout << "dropped " << sock->getSendDropCount() << " of " << kFrames << " frames, max queued buffers " << max_queued << endl;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    bool ok = testDropOrder() && testCongestion();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
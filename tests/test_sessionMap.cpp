@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "Util/logger.h"
+#include "Network/TcpServer.h"
+#include "Thread/threadgroup.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+class DummySession : public Session {
+public:
+    DummySession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override {}
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+// 模拟建连断连的线程数
+// Threads simulating connecting and disconnecting
+static constexpr size_t kThreadCount = 4;
+// 每个线程常驻的会话数
+// Resident sessions of each thread
+static constexpr size_t kResident = 5000;
+static constexpr size_t kSessionsPerThread = kResident * 2;
+
+// 按id与标识查找，标识与id对应的会话不符时返回空；移除后查找不到
+// Look up by id and identifier, null is returned if the identifier does not match the session of that id; not found after removal
+static bool testLookup(const shared_ptr<TcpServer> &server, const EventPoller::Ptr &poller) {
+    vector<Session::Ptr> sessions;
+    vector<shared_ptr<SessionHelper>> helpers;
+    for (size_t i = 0; i < 1000; ++i) {
+        sessions.emplace_back(std::make_shared<DummySession>(Socket::createSocket(poller, false)));
+        helpers.emplace_back(std::make_shared<SessionHelper>(server, sessions.back(), "DummySession"));
+    }
+    auto &map = SessionMap::Instance();
+    CHECK(map.size() == 1000 && map.snapshot().size() == 1000);
+    for (auto &session : sessions) {
+        CHECK(map.get(session->getSessionId()) == session);
+        CHECK(map.get(session->getIdentifier()) == session);
+        CHECK(!map.get(to_string(session->getSessionId()) + "-x"));
+    }
+    for (size_t i = 0; i < helpers.size(); i += 2) {
+        helpers[i] = nullptr;
+    }
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        CHECK((bool)map.get(sessions[i]->getSessionId()) == (i % 2 == 1));
+    }
+    helpers.clear();
+    CHECK(map.size() == 0 && map.snapshot().empty());
+    return true;
+}
+
+static uint32_t percentile(vector<uint32_t> &costs, size_t n) {
+    if (costs.empty()) {
+        return 0;
+    }
+    sort(costs.begin(), costs.end());
+    return costs[std::min(costs.size() - 1, costs.size() * n / 100)];
+}
+
+/**
+ * 多线程按固定速率(rate为0则不限速)加入和移除会话，同时另一线程不断做快照遍历与按id查找
+ * Multiple threads add and remove sessions at a fixed rate (unlimited if rate is 0),
+ * while another thread keeps taking snapshots and looking up by id
+ */
+static void benchmark(const shared_ptr<TcpServer> &server, vector<vector<Session::Ptr>> &sessions, size_t rate, size_t seconds) {
+    atomic<bool> exit { false };
+    vector<vector<uint32_t>> costs(kThreadCount);
+    vector<size_t> ops(kThreadCount, 0);
+    thread_group group;
+    for (size_t i = 0; i < kThreadCount; ++i) {
+        group.create_thread([&, i]() {
+            auto &pool = sessions[i];
+            vector<shared_ptr<SessionHelper>> ring(kResident);
+            size_t index = 0;
+            auto interval = rate ? chrono::nanoseconds(1000 * 1000 * 1000ULL * kThreadCount / rate) : chrono::nanoseconds(0);
+            auto next = chrono::steady_clock::now();
+            auto end = next + chrono::seconds(seconds);
+            while (true) {
+                auto now = chrono::steady_clock::now();
+                if (now >= end) {
+                    break;
+                }
+                if (rate) {
+                    if (now < next) {
+                        this_thread::yield();
+                        continue;
+                    }
+                    next += interval;
+                }
+                // 一次建连(加入)加一次断连(移除)
+                // One connect (add) and one disconnect (remove)
+                auto &slot = ring[index % kResident];
+                auto &session = pool[index % pool.size()];
+                auto begin = chrono::steady_clock::now();
+                slot = nullptr;
+                slot = std::make_shared<SessionHelper>(server, session, "DummySession");
+                costs[i].emplace_back((uint32_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count());
+                ++index;
+            }
+            ops[i] = index;
+        });
+    }
+
+    size_t snapshots = 0, lookups = 0, hits = 0;
+    vector<uint32_t> snapshot_costs;
+    thread reader([&]() {
+        while (!exit) {
+            auto begin = chrono::steady_clock::now();
+            auto handles = SessionMap::Instance().snapshot();
+            snapshot_costs.emplace_back((uint32_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count());
+            ++snapshots;
+            for (size_t i = 0; i < handles.size(); i += 16) {
+                ++lookups;
+                if (SessionMap::Instance().get(handles[i].id())) {
+                    ++hits;
+                }
+            }
+        }
+    });
+    group.join_all();
+    exit = true;
+    reader.join();
+
+    vector<uint32_t> all;
+    size_t total = 0;
+    for (size_t i = 0; i < kThreadCount; ++i) {
+        all.insert(all.end(), costs[i].begin(), costs[i].end());
+        total += ops[i];
+    }
+    cout << (rate ? "throttled " + to_string(rate) + "/s" : string("unthrottled")) << ": " << total / seconds << " connects/s"
+         << ", add+del p50: " << percentile(all, 50) << "ns, p99: " << percentile(all, 99) << "ns"
+         << ", sessions: " << SessionMap::Instance().size()
+         << ", snapshots: " << snapshots << " (p99 " << percentile(snapshot_costs, 99) << "us)"
+         << ", lookups: " << lookups << " (hit " << hits << ")" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    auto rate = argc > 1 ? (size_t)atoi(argv[1]) : 50 * 1000;
+    auto seconds = argc > 2 ? (size_t)atoi(argv[2]) : 3;
+
+    // 会话对象预先创建，测试只统计会话表的开销
+    // Sessions are created in advance, the test only measures the cost of the session map
+    auto poller = EventPollerPool::Instance().getPoller();
+    vector<vector<Session::Ptr>> sessions(kThreadCount);
+    for (auto &pool : sessions) {
+        for (size_t i = 0; i < kSessionsPerThread; ++i) {
+            pool.emplace_back(std::make_shared<DummySession>(Socket::createSocket(poller, false)));
+        }
+    }
+    auto server = std::make_shared<TcpServer>(poller);
+    if (!testLookup(server, poller)) {
+        cout << "checks failed" << endl;
+        return 1;
+    }
+    cout << "all checks passed" << endl;
+    benchmark(server, sessions, rate, seconds);
+    benchmark(server, sessions, 0, seconds);
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <functional>
+#include "Util/MD5.h"
+#include "Util/SHA1.h"
+#include "Util/base64.h"
+#include "Util/CpuFeature.h"
+#include "test_check.h"
+
+using namespace std;
+using namespace toolkit;
+
+static mt19937 s_rand(12345);
+
+static string randomBytes(size_t size) {
+    string ret(size, '\0');
+    for (auto &ch : ret) {
+        ch = (char)s_rand();
+    }
+    return ret;
+}
+
+// 分别在只允许标量实现与启用全部simd时执行
+// Run with only the scalar implementations allowed and with all simd enabled
+template <typename T>
+static void scalarAndSimd(T &scalar, T &simd, const function<T()> &func) {
+    CpuFeature::setEnabled(0);
+    scalar = func();
+    CpuFeature::setEnabled(CpuFeature::detected());
+    simd = func();
+}
+
+static bool testBase64() {
+    CHECK(encodeBase64("abc:def") == "YWJjOmRlZg==");
+    CHECK(decodeBase64("YWJjOmRlZg==") == "abc:def");
+    for (size_t size = 1; size < 600; ++size) {
+        auto data = randomBytes(size);
+        string scalar, simd;
+        scalarAndSimd<string>(scalar, simd, [&]() { return encodeBase64(data); });
+        CHECK(scalar == simd);
+        string decoded_scalar, decoded_simd;
+        scalarAndSimd<string>(decoded_scalar, decoded_simd, [&]() { return decodeBase64(simd); });
+        CHECK(decoded_scalar == data && decoded_simd == data);
+
+        // 在随机位置放入任意字节，结果须与标量实现一致
+        // Put an arbitrary byte at a random position, the result must be the same as the scalar implementation
+        for (int i = 0; i < 8; ++i) {
+            auto corrupted = simd;
+            corrupted[s_rand() % corrupted.size()] = (char)s_rand();
+            scalarAndSimd<string>(decoded_scalar, decoded_simd, [&]() { return decodeBase64(corrupted); });
+            CHECK(decoded_scalar == decoded_simd);
+        }
+    }
+    return true;
+}
+
+static bool testSHA1() {
+    CHECK(SHA1::encode("abc") == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    vector<string> msgs;
+    for (size_t size = 0; size < 300; ++size) {
+        msgs.emplace_back(randomBytes(size));
+    }
+    msgs.emplace_back(randomBytes(100000));
+    for (auto &msg : msgs) {
+        string scalar, simd;
+        scalarAndSimd<string>(scalar, simd, [&]() { return SHA1::encode_bin(msg); });
+        CHECK(scalar == simd);
+
+        // 分段更新
+        // Update in pieces
+        SHA1 sha1;
+        for (size_t pos = 0; pos < msg.size(); pos += 37) {
+            sha1.update(msg.substr(pos, 37));
+        }
+        CHECK(sha1.final_bin() == scalar);
+    }
+    vector<string> scalar, simd;
+    scalarAndSimd<vector<string>>(scalar, simd, [&]() { return SHA1::encode_bin_batch(msgs); });
+    CHECK(scalar.size() == msgs.size() && scalar == simd);
+    CHECK(scalar[3] == SHA1::encode_bin(msgs[3]));
+    return true;
+}
+
+static bool testMD5() {
+    CHECK(MD5("abc").hexdigest() == "900150983cd24fb0d6963f7d28e17f72");
+    vector<string> msgs;
+    for (size_t size = 0; size < 300; ++size) {
+        msgs.emplace_back(randomBytes(size));
+    }
+    msgs.emplace_back(randomBytes(100000));
+    vector<string> scalar, simd;
+    scalarAndSimd<vector<string>>(scalar, simd, [&]() { return MD5::rawdigestBatch(msgs); });
+    CHECK(scalar.size() == msgs.size() && scalar == simd);
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        CHECK(simd[i] == MD5(msgs[i]).rawdigest());
+    }
+    return true;
+}
+
+// 返回MB/s
+// Return MB/s
+static double throughput(size_t bytes, const function<void()> &func) {
+    // 至少运行约50毫秒
+    // Run for about 50 milliseconds at least
+    size_t rounds = 0;
+    auto begin = chrono::steady_clock::now();
+    chrono::duration<double> elapsed;
+    do {
+        func();
+        ++rounds;
+        elapsed = chrono::steady_clock::now() - begin;
+    } while (elapsed.count() < 0.05);
+    return bytes * rounds / elapsed.count() / (1024 * 1024);
+}
+
+static void printRow(const string &name, size_t size, double scalar, double simd) {
+    cout << "  " << name << " " << size << " bytes: scalar " << (uint64_t)scalar << " MB/s, simd " << (uint64_t)simd << " MB/s, x"
+         << (uint64_t)(simd * 100 / scalar) / 100.0 << endl;
+}
+
+static void benchmark() {
+    cout << "cpu features: " << CpuFeature::toString(CpuFeature::detected()) << endl;
+    for (size_t size : { 16, 64, 256, 1024, 16 * 1024, 1024 * 1024 }) {
+        auto data = randomBytes(size);
+        auto encoded = encodeBase64(data);
+        // 单条消息，按total凑够相近的数据量
+        // Single message, repeated to get a similar amount of data
+        size_t repeat = max<size_t>(1, 64 * 1024 / size);
+        double results[2][3];
+        for (int simd = 0; simd < 2; ++simd) {
+            CpuFeature::setEnabled(simd ? CpuFeature::detected() : 0);
+            results[simd][0] = throughput(size * repeat, [&]() {
+                for (size_t i = 0; i < repeat; ++i) {
+                    encodeBase64(data);
+                }
+            });
+            results[simd][1] = throughput(size * repeat, [&]() {
+                for (size_t i = 0; i < repeat; ++i) {
+                    decodeBase64(encoded);
+                }
+            });
+            results[simd][2] = throughput(size * repeat, [&]() {
+                for (size_t i = 0; i < repeat; ++i) {
+                    SHA1::encode_bin(data);
+                }
+            });
+        }
+        cout << "message size " << size << ":" << endl;
+        printRow("base64 encode", size, results[0][0], results[1][0]);
+        printRow("base64 decode", size, results[0][1], results[1][1]);
+        printRow("sha1", size, results[0][2], results[1][2]);
+
+        // 批量：1024条独立消息
+        // Batch: 1024 independent messages
+        if (size > 16 * 1024) {
+            continue;
+        }
+        vector<string> msgs;
+        for (int i = 0; i < 1024; ++i) {
+            msgs.emplace_back(randomBytes(size));
+        }
+        double batch[2][3];
+        for (int simd = 0; simd < 2; ++simd) {
+            CpuFeature::setEnabled(simd ? CpuFeature::detected() : 0);
+            batch[simd][0] = throughput(size * msgs.size(), [&]() { MD5::rawdigestBatch(msgs); });
+            batch[simd][1] = throughput(size * msgs.size(), [&]() { SHA1::encode_bin_batch(msgs); });
+        }
+        // 不使用批量接口的基线
+        // Baseline without the batch api
+        batch[0][2] = throughput(size * msgs.size(), [&]() {
+            for (auto &msg : msgs) {
+                MD5(msg).rawdigest();
+            }
+        });
+        printRow("md5 one by one vs batch", size, batch[0][2], batch[1][0]);
+        printRow("md5 batch 4 lanes vs best", size, batch[0][0], batch[1][0]);
+        printRow("sha1 batch 4 lanes vs best", size, batch[0][1], batch[1][1]);
+    }
+    CpuFeature::setEnabled(CpuFeature::detected());
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = testBase64() && testSHA1() && testMD5();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (ok && (argc < 2 || string(argv[1]) != "--no-bench")) {
+        benchmark();
+    }
+    return ok ? 0 : 1;
+}
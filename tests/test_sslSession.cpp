@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Util/SSLBox.h"
+#include "Util/SSLSessionCache.h"
+#include "Thread/semaphore.h"
+#include "Network/TcpServer.h"
+#include "Network/TcpClient.h"
+#include "Network/Session.h"
+#include "test_check.h"
+#include "test_cert.h"
+
+using namespace std;
+using namespace toolkit;
+
+class EchoSession : public Session {
+public:
+    EchoSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { send(buf); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+// 连接后发送一次数据，收到回显即完成
+// Send once after connecting, done when the echo is received
+class PingClient : public TcpClient {
+public:
+    PingClient(semaphore &sem, bool &ok) : _ok(ok), _sem(sem) {}
+
+protected:
+    void onConnect(const SockException &ex) override {
+        if (ex) {
+            _sem.post();
+            return;
+        }
+        send("ping");
+    }
+    void onRecv(const Buffer::Ptr &buf) override {
+        _ok = true;
+        _sem.post();
+    }
+    void onError(const SockException &ex) override {}
+
+private:
+    bool &_ok;
+    semaphore &_sem;
+};
+
+static bool connectOnce(uint16_t port) {
+    semaphore sem;
+    bool ok = false;
+    auto client = std::make_shared<TcpClientWithSSL<PingClient>>(sem, ok);
+    client->startConnect("127.0.0.1", port);
+    auto done = sem.wait(5 * 1000);
+    client->getPoller()->sync([&]() { client = nullptr; });
+    return done && ok;
+}
+
+struct HandshakeCount {
+    uint64_t counts[2][2];
+
+    HandshakeCount() {
+        for (auto server_mode : { false, true }) {
+            for (auto resumed : { false, true }) {
+                counts[server_mode][resumed] = SSL_Initor::Instance().getHandshakeCount(server_mode, resumed);
+            }
+        }
+    }
+
+    // 自构造以来的增量
+    // Increment since construction
+    uint64_t delta(bool server_mode, bool resumed) const {
+        return SSL_Initor::Instance().getHandshakeCount(server_mode, resumed) - counts[server_mode][resumed];
+    }
+};
+
+static bool testResumption(uint16_t port, bool tickets) {
+    SSL_Initor::Instance().enableSessionTickets(tickets);
+    // 首次连接(或切换模式后)进行完整握手，之后恢复会话
+    // The first connection (or the one after switching mode) does a full handshake, later ones resume the session
+    CHECK(connectOnce(port));
+    HandshakeCount count;
+    for (size_t i = 0; i < 10; ++i) {
+        CHECK(connectOnce(port));
+    }
+    CHECK(count.delta(true, false) == 0);
+    CHECK(count.delta(true, true) == 10);
+    CHECK(count.delta(false, true) == 10);
+    // 不签发票据时会话保存在服务端的分片缓存中
+    // Sessions are kept in the server side sharded cache when no tickets are issued
+    CHECK(tickets || SSLSessionCache::Instance().size(true) > 0);
+    return true;
+}
+
+static bool testRotation(uint16_t port) {
+    SSL_Initor::Instance().enableSessionTickets(true);
+    SSL_Initor::Instance().setTicketKeyRotation(1);
+    CHECK(connectOnce(port));
+
+    // 旧密钥在轮换后仍可用，票据被更新
+    // The old key is still usable after rotation, the ticket is renewed
+    sleep(1);
+    HandshakeCount count;
+    CHECK(connectOnce(port));
+    CHECK(count.delta(true, true) == 1);
+
+    // 密钥超过三个周期后失效，进行完整握手
+    // The key expires after three periods, a full handshake is done
+    sleep(3);
+    HandshakeCount count2;
+    CHECK(connectOnce(port));
+    CHECK(count2.delta(true, false) == 1);
+    SSL_Initor::Instance().setTicketKeyRotation(3600);
+    return true;
+}
+
+// 两个SSL_Box在内存中直接对接完成一次握手，sni为客户端发送的虚拟主机名，客户端按key复用之前的会话；返回服务端是否恢复了会话
+// Two SSL_Box are connected in memory to complete a handshake, sni is the virtual host sent by the client and the client
+// reuses the previous session by key; returns whether the server resumed the session
+static bool handshake(const char *sni, const string &key, bool &resumed) {
+    HandshakeCount count;
+    SSL_Box server(true), client(false);
+    List<Buffer::Ptr> to_server, to_client;
+    server.setOnEncData([&](const Buffer::Ptr &buf) { to_client.emplace_back(buf); });
+    client.setOnEncData([&](const Buffer::Ptr &buf) { to_server.emplace_back(buf); });
+    client.setHost(sni);
+    client.setSessionKey(key);
+    client.startHandshake();
+    for (size_t i = 0; i < 32 && (!to_server.empty() || !to_client.empty()); ++i) {
+        List<Buffer::Ptr> pending;
+        pending.swap(to_server);
+        pending.for_each([&](const Buffer::Ptr &buf) { server.onRecv(buf); });
+        pending.clear();
+        pending.swap(to_client);
+        pending.for_each([&](const Buffer::Ptr &buf) { client.onRecv(buf); });
+    }
+    resumed = count.delta(true, true) == 1;
+    return count.delta(true, false) + count.delta(true, true) == 1 && count.delta(false, false) + count.delta(false, true) == 1;
+}
+
+// 一个虚拟主机的会话不能在另一个虚拟主机上恢复
+// A session of one virtual host can not be resumed on another virtual host
+static bool testVhostIsolation(bool tickets) {
+    SSL_Initor::Instance().enableSessionTickets(tickets);
+    auto key = string("vhost-") + (tickets ? "ticket" : "cache");
+    bool resumed = true;
+    CHECK(handshake("a.test", key, resumed));
+    CHECK(!resumed);
+    CHECK(handshake("a.test", key, resumed));
+    CHECK(resumed);
+    // 客户端把a.test的会话提供给b.test
+    // The client offers the session of a.test to b.test
+    CHECK(handshake("b.test", key, resumed));
+    CHECK(!resumed);
+    CHECK(handshake("b.test", key, resumed));
+    CHECK(resumed);
+    return true;
+}
+
+static void benchmark(uint16_t port) {
+    static constexpr size_t kConnections = 300;
+    auto run = [&](bool resume) {
+        SSL_Initor::Instance().enableClientSessionResumption(resume);
+        connectOnce(port);
+        HandshakeCount count;
+        auto start = getCurrentMicrosecond();
+        for (size_t i = 0; i < kConnections; ++i) {
+            connectOnce(port);
+        }
+        auto elapsed = getCurrentMicrosecond() - start;
+        cout << (resume ? "resumed" : "full   ") << " handshakes: " << (uint64_t)(kConnections * 1000000.0 / elapsed) << "/s"
+             << " (server full " << count.delta(true, false) << ", resumed " << count.delta(true, true) << ")" << endl;
+    };
+    cout << "sequential tls connect + echo over loopback:" << endl;
+    run(false);
+    run(true);
+}
+
+// 用法: test_sslSession [--no-bench]
+// Usage: test_sslSession [--no-bench]
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    bool bench = argc < 2 || string(argv[1]) != "--no-bench";
+    // 默认证书与两个虚拟主机的证书，均为临时生成
+    // The default certificate and the certificates of two virtual hosts, all generated on the fly
+    auto cert = makeTestCertificate("localhost");
+    auto &initor = SSL_Initor::Instance();
+    if (!initor.loadCertificate(cert, true, "", false) || !initor.trustCertificate(cert, false, "", false)
+        || !initor.loadCertificate(makeTestCertificate("a.test"), true, "", false, false)
+        || !initor.loadCertificate(makeTestCertificate("b.test"), true, "", false, false)) {
+        cout << "failed to load the generated certificates" << endl;
+        return 1;
+    }
+    initor.ignoreInvalidCertificate(false);
+
+    TcpServer::Ptr server(new TcpServer());
+    server->start<SessionWithSSL<EchoSession>>(0, "127.0.0.1");
+    auto port = server->getPort();
+
+    bool ok = testResumption(port, true) && testResumption(port, false) && testRotation(port);
+    ok = ok && testVhostIsolation(true) && testVhostIsolation(false);
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (ok && bench) {
+        benchmark(port);
+    }
+    return ok ? 0 : 1;
+}
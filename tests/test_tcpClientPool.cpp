@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/util.h"
+#include "Util/TimeTicker.h"
+#include "Thread/semaphore.h"
+#include "Network/TcpServer.h"
+#include "Network/Session.h"
+#include "Network/TcpClientPool.h"
+#include "test_check.h"
+#include "test_cert.h"
+
+using namespace std;
+using namespace toolkit;
+
+static std::atomic<size_t> s_accepted { 0 };
+static std::mutex s_mtx;
+static vector<weak_ptr<Session>> s_sessions;
+
+class EchoSession : public Session {
+public:
+    EchoSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { send(buf); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+template <typename SessionType>
+static TcpServer::Ptr startServer() {
+    TcpServer::Ptr server(new TcpServer());
+    server->start<SessionType>(0, "127.0.0.1", 1024, [](std::shared_ptr<SessionType> &session) {
+        ++s_accepted;
+        lock_guard<mutex> lck(s_mtx);
+        s_sessions.emplace_back(session);
+    });
+    return server;
+}
+
+// 关闭服务器端的所有连接
+// Close all connections on the server side
+static void closeServerSessions() {
+    lock_guard<mutex> lck(s_mtx);
+    for (auto &weak_session : s_sessions) {
+        if (auto session = weak_session.lock()) {
+            session->safeShutdown();
+        }
+    }
+    s_sessions.clear();
+}
+
+struct RequestResult {
+    bool ok = false;
+    size_t reuse_count = 0;
+    SockException ex;
+};
+
+// 获取连接，发送一次请求并等待回显后归还
+// Acquire a connection, send one request, wait for the echo and then return it
+static RequestResult request(const TcpClientPool::Ptr &pool, uint16_t port, bool ssl, bool reusable = true) {
+    RequestResult ret;
+    semaphore sem;
+    pool->acquire("127.0.0.1", port, ssl, [&](const SockException &ex, const PooledTcpClient::Ptr &client) {
+        if (ex) {
+            ret.ex = ex;
+            sem.post();
+            return;
+        }
+        ret.reuse_count = client->getReuseCount();
+        client->setReusable(reusable);
+        // 连接由回调持有，回显完成后释放
+        // The connection is held by the callback and released after the echo completes
+        auto holder = std::make_shared<PooledTcpClient::Ptr>(client);
+        auto received = std::make_shared<size_t>(0);
+        static const string payload(256, 'p');
+        client->setOnRecv([&, holder, received](const Buffer::Ptr &buf) {
+            *received += buf->size();
+            if (*received >= payload.size()) {
+                ret.ok = *received == payload.size();
+                *holder = nullptr;
+                sem.post();
+            }
+        });
+        client->setOnErr([&, holder](const SockException &ex) {
+            ret.ex = ex;
+            *holder = nullptr;
+            sem.post();
+        });
+        client->send(payload);
+    });
+    if (!sem.wait(5 * 1000)) {
+        ret.ex = SockException(Err_timeout, "request timeout");
+    }
+    return ret;
+}
+
+static size_t idleCount(const TcpClientPool::Ptr &pool, uint16_t port, bool ssl) {
+    size_t ret = 0;
+    pool->getPoller()->sync([&]() { ret = pool->getIdleCount("127.0.0.1", port, ssl); });
+    return ret;
+}
+
+static size_t totalCount(const TcpClientPool::Ptr &pool, uint16_t port, bool ssl) {
+    size_t ret = 0;
+    pool->getPoller()->sync([&]() { ret = pool->getTotalCount("127.0.0.1", port, ssl); });
+    return ret;
+}
+
+static bool waitIdle(const TcpClientPool::Ptr &pool, uint16_t port, bool ssl, size_t count) {
+    Ticker ticker;
+    while (idleCount(pool, port, ssl) != count && ticker.elapsedTime() < 3000) {
+        usleep(10 * 1000);
+    }
+    return idleCount(pool, port, ssl) == count;
+}
+
+static bool testReuse(bool ssl) {
+    auto server = ssl ? startServer<SessionWithSSL<EchoSession>>() : startServer<EchoSession>();
+    auto port = server->getPort();
+    auto pool = std::make_shared<TcpClientPool>();
+    s_accepted = 0;
+
+    for (size_t i = 0; i < 10; ++i) {
+        auto ret = request(pool, port, ssl);
+        CHECK(ret.ok);
+        CHECK(ret.reuse_count == i);
+    }
+    CHECK(s_accepted == 1);
+    CHECK(idleCount(pool, port, ssl) == 1);
+
+    // 不可复用的连接归还时被关闭
+    // A connection that is not reusable is closed when returned
+    CHECK(request(pool, port, ssl, false).ok);
+    CHECK(idleCount(pool, port, ssl) == 0);
+    CHECK(totalCount(pool, port, ssl) == 0);
+    auto ret = request(pool, port, ssl);
+    CHECK(ret.ok);
+    CHECK(ret.reuse_count == 0);
+    CHECK(s_accepted == 2);
+
+    // 对端关闭空闲连接后连接被移除，之后新建连接
+    // The idle connection is removed after the peer closes it, a new one is created afterwards
+    closeServerSessions();
+    CHECK(waitIdle(pool, port, ssl, 0));
+    CHECK(totalCount(pool, port, ssl) == 0);
+    ret = request(pool, port, ssl);
+    CHECK(ret.ok);
+    CHECK(ret.reuse_count == 0);
+    CHECK(s_accepted == 3);
+    return true;
+}
+
+static bool testLimit() {
+    auto server = startServer<EchoSession>();
+    auto port = server->getPort();
+    auto pool = std::make_shared<TcpClientPool>();
+    pool->setMaxPerHost(2);
+    pool->setAcquireTimeout(0.5f);
+
+    semaphore sem;
+    vector<PooledTcpClient::Ptr> clients(3);
+    std::atomic<size_t> acquired { 0 };
+    for (size_t i = 0; i < clients.size(); ++i) {
+        pool->acquire("127.0.0.1", port, false, [&, i](const SockException &ex, const PooledTcpClient::Ptr &client) {
+            clients[i] = client;
+            ++acquired;
+            sem.post();
+        });
+    }
+    CHECK(sem.wait(5 * 1000) && sem.wait(5 * 1000));
+    CHECK(!sem.wait(200));
+    CHECK(acquired == 2);
+    CHECK(totalCount(pool, port, false) == 2);
+
+    // 归还一个后等待者拿到该连接
+    // After returning one, the waiter gets that connection
+    pool->getPoller()->sync([&]() { clients[0] = nullptr; });
+    CHECK(sem.wait(5 * 1000));
+    CHECK(clients[2] && clients[2]->getReuseCount() == 1);
+    CHECK(totalCount(pool, port, false) == 2);
+
+    // 等待超时
+    // Waiting times out
+    SockException timeout_ex;
+    pool->acquire("127.0.0.1", port, false, [&](const SockException &ex, const PooledTcpClient::Ptr &client) {
+        timeout_ex = ex;
+        sem.post();
+    });
+    CHECK(sem.wait(5 * 1000));
+    CHECK(timeout_ex.getErrCode() == Err_timeout);
+    pool->getPoller()->sync([&]() { clients.clear(); });
+
+    // 连接失败空出的名额立即交给等待者，而不是等到超时
+    // The slot freed by a failed connection goes to the waiter at once instead of waiting for the timeout
+    server = nullptr;
+    usleep(200 * 1000);
+    pool = std::make_shared<TcpClientPool>();
+    pool->setMaxPerHost(1);
+    pool->setAcquireTimeout(5.0f);
+    std::atomic<size_t> failed { 0 };
+    pool->getPoller()->sync([&]() {
+        // 在poller线程中同步发起，第二个请求必然排队
+        // Issued synchronously in the poller thread, so the second request must wait
+        for (size_t i = 0; i < 2; ++i) {
+            pool->acquire("127.0.0.1", port, false, [&](const SockException &ex, const PooledTcpClient::Ptr &client) {
+                failed += ex && ex.getErrCode() != Err_timeout;
+                sem.post();
+            });
+        }
+    });
+    CHECK(sem.wait(3 * 1000) && sem.wait(3 * 1000));
+    CHECK(failed == 2);
+    CHECK(totalCount(pool, port, false) == 0);
+    return true;
+}
+
+static bool testPrewarm(bool ssl) {
+    auto server = ssl ? startServer<SessionWithSSL<EchoSession>>() : startServer<EchoSession>();
+    auto port = server->getPort();
+    auto pool = std::make_shared<TcpClientPool>();
+    s_accepted = 0;
+
+    pool->setMinIdle("127.0.0.1", port, ssl, 3);
+    CHECK(waitIdle(pool, port, ssl, 3));
+    CHECK(s_accepted == 3);
+
+    // 取出的是预热的连接，随后补足空闲数
+    // The acquired connection is a pre-warmed one, the idle count is refilled afterwards
+    auto ret = request(pool, port, ssl, false);
+    CHECK(ret.ok);
+    CHECK(ret.reuse_count == 1);
+    CHECK(waitIdle(pool, port, ssl, 3));
+
+    // 对端关闭后重新预热
+    // Pre-warmed again after the peer closes the connections
+    closeServerSessions();
+    usleep(200 * 1000);
+    CHECK(waitIdle(pool, port, ssl, 3));
+    CHECK(totalCount(pool, port, ssl) == 3);
+    return true;
+}
+
+static void benchmark(bool ssl) {
+    static constexpr size_t kRequests = 200;
+    auto server = ssl ? startServer<SessionWithSSL<EchoSession>>() : startServer<EchoSession>();
+    auto port = server->getPort();
+    auto pool = std::make_shared<TcpClientPool>();
+
+    auto run = [&](bool reusable) {
+        auto start = getCurrentMicrosecond();
+        for (size_t i = 0; i < kRequests; ++i) {
+            request(pool, port, ssl, reusable);
+        }
+        return (getCurrentMicrosecond() - start) / (double)kRequests;
+    };
+    auto fresh = run(false);
+    auto pooled = run(true);
+    cout << (ssl ? "tls" : "tcp") << " request latency (us), new connection: " << (uint64_t)fresh
+         << ", pooled: " << (uint64_t)pooled << endl;
+}
+
+// 用法: test_tcpClientPool [--no-bench]
+// Usage: test_tcpClientPool [--no-bench]
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    bool bench = argc < 2 || string(argv[1]) != "--no-bench";
+    // tls用例使用临时生成的证书
+    // The tls cases use a certificate generated on the fly
+    auto cert = makeTestCertificate("localhost");
+    if (!SSL_Initor::Instance().loadCertificate(cert, true, "", false) || !SSL_Initor::Instance().trustCertificate(cert, false, "", false)) {
+        cout << "failed to load the generated certificate" << endl;
+        return 1;
+    }
+
+    bool ok = testReuse(false) && testLimit() && testPrewarm(false) && testReuse(true) && testPrewarm(true);
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (ok && bench) {
+        benchmark(false);
+        benchmark(true);
+    }
+    return ok ? 0 : 1;
+}
@@ -19,6 +19,7 @@
 #include "Util/TimeTicker.h"
 #include "Network/TcpServer.h"
 #include "Network/Session.h"
+#include "Network/MetricsSession.h"
 
 using namespace std;
 using namespace toolkit;
@@ -28,6 +29,9 @@ public:
     EchoSession(const Socket::Ptr &sock) :
             Session(sock) {
         DebugL;
+        // 使用onManager做定时管理
+        // Use onManager for periodic management
+        enableManager(true);
     }
     ~EchoSession() {
         DebugL;
@@ -73,6 +77,11 @@ int main() {
     TcpServer::Ptr serverSSL(new TcpServer());
     serverSSL->start<SessionWithSSL<EchoSession> >(9001);//监听9001端口
 
+    // 通过http://127.0.0.1:9002/metrics查看指标
+    // View the metrics via http://127.0.0.1:9002/metrics
+    TcpServer::Ptr serverMetrics(new TcpServer());
+    serverMetrics->start<MetricsSession>(9002);
+
     //退出程序事件处理  [AUTO-TRANSLATED:80065cb7]
     // Exit program event handling
     static semaphore sem;
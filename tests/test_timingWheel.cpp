@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Thread/semaphore.h"
+#include "Network/TcpServer.h"
+#include "Network/UdpServer.h"
+#include "Poller/TimingWheel.h"
+#include "Util/uv_errno.h"
+#include "test_check.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+static atomic<size_t> s_manager_count { 0 };
+static atomic<size_t> s_timeout_count { 0 };
+static atomic<size_t> s_udp_timeout_count { 0 };
+
+class IdleSession : public Session {
+public:
+    IdleSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void attachServer(const Server &server) override {
+        // 只依赖空闲超时，默认不参与onManager
+        // Only relies on the idle timeout, no onManager by default
+        setIdleTimeout(500);
+    }
+    void onRecv(const Buffer::Ptr &buf) override {}
+    void onError(const SockException &err) override {
+        if (err.getErrCode() == Err_timeout) {
+            ++s_timeout_count;
+        }
+    }
+    void onManager() override { ++s_manager_count; }
+};
+
+// 不设置空闲超时，依赖服务器的默认值
+// Does not set an idle timeout, relies on the default of the server
+class UdpIdleSession : public Session {
+public:
+    UdpIdleSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override {}
+    void onError(const SockException &err) override {
+        if (err.getErrCode() == Err_timeout) {
+            ++s_udp_timeout_count;
+        }
+    }
+    void onManager() override {}
+};
+
+class DummySession : public Session {
+public:
+    DummySession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override {}
+    void onError(const SockException &err) override {}
+    void onManager() override { ++s_manager_count; }
+};
+
+/**
+ * 一个连接持续发送数据，另一个保持静默，只有静默的连接应被空闲超时关闭
+ * One connection keeps sending data while another stays silent, only the silent one should be closed by the idle timeout
+ */
+static bool testIdleTimeout() {
+    auto server = std::make_shared<TcpServer>();
+    server->start<IdleSession>(0, "127.0.0.1");
+    auto active = SockUtil::connect("127.0.0.1", server->getPort(), false);
+    auto silent = SockUtil::connect("127.0.0.1", server->getPort(), false);
+    SockUtil::setNoBlocked(active, true);
+    SockUtil::setNoBlocked(silent, true);
+
+    char buf[16];
+    Ticker ticker;
+    bool silent_closed = false;
+    while (ticker.elapsedTime() < 1500) {
+        ::send(active, "ping", 4, 0);
+        if (!silent_closed && recv(silent, buf, sizeof(buf), 0) == 0) {
+            silent_closed = true;
+            InfoL << "silent connection closed after " << ticker.elapsedTime() << "ms";
+        }
+        usleep(100 * 1000);
+    }
+    auto active_ret = recv(active, buf, sizeof(buf), 0);
+    auto active_err = get_uv_error();
+    close(active);
+    close(silent);
+    CHECK(silent_closed);
+    CHECK(active_ret < 0 && active_err == UV_EAGAIN);
+    CHECK(s_timeout_count == 1);
+    CHECK(s_manager_count == 0);
+    return true;
+}
+
+/**
+ * udp会话自身不设置空闲超时时，使用服务器的默认空闲超时被回收
+ * A udp session that does not set an idle timeout itself is reaped with the default idle timeout of the server
+ */
+static bool testUdpDefaultIdleTimeout() {
+    auto server = std::make_shared<UdpServer>();
+    server->setSessionIdleTimeout(500);
+    server->start<UdpIdleSession>(0, "127.0.0.1");
+    auto fd = SockUtil::bindUdpSock(0, "127.0.0.1");
+    auto addr = SockUtil::make_sockaddr("127.0.0.1", server->getPort());
+    ::sendto(fd, "ping", 4, 0, (struct sockaddr *)&addr, SockUtil::get_sock_len((struct sockaddr *)&addr));
+
+    Ticker ticker;
+    while (ticker.elapsedTime() < 1500 && s_udp_timeout_count == 0) {
+        usleep(50 * 1000);
+    }
+    InfoL << "udp session reaped after " << ticker.elapsedTime() << "ms";
+    close(fd);
+    CHECK(s_udp_timeout_count == 1);
+    return true;
+}
+
+/**
+ * 大量空闲会话下，对比旧的全量onManager扫描与时间轮每个tick的开销
+ * With lots of idle sessions, compare the old full onManager scan with the per-tick cost of the timing wheel
+ */
+static void benchmark(const EventPoller::Ptr &poller, size_t count, bool enable_manager) {
+    auto server = std::make_shared<TcpServer>(poller);
+    vector<SessionHelper::Ptr> helpers;
+    helpers.reserve(count);
+    uint64_t full_scan_us = 0;
+    poller->sync([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            auto session = std::make_shared<DummySession>(Socket::createSocket(poller, false));
+            session->setIdleTimeout(60 * 1000);
+            session->enableManager(enable_manager);
+            helpers.emplace_back(std::make_shared<SessionHelper>(server, session, "DummySession"));
+            helpers.back()->startManager();
+        }
+        // 旧方案每2秒做一次的全量扫描
+        // The full scan done every 2 seconds by the old scheme
+        auto begin = chrono::steady_clock::now();
+        for (auto &helper : helpers) {
+            helper->session()->onManager();
+        }
+        full_scan_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count();
+    });
+
+    // 跳过创建会话时阻塞poller导致的集中补偿
+    // Skip the catch-up caused by blocking the poller while creating sessions
+    sleep(3);
+    auto wheel = TimingWheel::getInstance(poller);
+    auto before = wheel->getStatistic(true);
+    // 每100ms有1%的会话收到数据
+    // 1% of the sessions receive data every 100ms
+    auto touch = poller->doDelayTask(100, [&helpers]() -> uint64_t {
+        for (size_t i = rand() % 100; i < helpers.size(); i += 100) {
+            helpers[i]->session()->keepAlive();
+        }
+        return 100;
+    });
+    sleep(5);
+    touch->cancel();
+    auto after = wheel->getStatistic();
+    auto ticks = after.ticks - before.ticks;
+    cout << "sessions: " << count << ", onManager " << (enable_manager ? "enabled" : "disabled")
+         << ", full scan: " << full_scan_us << "us per 2s"
+         << ", wheel ticks: " << ticks
+         << ", visited/tick: " << (after.visited - before.visited) / (ticks ? ticks : 1)
+         << ", max visited/tick: " << after.max_visited_per_tick
+         << ", avg cost/tick: " << (after.total_cost_us - before.total_cost_us) / (ticks ? ticks : 1) << "us"
+         << ", max cost/tick: " << after.max_cost_us << "us"
+         << ", fired: " << after.fired - before.fired << endl;
+
+    poller->sync([&]() { helpers.clear(); });
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LInfo));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    // 每组测试使用独立的poller，互不影响
+    // Each test uses its own poller so they do not affect each other
+    EventPollerPool::setPoolSize(3);
+    vector<EventPoller::Ptr> pollers;
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+        pollers.emplace_back(static_pointer_cast<EventPoller>(executor));
+    });
+
+    bool ok = testIdleTimeout() && testUdpDefaultIdleTimeout();
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    if (!ok) {
+        return 1;
+    }
+    benchmark(pollers[1], 100 * 1000, true);
+    benchmark(pollers[2], 100 * 1000, false);
+    return 0;
+}
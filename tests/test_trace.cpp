@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <chrono>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/Trace.h"
+#include "Util/SSLBox.h"
+#include "Network/TcpServer.h"
+#include "Network/TcpClient.h"
+#include "Network/Session.h"
+
+using namespace std;
+using namespace toolkit;
+
+class EchoSession : public Session {
+public:
+    EchoSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { send(buf); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+class EchoClient : public TcpClient {
+public:
+    EchoClient(const EventPoller::Ptr &poller) : TcpClient(poller) {}
+
+    void onConnect(const SockException &ex) override {
+        if (!ex) {
+            send("ping");
+        }
+    }
+
+    void onRecv(const Buffer::Ptr &buf) override {
+        if (++_count < 100) {
+            send("ping");
+        } else {
+            _sem.post();
+        }
+    }
+
+    void onError(const SockException &ex) override { _sem.post(); }
+
+    void wait() { _sem.wait(); }
+
+private:
+    size_t _count = 0;
+    semaphore _sem;
+};
+
+/**
+ * 追踪点的耗时，关闭时应只有一次分支判断
+ * Cost of a trace point, it should be only a branch when disabled
+ */
+static double benchmarkScope(bool enabled) {
+    Tracer::setEnabled(enabled);
+    static constexpr size_t kCount = 10000000;
+    auto begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < kCount; ++i) {
+        TRACE_SCOPE("bench");
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count() / (double)kCount;
+    Tracer::setEnabled(false);
+    return ns;
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+    // 较新的openssl默认不支持旧格式的p12证书，此时退化为不加密的连接
+    // Newer openssl does not support the legacy p12 certificate by default, fall back to a plain connection then
+    // 也可以通过参数指定pem证书
+    // A pem certificate can also be specified by the argument
+    auto cert = argc > 1 ? string(argv[1]) : exeDir() + "ssl.p12";
+    auto has_ssl = SSL_Initor::Instance().loadCertificate(cert);
+    SSL_Initor::Instance().trustCertificate(cert);
+
+    cout << "trace scope, disabled: " << benchmarkScope(false) << "ns, enabled: " << benchmarkScope(true) << "ns" << endl;
+    Tracer::Instance().clear();
+
+    TcpServer::Ptr server(new TcpServer());
+    if (has_ssl) {
+        server->start<SessionWithSSL<EchoSession>>(0, "127.0.0.1");
+    } else {
+        server->start<EchoSession>(0, "127.0.0.1");
+    }
+
+    Tracer::setEnabled(true);
+    auto poller = EventPollerPool::Instance().getPoller();
+    poller->async([]() {});
+    poller->doDelayTask(10, []() { return 0; });
+    if (has_ssl) {
+        auto client = std::make_shared<TcpClientWithSSL<EchoClient>>(poller);
+        client->startConnect("127.0.0.1", server->getPort());
+        client->wait();
+    } else {
+        auto client = std::make_shared<EchoClient>(poller);
+        client->startConnect("127.0.0.1", server->getPort());
+        client->wait();
+    }
+    usleep(50 * 1000);
+    Tracer::setEnabled(false);
+
+    auto json = Tracer::Instance().dumpChromeJson();
+    auto path = exeDir() + "trace.json";
+    Tracer::Instance().dumpToFile(path);
+    bool ok = true;
+    for (auto name : { "poll_wait", "event", "task", "timer", "socket_flush", "ssl_encrypt", "ssl_decrypt" }) {
+        if (!has_ssl && start_with(name, "ssl_")) {
+            cout << name << ": skipped, certificate not loaded" << endl;
+            continue;
+        }
+        auto found = json.find(string("{\"name\":\"") + name + "\",\"ph\":\"X\"") != string::npos;
+        cout << name << ": " << (found ? "found" : "missing") << endl;
+        ok = ok && found;
+    }
+    cout << "trace size: " << json.size() << " bytes, dumped to " << path << ", open it with https://ui.perfetto.dev" << endl;
+    cout << (ok ? "all checks passed" : "checks failed") << endl;
+    return ok ? 0 : 1;
+}
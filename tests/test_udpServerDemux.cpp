@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/ZLMediaKit/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/File.h"
+#include "Util/TimeTicker.h"
+#include "Network/UdpServer.h"
+#include "Network/Session.h"
+
+#if defined(__linux__) || defined(__linux)
+#include <poll.h>
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+class EchoSession : public Session {
+public:
+    EchoSession(const Socket::Ptr &sock) : Session(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override { send(buf); }
+    void onError(const SockException &err) override {}
+    void onManager() override {}
+};
+
+#if defined(__linux__) || defined(__linux)
+
+// 模拟客户端的socket个数，每个socket配合不同的127.x.x.x源地址模拟大量对端
+// Number of client sockets, each socket simulates lots of peers with different 127.x.x.x source addresses
+static constexpr size_t kClientSocks = 8;
+// 未收到回复的最大包数
+// Max packets in flight
+static constexpr size_t kWindow = 512;
+static constexpr size_t kPacketSize = 200;
+// 稳定状态下每个对端发送的包数
+// Packets sent by each peer in steady state
+static constexpr size_t kRounds = 3;
+
+class PeerSimulator {
+public:
+    PeerSimulator(uint16_t server_port) {
+        _server.sin_family = AF_INET;
+        _server.sin_port = htons(server_port);
+        _server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        for (size_t i = 0; i < kClientSocks; ++i) {
+            auto fd = SockUtil::bindUdpSock(0, "0.0.0.0", false);
+            SockUtil::setRecvBuf(fd, 8 * 1024 * 1024);
+            SockUtil::setSendBuf(fd, 8 * 1024 * 1024);
+            _fds.emplace_back(fd);
+        }
+        _thread = std::thread([this]() { recvLoop(); });
+    }
+
+    ~PeerSimulator() {
+        _exit = true;
+        _thread.join();
+        for (auto fd : _fds) {
+            close(fd);
+        }
+    }
+
+    /**
+     * 每个对端发送一个包，返回未收到回复的包数
+     * Send a packet from each peer, return the number of packets not echoed
+     */
+    size_t round(size_t peers) {
+        char payload[kPacketSize] = { 0 };
+        size_t lost = 0;
+        auto base = _received.load();
+        for (size_t i = 0; i < peers; ++i) {
+            Ticker ticker;
+            while (i - lost > _received.load() - base + kWindow) {
+                if (ticker.elapsedTime() > 200) {
+                    // 认为在途的包已丢失
+                    // Regard the packets in flight as lost
+                    lost = i - (_received.load() - base);
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            sendFrom(i, payload, sizeof(payload));
+        }
+        Ticker ticker;
+        while (_received.load() - base + lost < peers && ticker.elapsedTime() < 500) {
+            std::this_thread::yield();
+        }
+        return peers - (_received.load() - base);
+    }
+
+private:
+    void sendFrom(size_t peer, const char *data, size_t size) {
+        // 源地址为127.1.0.0起的第peer/kClientSocks个地址
+        // The source address is the peer/kClientSocks-th address from 127.1.0.0
+        char control[CMSG_SPACE(sizeof(struct in_pktinfo))] = { 0 };
+        struct iovec iov { (void *)data, size };
+        struct msghdr msg {};
+        msg.msg_name = &_server;
+        msg.msg_namelen = sizeof(_server);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = IPPROTO_IP;
+        cmsg->cmsg_type = IP_PKTINFO;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+        auto info = (struct in_pktinfo *)CMSG_DATA(cmsg);
+        info->ipi_spec_dst.s_addr = htonl((127u << 24) + (1u << 16) + 1 + (uint32_t)(peer / kClientSocks));
+        sendmsg(_fds[peer % kClientSocks], &msg, 0);
+    }
+
+    void recvLoop() {
+        vector<struct pollfd> pfds;
+        for (auto fd : _fds) {
+            pfds.push_back({ fd, POLLIN, 0 });
+        }
+        char buf[2048];
+        while (!_exit) {
+            if (poll(pfds.data(), pfds.size(), 50) <= 0) {
+                continue;
+            }
+            for (auto &pfd : pfds) {
+                if (!(pfd.revents & POLLIN)) {
+                    continue;
+                }
+                while (recv(pfd.fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+                    ++_received;
+                }
+            }
+        }
+    }
+
+private:
+    std::atomic<bool> _exit { false };
+    std::atomic<size_t> _received { 0 };
+    struct sockaddr_in _server {};
+    vector<int> _fds;
+    std::thread _thread;
+};
+
+static size_t countFds() {
+    size_t ret = 0;
+    File::scanDir("/proc/self/fd", [&](const string &, bool) {
+        ++ret;
+        return true;
+    }, false);
+    return ret;
+}
+
+static size_t rssMB() {
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, rss = 0;
+    statm >> pages >> rss;
+    return rss * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+static void benchmark(size_t peers, bool demux) {
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (!demux && peers + 1024 > limit.rlim_cur) {
+        cout << "legacy mode, peers: " << peers << ", skipped: fd limit " << limit.rlim_cur << endl;
+        return;
+    }
+
+    auto fds = countFds();
+    auto rss = rssMB();
+    UdpServer::Ptr server(new UdpServer());
+    server->enableDemux(demux);
+    server->start<EchoSession>(0, "127.0.0.1");
+
+    {
+        PeerSimulator simulator(server->getPort());
+        Ticker ticker;
+        auto lost = simulator.round(peers);
+        auto setup_ms = ticker.elapsedTime();
+
+        ticker.resetTime();
+        for (size_t i = 0; i < kRounds; ++i) {
+            lost += simulator.round(peers);
+        }
+        auto steady_ms = ticker.elapsedTime();
+
+        cout << (demux ? "demux" : "legacy") << " mode, peers: " << peers << ", sessions: " << server->getSessionCount()
+             << ", setup: " << setup_ms << "ms, steady: " << kRounds * peers * 1000 / (steady_ms ? steady_ms : 1) << " pkt/s"
+             << ", lost: " << lost << ", fds: +" << countFds() - fds << ", rss: +" << (int64_t)rssMB() - (int64_t)rss << "MB" << endl;
+    }
+    server = nullptr;
+    // 等待各poller销毁会话
+    // Wait for the pollers to destroy the sessions
+    sleep(1);
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LWarn));
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    vector<size_t> peers_list;
+    for (int i = 1; i < argc; ++i) {
+        peers_list.emplace_back(atoi(argv[i]));
+    }
+    if (peers_list.empty()) {
+        peers_list = { 10000, 100000, 500000 };
+    }
+    for (auto peers : peers_list) {
+        benchmark(peers, false);
+        benchmark(peers, true);
+    }
+    return 0;
+}
+
+#else
+
+int main() {
+    return 0;
+}
+
+#endif